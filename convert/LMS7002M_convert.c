@@ -0,0 +1,294 @@
+///
+/// \file LMS7002M_convert.c
+///
+/// Sample format converters: scalar kernels and runtime dispatch.
+///
+/// \copyright
+/// Copyright (c) 2015-2017 Fairwaves, Inc.
+/// Copyright (c) 2015-2015 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include "LMS7002M_convert_impl.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/***********************************************************************
+ * Scalar kernels
+ **********************************************************************/
+static void cs16_to_cf32_scalar(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    float *out = (float *)outp;
+    const float k = 1.0f/scale;
+    for (size_t i = 0; i < n*2; i++) out[i] = in[i]*k;
+}
+
+static void cf32_to_cs16_scalar(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const float *in = (const float *)inp;
+    int16_t *out = (int16_t *)outp;
+    for (size_t i = 0; i < n*2; i++) out[i] = LMS7_conv_sat16(in[i]*scale);
+}
+
+static void cs16_to_cf64_scalar(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    double *out = (double *)outp;
+    const double k = 1.0/scale;
+    for (size_t i = 0; i < n*2; i++) out[i] = in[i]*k;
+}
+
+static void cf64_to_cs16_scalar(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const double *in = (const double *)inp;
+    int16_t *out = (int16_t *)outp;
+    const double k = scale;
+    for (size_t i = 0; i < n*2; i++) out[i] = LMS7_conv_sat16d(in[i]*k);
+}
+
+static void cs16_to_cs8_scalar(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    int8_t *out = (int8_t *)outp;
+    (void)scale;
+    for (size_t i = 0; i < n*2; i++) out[i] = (int8_t)(in[i] >> 8);
+}
+
+static void cs8_to_cs16_scalar(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int8_t *in = (const int8_t *)inp;
+    int16_t *out = (int16_t *)outp;
+    (void)scale;
+    for (size_t i = 0; i < n*2; i++) out[i] = (int16_t)(in[i]*256);
+}
+
+static void cs16_to_cu8_scalar(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    uint8_t *out = (uint8_t *)outp;
+    (void)scale;
+    for (size_t i = 0; i < n*2; i++) out[i] = (uint8_t)((in[i] >> 8) ^ 0x80);
+}
+
+static void cu8_to_cs16_scalar(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const uint8_t *in = (const uint8_t *)inp;
+    int16_t *out = (int16_t *)outp;
+    (void)scale;
+    for (size_t i = 0; i < n*2; i++) out[i] = (int16_t)(((int)in[i] - 128)*256);
+}
+
+static void cs16_to_cs12_scalar(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const uint16_t *in = (const uint16_t *)inp;
+    uint8_t *out = (uint8_t *)outp;
+    (void)scale;
+    for (size_t i = 0; i < n; i++)
+    {
+        const uint16_t I = in[i*2+0];
+        const uint16_t Q = in[i*2+1];
+        out[i*3+0] = (uint8_t)(I >> 4);
+        out[i*3+1] = (uint8_t)((I >> 12) | (Q & 0xf0));
+        out[i*3+2] = (uint8_t)(Q >> 8);
+    }
+}
+
+static void cs12_to_cs16_scalar(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const uint8_t *in = (const uint8_t *)inp;
+    uint16_t *out = (uint16_t *)outp;
+    (void)scale;
+    for (size_t i = 0; i < n; i++)
+    {
+        const uint16_t b0 = in[i*3+0];
+        const uint16_t b1 = in[i*3+1];
+        const uint16_t b2 = in[i*3+2];
+        out[i*2+0] = (uint16_t)((b0 << 4) | ((b1 & 0x0f) << 12));
+        out[i*2+1] = (uint16_t)((b1 & 0xf0) | (b2 << 8));
+    }
+}
+
+static void deinterleave_scalar(const void *inp, void *outAp, void *outBp, const size_t n)
+{
+    const uint32_t *in = (const uint32_t *)inp;
+    uint32_t *outA = (uint32_t *)outAp;
+    uint32_t *outB = (uint32_t *)outBp;
+    for (size_t i = 0; i < n; i++)
+    {
+        outA[i] = in[i*2+0];
+        outB[i] = in[i*2+1];
+    }
+}
+
+static void interleave_scalar(const void *inAp, const void *inBp, void *outp, const size_t n)
+{
+    const uint32_t *inA = (const uint32_t *)inAp;
+    const uint32_t *inB = (const uint32_t *)inBp;
+    uint32_t *out = (uint32_t *)outp;
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i*2+0] = inA[i];
+        out[i*2+1] = inB[i];
+    }
+}
+
+const LMS7_conv_kernels_t LMS7_conv_kernels_scalar = {
+    LMS7_CONV_SCALAR,
+    cs16_to_cf32_scalar,
+    cf32_to_cs16_scalar,
+    cs16_to_cf64_scalar,
+    cf64_to_cs16_scalar,
+    cs16_to_cs8_scalar,
+    cs8_to_cs16_scalar,
+    cs16_to_cu8_scalar,
+    cu8_to_cs16_scalar,
+    cs16_to_cs12_scalar,
+    cs12_to_cs16_scalar,
+    deinterleave_scalar,
+    interleave_scalar,
+};
+
+/***********************************************************************
+ * Kernel selection
+ **********************************************************************/
+static const LMS7_conv_kernels_t *conv_kernels_for(const LMS7_conv_isa_t isa)
+{
+    switch (isa)
+    {
+    case LMS7_CONV_SCALAR: return &LMS7_conv_kernels_scalar;
+    case LMS7_CONV_SSE2: return LMS7_conv_kernels_sse2();
+    case LMS7_CONV_AVX2: return LMS7_conv_kernels_avx2();
+    case LMS7_CONV_NEON: return LMS7_conv_kernels_neon();
+    }
+    return NULL;
+}
+
+static const LMS7_conv_kernels_t *_kernels = NULL;
+
+static const LMS7_conv_kernels_t *conv_kernels(void)
+{
+    const LMS7_conv_kernels_t *k = __atomic_load_n(&_kernels, __ATOMIC_ACQUIRE);
+    if (k != NULL) return k;
+
+    //probe from the fastest to the slowest
+    static const LMS7_conv_isa_t order[] = {
+        LMS7_CONV_AVX2, LMS7_CONV_SSE2, LMS7_CONV_NEON, LMS7_CONV_SCALAR};
+    for (size_t i = 0; i < sizeof(order)/sizeof(order[0]) && k == NULL; i++)
+    {
+        k = conv_kernels_for(order[i]);
+    }
+
+    //environment override for testing and benchmarking
+    const char *env = getenv("LMS7_CONV_ISA");
+    for (int isa = LMS7_CONV_SCALAR; env != NULL && isa <= LMS7_CONV_NEON; isa++)
+    {
+        if (strcasecmp(env, LMS7_conv_isa_name((LMS7_conv_isa_t)isa)) != 0) continue;
+        if (conv_kernels_for((LMS7_conv_isa_t)isa) != NULL) k = conv_kernels_for((LMS7_conv_isa_t)isa);
+    }
+
+    __atomic_store_n(&_kernels, k, __ATOMIC_RELEASE);
+    return k;
+}
+
+bool LMS7_conv_isa_supported(const LMS7_conv_isa_t isa)
+{
+    return conv_kernels_for(isa) != NULL;
+}
+
+LMS7_conv_isa_t LMS7_conv_get_isa(void)
+{
+    return conv_kernels()->isa;
+}
+
+int LMS7_conv_set_isa(const LMS7_conv_isa_t isa)
+{
+    const LMS7_conv_kernels_t *k = conv_kernels_for(isa);
+    if (k == NULL) return -1;
+    __atomic_store_n(&_kernels, k, __ATOMIC_RELEASE);
+    return 0;
+}
+
+const char *LMS7_conv_isa_name(const LMS7_conv_isa_t isa)
+{
+    switch (isa)
+    {
+    case LMS7_CONV_SCALAR: return "scalar";
+    case LMS7_CONV_SSE2: return "SSE2";
+    case LMS7_CONV_AVX2: return "AVX2";
+    case LMS7_CONV_NEON: return "NEON";
+    }
+    return "unknown";
+}
+
+/***********************************************************************
+ * Dispatched entry points
+ **********************************************************************/
+#define CONV_DISPATCH(name) \
+    void LMS7_conv_ ## name(const void *in, void *out, const size_t n, const float scale) \
+    { \
+        const LMS7_conv_kernels_t *k = conv_kernels(); \
+        if (k->name == NULL) k = &LMS7_conv_kernels_scalar; \
+        k->name(in, out, n, scale); \
+    }
+
+CONV_DISPATCH(cs16_to_cf32)
+CONV_DISPATCH(cf32_to_cs16)
+CONV_DISPATCH(cs16_to_cf64)
+CONV_DISPATCH(cf64_to_cs16)
+CONV_DISPATCH(cs16_to_cs8)
+CONV_DISPATCH(cs8_to_cs16)
+CONV_DISPATCH(cs16_to_cu8)
+CONV_DISPATCH(cu8_to_cs16)
+CONV_DISPATCH(cs16_to_cs12)
+CONV_DISPATCH(cs12_to_cs16)
+
+void LMS7_conv_deinterleave(const void *in, void *outA, void *outB, const size_t n)
+{
+    const LMS7_conv_kernels_t *k = conv_kernels();
+    if (k->deinterleave == NULL) k = &LMS7_conv_kernels_scalar;
+    k->deinterleave(in, outA, outB, n);
+}
+
+void LMS7_conv_interleave(const void *inA, const void *inB, void *out, const size_t n)
+{
+    const LMS7_conv_kernels_t *k = conv_kernels();
+    if (k->interleave == NULL) k = &LMS7_conv_kernels_scalar;
+    k->interleave(inA, inB, out, n);
+}
+
+void LMS7_conv_cs16_to_cs16(const void *in, void *out, const size_t n, const float scale)
+{
+    (void)scale;
+    memcpy(out, in, n*2*sizeof(int16_t));
+}
+
+LMS7_conv_fcn_t LMS7_conv_lookup(const char *from, const char *to)
+{
+    static const struct
+    {
+        const char *from;
+        const char *to;
+        LMS7_conv_fcn_t fcn;
+    } table[] = {
+        {"CS16", "CS16", LMS7_conv_cs16_to_cs16},
+        {"CS16", "CF32", LMS7_conv_cs16_to_cf32},
+        {"CF32", "CS16", LMS7_conv_cf32_to_cs16},
+        {"CS16", "CF64", LMS7_conv_cs16_to_cf64},
+        {"CF64", "CS16", LMS7_conv_cf64_to_cs16},
+        {"CS16", "CS8", LMS7_conv_cs16_to_cs8},
+        {"CS8", "CS16", LMS7_conv_cs8_to_cs16},
+        {"CS16", "CU8", LMS7_conv_cs16_to_cu8},
+        {"CU8", "CS16", LMS7_conv_cu8_to_cs16},
+        {"CS16", "CS12", LMS7_conv_cs16_to_cs12},
+        {"CS12", "CS16", LMS7_conv_cs12_to_cs16},
+    };
+
+    for (size_t i = 0; i < sizeof(table)/sizeof(table[0]); i++)
+    {
+        if (strcmp(table[i].from, from) == 0 && strcmp(table[i].to, to) == 0) return table[i].fcn;
+    }
+    return NULL;
+}
@@ -0,0 +1,167 @@
+///
+/// \file LMS7002M_convert_bench.c
+///
+/// Throughput benchmark for the sample format converters.
+/// Every kernel supported on this machine is timed
+/// and its output is checked against the scalar kernel.
+///
+/// Usage: LMS7002M_convert_bench [num samples] [iterations]
+///
+/// \copyright
+/// Copyright (c) 2015-2017 Fairwaves, Inc.
+/// Copyright (c) 2015-2015 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include <LMS7002M/LMS7002M_convert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct
+{
+    const char *from;
+    const char *to;
+    size_t in_size; //bytes per complex sample
+    size_t out_size; //bytes per complex sample
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+    {"CS16", "CF32", 4, 8},
+    {"CF32", "CS16", 8, 4},
+    {"CS16", "CF64", 4, 16},
+    {"CF64", "CS16", 16, 4},
+    {"CS16", "CS12", 4, 3},
+    {"CS12", "CS16", 3, 4},
+    {"CS16", "CS8", 4, 2},
+    {"CS8", "CS16", 2, 4},
+    {"CS16", "CU8", 4, 2},
+    {"CU8", "CS16", 2, 4},
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/*!
+ * Fill the input with a full scale ramp that also exercises saturation.
+ */
+static void fill_input(const bench_case_t *c, void *buff, const size_t n)
+{
+    if (strcmp(c->from, "CF32") == 0)
+    {
+        float *p = (float *)buff;
+        for (size_t i = 0; i < n*2; i++) p[i] = 2.2f*((float)(i % 4099)/4099.0f) - 1.1f;
+    }
+    else if (strcmp(c->from, "CF64") == 0)
+    {
+        double *p = (double *)buff;
+        for (size_t i = 0; i < n*2; i++) p[i] = 2.2*((double)(i % 4099)/4099.0) - 1.1;
+    }
+    else
+    {
+        uint8_t *p = (uint8_t *)buff;
+        for (size_t i = 0; i < n*c->in_size; i++) p[i] = (uint8_t)((i*7919) >> 3);
+    }
+}
+
+/*!
+ * Time and check the two channel deinterleave and interleave kernels.
+ * \return the number of mismatches
+ */
+static int bench_interleave(const size_t n, const size_t iters)
+{
+    int errors = 0;
+    uint32_t *in = malloc(n*2*sizeof(uint32_t));
+    uint32_t *outA = malloc(n*sizeof(uint32_t));
+    uint32_t *outB = malloc(n*sizeof(uint32_t));
+    uint32_t *back = malloc(n*2*sizeof(uint32_t));
+    for (size_t i = 0; i < n*2; i++) in[i] = (uint32_t)(i*2654435761u);
+
+    for (int isa = LMS7_CONV_SCALAR; isa <= LMS7_CONV_NEON; isa++)
+    {
+        if (LMS7_conv_set_isa((LMS7_conv_isa_t)isa) != 0) continue;
+
+        //the round trip must be exact and the split must match the input order
+        memset(back, 0, n*2*sizeof(uint32_t));
+        LMS7_conv_deinterleave(in, outA, outB, n);
+        LMS7_conv_interleave(outA, outB, back, n);
+        bool match = memcmp(in, back, n*2*sizeof(uint32_t)) == 0;
+        for (size_t i = 0; i < n && match; i++) match = outA[i] == in[i*2] && outB[i] == in[i*2+1];
+        if (!match) errors++;
+
+        const double t0 = now_seconds();
+        for (size_t i = 0; i < iters; i++) LMS7_conv_deinterleave(in, outA, outB, n);
+        const double t1 = now_seconds();
+        for (size_t i = 0; i < iters; i++) LMS7_conv_interleave(outA, outB, back, n);
+        const double t2 = now_seconds();
+
+        printf("MIMO deinterleave %-6s %10.1f Msps %8.2f GB/s %s\n",
+            LMS7_conv_isa_name((LMS7_conv_isa_t)isa),
+            (n*iters)/(t1-t0)/1e6, (n*iters*16)/(t1-t0)/1e9, match?"":"MISMATCH");
+        printf("MIMO interleave   %-6s %10.1f Msps %8.2f GB/s %s\n",
+            LMS7_conv_isa_name((LMS7_conv_isa_t)isa),
+            (n*iters)/(t2-t1)/1e6, (n*iters*16)/(t2-t1)/1e9, match?"":"MISMATCH");
+    }
+
+    free(in);
+    free(outA);
+    free(outB);
+    free(back);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t n = (argc > 1)?strtoul(argv[1], NULL, 10):65536;
+    const size_t iters = (argc > 2)?strtoul(argv[2], NULL, 10):1000;
+    int errors = 0;
+
+    //the odd length checks the scalar remainder handling
+    const size_t n_odd = n + 3;
+
+    for (size_t ci = 0; ci < sizeof(cases)/sizeof(cases[0]); ci++)
+    {
+        const bench_case_t *c = cases + ci;
+        void *in = malloc(n_odd*c->in_size);
+        void *out = malloc(n_odd*c->out_size);
+        void *ref = malloc(n_odd*c->out_size);
+        fill_input(c, in, n_odd);
+
+        LMS7_conv_set_isa(LMS7_CONV_SCALAR);
+        LMS7_conv_lookup(c->from, c->to)(in, ref, n_odd, LMS7_CONV_FULL_SCALE);
+
+        for (int isa = LMS7_CONV_SCALAR; isa <= LMS7_CONV_NEON; isa++)
+        {
+            if (LMS7_conv_set_isa((LMS7_conv_isa_t)isa) != 0) continue;
+            const LMS7_conv_fcn_t fcn = LMS7_conv_lookup(c->from, c->to);
+
+            memset(out, 0, n_odd*c->out_size);
+            fcn(in, out, n_odd, LMS7_CONV_FULL_SCALE);
+            const bool match = memcmp(out, ref, n_odd*c->out_size) == 0;
+            if (!match) errors++;
+
+            const double t0 = now_seconds();
+            for (size_t i = 0; i < iters; i++) fcn(in, out, n, LMS7_CONV_FULL_SCALE);
+            const double t1 = now_seconds();
+
+            const double msps = (n*iters)/(t1-t0)/1e6;
+            printf("%s -> %s %-6s %10.1f Msps %8.2f GB/s %s\n",
+                c->from, c->to, LMS7_conv_isa_name((LMS7_conv_isa_t)isa),
+                msps, msps*(c->in_size+c->out_size)/1e3, match?"":"MISMATCH");
+        }
+
+        free(in);
+        free(out);
+        free(ref);
+    }
+
+    errors += bench_interleave(n_odd, iters);
+
+    return (errors == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
@@ -0,0 +1,69 @@
+///
+/// \file LMS7002M_convert_impl.h
+///
+/// Kernel tables for the sample format converters.
+///
+/// \copyright
+/// Copyright (c) 2015-2017 Fairwaves, Inc.
+/// Copyright (c) 2015-2015 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#pragma once
+#include <LMS7002M/LMS7002M_convert.h>
+
+/*!
+ * One set of kernels per instruction set.
+ * A NULL entry falls back to the scalar kernel.
+ */
+typedef struct
+{
+    LMS7_conv_isa_t isa;
+    LMS7_conv_fcn_t cs16_to_cf32;
+    LMS7_conv_fcn_t cf32_to_cs16;
+    LMS7_conv_fcn_t cs16_to_cf64;
+    LMS7_conv_fcn_t cf64_to_cs16;
+    LMS7_conv_fcn_t cs16_to_cs8;
+    LMS7_conv_fcn_t cs8_to_cs16;
+    LMS7_conv_fcn_t cs16_to_cu8;
+    LMS7_conv_fcn_t cu8_to_cs16;
+    LMS7_conv_fcn_t cs16_to_cs12;
+    LMS7_conv_fcn_t cs12_to_cs16;
+    LMS7_conv_deint_fcn_t deinterleave;
+    LMS7_conv_int_fcn_t interleave;
+} LMS7_conv_kernels_t;
+
+//! The portable kernels, always available
+extern const LMS7_conv_kernels_t LMS7_conv_kernels_scalar;
+
+//! The x86 kernels or NULL when not supported by the build or CPU
+const LMS7_conv_kernels_t *LMS7_conv_kernels_sse2(void);
+const LMS7_conv_kernels_t *LMS7_conv_kernels_avx2(void);
+
+//! The ARM kernels or NULL when not supported by the build or CPU
+const LMS7_conv_kernels_t *LMS7_conv_kernels_neon(void);
+
+/*!
+ * Round a scaled float to int16 with saturation.
+ * This is the reference behaviour every SIMD kernel must match.
+ */
+static inline int16_t LMS7_conv_sat16(float x)
+{
+    if (x > 32767.0f) x = 32767.0f;
+    if (x < -32768.0f) x = -32768.0f;
+    //the magic add rounds to nearest even like cvtps2dq: |x| < 2^22
+    const float magic = 12582912.0f; //1.5*2^23
+    const float r = x + magic;
+    return (int16_t)(int)(r - magic);
+}
+
+//! Double precision version of LMS7_conv_sat16()
+static inline int16_t LMS7_conv_sat16d(double x)
+{
+    if (x > 32767.0) x = 32767.0;
+    if (x < -32768.0) x = -32768.0;
+    const double magic = 6755399441055744.0; //1.5*2^52
+    const double r = x + magic;
+    return (int16_t)(int)(r - magic);
+}
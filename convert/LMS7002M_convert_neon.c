@@ -0,0 +1,314 @@
+///
+/// \file LMS7002M_convert_neon.c
+///
+/// Sample format converters: ARM NEON kernels.
+/// On 32-bit ARM this file must be built with -mfpu=neon,
+/// the kernels are only selected when the CPU reports NEON.
+///
+/// \copyright
+/// Copyright (c) 2015-2017 Fairwaves, Inc.
+/// Copyright (c) 2015-2015 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include "LMS7002M_convert_impl.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+#ifndef __aarch64__
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/*!
+ * Round to nearest even, the input is already clamped to the int16 range.
+ */
+static inline int32x4_t neon_round_s32(const float32x4_t x)
+{
+#ifdef __aarch64__
+    return vcvtnq_s32_f32(x);
+#else
+    //armv7 only converts with truncation: use the magic add
+    const float32x4_t magic = vdupq_n_f32(12582912.0f);
+    return vcvtq_s32_f32(vsubq_f32(vaddq_f32(x, magic), magic));
+#endif
+}
+
+/***********************************************************************
+ * NEON kernels: 4 complex samples per iteration
+ **********************************************************************/
+static void cs16_to_cf32_neon(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    float *out = (float *)outp;
+    const float k = 1.0f/scale;
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        const int16x8_t s16 = vld1q_s16(in+i*2);
+        const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s16)));
+        const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s16)));
+        vst1q_f32(out+i*2+0, vmulq_n_f32(lo, k));
+        vst1q_f32(out+i*2+4, vmulq_n_f32(hi, k));
+    }
+
+    LMS7_conv_kernels_scalar.cs16_to_cf32(in+i*2, out+i*2, n-i, scale);
+}
+
+static void cf32_to_cs16_neon(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const float *in = (const float *)inp;
+    int16_t *out = (int16_t *)outp;
+    const float32x4_t max = vdupq_n_f32(32767.0f);
+    const float32x4_t min = vdupq_n_f32(-32768.0f);
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        float32x4_t lo = vmulq_n_f32(vld1q_f32(in+i*2+0), scale);
+        float32x4_t hi = vmulq_n_f32(vld1q_f32(in+i*2+4), scale);
+        lo = vmaxq_f32(vminq_f32(lo, max), min);
+        hi = vmaxq_f32(vminq_f32(hi, max), min);
+        const int16x8_t s16 = vcombine_s16(
+            vqmovn_s32(neon_round_s32(lo)),
+            vqmovn_s32(neon_round_s32(hi)));
+        vst1q_s16(out+i*2, s16);
+    }
+
+    LMS7_conv_kernels_scalar.cf32_to_cs16(in+i*2, out+i*2, n-i, scale);
+}
+
+#ifdef __aarch64__
+static void cs16_to_cf64_neon(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    double *out = (double *)outp;
+    const double k = 1.0/scale;
+    size_t i = 0;
+
+    for (; i+2 <= n; i+=2)
+    {
+        const int32x4_t s32 = vmovl_s16(vld1_s16(in+i*2));
+        const float64x2_t lo = vcvtq_f64_s64(vmovl_s32(vget_low_s32(s32)));
+        const float64x2_t hi = vcvtq_f64_s64(vmovl_s32(vget_high_s32(s32)));
+        vst1q_f64(out+i*2+0, vmulq_n_f64(lo, k));
+        vst1q_f64(out+i*2+2, vmulq_n_f64(hi, k));
+    }
+
+    LMS7_conv_kernels_scalar.cs16_to_cf64(in+i*2, out+i*2, n-i, scale);
+}
+
+static void cf64_to_cs16_neon(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const double *in = (const double *)inp;
+    int16_t *out = (int16_t *)outp;
+    const double k = scale;
+    const float64x2_t max = vdupq_n_f64(32767.0);
+    const float64x2_t min = vdupq_n_f64(-32768.0);
+    size_t i = 0;
+
+    for (; i+2 <= n; i+=2)
+    {
+        float64x2_t lo = vmulq_n_f64(vld1q_f64(in+i*2+0), k);
+        float64x2_t hi = vmulq_n_f64(vld1q_f64(in+i*2+2), k);
+        lo = vmaxq_f64(vminq_f64(lo, max), min);
+        hi = vmaxq_f64(vminq_f64(hi, max), min);
+        const int32x4_t s32 = vcombine_s32(
+            vmovn_s64(vcvtnq_s64_f64(lo)),
+            vmovn_s64(vcvtnq_s64_f64(hi)));
+        vst1_s16(out+i*2, vqmovn_s32(s32));
+    }
+
+    LMS7_conv_kernels_scalar.cf64_to_cs16(in+i*2, out+i*2, n-i, scale);
+}
+#endif //__aarch64__
+
+static void cs16_to_cs8_neon(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    int8_t *out = (int8_t *)outp;
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        const int8x8_t lo = vshrn_n_s16(vld1q_s16(in+i*2+0), 8);
+        const int8x8_t hi = vshrn_n_s16(vld1q_s16(in+i*2+8), 8);
+        vst1q_s8(out+i*2, vcombine_s8(lo, hi));
+    }
+
+    LMS7_conv_kernels_scalar.cs16_to_cs8(in+i*2, out+i*2, n-i, scale);
+}
+
+static void cs8_to_cs16_neon(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int8_t *in = (const int8_t *)inp;
+    int16_t *out = (int16_t *)outp;
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        const int8x16_t s8 = vld1q_s8(in+i*2);
+        vst1q_s16(out+i*2+0, vshll_n_s8(vget_low_s8(s8), 8));
+        vst1q_s16(out+i*2+8, vshll_n_s8(vget_high_s8(s8), 8));
+    }
+
+    LMS7_conv_kernels_scalar.cs8_to_cs16(in+i*2, out+i*2, n-i, scale);
+}
+
+static void cs16_to_cu8_neon(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    uint8_t *out = (uint8_t *)outp;
+    const uint8x16_t flip = vdupq_n_u8(0x80);
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        const int8x8_t lo = vshrn_n_s16(vld1q_s16(in+i*2+0), 8);
+        const int8x8_t hi = vshrn_n_s16(vld1q_s16(in+i*2+8), 8);
+        vst1q_u8(out+i*2, veorq_u8(vreinterpretq_u8_s8(vcombine_s8(lo, hi)), flip));
+    }
+
+    LMS7_conv_kernels_scalar.cs16_to_cu8(in+i*2, out+i*2, n-i, scale);
+}
+
+static void cu8_to_cs16_neon(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const uint8_t *in = (const uint8_t *)inp;
+    int16_t *out = (int16_t *)outp;
+    const uint8x16_t flip = vdupq_n_u8(0x80);
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        const int8x16_t s8 = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(in+i*2), flip));
+        vst1q_s16(out+i*2+0, vshll_n_s8(vget_low_s8(s8), 8));
+        vst1q_s16(out+i*2+8, vshll_n_s8(vget_high_s8(s8), 8));
+    }
+
+    LMS7_conv_kernels_scalar.cu8_to_cs16(in+i*2, out+i*2, n-i, scale);
+}
+
+/*!
+ * CS12 uses the structured loads and stores:
+ * 8 complex samples are split into I, Q lanes or the 3 byte planes.
+ */
+static void cs16_to_cs12_neon(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const uint16_t *in = (const uint16_t *)inp;
+    uint8_t *out = (uint8_t *)outp;
+    const uint16x8_t maskQ = vdupq_n_u16(0x00f0);
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        const uint16x8x2_t iq = vld2q_u16(in+i*2);
+        uint8x8x3_t b;
+        b.val[0] = vmovn_u16(vshrq_n_u16(iq.val[0], 4));
+        b.val[1] = vmovn_u16(vorrq_u16(vshrq_n_u16(iq.val[0], 12), vandq_u16(iq.val[1], maskQ)));
+        b.val[2] = vshrn_n_u16(iq.val[1], 8);
+        vst3_u8(out+i*3, b);
+    }
+
+    LMS7_conv_kernels_scalar.cs16_to_cs12(in+i*2, out+i*3, n-i, scale);
+}
+
+static void cs12_to_cs16_neon(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const uint8_t *in = (const uint8_t *)inp;
+    uint16_t *out = (uint16_t *)outp;
+    const uint8x8_t lo4 = vdup_n_u8(0x0f);
+    const uint8x8_t hi4 = vdup_n_u8(0xf0);
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        const uint8x8x3_t b = vld3_u8(in+i*3);
+        uint16x8x2_t iq;
+        iq.val[0] = vshlq_n_u16(vorrq_u16(vshll_n_u8(vand_u8(b.val[1], lo4), 8), vmovl_u8(b.val[0])), 4);
+        iq.val[1] = vorrq_u16(vshll_n_u8(b.val[2], 8), vmovl_u8(vand_u8(b.val[1], hi4)));
+        vst2q_u16(out+i*2, iq);
+    }
+
+    LMS7_conv_kernels_scalar.cs12_to_cs16(in+i*3, out+i*2, n-i, scale);
+}
+
+static void deinterleave_neon(const void *inp, void *outAp, void *outBp, const size_t n)
+{
+    const uint32_t *in = (const uint32_t *)inp;
+    uint32_t *outA = (uint32_t *)outAp;
+    uint32_t *outB = (uint32_t *)outBp;
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        const uint32x4x2_t ab = vld2q_u32(in+i*2);
+        vst1q_u32(outA+i, ab.val[0]);
+        vst1q_u32(outB+i, ab.val[1]);
+    }
+
+    LMS7_conv_kernels_scalar.deinterleave(in+i*2, outA+i, outB+i, n-i);
+}
+
+static void interleave_neon(const void *inAp, const void *inBp, void *outp, const size_t n)
+{
+    const uint32_t *inA = (const uint32_t *)inAp;
+    const uint32_t *inB = (const uint32_t *)inBp;
+    uint32_t *out = (uint32_t *)outp;
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        uint32x4x2_t ab;
+        ab.val[0] = vld1q_u32(inA+i);
+        ab.val[1] = vld1q_u32(inB+i);
+        vst2q_u32(out+i*2, ab);
+    }
+
+    LMS7_conv_kernels_scalar.interleave(inA+i, inB+i, out+i*2, n-i);
+}
+
+/***********************************************************************
+ * Kernel table
+ **********************************************************************/
+static const LMS7_conv_kernels_t kernels_neon = {
+    LMS7_CONV_NEON,
+    cs16_to_cf32_neon,
+    cf32_to_cs16_neon,
+#ifdef __aarch64__
+    cs16_to_cf64_neon,
+    cf64_to_cs16_neon,
+#else
+    NULL, //no double precision vectors on armv7
+    NULL,
+#endif
+    cs16_to_cs8_neon,
+    cs8_to_cs16_neon,
+    cs16_to_cu8_neon,
+    cu8_to_cs16_neon,
+    cs16_to_cs12_neon,
+    cs12_to_cs16_neon,
+    deinterleave_neon,
+    interleave_neon,
+};
+
+const LMS7_conv_kernels_t *LMS7_conv_kernels_neon(void)
+{
+#ifdef __aarch64__
+    return &kernels_neon; //always present
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON)?&kernels_neon:NULL;
+#endif
+}
+
+#else //no neon
+
+const LMS7_conv_kernels_t *LMS7_conv_kernels_neon(void)
+{
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,444 @@
+///
+/// \file LMS7002M_convert_x86.c
+///
+/// Sample format converters: SSE2 and AVX2 kernels.
+/// The kernels use function target attributes so that
+/// the file builds without any ISA specific compiler flags;
+/// the dispatcher only selects them when the CPU supports them.
+///
+/// \copyright
+/// Copyright (c) 2015-2017 Fairwaves, Inc.
+/// Copyright (c) 2015-2015 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include "LMS7002M_convert_impl.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+/***********************************************************************
+ * SSE2 kernels: 4 complex samples per iteration
+ **********************************************************************/
+SSE2 static void cs16_to_cf32_sse2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    float *out = (float *)outp;
+    const __m128 k = _mm_set1_ps(1.0f/scale);
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        const __m128i s16 = _mm_loadu_si128((const __m128i *)(in+i*2));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s16, s16), 16);
+        _mm_storeu_ps(out+i*2+0, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+        _mm_storeu_ps(out+i*2+4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+    }
+
+    LMS7_conv_kernels_scalar.cs16_to_cf32(in+i*2, out+i*2, n-i, scale);
+}
+
+SSE2 static void cf32_to_cs16_sse2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const float *in = (const float *)inp;
+    int16_t *out = (int16_t *)outp;
+    const __m128 k = _mm_set1_ps(scale);
+    const __m128 max = _mm_set1_ps(32767.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        __m128 lo = _mm_mul_ps(_mm_loadu_ps(in+i*2+0), k);
+        __m128 hi = _mm_mul_ps(_mm_loadu_ps(in+i*2+4), k);
+        lo = _mm_max_ps(_mm_min_ps(lo, max), min);
+        hi = _mm_max_ps(_mm_min_ps(hi, max), min);
+        const __m128i s16 = _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+        _mm_storeu_si128((__m128i *)(out+i*2), s16);
+    }
+
+    LMS7_conv_kernels_scalar.cf32_to_cs16(in+i*2, out+i*2, n-i, scale);
+}
+
+SSE2 static void cs16_to_cf64_sse2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    double *out = (double *)outp;
+    const __m128d k = _mm_set1_pd(1.0/scale);
+    size_t i = 0;
+
+    for (; i+2 <= n; i+=2)
+    {
+        const __m128i s16 = _mm_loadl_epi64((const __m128i *)(in+i*2));
+        const __m128i s32 = _mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16);
+        _mm_storeu_pd(out+i*2+0, _mm_mul_pd(_mm_cvtepi32_pd(s32), k));
+        _mm_storeu_pd(out+i*2+2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(s32, 8)), k));
+    }
+
+    LMS7_conv_kernels_scalar.cs16_to_cf64(in+i*2, out+i*2, n-i, scale);
+}
+
+SSE2 static void cf64_to_cs16_sse2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const double *in = (const double *)inp;
+    int16_t *out = (int16_t *)outp;
+    const __m128d k = _mm_set1_pd(scale);
+    const __m128d max = _mm_set1_pd(32767.0);
+    const __m128d min = _mm_set1_pd(-32768.0);
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        __m128i s32[4];
+        for (size_t j = 0; j < 4; j++)
+        {
+            __m128d x = _mm_mul_pd(_mm_loadu_pd(in+i*2+j*2), k);
+            x = _mm_max_pd(_mm_min_pd(x, max), min);
+            s32[j] = _mm_cvtpd_epi32(x); //2 results in the low half
+        }
+        const __m128i lo = _mm_unpacklo_epi64(s32[0], s32[1]);
+        const __m128i hi = _mm_unpacklo_epi64(s32[2], s32[3]);
+        _mm_storeu_si128((__m128i *)(out+i*2), _mm_packs_epi32(lo, hi));
+    }
+
+    LMS7_conv_kernels_scalar.cf64_to_cs16(in+i*2, out+i*2, n-i, scale);
+}
+
+/*!
+ * Shared body for the 8-bit formats: flip is 0x80 for CU8.
+ */
+SSE2 static inline void cs16_to_8bit_sse2(const int16_t *in, uint8_t *out, const size_t n, const int flip)
+{
+    const __m128i x = _mm_set1_epi8((char)flip);
+    for (size_t i = 0; i < n; i+=8)
+    {
+        const __m128i lo = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(in+i*2+0)), 8);
+        const __m128i hi = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(in+i*2+8)), 8);
+        _mm_storeu_si128((__m128i *)(out+i*2), _mm_xor_si128(_mm_packs_epi16(lo, hi), x));
+    }
+}
+
+SSE2 static inline void cs8bit_to_cs16_sse2(const uint8_t *in, int16_t *out, const size_t n, const int flip)
+{
+    const __m128i x = _mm_set1_epi8((char)flip);
+    const __m128i zero = _mm_setzero_si128();
+    for (size_t i = 0; i < n; i+=8)
+    {
+        const __m128i s8 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in+i*2)), x);
+        _mm_storeu_si128((__m128i *)(out+i*2+0), _mm_unpacklo_epi8(zero, s8));
+        _mm_storeu_si128((__m128i *)(out+i*2+8), _mm_unpackhi_epi8(zero, s8));
+    }
+}
+
+SSE2 static void cs16_to_cs8_sse2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const size_t m = n & ~(size_t)7;
+    cs16_to_8bit_sse2((const int16_t *)inp, (uint8_t *)outp, m, 0);
+    LMS7_conv_kernels_scalar.cs16_to_cs8((const int16_t *)inp+m*2, (uint8_t *)outp+m*2, n-m, scale);
+}
+
+SSE2 static void cs8_to_cs16_sse2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const size_t m = n & ~(size_t)7;
+    cs8bit_to_cs16_sse2((const uint8_t *)inp, (int16_t *)outp, m, 0);
+    LMS7_conv_kernels_scalar.cs8_to_cs16((const uint8_t *)inp+m*2, (int16_t *)outp+m*2, n-m, scale);
+}
+
+SSE2 static void cs16_to_cu8_sse2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const size_t m = n & ~(size_t)7;
+    cs16_to_8bit_sse2((const int16_t *)inp, (uint8_t *)outp, m, 0x80);
+    LMS7_conv_kernels_scalar.cs16_to_cu8((const int16_t *)inp+m*2, (uint8_t *)outp+m*2, n-m, scale);
+}
+
+SSE2 static void cu8_to_cs16_sse2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const size_t m = n & ~(size_t)7;
+    cs8bit_to_cs16_sse2((const uint8_t *)inp, (int16_t *)outp, m, 0x80);
+    LMS7_conv_kernels_scalar.cu8_to_cs16((const uint8_t *)inp+m*2, (int16_t *)outp+m*2, n-m, scale);
+}
+
+/***********************************************************************
+ * AVX2 kernels: 8 complex samples per iteration
+ **********************************************************************/
+AVX2 static void cs16_to_cf32_avx2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    float *out = (float *)outp;
+    const __m256 k = _mm256_set1_ps(1.0f/scale);
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        const __m128i s16lo = _mm_loadu_si128((const __m128i *)(in+i*2+0));
+        const __m128i s16hi = _mm_loadu_si128((const __m128i *)(in+i*2+8));
+        const __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s16lo));
+        const __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s16hi));
+        _mm256_storeu_ps(out+i*2+0, _mm256_mul_ps(lo, k));
+        _mm256_storeu_ps(out+i*2+8, _mm256_mul_ps(hi, k));
+    }
+
+    cs16_to_cf32_sse2(in+i*2, out+i*2, n-i, scale);
+}
+
+AVX2 static void cf32_to_cs16_avx2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const float *in = (const float *)inp;
+    int16_t *out = (int16_t *)outp;
+    const __m256 k = _mm256_set1_ps(scale);
+    const __m256 max = _mm256_set1_ps(32767.0f);
+    const __m256 min = _mm256_set1_ps(-32768.0f);
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        __m256 lo = _mm256_mul_ps(_mm256_loadu_ps(in+i*2+0), k);
+        __m256 hi = _mm256_mul_ps(_mm256_loadu_ps(in+i*2+8), k);
+        lo = _mm256_max_ps(_mm256_min_ps(lo, max), min);
+        hi = _mm256_max_ps(_mm256_min_ps(hi, max), min);
+        //packs works per 128-bit lane, restore the sample order after
+        const __m256i s16 = _mm256_packs_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+        _mm256_storeu_si256((__m256i *)(out+i*2), _mm256_permute4x64_epi64(s16, 0xd8));
+    }
+
+    cf32_to_cs16_sse2(in+i*2, out+i*2, n-i, scale);
+}
+
+AVX2 static void cs16_to_cf64_avx2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    double *out = (double *)outp;
+    const __m256d k = _mm256_set1_pd(1.0/scale);
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        const __m128i s32 = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)(in+i*2+0)));
+        const __m128i s32hi = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)(in+i*2+4)));
+        _mm256_storeu_pd(out+i*2+0, _mm256_mul_pd(_mm256_cvtepi32_pd(s32), k));
+        _mm256_storeu_pd(out+i*2+4, _mm256_mul_pd(_mm256_cvtepi32_pd(s32hi), k));
+    }
+
+    cs16_to_cf64_sse2(in+i*2, out+i*2, n-i, scale);
+}
+
+AVX2 static void cf64_to_cs16_avx2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const double *in = (const double *)inp;
+    int16_t *out = (int16_t *)outp;
+    const __m256d k = _mm256_set1_pd(scale);
+    const __m256d max = _mm256_set1_pd(32767.0);
+    const __m256d min = _mm256_set1_pd(-32768.0);
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        __m256d lo = _mm256_mul_pd(_mm256_loadu_pd(in+i*2+0), k);
+        __m256d hi = _mm256_mul_pd(_mm256_loadu_pd(in+i*2+4), k);
+        lo = _mm256_max_pd(_mm256_min_pd(lo, max), min);
+        hi = _mm256_max_pd(_mm256_min_pd(hi, max), min);
+        const __m128i s16 = _mm_packs_epi32(_mm256_cvtpd_epi32(lo), _mm256_cvtpd_epi32(hi));
+        _mm_storeu_si128((__m128i *)(out+i*2), s16);
+    }
+
+    cf64_to_cs16_sse2(in+i*2, out+i*2, n-i, scale);
+}
+
+/*!
+ * CS12 uses byte shuffles (SSSE3, implied by AVX2).
+ * Each 32-bit lane holds one complex sample in 24 bits:
+ * bits [11:0] = I[15:4] and bits [23:12] = Q[15:4].
+ */
+AVX2 static void cs16_to_cs12_avx2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const int16_t *in = (const int16_t *)inp;
+    uint8_t *out = (uint8_t *)outp;
+    const __m128i maskI = _mm_set1_epi32(0x00000fff);
+    const __m128i maskQ = _mm_set1_epi32(0x00fff000);
+    const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        __m128i w0 = _mm_loadu_si128((const __m128i *)(in+i*2+0));
+        __m128i w1 = _mm_loadu_si128((const __m128i *)(in+i*2+8));
+        w0 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(w0, 4), maskI), _mm_and_si128(_mm_srli_epi32(w0, 8), maskQ));
+        w1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(w1, 4), maskI), _mm_and_si128(_mm_srli_epi32(w1, 8), maskQ));
+        w0 = _mm_shuffle_epi8(w0, pack); //12 bytes
+        w1 = _mm_shuffle_epi8(w1, pack); //12 bytes
+        _mm_storeu_si128((__m128i *)(out+i*3), _mm_or_si128(w0, _mm_slli_si128(w1, 12)));
+        _mm_storel_epi64((__m128i *)(out+i*3+16), _mm_srli_si128(w1, 4));
+    }
+
+    LMS7_conv_kernels_scalar.cs16_to_cs12(in+i*2, out+i*3, n-i, scale);
+}
+
+AVX2 static void cs12_to_cs16_avx2(const void *inp, void *outp, const size_t n, const float scale)
+{
+    const uint8_t *in = (const uint8_t *)inp;
+    int16_t *out = (int16_t *)outp;
+    const __m128i maskI = _mm_set1_epi32(0x0000fff0);
+    const __m128i maskQ = _mm_set1_epi32((int)0xfff00000);
+    const __m128i unpack = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    size_t i = 0;
+
+    //each load reads 16 bytes to use 12, stay clear of the input end
+    for (; i+6 <= n; i+=4)
+    {
+        const __m128i w = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in+i*3)), unpack);
+        const __m128i s16 = _mm_or_si128(
+            _mm_and_si128(_mm_slli_epi32(w, 4), maskI),
+            _mm_and_si128(_mm_slli_epi32(w, 8), maskQ));
+        _mm_storeu_si128((__m128i *)(out+i*2), s16);
+    }
+
+    LMS7_conv_kernels_scalar.cs12_to_cs16(in+i*3, out+i*2, n-i, scale);
+}
+
+/***********************************************************************
+ * Channel interleaving: one 32-bit word per complex sample
+ **********************************************************************/
+SSE2 static void deinterleave_sse2(const void *inp, void *outAp, void *outBp, const size_t n)
+{
+    const uint32_t *in = (const uint32_t *)inp;
+    uint32_t *outA = (uint32_t *)outAp;
+    uint32_t *outB = (uint32_t *)outBp;
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        //A0 B0 A1 B1 -> A0 A1 B0 B1
+        const __m128i lo = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(in+i*2+0)), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m128i hi = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(in+i*2+4)), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i *)(outA+i), _mm_unpacklo_epi64(lo, hi));
+        _mm_storeu_si128((__m128i *)(outB+i), _mm_unpackhi_epi64(lo, hi));
+    }
+
+    LMS7_conv_kernels_scalar.deinterleave(in+i*2, outA+i, outB+i, n-i);
+}
+
+SSE2 static void interleave_sse2(const void *inAp, const void *inBp, void *outp, const size_t n)
+{
+    const uint32_t *inA = (const uint32_t *)inAp;
+    const uint32_t *inB = (const uint32_t *)inBp;
+    uint32_t *out = (uint32_t *)outp;
+    size_t i = 0;
+
+    for (; i+4 <= n; i+=4)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i *)(inA+i));
+        const __m128i b = _mm_loadu_si128((const __m128i *)(inB+i));
+        _mm_storeu_si128((__m128i *)(out+i*2+0), _mm_unpacklo_epi32(a, b));
+        _mm_storeu_si128((__m128i *)(out+i*2+4), _mm_unpackhi_epi32(a, b));
+    }
+
+    LMS7_conv_kernels_scalar.interleave(inA+i, inB+i, out+i*2, n-i);
+}
+
+AVX2 static void deinterleave_avx2(const void *inp, void *outAp, void *outBp, const size_t n)
+{
+    const uint32_t *in = (const uint32_t *)inp;
+    uint32_t *outA = (uint32_t *)outAp;
+    uint32_t *outB = (uint32_t *)outBp;
+    const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        //A0 B0 .. A3 B3 -> A0 .. A3 B0 .. B3
+        const __m256i lo = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(in+i*2+0)), idx);
+        const __m256i hi = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(in+i*2+8)), idx);
+        _mm256_storeu_si256((__m256i *)(outA+i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(outB+i), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    LMS7_conv_kernels_scalar.deinterleave(in+i*2, outA+i, outB+i, n-i);
+}
+
+AVX2 static void interleave_avx2(const void *inAp, const void *inBp, void *outp, const size_t n)
+{
+    const uint32_t *inA = (const uint32_t *)inAp;
+    const uint32_t *inB = (const uint32_t *)inBp;
+    uint32_t *out = (uint32_t *)outp;
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        const __m256i a = _mm256_loadu_si256((const __m256i *)(inA+i));
+        const __m256i b = _mm256_loadu_si256((const __m256i *)(inB+i));
+        //the unpacks work per 128-bit lane: fix the lane order on store
+        const __m256i lo = _mm256_unpacklo_epi32(a, b);
+        const __m256i hi = _mm256_unpackhi_epi32(a, b);
+        _mm256_storeu_si256((__m256i *)(out+i*2+0), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(out+i*2+8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    LMS7_conv_kernels_scalar.interleave(inA+i, inB+i, out+i*2, n-i);
+}
+
+/***********************************************************************
+ * Kernel tables
+ **********************************************************************/
+static const LMS7_conv_kernels_t kernels_sse2 = {
+    LMS7_CONV_SSE2,
+    cs16_to_cf32_sse2,
+    cf32_to_cs16_sse2,
+    cs16_to_cf64_sse2,
+    cf64_to_cs16_sse2,
+    cs16_to_cs8_sse2,
+    cs8_to_cs16_sse2,
+    cs16_to_cu8_sse2,
+    cu8_to_cs16_sse2,
+    NULL, //CS12 needs byte shuffles
+    NULL,
+    deinterleave_sse2,
+    interleave_sse2,
+};
+
+//the 8-bit formats are memory bound, SSE2 is as fast there
+static const LMS7_conv_kernels_t kernels_avx2 = {
+    LMS7_CONV_AVX2,
+    cs16_to_cf32_avx2,
+    cf32_to_cs16_avx2,
+    cs16_to_cf64_avx2,
+    cf64_to_cs16_avx2,
+    cs16_to_cs8_sse2,
+    cs8_to_cs16_sse2,
+    cs16_to_cu8_sse2,
+    cu8_to_cs16_sse2,
+    cs16_to_cs12_avx2,
+    cs12_to_cs16_avx2,
+    deinterleave_avx2,
+    interleave_avx2,
+};
+
+const LMS7_conv_kernels_t *LMS7_conv_kernels_sse2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2")?&kernels_sse2:NULL;
+}
+
+const LMS7_conv_kernels_t *LMS7_conv_kernels_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2")?&kernels_avx2:NULL;
+}
+
+#else //not x86
+
+const LMS7_conv_kernels_t *LMS7_conv_kernels_sse2(void)
+{
+    return NULL;
+}
+
+const LMS7_conv_kernels_t *LMS7_conv_kernels_avx2(void)
+{
+    return NULL;
+}
+
+#endif
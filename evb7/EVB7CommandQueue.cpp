@@ -0,0 +1,185 @@
+//
+// Timed register write queue for the EVB7.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include "EVB7CommandQueue.hpp"
+#include <SoapySDR/Logger.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+//pending commands before push() refuses more
+#define CMD_QUEUE_DEPTH 1024
+
+//bounds of the margin the scheduler wakes up before a command
+//and spins for: the margin follows the measured wake up latency
+#define CMD_MIN_SPIN_NS 20000
+#define CMD_MAX_SPIN_NS 2000000
+
+//weight of a new duration in the latency model
+#define CMD_FIT_ALPHA (1.0/16)
+
+EVB7CommandQueue::EVB7CommandQueue(const TimeFcn &getTime, const WriteFcn &write, const long long toleranceNs):
+    _getTime(getTime),
+    _write(write),
+    _toleranceNs(toleranceNs),
+    _running(true),
+    _wakeLateNs(CMD_MIN_SPIN_NS),
+    _sumW(0.0), _sumN(0.0), _sumNN(0.0), _sumD(0.0), _sumND(0.0),
+    _stats()
+{
+    _thread = std::thread(&EVB7CommandQueue::schedulerLoop, this);
+}
+
+EVB7CommandQueue::~EVB7CommandQueue(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+        _cond.notify_all();
+    }
+    _thread.join();
+}
+
+bool EVB7CommandQueue::push(const long long timeNs, const std::vector<int> &addrs, const std::vector<int> &values)
+{
+    if (addrs.size() != values.size()) return false;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_commands.size() >= CMD_QUEUE_DEPTH) return false;
+
+    Command cmd;
+    cmd.addrs = addrs;
+    cmd.values = values;
+    const bool first = _commands.empty() or timeNs < _commands.begin()->first;
+    _commands.emplace(timeNs, std::move(cmd));
+
+    //the scheduler only needs a new deadline when this command is first
+    if (first) _cond.notify_all();
+    return true;
+}
+
+void EVB7CommandQueue::clear(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _commands.clear();
+}
+
+size_t EVB7CommandQueue::pending(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _commands.size();
+}
+
+void EVB7CommandQueue::calibrate(const std::vector<int> &addrs, const std::vector<int> &values, const size_t numRuns)
+{
+    Command cmd;
+    cmd.addrs = addrs;
+    cmd.values = values;
+    for (size_t i = 0; i < numRuns; i++)
+    {
+        long long doneNs = 0;
+        const long long durationNs = this->write(cmd, doneNs);
+        std::lock_guard<std::mutex> lock(_mutex);
+        this->fit(addrs.size(), durationNs);
+    }
+}
+
+EVB7CommandStats EVB7CommandQueue::getStats(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+/*******************************************************************
+ * Latency model
+ ******************************************************************/
+long long EVB7CommandQueue::estimateNs(const size_t numWords) const
+{
+    return std::llround(_stats.overheadNs + numWords*_stats.wordNs);
+}
+
+long long EVB7CommandQueue::write(const Command &cmd, long long &doneNs)
+{
+    const long long t0 = _getTime();
+    _write(cmd.addrs.data(), cmd.values.data(), cmd.addrs.size());
+    doneNs = _getTime();
+    return doneNs - t0;
+}
+
+void EVB7CommandQueue::fit(const size_t numWords, const long long durationNs)
+{
+    //decay the old durations so the model follows bus load changes
+    const double n = double(numWords), d = double(durationNs);
+    const double keep = (_sumW == 0.0)?0.0:(1.0-CMD_FIT_ALPHA);
+    _sumW = keep*_sumW + 1.0;
+    _sumN = keep*_sumN + n;
+    _sumNN = keep*_sumNN + n*n;
+    _sumD = keep*_sumD + d;
+    _sumND = keep*_sumND + n*d;
+
+    //line fit of duration over words, only the offset when
+    //the recent batches were all about the same size
+    const double det = _sumW*_sumNN - _sumN*_sumN;
+    if (det > 1e-6*_sumW*_sumW) _stats.wordNs = std::max(0.0, (_sumW*_sumND - _sumN*_sumD)/det);
+    _stats.overheadNs = std::max(0.0, (_sumD - _stats.wordNs*_sumN)/_sumW);
+}
+
+/*******************************************************************
+ * Scheduler thread
+ ******************************************************************/
+void EVB7CommandQueue::schedulerLoop(void)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_running)
+    {
+        if (_commands.empty())
+        {
+            _cond.wait(lock);
+            continue;
+        }
+
+        //sleep until the next command is close, a new first command wakes us up
+        auto it = _commands.begin();
+        const long long timeNs = it->first;
+        const long long startNs = timeNs - this->estimateNs(it->second.addrs.size());
+        const long long spinNs = std::min<long long>(CMD_MAX_SPIN_NS, std::max<long long>(CMD_MIN_SPIN_NS, std::llround(2*_wakeLateNs)));
+        const long long waitNs = startNs - _getTime();
+        if (waitNs > spinNs)
+        {
+            const long long wakeNs = startNs - spinNs;
+            if (_cond.wait_for(lock, std::chrono::nanoseconds(waitNs - spinNs)) == std::cv_status::timeout)
+            {
+                //track the wake up latency, rise at once and decay slowly
+                const double lateNs = double(_getTime() - wakeNs);
+                _wakeLateNs = std::max(lateNs, _wakeLateNs + CMD_FIT_ALPHA*(lateNs - _wakeLateNs));
+            }
+            continue;
+        }
+
+        Command cmd(std::move(it->second));
+        _commands.erase(it);
+        lock.unlock();
+
+        while (_getTime() < startNs){}
+        long long doneNs = 0;
+        const long long durationNs = this->write(cmd, doneNs);
+        const long long errorNs = doneNs - timeNs;
+
+        lock.lock();
+        this->fit(cmd.addrs.size(), durationNs);
+        _stats.commands++;
+        _stats.lastErrorNs = errorNs;
+        if (errorNs > _stats.maxLateNs) _stats.maxLateNs = errorNs;
+        if (errorNs > _toleranceNs)
+        {
+            _stats.late++;
+            SoapySDR::logf(SOAPY_SDR_WARNING, "EVB7 command for %lld ns late by %lld us", timeNs, errorNs/1000);
+        }
+    }
+}
@@ -0,0 +1,109 @@
+//
+// Timed register write queue for the EVB7.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <vector>
+
+/*!
+ * Counters for the timed command queue.
+ * The error of a command is the time its last word was written
+ * minus the requested time, late commands exceed the tolerance.
+ */
+struct EVB7CommandStats
+{
+    unsigned long long commands; //commands written
+    unsigned long long late; //commands past the tolerance
+    long long maxLateNs; //largest positive error
+    long long lastErrorNs; //error of the last command
+    double overheadNs; //SPI latency estimate: fixed cost per batch
+    double wordNs; //SPI latency estimate: cost per word
+};
+
+/*!
+ * Register write batches released at a hardware time.
+ *
+ * A scheduler thread sleeps until shortly before each command,
+ * then spins on the time source and starts the batch early by the
+ * estimated SPI latency, so that the last word lands on the requested time.
+ * The latency model (fixed cost plus cost per word) is fit from the
+ * measured duration of every batch, calibrate() seeds it before use.
+ * The spin margin is twice the measured wake up latency of the thread.
+ * Commands with the same time are written in the order queued.
+ *
+ * The scheduler runs at normal priority, so the error is bounded by the
+ * scheduling latency of the host and not by the queue: a few microseconds
+ * on an idle system, milliseconds when the thread is preempted under load.
+ * Late commands are still written, and counted in the stats.
+ */
+class EVB7CommandQueue
+{
+public:
+    //! The current hardware time in nanoseconds
+    typedef std::function<long long(void)> TimeFcn;
+
+    //! Write a batch of registers
+    typedef std::function<void(const int *addrs, const int *values, const size_t num)> WriteFcn;
+
+    EVB7CommandQueue(const TimeFcn &getTime, const WriteFcn &write, const long long toleranceNs);
+
+    ~EVB7CommandQueue(void);
+
+    /*!
+     * Queue a register write batch for a hardware time.
+     * \return false when the queue is full
+     */
+    bool push(const long long timeNs, const std::vector<int> &addrs, const std::vector<int> &values);
+
+    //! Drop all pending commands
+    void clear(void);
+
+    //! The number of pending commands
+    size_t pending(void);
+
+    /*!
+     * Write a batch numRuns times now, fitting the latency model to the
+     * durations. Use a batch of harmless writes, such as register values
+     * rewritten from the shadow, at two or more sizes.
+     */
+    void calibrate(const std::vector<int> &addrs, const std::vector<int> &values, const size_t numRuns);
+
+    EVB7CommandStats getStats(void);
+
+private:
+    struct Command
+    {
+        std::vector<int> addrs;
+        std::vector<int> values;
+    };
+
+    void schedulerLoop(void);
+    long long estimateNs(const size_t numWords) const;
+    long long write(const Command &cmd, long long &doneNs);
+    void fit(const size_t numWords, const long long durationNs);
+
+    TimeFcn _getTime;
+    WriteFcn _write;
+    long long _toleranceNs;
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::multimap<long long, Command> _commands;
+    bool _running;
+    std::thread _thread;
+    double _wakeLateNs; //wake up latency estimate of the scheduler
+
+    //exponentially weighted least squares sums for the latency model
+    double _sumW, _sumN, _sumNN, _sumD, _sumND;
+    EVB7CommandStats _stats;
+};
@@ -0,0 +1,75 @@
+//
+// DMA backend interface for the EVB7 streamer.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#pragma once
+#include "EVB7HostMemory.hpp"
+#include <cstddef>
+
+//backend return codes, negative values are errors
+#define EVB7_DMA_OK 0
+#define EVB7_DMA_ERROR -1 //generic failure (alloc, init)
+#define EVB7_DMA_TIMEOUT -2 //no buffer available
+#define EVB7_DMA_CLAIMED -3 //all buffers are held by the user
+
+/*!
+ * One DMA channel: a ring of buffers shared with the framer or deframer.
+ * Device to host channels (S2MM) hand filled buffers to the user,
+ * host to device channels (MM2S) hand empty buffers to the user to fill.
+ * The calls mirror the pothos zynq DMA driver (pzdud_*).
+ */
+class EVB7DMA
+{
+public:
+    virtual ~EVB7DMA(void)
+    {
+        return;
+    }
+
+    /*!
+     * Allocate the ring: numBuffs buffers of buffSize bytes.
+     * The memFlags (EVB7_MEM_*) only apply to rings in host memory,
+     * kernel DMA buffers are always resident and physically contiguous.
+     */
+    virtual int alloc(const size_t numBuffs, const size_t buffSize, const int memFlags = 0) = 0;
+
+    //! Free the ring allocated by alloc()
+    virtual int free(void) = 0;
+
+    //! Start the channel after alloc()
+    virtual int init(void) = 0;
+
+    //! Stop the channel before free()
+    virtual int halt(void) = 0;
+
+    //! Wait for a buffer to become available: EVB7_DMA_OK or EVB7_DMA_TIMEOUT
+    virtual int wait(const long timeoutUs) = 0;
+
+    //! Acquire the next available buffer: the handle or a negative error code
+    //! For S2MM len is the number of bytes received, for MM2S the buffer size.
+    virtual int acquire(size_t &len) = 0;
+
+    //! Release an acquired buffer, for MM2S len is the number of bytes to send
+    virtual void release(const size_t handle, const size_t len) = 0;
+
+    //! The address of a buffer in the ring
+    virtual void *addr(const size_t handle) = 0;
+};
+
+/*!
+ * The four channels used by the streamer.
+ * The framer is controlled through rxCtrl and fills rxData,
+ * the deframer consumes txData and reports through txStat.
+ */
+struct EVB7DMAChannels
+{
+    EVB7DMA *rxData;
+    EVB7DMA *rxCtrl;
+    EVB7DMA *txData;
+    EVB7DMA *txStat;
+};
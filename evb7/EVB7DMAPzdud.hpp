@@ -0,0 +1,78 @@
+//
+// EVB7 DMA backend for the pothos zynq DMA driver.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#pragma once
+#include "EVB7DMA.hpp"
+#include <pothos_zynq_dma_driver.h>
+#include <stdexcept>
+
+/*!
+ * Hardware DMA channel: a thin wrapper around a pzdud_t.
+ */
+class EVB7DMAPzdud : public EVB7DMA
+{
+public:
+    EVB7DMAPzdud(const size_t engineNo, const pzdud_dir_t dir):
+        _dma(pzdud_create(engineNo, dir))
+    {
+        if (_dma == NULL) throw std::runtime_error("EVB7DMAPzdud: fail pzdud_create()");
+        pzdud_reset(_dma);
+    }
+
+    ~EVB7DMAPzdud(void)
+    {
+        pzdud_destroy(_dma);
+    }
+
+    int alloc(const size_t numBuffs, const size_t buffSize, const int)
+    {
+        return (pzdud_alloc(_dma, numBuffs, buffSize) == PZDUD_OK)?EVB7_DMA_OK:EVB7_DMA_ERROR;
+    }
+
+    int free(void)
+    {
+        return (pzdud_free(_dma) == PZDUD_OK)?EVB7_DMA_OK:EVB7_DMA_ERROR;
+    }
+
+    int init(void)
+    {
+        return (pzdud_init(_dma, true) == PZDUD_OK)?EVB7_DMA_OK:EVB7_DMA_ERROR;
+    }
+
+    int halt(void)
+    {
+        return (pzdud_halt(_dma) == PZDUD_OK)?EVB7_DMA_OK:EVB7_DMA_ERROR;
+    }
+
+    int wait(const long timeoutUs)
+    {
+        return (pzdud_wait(_dma, timeoutUs) == PZDUD_OK)?EVB7_DMA_OK:EVB7_DMA_TIMEOUT;
+    }
+
+    int acquire(size_t &len)
+    {
+        const int handle = pzdud_acquire(_dma, &len);
+        if (handle >= 0) return handle;
+        if (handle == PZDUD_ERROR_CLAIMED) return EVB7_DMA_CLAIMED;
+        return EVB7_DMA_TIMEOUT;
+    }
+
+    void release(const size_t handle, const size_t len)
+    {
+        pzdud_release(_dma, handle, len);
+    }
+
+    void *addr(const size_t handle)
+    {
+        return pzdud_addr(_dma, handle);
+    }
+
+private:
+    pzdud_t *_dma;
+};
@@ -8,12 +8,16 @@
 //
 
 #include "EVB7Device.hpp"
+#include "EVB7DMAPzdud.hpp"
 #include <SoapySDR/Registry.hpp>
 #include <SoapySDR/Logger.hpp>
 #include <LMS7002M/LMS7002M_logger.h>
+#include <LMS7002M/LMS7002M_time.h>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 
-void customLogHandler(const LMS7_log_level_t level, const char *message)
+void customLogHandler(const LMS7_log_level_t level, struct LMS7002M_struct *, const char *message)
 {
     switch (level)
     {
@@ -39,7 +43,11 @@ EVB7::EVB7(const SoapySDR::Kwargs &args):
     _rx_ctrl_dma(NULL),
     _tx_data_dma(NULL),
     _tx_stat_dma(NULL),
-    _masterClockRate(1.0e6)
+    _streamer(NULL),
+    _cmdQueue(NULL),
+    _masterClockRate(1.0e6),
+    _gatewareMimo(false),
+    _calInterpolate(false)
 {
     LMS7_set_log_handler(&customLogHandler);
     LMS7_set_log_level(LMS7_INFO);
@@ -55,6 +63,13 @@ EVB7::EVB7(const SoapySDR::Kwargs &args):
         throw std::runtime_error("EVB7 fail to map registers");
     }
     SoapySDR::logf(SOAPY_SDR_INFO, "Read sentinel 0x%x\n", xumem_read32(_regs, FPGA_REG_RD_SENTINEL));
+
+    //probe the gateware for the proposed MIMO framers, two channel streams need them
+    const unsigned caps = this->readRegister(FPGA_REG_RD_CAPS);
+    _gatewareMimo = ((caps >> 16) == FPGA_CAPS_MAGIC) and ((caps & FPGA_CAPS_MIMO) != 0);
+    if (_gatewareMimo) SoapySDR::logf(SOAPY_SDR_INFO, "Gateware caps 0x%x, MIMO framers", caps);
+    else SoapySDR::logf(SOAPY_SDR_INFO, "Gateware caps 0x%x, SISO framers: "
+        "two channel streams need MIMO framer gateware, which does not exist for EVB7 yet", caps);
     this->writeRegister(FPGA_REG_WR_TX_TEST, 0); //test off, normal tx from deframer
 
     //perform reset
@@ -68,6 +83,7 @@ EVB7::EVB7(const SoapySDR::Kwargs &args):
     //setup LMS7002M
     _lms = LMS7002M_create(spidev_interface_transact, _spiHandle);
     if (_lms == NULL) std::runtime_error("EVB7 fail to LMS7002M_create()");
+    LMS7002M_set_spi_batch(_lms, spidev_interface_transact_batch);
     LMS7002M_reset(_lms);
     LMS7002M_set_spi_mode(_lms, 4); //set 4-wire spi before reading back
 
@@ -79,6 +95,16 @@ EVB7::EVB7(const SoapySDR::Kwargs &args):
     SoapySDR::logf(SOAPY_SDR_INFO, "rev 0x%x", LMS7002M_regs(_lms)->reg_0x002f_rev);
     SoapySDR::logf(SOAPY_SDR_INFO, "ver 0x%x", LMS7002M_regs(_lms)->reg_0x002f_ver);
 
+    //filter calibration results, kept across restarts with the "calcache" file arg
+    const char *calCachePath = (args.count("calcache") != 0)?args.at("calcache").c_str():NULL;
+    if (LMS7002M_cal_cache_open(_lms, calCachePath) != 0) SoapySDR::logf(SOAPY_SDR_WARNING, "EVB7 calibration cache disabled");
+
+    //on-chip IQ calibration table from IQ_CAL_SWEEP, loaded with the "iqcaltable" file arg
+    if (args.count("iqcaltable") != 0 and LMS7002M_iq_cal_load(_lms, args.at("iqcaltable").c_str()) != 0)
+    {
+        SoapySDR::logf(SOAPY_SDR_WARNING, "EVB7 IQ calibration table %s not loaded", args.at("iqcaltable").c_str());
+    }
+
     //turn the clocks on
     this->setMasterClockRate(61.44e6);
 
@@ -134,21 +160,39 @@ EVB7::EVB7(const SoapySDR::Kwargs &args):
     LMS7002M_sxx_enable(_lms, LMS_TX, true);
 
     //setup dma buffs
-    _rx_data_dma = pzdud_create(RX_DMA_INDEX, PZDUD_S2MM);
-    if (_rx_data_dma == NULL) throw std::runtime_error("EVB7 fail create rx data DMA");
-    pzdud_reset(_rx_data_dma);
-
-    _rx_ctrl_dma = pzdud_create(RX_DMA_INDEX, PZDUD_MM2S);
-    if (_rx_ctrl_dma == NULL) throw std::runtime_error("EVB7 fail create rx ctrl DMA");
-    pzdud_reset(_rx_ctrl_dma);
-
-    _tx_data_dma = pzdud_create(TX_DMA_INDEX, PZDUD_MM2S);
-    if (_tx_data_dma == NULL) throw std::runtime_error("EVB7 fail create tx data DMA");
-    pzdud_reset(_tx_data_dma);
-
-    _tx_stat_dma = pzdud_create(TX_DMA_INDEX, PZDUD_S2MM);
-    if (_tx_stat_dma == NULL) throw std::runtime_error("EVB7 fail create tx stat DMA");
-    pzdud_reset(_tx_stat_dma);
+    _rx_data_dma = new EVB7DMAPzdud(RX_DMA_INDEX, PZDUD_S2MM);
+    _rx_ctrl_dma = new EVB7DMAPzdud(RX_DMA_INDEX, PZDUD_MM2S);
+    _tx_data_dma = new EVB7DMAPzdud(TX_DMA_INDEX, PZDUD_MM2S);
+    _tx_stat_dma = new EVB7DMAPzdud(TX_DMA_INDEX, PZDUD_S2MM);
+
+    //the streamer runs the framing protocol over the dma channels
+    EVB7DMAChannels dma;
+    dma.rxData = _rx_data_dma;
+    dma.rxCtrl = _rx_ctrl_dma;
+    dma.txData = _tx_data_dma;
+    dma.txStat = _tx_stat_dma;
+    _streamer = new EVB7Streamer(dma, [this](void){return this->getHardwareTime("");});
+
+    //timed register writes against the hardware time
+    const long long cmdToleranceUs = (args.count("cmdtolerance") != 0)?std::stoll(args.at("cmdtolerance")):50;
+    _cmdQueue = new EVB7CommandQueue(
+        [this](void){return this->getHardwareTime("");},
+        [this](const int *addrs, const int *values, const size_t num)
+        {
+            //the batch selects its channel with the MAC word first,
+            //the shadows follow so later driver writes do not revert it
+            std::lock_guard<std::mutex> lock(_mutex);
+            LMS7002M_spi_write_batch(_lms, addrs, values, num);
+            LMS7002M_regs_update(_lms, addrs, values, num);
+        },
+        cmdToleranceUs*1000);
+
+    //seed the SPI latency model by rewriting a global register from its shadow
+    const int cgenReg = LMS7002M_regs_get(LMS7002M_regs(_lms), 0x0086);
+    _cmdQueue->calibrate(std::vector<int>(1, 0x0086), std::vector<int>(1, cgenReg), 8);
+    _cmdQueue->calibrate(std::vector<int>(16, 0x0086), std::vector<int>(16, cgenReg), 8);
+    const EVB7CommandStats cmdStats = _cmdQueue->getStats();
+    SoapySDR::logf(SOAPY_SDR_INFO, "SPI latency %.1f us + %.2f us/word", cmdStats.overheadNs/1e3, cmdStats.wordNs/1e3);
 
     SoapySDR::logf(SOAPY_SDR_INFO, "EVB7() setup OK");
 
@@ -215,7 +259,9 @@ EVB7::EVB7(const SoapySDR::Kwargs &args):
     writeArgToSetting(args, "RXTSP_TSG_CONST");
     writeArgToSetting(args, "TXTSP_TSG_CONST");
 
-    //load the calibration data if present
+    //load the calibration data if present,
+    //the "calinterp" arg interpolates between its frequencies
+    _calInterpolate = (args.count("calinterp") != 0) and (args.at("calinterp") == "true");
     this->loadCalData();
 
     //LMS7002M_dump_ini(_lms, "/root/src/regs.ini");
@@ -226,6 +272,10 @@ EVB7::~EVB7(void)
 {
     SoapySDR::log(SOAPY_SDR_INFO, "Power down and cleanup");
 
+    //stop the timed writes before the chip goes away
+    delete _cmdQueue;
+    _cmdQueue = NULL;
+
     //power down and clean up
     LMS7002M_afe_enable(_lms, LMS_TX, LMS_CHA, false);
     LMS7002M_afe_enable(_lms, LMS_TX, LMS_CHB, false);
@@ -248,10 +298,11 @@ EVB7::~EVB7(void)
     CLEANUP_EMIO(TXEN_EMIO);
 
     //dma cleanup
-    pzdud_destroy(_rx_data_dma);
-    pzdud_destroy(_rx_ctrl_dma);
-    pzdud_destroy(_tx_data_dma);
-    pzdud_destroy(_tx_stat_dma);
+    delete _streamer;
+    delete _rx_data_dma;
+    delete _rx_ctrl_dma;
+    delete _tx_data_dma;
+    delete _tx_stat_dma;
 
     //spi cleanup
     spidev_interface_close(_spiHandle);
@@ -267,12 +318,10 @@ void EVB7::loadCalData(void)
 {
     std::ifstream calFile("/root/results.csv");
     size_t calLineNumber = 0;
-    std::vector<std::string> calHeaders;
+    std::map<std::string, size_t> calColumns;
     std::string line;
     while (std::getline(calFile, line))
     {
-        //std::cout << line << std::endl;
-        std::map<std::string, std::string> calEntry;
         std::vector<std::string> entries;
         for (char ch : line)
         {
@@ -281,64 +330,104 @@ void EVB7::loadCalData(void)
             if (ch == ',') entries.push_back("");
             else entries.back().push_back(ch);
         }
-        if (calLineNumber == 0)
+        if (calLineNumber++ == 0)
         {
-            calHeaders = entries;
+            for (size_t i = 0; i < entries.size(); i++) calColumns[entries[i]] = i;
+            continue;
         }
-        else
+
+        //parsed once here, the lookups only search
+        const auto column = [&](const std::string &name) -> const std::string &
+        {
+            return entries.at(calColumns.at(name));
+        };
+        const auto complexColumn = [&](const std::string &name)
         {
-            for (size_t i = 0; i < entries.size(); i++)
-            {
-                calEntry[calHeaders[i]] = entries[i];
-            }
-            _calData.push_back(calEntry);
+            double re = 0.0, im = 0.0;
+            std::sscanf(column(name).c_str(), "(%lf%lfj)", &re, &im);
+            return std::complex<double>(re, im);
+        };
+        try
+        {
+            EVB7CalPoint point;
+            point.freq = std::stod(column("Frequency"));
+
+            point.cal = this->balance2IqCal(complexColumn("RX IQ correction"));
+            _calData[SOAPY_SDR_RX][std::stoul(column("RX Channel"))].push_back(point);
+
+            const std::complex<double> txDc = complexColumn("TX DC correction");
+            point.cal = this->balance2IqCal(complexColumn("TX IQ correction"));
+            point.cal.dc_i = int(txDc.real()*128);
+            point.cal.dc_q = int(txDc.imag()*128);
+            _calData[SOAPY_SDR_TX][std::stoul(column("TX Channel"))].push_back(point);
+        }
+        catch (const std::exception &ex)
+        {
+            SoapySDR::logf(SOAPY_SDR_WARNING, "Calibration data line %d skipped - %s", int(calLineNumber), ex.what());
         }
-        calLineNumber++;
     }
-    if (not _calData.empty()) SoapySDR::log(SOAPY_SDR_INFO, "Loaded calibration data");
-}
 
-void EVB7::applyCalData(const int direction, const size_t channel, const double rfFreq)
-{
-    std::map<std::string, std::string> closestEntry;
-    double closestFreq = 0.0;
-    for (const auto &entry : _calData)
+    for (auto &dir : _calData)
     {
-        if (direction == SOAPY_SDR_RX and std::stoul(entry.at("RX Channel")) != channel) continue;
-        if (direction == SOAPY_SDR_TX and std::stoul(entry.at("TX Channel")) != channel) continue;
-        const double calFreq = std::stod(entry.at("Frequency"));
-        if (std::abs(rfFreq-calFreq) < std::abs(rfFreq-closestFreq))
+        for (auto &ch : dir.second)
         {
-            closestEntry = entry;
-            closestFreq = calFreq;
+            std::sort(ch.second.begin(), ch.second.end(), [](const EVB7CalPoint &a, const EVB7CalPoint &b){return a.freq < b.freq;});
         }
     }
+    if (not _calData.empty()) SoapySDR::log(SOAPY_SDR_INFO, "Loaded calibration data");
+}
 
-    if (closestFreq != 0.0)
+bool EVB7::lookupCalData(const int direction, const size_t channel, const double rfFreq, EVB7CalPoint &point) const
+{
+    const auto dir = _calData.find(direction);
+    if (dir == _calData.end()) return false;
+    const auto ch = dir->second.find(channel);
+    if (ch == dir->second.end() or ch->second.empty()) return false;
+    const std::vector<EVB7CalPoint> &points = ch->second;
+
+    //the first point not below the frequency, and the one before it
+    const auto it = std::lower_bound(points.begin(), points.end(), rfFreq,
+        [](const EVB7CalPoint &p, const double freq){return p.freq < freq;});
+    if (it == points.begin() or it == points.end())
     {
-        SoapySDR::logf(SOAPY_SDR_INFO, "Using cal data at %f MHz", closestFreq/1e6);
+        point = (it == points.end())?points.back():points.front();
+        return true;
+    }
+    const EVB7CalPoint &lo = *(it-1);
+    const EVB7CalPoint &hi = *it;
+    const double t = (rfFreq - lo.freq)/(hi.freq - lo.freq);
+    point = (t < 0.5)?lo:hi;
+    if (not _calInterpolate) return true;
+
+    const auto lerp = [t](const int a, const int b){return int(std::lround(a + t*(b - a)));};
+    point.freq = rfFreq;
+    point.cal.dc_i = lerp(lo.cal.dc_i, hi.cal.dc_i);
+    point.cal.dc_q = lerp(lo.cal.dc_q, hi.cal.dc_q);
+    point.cal.gain = lerp(lo.cal.gain, hi.cal.gain);
+    point.cal.phase = lerp(lo.cal.phase, hi.cal.phase);
+    return true;
+}
 
-        if (direction == SOAPY_SDR_TX)
-        {
-            double realTxDc, imagTxDc;
-            std::sscanf(closestEntry.at("TX DC correction").c_str(), "(%lf%lfj)", &realTxDc, &imagTxDc);
-            SoapySDR::logf(SOAPY_SDR_INFO, "Parse TX DC correction %s -> %f %f", closestEntry.at("TX DC correction").c_str(), realTxDc, imagTxDc);
-            this->setDCOffset(direction, channel, std::complex<double>(realTxDc, imagTxDc));
-
-            double realTxIq, imagTxIq;
-            std::sscanf(closestEntry.at("TX IQ correction").c_str(), "(%lf%lfj)", &realTxIq, &imagTxIq);
-            SoapySDR::logf(SOAPY_SDR_INFO, "Parse TX IQ correction %s -> %f %f", closestEntry.at("TX IQ correction").c_str(), realTxIq, imagTxIq);
-            this->setIQBalance(direction, channel, std::complex<double>(realTxIq, imagTxIq));
-        }
+void EVB7::applyCalData(const int direction, const size_t channel, const double rfFreq, const EVB7CalPoint *filePoint)
+{
+    //called locked: results calibrated on the device take precedence over the file
+    LMS7002M_iq_cal_t cal;
+    if (LMS7002M_iq_cal_apply(_lms, dir2LMS(direction), ch2LMS(channel), rfFreq, &cal) == 0)
+    {
+        SoapySDR::logf(SOAPY_SDR_DEBUG, "Using device cal data for %f MHz", rfFreq/1e6);
+    }
+    else if (filePoint != NULL)
+    {
+        SoapySDR::logf(SOAPY_SDR_DEBUG, "Using cal data at %f MHz", filePoint->freq/1e6);
+        cal = filePoint->cal;
 
-        if (direction == SOAPY_SDR_RX)
-        {
-            double realRxIq, imagRxIq;
-            std::sscanf(closestEntry.at("RX IQ correction").c_str(), "(%lf%lfj)", &realRxIq, &imagRxIq);
-            SoapySDR::logf(SOAPY_SDR_INFO, "Parse RX IQ correction %s -> %f %f", closestEntry.at("RX IQ correction").c_str(), realRxIq, imagRxIq);
-            this->setIQBalance(direction, channel, std::complex<double>(realRxIq, imagRxIq));
-        }
+        //the file has no RX DC: leave the RFE DC offset as it is
+        LMS7002M_iq_cal_write(_lms, dir2LMS(direction), ch2LMS(channel), &cal, direction == SOAPY_SDR_TX);
     }
+    else return;
+
+    _cachedIqBalValues[direction][channel] = this->iqCal2Balance(cal);
+    if (direction == SOAPY_SDR_TX) _txDCOffset = std::complex<double>(cal.dc_i/128.0, cal.dc_q/128.0);
 }
 
 /*******************************************************************
@@ -550,7 +639,11 @@ SoapySDR::Range EVB7::getGainRange(const int direction, const size_t channel, co
  ******************************************************************/
 void EVB7::setFrequency(const int direction, const size_t channel, const std::string &name, const double frequency, const SoapySDR::Kwargs &)
 {
-    std::unique_lock<std::mutex> lock(_mutex);
+    //the file cal data is looked up before taking the lock
+    EVB7CalPoint calPoint;
+    const bool haveCalPoint = (name == "RF") and this->lookupCalData(direction, channel, frequency, calPoint);
+
+    std::lock_guard<std::mutex> lock(_mutex);
 
     SoapySDR::logf(SOAPY_SDR_INFO, "EVB7::setFrequency(%s, ch%d, %s, %f MHz)", dir2Str(direction), channel, name.c_str(), frequency/1e6);
 
@@ -562,10 +655,8 @@ void EVB7::setFrequency(const int direction, const size_t channel, const std::st
         _cachedFreqValues[direction][0][name] = actualFreq;
         _cachedFreqValues[direction][1][name] = actualFreq;
 
-        //try to apply the cal data when turned
-        lock.unlock();
-        this->applyCalData(direction, channel, frequency);
-        lock.lock();
+        //apply the cal data when tuned, in the same lock as the tune
+        this->applyCalData(direction, channel, frequency, haveCalPoint?&calPoint:NULL);
     }
 
     if (name == "BB")
@@ -648,6 +739,7 @@ void EVB7::setSampleRate(const int direction, const size_t, const double rate)
     }
 
     _cachedSampleRates[direction] = baseRate/intFactor;
+    _streamer->setSampleRate(direction, _cachedSampleRates[direction]);
 }
 
 double EVB7::getSampleRate(const int direction, const size_t) const
@@ -777,6 +869,93 @@ void EVB7::setHardwareTime(const long long timeNs, const std::string &)
     this->writeRegister(FPGA_REG_WR_TIME_LATCH, 0);
 }
 
+void EVB7::queueRegisterWrites(const long long timeNs, const size_t channel, const std::vector<int> &addrs, const std::vector<int> &values)
+{
+    if (channel > 1) throw std::runtime_error("EVB7::queueRegisterWrites() invalid channel");
+    if (addrs.size() != values.size()) throw std::runtime_error("EVB7::queueRegisterWrites() addrs and values size mismatch");
+
+    //the batch selects the channel itself, whatever MAC is set when it fires
+    std::vector<int> batchAddrs(1, 0x0020), batchValues(1, 0);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        batchValues[0] = LMS7002M_mac_value(_lms, (channel == 0)?LMS_CHA:LMS_CHB);
+    }
+    for (size_t i = 0; i < addrs.size(); i++)
+    {
+        if (addrs[i] == 0x0020) throw std::runtime_error("EVB7::queueRegisterWrites() MAC register 0x0020 not allowed");
+        batchAddrs.push_back(addrs[i]);
+        batchValues.push_back(values[i]);
+    }
+    if (not _cmdQueue->push(timeNs, batchAddrs, batchValues)) throw std::runtime_error("EVB7::queueRegisterWrites() command queue full");
+}
+
+/*******************************************************************
+ * Sensor API
+ ******************************************************************/
+std::vector<std::string> EVB7::listSensors(void) const
+{
+    std::vector<std::string> sensors = {EVB7_STREAM_STATS_NAMES};
+    sensors.push_back("rx_loss_ratio");
+    sensors.push_back("cmd_commands");
+    sensors.push_back("cmd_late");
+    sensors.push_back("cmd_max_late_ns");
+    sensors.push_back("cmd_spi_word_ns");
+    sensors.push_back("cal_tunes_full");
+    sensors.push_back("cal_tunes_restored");
+    sensors.push_back("cal_tunes_avoided");
+    sensors.push_back("cal_searches");
+    sensors.push_back("cal_search_probes");
+    return sensors;
+}
+
+std::string EVB7::readSensor(const std::string &key) const
+{
+    const EVB7_stream_stats_t stats = _streamer->getStreamStats();
+
+    #define readStatSensor(name) if (key == #name) return std::to_string(stats.name)
+    readStatSensor(rx_packets);
+    readStatSensor(rx_samples);
+    readStatSensor(rx_overflows);
+    readStatSensor(rx_restarts);
+    readStatSensor(rx_gaps);
+    readStatSensor(rx_dropped_samples);
+    readStatSensor(rx_tag_errors);
+    readStatSensor(rx_time_errors);
+    readStatSensor(rx_ingest_overruns);
+    readStatSensor(tx_packets);
+    readStatSensor(tx_samples);
+    readStatSensor(tx_underflows);
+    readStatSensor(tx_time_errors);
+    readStatSensor(tx_burst_ends);
+    readStatSensor(tx_status_dropped);
+
+    const EVB7CommandStats cmdStats = _cmdQueue->getStats();
+    if (key == "cmd_commands") return std::to_string(cmdStats.commands);
+    if (key == "cmd_late") return std::to_string(cmdStats.late);
+    if (key == "cmd_max_late_ns") return std::to_string(cmdStats.maxLateNs);
+    if (key == "cmd_spi_word_ns") return std::to_string(cmdStats.wordNs);
+
+    LMS7002M_cal_tune_stats_t tuneStats;
+    LMS7002M_cal_tune_stats(_lms, &tuneStats);
+    if (key == "cal_tunes_full") return std::to_string(tuneStats.full);
+    if (key == "cal_tunes_restored") return std::to_string(tuneStats.restored);
+    if (key == "cal_tunes_avoided") return std::to_string(tuneStats.avoided);
+
+    LMS7002M_cal_search_stats_t searchStats;
+    LMS7002M_cal_search_stats(_lms, &searchStats);
+    if (key == "cal_searches") return std::to_string(searchStats.searches);
+    if (key == "cal_search_probes") return std::to_string(searchStats.probes);
+
+    //fraction of the RX samples lost between packets
+    if (key == "rx_loss_ratio")
+    {
+        const double total = double(stats.rx_samples + stats.rx_dropped_samples);
+        return std::to_string((total == 0.0)?0.0:stats.rx_dropped_samples/total);
+    }
+
+    throw std::runtime_error("EVB7::readSensor("+key+") unknown key");
+}
+
 /*******************************************************************
  * Settings API
  ******************************************************************/
@@ -830,6 +1009,66 @@ void EVB7::writeSetting(const std::string &key, const std::string &value)
         this->writeRegister(FPGA_REG_WR_TX_CHA, ampl << 16);
         this->writeRegister(FPGA_REG_WR_TX_CHB, ampl << 16);
     }
+    else if (key == "CAL_CACHE_FORCE") LMS7002M_cal_cache_force(_lms, value == "TRUE");
+    else if (key == "RBB_SET_FILTER_BW_CHAB")
+    {
+        //both RX channels in one calibration pass
+        double actualBw = 0.0;
+        const int ret = LMS7002M_rbb_set_filter_bw(_lms, LMS_CHAB, std::stod(value), &actualBw);
+        if (ret != 0) throw std::runtime_error("EVB7::writeSetting("+key+", "+value+") failed "+std::to_string(ret));
+        _cachedFilterBws[SOAPY_SDR_RX][0] = actualBw;
+        _cachedFilterBws[SOAPY_SDR_RX][1] = actualBw;
+    }
+    else if (key == "RX_IQ_CALIBRATE" or key == "TX_IQ_CALIBRATE")
+    {
+        //at the current LO frequency, reapplied when tuned back near it
+        const int direction = (key == "TX_IQ_CALIBRATE")?SOAPY_SDR_TX:SOAPY_SDR_RX;
+        LMS7002M_chan_t channel = LMS_CHA;
+        if      (value == "A") channel = LMS_CHA;
+        else if (value == "B") channel = LMS_CHB;
+        else if (value == "AB") channel = LMS_CHAB;
+        else throw std::runtime_error("EVB7::writeSetting("+key+", "+value+") unknown value");
+        LMS7002M_iq_cal_t results[2];
+        const int ret = (direction == SOAPY_SDR_TX)?
+            LMS7002M_tx_iq_calibrate(_lms, channel, results):
+            LMS7002M_rx_iq_calibrate(_lms, channel, results);
+        if (ret != 0) throw std::runtime_error("EVB7::writeSetting("+key+", "+value+") failed "+std::to_string(ret));
+        for (size_t i = 0; i < ((channel == LMS_CHAB)?2:1); i++)
+        {
+            const size_t ch = (channel == LMS_CHB)?1:i;
+            _cachedIqBalValues[direction][ch] = this->iqCal2Balance(results[i]);
+            if (direction == SOAPY_SDR_TX) _txDCOffset = std::complex<double>(results[i].dc_i/128.0, results[i].dc_q/128.0);
+            SoapySDR::logf(SOAPY_SDR_DEBUG, "%s IQ cal [%c] in %d probes, %lld us", dir2Str(direction),
+                int('A'+ch), results[i].probes, (results[i].elapsed*1000000)/LMS7_time_tps());
+        }
+    }
+    else if (key == "RX_IQ_CAL_SWEEP" or key == "TX_IQ_CAL_SWEEP")
+    {
+        //both channels over a comma separated list of frequencies in Hz
+        std::vector<double> freqs;
+        std::stringstream ss(value);
+        std::string freq;
+        while (std::getline(ss, freq, ',')) freqs.push_back(std::stod(freq));
+        const int direction = (key == "TX_IQ_CAL_SWEEP")?SOAPY_SDR_TX:SOAPY_SDR_RX;
+        const int ret = LMS7002M_iq_cal_sweep(_lms, dir2LMS(direction), LMS_CHAB, freqs.data(), freqs.size());
+        if (ret != 0) SoapySDR::logf(SOAPY_SDR_WARNING, "EVB7::writeSetting(%s) failed at some frequencies (%d)", key.c_str(), ret);
+    }
+    else if (key == "IQ_CAL_SAVE" or key == "IQ_CAL_LOAD")
+    {
+        const int ret = (key == "IQ_CAL_SAVE")?LMS7002M_iq_cal_save(_lms, value.c_str()):LMS7002M_iq_cal_load(_lms, value.c_str());
+        if (ret != 0) throw std::runtime_error("EVB7::writeSetting("+key+", "+value+") failed "+std::to_string(ret));
+    }
+    else if (key == "TDD_STORE" or key == "TDD_SWITCH")
+    {
+        LMS7002M_dir_t direction = LMS_TX;
+        if      (value == "TX") direction = LMS_TX;
+        else if (value == "RX") direction = LMS_RX;
+        else throw std::runtime_error("EVB7::writeSetting("+key+", "+value+") unknown value");
+        long long elapsed = 0;
+        const int ret = (key == "TDD_STORE")?LMS7002M_tdd_store(_lms, direction):LMS7002M_tdd_switch(_lms, direction, &elapsed);
+        if (ret != 0) throw std::runtime_error("EVB7::writeSetting("+key+", "+value+") failed "+std::to_string(ret));
+        if (key == "TDD_SWITCH") SoapySDR::logf(SOAPY_SDR_DEBUG, "TDD switch to %s in %lld us", value.c_str(), (elapsed*1000000)/LMS7_time_tps());
+    }
     else throw std::runtime_error("EVB7::writeSetting("+key+", "+value+") unknown key");
 }
 
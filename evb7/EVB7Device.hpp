@@ -8,7 +8,8 @@
 //
 
 #include "EVB7Regs.hpp"
-#include "twbw_helper.h"
+#include "EVB7Streamer.hpp"
+#include "EVB7CommandQueue.hpp"
 #include "spidev_interface.h"
 #include "sysfs_gpio_interface.h"
 #include "xilinx_user_gpio.h"
@@ -17,8 +18,9 @@
 #include <SoapySDR/Device.hpp>
 #include <SoapySDR/Logger.hpp>
 #include <SoapySDR/Time.hpp>
-#include <pothos_zynq_dma_driver.h>
 #include <mutex>
+#include <complex>
+#include <cmath>
 #include <cstring>
 #include <cstdlib>
 #include <stdexcept>
@@ -26,6 +28,13 @@
 
 #include <LMS7002M/LMS7002M.h>
 
+//! One calibration file entry, parsed for one direction and channel
+struct EVB7CalPoint
+{
+    double freq;
+    LMS7002M_iq_cal_t cal; //corrections as register codes
+};
+
 class EVB7 : public SoapySDR::Device
 {
 public:
@@ -63,22 +72,20 @@ public:
 * Stream API
 ******************************************************************/
 
+    std::vector<std::string> getStreamFormats(const int direction, const size_t channel) const;
+
+    std::string getNativeStreamFormat(const int direction, const size_t channel, double &fullScale) const;
+
     SoapySDR::Stream *setupStream(
         const int direction,
         const std::string &format,
         const std::vector<size_t> &channels,
         const SoapySDR::Kwargs &);
 
-    void rxFlush(void);
-
     void closeStream(SoapySDR::Stream *stream);
 
     size_t getStreamMTU(SoapySDR::Stream *stream) const;
 
-    int sendControlMessage(const int tag, const bool timeFlag, const bool burstFlag, const int frameSize, const int burstSize, const long long time);
-
-    int convertRemainder(SoapySDR::Stream *stream, void *outp, const size_t numOutSamps, int &flags);
-
     int activateStream(
         SoapySDR::Stream *stream,
         const int flags,
@@ -98,6 +105,19 @@ public:
         long long &timeNs,
         const long timeoutUs);
 
+    /*!
+     * EVB7 specific zero copy read of a "zerocopy" RX stream:
+     * view is set to the CS16 samples in the DMA buffer, valid until
+     * the next read or deactivateStream() (see EVB7Streamer).
+     */
+    int readStreamView(
+        SoapySDR::Stream *stream,
+        const void *&view,
+        const size_t numElems,
+        int &flags,
+        long long &timeNs,
+        const long timeoutUs);
+
     int writeStream(
         SoapySDR::Stream *,
         const void * const *buffs,
@@ -114,6 +134,8 @@ public:
         long long &timeNs,
         const long timeoutUs);
 
+    //direct access buffers hold the raw LML words,
+    //MIMO streams interleave the channels: A0 B0 A1 B1...
     size_t getNumDirectAccessBuffers(SoapySDR::Stream *stream);
     int getDirectAccessBufferAddrs(SoapySDR::Stream *stream, const size_t handle, void **buffs);
 
@@ -129,6 +151,22 @@ public:
         SoapySDR::Stream *stream,
         const size_t handle);
 
+    //EVB7 specific batched RX buffer access (see EVB7Streamer)
+    int acquireReadBuffers(
+        SoapySDR::Stream *stream,
+        const size_t maxBuffs,
+        size_t *handles,
+        const void **buffs,
+        size_t *numElems,
+        int *flags,
+        long long *timeNs,
+        const long timeoutUs);
+
+    void releaseReadBuffers(
+        SoapySDR::Stream *stream,
+        const size_t numBuffs,
+        const size_t *handles);
+
     int acquireWriteBuffer(
         SoapySDR::Stream *stream,
         size_t &handle,
@@ -142,28 +180,12 @@ public:
         int &flags,
         const long long timeNs);
 
-    //rx streaming
-    int _remainderHandle;
-    size_t _remainderSamps;
-    const uint32_t *_remainderBuff;
-
-    //tx streaming
-    bool _userHandlesTxStatus;
-
-    //stream configuration
-    enum StreamFormat
-    {
-        SF_CS16,
-        SF_CF32,
-    };
-    StreamFormat _rxFormat;
-    StreamFormat _txFormat;
-
     /*******************************************************************
      * Cal hooks
      ******************************************************************/
     void loadCalData(void);
-    void applyCalData(const int direction, const size_t channel, const double rfFreq);
+    bool lookupCalData(const int direction, const size_t channel, const double rfFreq, EVB7CalPoint &point) const;
+    void applyCalData(const int direction, const size_t channel, const double rfFreq, const EVB7CalPoint *filePoint);
 
     /*******************************************************************
      * Antenna API
@@ -257,10 +279,33 @@ public:
     long long getHardwareTime(const std::string &) const;
     void setHardwareTime(const long long timeNs, const std::string &);
 
+    /*!
+     * EVB7 specific timed LMS7002M register writes (see EVB7CommandQueue).
+     * The batch is written in order so that its last word lands at the
+     * hardware time. It starts with a MAC 0x0020 word for the channel,
+     * so channel registers (0x0100 and up) land in that channel; the
+     * MAC itself is refused in addrs. The batch is written under the
+     * device mutex and the register shadows are updated with it.
+     * A long driver call (a calibration) delays the batch, commands past
+     * the "cmdtolerance" device arg (us, default 50) are logged and
+     * counted in the cmd_late sensor.
+     */
+    void queueRegisterWrites(const long long timeNs, const size_t channel, const std::vector<int> &addrs, const std::vector<int> &values);
+
     /*******************************************************************
      * Sensor API
      ******************************************************************/
 
+    /*!
+     * Stream health counters (see EVB7_stream_stats_t) by field name,
+     * cleared when the stream of the direction is setup or activated.
+     * rx_loss_ratio is rx_dropped_samples over the samples expected.
+     * cmd_commands, cmd_late, cmd_max_late_ns and cmd_spi_word_ns
+     * report on the timed command queue.
+     */
+    std::vector<std::string> listSensors(void) const;
+    std::string readSensor(const std::string &key) const;
+
     /*******************************************************************
      * Register API
      ******************************************************************/
@@ -316,6 +361,14 @@ public:
      *   for a constant valued output. When FPGA_TX_TEST is FALSE,
      *   this value drives the TX FPGA CORDIC when no user stream is applied.
      *   When FPGA_TX_TEST is TRUE, this value directly drives the TX DIQ bus.
+     *
+     * - CAL_CACHE_FORCE(TRUE/FALSE) - always run the filter calibrations
+     *   in setBandwidth(), refreshing the cached results.
+     *
+     * - TDD_STORE(TX/RX) - store the current chip state as the TDD profile
+     *   for the direction (see LMS7002M_tdd_store()).
+     *
+     * - TDD_SWITCH(TX/RX) - switch to a stored TDD profile with one SPI batch.
      */
     void writeSetting(const std::string &key, const std::string &value);
 
@@ -347,6 +400,24 @@ private:
         return (channel == 0)?LMS_CHA:LMS_CHB;
     }
 
+    //the IQ balance equivalent to a calibrated gain and phase correction
+    std::complex<double> iqCal2Balance(const LMS7002M_iq_cal_t &cal) const
+    {
+        const double gain = (cal.gain > 0)?2047.0/(2047-cal.gain):(2047.0+cal.gain)/2047;
+        return std::polar(gain, cal.phase*(M_PI/2)/2047);
+    }
+
+    //the gain and phase correction equivalent to an IQ balance
+    LMS7002M_iq_cal_t balance2IqCal(const std::complex<double> &balance) const
+    {
+        LMS7002M_iq_cal_t cal = LMS7002M_iq_cal_t();
+        const double gain = std::abs(balance);
+        if (gain > 1.0) cal.gain = 2047 - int(2047/gain);
+        if (gain < 1.0 and gain != 0.0) cal.gain = int(2047*gain) - 2047;
+        cal.phase = int(2047*(std::arg(balance)/(M_PI/2)));
+        return cal;
+    }
+
     const char *dir2Str(const int direction) const
     {
         return (direction == SOAPY_SDR_RX)?"RX":"TX";
@@ -355,14 +426,18 @@ private:
     void *_regs;
     void *_spiHandle;
     LMS7002M_t *_lms;
-    pzdud_t *_rx_data_dma;
-    pzdud_t *_rx_ctrl_dma;
-    pzdud_t *_tx_data_dma;
-    pzdud_t *_tx_stat_dma;
+    EVB7DMA *_rx_data_dma;
+    EVB7DMA *_rx_ctrl_dma;
+    EVB7DMA *_tx_data_dma;
+    EVB7DMA *_tx_stat_dma;
+    EVB7Streamer *_streamer;
+    EVB7CommandQueue *_cmdQueue;
     double _masterClockRate;
+    bool _gatewareMimo; //the framers can carry both channels
 
-    //calibration data
-    std::vector<std::map<std::string, std::string>> _calData;
+    //calibration data per direction and channel, sorted by frequency
+    std::map<int, std::map<size_t, std::vector<EVB7CalPoint>>> _calData;
+    bool _calInterpolate;
 
     //register protection
     std::mutex _mutex;
@@ -0,0 +1,59 @@
+//
+// Host memory for the EVB7 stream rings.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include "EVB7HostMemory.hpp"
+#include <SoapySDR/Logger.hpp>
+#include <sys/mman.h>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#define HUGE_PAGE_SIZE (2 << 20)
+
+EVB7HostMemory::EVB7HostMemory(const size_t size, const int flags):
+    _mem(nullptr),
+    _size(size),
+    _mapped(0),
+    _locked(false)
+{
+    if ((flags & EVB7_MEM_HUGEPAGES) != 0)
+    {
+        const size_t len = ((size + HUGE_PAGE_SIZE - 1)/HUGE_PAGE_SIZE)*HUGE_PAGE_SIZE;
+        void *mem = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED)
+        {
+            _mem = mem;
+            _mapped = len;
+        }
+        else SoapySDR::logf(SOAPY_SDR_DEBUG, "EVB7HostMemory: no hugepages reserved (%s), using transparent hugepages", std::strerror(errno));
+    }
+
+    if (_mem == nullptr)
+    {
+        const size_t align = ((flags & EVB7_MEM_HUGEPAGES) != 0)?HUGE_PAGE_SIZE:4096;
+        if (posix_memalign(&_mem, align, size) != 0) throw std::runtime_error("EVB7HostMemory: fail posix_memalign()");
+        #ifdef MADV_HUGEPAGE
+        if ((flags & EVB7_MEM_HUGEPAGES) != 0) madvise(_mem, size, MADV_HUGEPAGE);
+        #endif
+    }
+
+    if ((flags & EVB7_MEM_LOCK) != 0)
+    {
+        _locked = mlock(_mem, size) == 0;
+        if (not _locked) SoapySDR::logf(SOAPY_SDR_WARNING, "EVB7HostMemory: mlock(%d bytes) failed (%s), check RLIMIT_MEMLOCK", int(size), std::strerror(errno));
+    }
+}
+
+EVB7HostMemory::~EVB7HostMemory(void)
+{
+    if (_locked) munlock(_mem, _size);
+    if (_mapped != 0) munmap(_mem, _mapped);
+    else std::free(_mem);
+}
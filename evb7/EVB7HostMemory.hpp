@@ -0,0 +1,63 @@
+//
+// Host memory for the EVB7 stream rings.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#pragma once
+#include <cstddef>
+
+//allocation flags for the stream "hugepages" and "mlock" args
+#define EVB7_MEM_HUGEPAGES (1 << 0)
+#define EVB7_MEM_LOCK (1 << 1)
+
+/*!
+ * A page aligned block of host memory.
+ *
+ * EVB7_MEM_HUGEPAGES maps explicit hugepages (MAP_HUGETLB) and falls back
+ * to transparent hugepages when none are reserved (vm.nr_hugepages).
+ * EVB7_MEM_LOCK locks the block into RAM so it never faults while streaming,
+ * a failure (RLIMIT_MEMLOCK) is logged and the block stays unlocked.
+ */
+class EVB7HostMemory
+{
+public:
+    EVB7HostMemory(const size_t size, const int flags);
+
+    ~EVB7HostMemory(void);
+
+    void *data(void) const
+    {
+        return _mem;
+    }
+
+    size_t size(void) const
+    {
+        return _size;
+    }
+
+    //! True when backed by explicit hugepages
+    bool huge(void) const
+    {
+        return _mapped != 0;
+    }
+
+    //! True when locked into RAM
+    bool locked(void) const
+    {
+        return _locked;
+    }
+
+private:
+    //non-copyable
+    EVB7HostMemory(const EVB7HostMemory &);
+    EVB7HostMemory &operator=(const EVB7HostMemory &);
+
+    void *_mem;
+    size_t _size;
+    size_t _mapped; //mmap length when hugepages, 0 otherwise
+    bool _locked;
+};
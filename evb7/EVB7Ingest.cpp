@@ -0,0 +1,96 @@
+//
+// RX ingest ring for the EVB7 streamer.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include "EVB7Ingest.hpp"
+#include <chrono>
+#include <new>
+
+//slots start on a cache line so readers and the producer dont share lines
+#define SLOT_ALIGN 64
+
+static size_t slotStride(const size_t slotWords)
+{
+    const size_t size = offsetof(EVB7IngestSlot, words) + slotWords*sizeof(uint32_t);
+    return ((size + SLOT_ALIGN - 1)/SLOT_ALIGN)*SLOT_ALIGN;
+}
+
+EVB7IngestRing::EVB7IngestRing(const size_t numSlots, const size_t slotWords, const int memFlags):
+    _mask(numSlots-1),
+    _slotWords(slotWords),
+    _slotStride(slotStride(slotWords)),
+    _mem(numSlots*slotStride(slotWords), memFlags),
+    _head(0),
+    _numWaiters(0)
+{
+    for (size_t i = 0; i < numSlots; i++)
+    {
+        //no frame has this number before the first lap
+        auto *slot = new (&this->slot(i)) EVB7IngestSlot;
+        slot->seq.store(EVB7_INGEST_WRITING, std::memory_order_relaxed);
+        slot->numWords = 0;
+    }
+}
+
+EVB7IngestRing::~EVB7IngestRing(void)
+{
+    return;
+}
+
+bool EVB7IngestRing::valid(const uint64_t seq) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return this->slot(seq).seq.load(std::memory_order_relaxed) == seq;
+}
+
+uint32_t *EVB7IngestRing::beginWrite(void)
+{
+    auto &slot = this->slot(_head.load(std::memory_order_relaxed));
+    slot.seq.store(EVB7_INGEST_WRITING, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return slot.words;
+}
+
+void EVB7IngestRing::endWrite(const size_t numWords, const long long timeNs, const int flags)
+{
+    const uint64_t seq = _head.load(std::memory_order_relaxed);
+    auto &slot = this->slot(seq);
+    slot.numWords = numWords;
+    slot.timeNs = timeNs;
+    slot.flags = flags;
+    slot.seq.store(seq, std::memory_order_release);
+    _head.store(seq+1, std::memory_order_seq_cst);
+
+    //only pay for the lock when a reader sleeps
+    if (_numWaiters.load(std::memory_order_seq_cst) != 0)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cond.notify_all();
+    }
+}
+
+bool EVB7IngestRing::wait(const uint64_t seq, const long timeoutUs)
+{
+    if (this->head() > seq) return true;
+    if (timeoutUs <= 0) return false;
+
+    _numWaiters.fetch_add(1, std::memory_order_seq_cst);
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cond.wait_for(lock, std::chrono::microseconds(timeoutUs),
+            [this, seq](void){return this->head() > seq;});
+    }
+    _numWaiters.fetch_sub(1, std::memory_order_seq_cst);
+    return this->head() > seq;
+}
+
+void EVB7IngestRing::notify(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cond.notify_all();
+}
@@ -0,0 +1,112 @@
+//
+// RX ingest ring for the EVB7 streamer.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#pragma once
+#include "EVB7HostMemory.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/*!
+ * One frame in the ingest ring.
+ * seq is the frame number while the slot is valid,
+ * EVB7_INGEST_WRITING while the producer is filling it.
+ */
+struct EVB7IngestSlot
+{
+    std::atomic<uint64_t> seq;
+    size_t numWords;
+    long long timeNs;
+    int flags;
+    uint32_t words[1]; //slotWords long
+};
+
+#define EVB7_INGEST_WRITING (~uint64_t(0))
+
+/*!
+ * Single producer, multiple reader frame ring.
+ *
+ * The producer never waits for the readers: it overwrites the oldest frame.
+ * Each reader keeps its own frame number and checks the slot sequence
+ * before and after reading (a seqlock), so a reader that fell a ring behind
+ * sees the overrun instead of torn samples.
+ * The number of slots is a power of two so the slot index is a mask.
+ */
+class EVB7IngestRing
+{
+public:
+    EVB7IngestRing(const size_t numSlots, const size_t slotWords, const int memFlags);
+
+    ~EVB7IngestRing(void);
+
+    size_t numSlots(void) const
+    {
+        return _mask+1;
+    }
+
+    size_t slotWords(void) const
+    {
+        return _slotWords;
+    }
+
+    //! The number of frames published so far
+    uint64_t head(void) const
+    {
+        return _head.load(std::memory_order_acquire);
+    }
+
+    //! The slot for a frame number
+    EVB7IngestSlot &slot(const uint64_t seq) const
+    {
+        return *reinterpret_cast<EVB7IngestSlot *>(((char *)_mem.data()) + (seq & _mask)*_slotStride);
+    }
+
+    //! True when the slot still holds the frame, use after reading it
+    bool valid(const uint64_t seq) const;
+
+    //! Producer: the words of the next frame to fill
+    uint32_t *beginWrite(void);
+
+    //! Producer: publish the frame started by beginWrite()
+    void endWrite(const size_t numWords, const long long timeNs, const int flags);
+
+    //! Reader: wait for frame seq to be published: true when available
+    bool wait(const uint64_t seq, const long timeoutUs);
+
+    //! Wake up all waiting readers (used on shutdown)
+    void notify(void);
+
+private:
+    size_t _mask;
+    size_t _slotWords;
+    size_t _slotStride;
+    EVB7HostMemory _mem;
+    std::atomic<uint64_t> _head;
+
+    //readers only sleep on the condition when the ring is empty
+    std::atomic<size_t> _numWaiters;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+};
+
+/*!
+ * The per-stream state of one ingest ring reader.
+ */
+struct EVB7IngestReader
+{
+    int format; //EVB7Streamer::StreamFormat
+    size_t numChans;
+    bool active;
+    uint64_t seq; //next frame to read
+    size_t offset; //words already read from the frame
+    size_t overruns; //times the reader fell a ring behind
+    unsigned long long lostFrames; //frames skipped by the overruns
+};
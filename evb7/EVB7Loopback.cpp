@@ -0,0 +1,339 @@
+//
+// In-process loopback backend for the EVB7 streamer.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include "EVB7Loopback.hpp"
+#include "EVB7Regs.hpp"
+#include "twbw_helper.h"
+#include <SoapySDR/Time.hpp>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+
+//the looped back TX samples are dropped past this depth
+#define LOOPBACK_MAX_SAMPS (1 << 20)
+
+/*******************************************************************
+ * Emulated DMA channel
+ ******************************************************************/
+EVB7LoopbackDMA::EVB7LoopbackDMA(EVB7Loopback &device, const bool toHost):
+    _device(device),
+    _toHost(toHost),
+    _active(false),
+    _numBuffs(0),
+    _buffSize(0),
+    _numHeld(0)
+{
+    return;
+}
+
+EVB7LoopbackDMA::~EVB7LoopbackDMA(void)
+{
+    this->free();
+}
+
+int EVB7LoopbackDMA::alloc(const size_t numBuffs, const size_t buffSize, const int memFlags)
+{
+    std::lock_guard<std::mutex> lock(_device._mutex);
+    if (_mem) return EVB7_DMA_ERROR;
+
+    try
+    {
+        _mem.reset(new EVB7HostMemory(numBuffs*buffSize, memFlags));
+    }
+    catch (const std::exception &)
+    {
+        return EVB7_DMA_ERROR;
+    }
+    _numBuffs = numBuffs;
+    _buffSize = buffSize;
+    _lens.assign(numBuffs, 0);
+    return EVB7_DMA_OK;
+}
+
+int EVB7LoopbackDMA::free(void)
+{
+    std::lock_guard<std::mutex> lock(_device._mutex);
+    _mem.reset();
+    _numBuffs = 0;
+    _free.clear();
+    _ready.clear();
+    return EVB7_DMA_OK;
+}
+
+int EVB7LoopbackDMA::init(void)
+{
+    std::lock_guard<std::mutex> lock(_device._mutex);
+    if (not _mem) return EVB7_DMA_ERROR;
+
+    //every buffer starts with the device for S2MM, with the user for MM2S
+    _free.clear();
+    _ready.clear();
+    _numHeld = 0;
+    for (size_t i = 0; i < _numBuffs; i++)
+    {
+        if (_toHost) _free.push_back(i);
+        else _ready.push_back(i);
+    }
+    _active = true;
+    return EVB7_DMA_OK;
+}
+
+int EVB7LoopbackDMA::halt(void)
+{
+    std::lock_guard<std::mutex> lock(_device._mutex);
+    _active = false;
+    _device._cond.notify_all();
+    return EVB7_DMA_OK;
+}
+
+int EVB7LoopbackDMA::wait(const long timeoutUs)
+{
+    std::unique_lock<std::mutex> lock(_device._mutex);
+
+    //the framer produces on demand, so run it on every wake up:
+    //a control message from another thread may have started it
+    const auto ready = [this](void)
+    {
+        if (_toHost) _device.produce(*this);
+        return not _active or not _ready.empty();
+    };
+
+    //only block when needed: a zero timeout still sleeps for the timer slack
+    if (not ready() and timeoutUs > 0)
+    {
+        _device._cond.wait_for(lock, std::chrono::microseconds(timeoutUs), ready);
+    }
+    return (_active and not _ready.empty())?EVB7_DMA_OK:EVB7_DMA_TIMEOUT;
+}
+
+int EVB7LoopbackDMA::acquire(size_t &len)
+{
+    std::lock_guard<std::mutex> lock(_device._mutex);
+    if (_toHost) _device.produce(*this);
+    if (_ready.empty()) return (_numHeld == _numBuffs)?EVB7_DMA_CLAIMED:EVB7_DMA_TIMEOUT;
+    const size_t handle = _ready.front();
+    _ready.pop_front();
+    _numHeld++;
+    len = _toHost?_lens[handle]:_buffSize;
+    return int(handle);
+}
+
+void EVB7LoopbackDMA::release(const size_t handle, const size_t len)
+{
+    std::lock_guard<std::mutex> lock(_device._mutex);
+    _numHeld--;
+    if (_toHost) _free.push_back(handle);
+    else
+    {
+        _device.consume(*this, handle, len);
+        _ready.push_back(handle);
+    }
+    _device._cond.notify_all();
+}
+
+void *EVB7LoopbackDMA::addr(const size_t handle)
+{
+    return ((char *)_mem->data()) + handle*_buffSize;
+}
+
+/*******************************************************************
+ * Framer/deframer emulation
+ ******************************************************************/
+EVB7Loopback::EVB7Loopback(const SoapySDR::Kwargs &args):
+    _rxData(*this, true),
+    _rxCtrl(*this, false),
+    _txData(*this, false),
+    _txStat(*this, true),
+    _ticksPerSamp(IF_TIME_CLK/1e6),
+    _rxWordsPerSamp(1),
+    _txWordsPerSamp(1),
+    _overflowEvery(0),
+    _loopback(false),
+    _frameCount(0),
+    _rxActive(false),
+    _rxIdTag(0),
+    _rxHasTime(false),
+    _rxTimeError(false),
+    _rxIsBurst(false),
+    _rxFrameSize(RX_FRAME_SIZE),
+    _rxBurstLeft(0),
+    _rxTicks(0.0),
+    _rxCount(0),
+    _txTicks(0.0)
+{
+    if (args.count("rate") != 0) _ticksPerSamp = IF_TIME_CLK/std::stod(args.at("rate"));
+    if (args.count("overflow") != 0) _overflowEvery = std::stoul(args.at("overflow"));
+    if (args.count("loopback") != 0) _loopback = args.at("loopback") == "true";
+}
+
+EVB7Loopback::~EVB7Loopback(void)
+{
+    return;
+}
+
+EVB7DMAChannels EVB7Loopback::channels(void)
+{
+    EVB7DMAChannels dma;
+    dma.rxData = &_rxData;
+    dma.rxCtrl = &_rxCtrl;
+    dma.txData = &_txData;
+    dma.txStat = &_txStat;
+    return dma;
+}
+
+long long EVB7Loopback::getTimeNs(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return SoapySDR::ticksToTimeNs(this->nowTicks(), IF_TIME_CLK);
+}
+
+void EVB7Loopback::writeRegister(const unsigned addr, const unsigned value)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (addr == FPGA_REG_WR_RX_MIMO) _rxWordsPerSamp = (value != 0)?2:1;
+    if (addr == FPGA_REG_WR_TX_MIMO) _txWordsPerSamp = (value != 0)?2:1;
+}
+
+long long EVB7Loopback::nowTicks(void) const
+{
+    return (long long)std::max(_rxTicks, _txTicks);
+}
+
+void EVB7Loopback::produce(EVB7LoopbackDMA &dma)
+{
+    if (&dma == &_rxData) this->framerData();
+    //status messages are produced by the deframer as packets arrive
+}
+
+void EVB7Loopback::consume(EVB7LoopbackDMA &dma, const size_t handle, const size_t len)
+{
+    if (&dma == &_rxCtrl) this->framerCtrl(dma.addr(handle));
+    if (&dma == &_txData) this->deframerData(dma.addr(handle), len);
+}
+
+void EVB7Loopback::framerCtrl(const void *buff)
+{
+    long long timeTicks = 0;
+    size_t burstSize = 0;
+    twbw_framer_ctrl_unpacker(buff,
+        _rxIdTag, _rxHasTime, timeTicks,
+        _rxIsBurst, _rxFrameSize, burstSize);
+
+    //a time in the past produces a single time error packet
+    _rxTimeError = _rxHasTime and timeTicks < this->nowTicks();
+    if (_rxHasTime and not _rxTimeError) _rxTicks = double(timeTicks);
+
+    _rxBurstLeft = burstSize;
+    _rxActive = true;
+}
+
+void EVB7Loopback::framerData(void)
+{
+    while (_rxActive and _rxData._active and not _rxData._free.empty())
+    {
+        const size_t handle = _rxData._free.front();
+        _rxData._free.pop_front();
+
+        size_t numSamps = std::min(_rxFrameSize, _rxData._buffSize/sizeof(uint32_t) - 4);
+        if (_rxIsBurst) numSamps = std::min(numSamps, _rxBurstLeft);
+        if (_rxTimeError) numSamps = 0;
+
+        //overflow injection: a short frame, then the framer waits for a restart
+        bool overflow = false;
+        if (not _rxIsBurst and not _rxTimeError and _overflowEvery != 0 and (++_frameCount % _overflowEvery) == 0)
+        {
+            numSamps /= 2;
+            overflow = true;
+        }
+
+        size_t len = 0;
+        void *payload = nullptr;
+        twbw_framer_data_packer(
+            _rxData.addr(handle), len, sizeof(uint32_t),
+            payload, numSamps, _rxIdTag,
+            _rxHasTime, (long long)_rxTicks, _rxTimeError,
+            _rxIsBurst, _rxFrameSize, _rxIsBurst?_rxBurstLeft:0);
+
+        //looped back TX samples when available, otherwise a counting pattern
+        uint32_t *out = (uint32_t *)payload;
+        for (size_t i = 0; i < numSamps; i++)
+        {
+            if (_loopSamps.empty()) out[i] = _rxCount++;
+            else
+            {
+                out[i] = _loopSamps.front();
+                _loopSamps.pop_front();
+            }
+        }
+        _rxTicks += (numSamps/_rxWordsPerSamp)*_ticksPerSamp;
+
+        //the samples of the truncated frame are lost
+        if (overflow)
+        {
+            _rxTicks += ((_rxFrameSize-numSamps)/_rxWordsPerSamp)*_ticksPerSamp;
+            _rxActive = false;
+        }
+        if (_rxIsBurst)
+        {
+            _rxBurstLeft -= numSamps;
+            if (_rxBurstLeft == 0) _rxActive = false;
+        }
+        if (_rxTimeError) _rxActive = false;
+
+        _rxData._lens[handle] = len;
+        _rxData._ready.push_back(handle);
+    }
+}
+
+void EVB7Loopback::deframerData(const void *buff, const size_t len)
+{
+    const void *payload = nullptr;
+    size_t numSamps = 0;
+    int idTag = 0;
+    bool hasTime = false;
+    long long timeTicks = 0;
+    bool burstEnd = false;
+    twbw_deframer_data_unpacker(buff, len, sizeof(uint32_t),
+        payload, numSamps, idTag, hasTime, timeTicks, burstEnd);
+
+    //a packet timed in the past is dropped with a time error
+    if (hasTime and timeTicks < this->nowTicks())
+    {
+        this->deframerStat(false, idTag, true, timeTicks, true, burstEnd);
+        return;
+    }
+    if (hasTime) _txTicks = double(timeTicks);
+
+    const uint32_t *in = (const uint32_t *)payload;
+    for (size_t i = 0; _loopback and i < numSamps and _loopSamps.size() < LOOPBACK_MAX_SAMPS; i++)
+    {
+        _loopSamps.push_back(in[i]);
+    }
+    _txTicks += (numSamps/_txWordsPerSamp)*_ticksPerSamp;
+
+    if (burstEnd) this->deframerStat(false, idTag, hasTime, (long long)_txTicks, false, true);
+}
+
+void EVB7Loopback::deframerStat(const bool underflow, const int idTag, const bool hasTime, const long long timeTicks, const bool timeError, const bool burstEnd)
+{
+    //no room: the message is lost like on the hardware
+    if (not _txStat._active or _txStat._free.empty()) return;
+
+    const size_t handle = _txStat._free.front();
+    _txStat._free.pop_front();
+
+    size_t len = 0;
+    twbw_deframer_stat_packer(_txStat.addr(handle), len,
+        underflow, idTag, hasTime, timeTicks, timeError, burstEnd);
+
+    _txStat._lens[handle] = len;
+    _txStat._ready.push_back(handle);
+    _cond.notify_all();
+}
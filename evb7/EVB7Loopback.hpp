@@ -0,0 +1,137 @@
+//
+// In-process loopback backend for the EVB7 streamer.
+// Emulates the TWBW framer and deframer over memory rings
+// so the stream engine can run and be profiled without hardware.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#pragma once
+#include "EVB7DMA.hpp"
+#include <SoapySDR/Types.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+class EVB7Loopback;
+
+/*!
+ * One emulated DMA channel: a ring of buffers in host memory.
+ * Buffers move between the free list, the user and the ready list.
+ */
+class EVB7LoopbackDMA : public EVB7DMA
+{
+public:
+    EVB7LoopbackDMA(EVB7Loopback &device, const bool toHost);
+
+    ~EVB7LoopbackDMA(void);
+
+    int alloc(const size_t numBuffs, const size_t buffSize, const int memFlags);
+    int free(void);
+    int init(void);
+    int halt(void);
+    int wait(const long timeoutUs);
+    int acquire(size_t &len);
+    void release(const size_t handle, const size_t len);
+    void *addr(const size_t handle);
+
+private:
+    friend class EVB7Loopback;
+    EVB7Loopback &_device;
+    const bool _toHost; //S2MM when true, MM2S otherwise
+    bool _active;
+    std::unique_ptr<EVB7HostMemory> _mem;
+    size_t _numBuffs;
+    size_t _buffSize;
+    size_t _numHeld; //buffers held by the user
+    std::deque<size_t> _free; //device to host: empty buffers the device can fill
+    std::deque<size_t> _ready; //device to host: filled buffers, host to device: empty buffers
+    std::vector<size_t> _lens;
+};
+
+/*!
+ * Framer and deframer emulation.
+ *
+ * RX: control messages start, stop and time the framer like the gateware.
+ * Frames are produced on demand (no sample rate limit) as long as
+ * the user releases buffers; the payload is a counting pattern,
+ * or the TX samples when looped back.
+ *
+ * TX: data packets are consumed when released, timed packets in the past
+ * produce a time error status, and burst ends produce a status message.
+ *
+ * Time is counted in IF_TIME_CLK ticks at a nominal sample rate.
+ *
+ * Args:
+ *  - "rate" the nominal sample rate for timestamps (default 1e6)
+ *  - "overflow" truncate every Nth RX frame like an overflow (default 0: off)
+ *  - "loopback" feed the TX samples into the RX frames (default false)
+ */
+class EVB7Loopback
+{
+public:
+    EVB7Loopback(const SoapySDR::Kwargs &args = SoapySDR::Kwargs());
+
+    ~EVB7Loopback(void);
+
+    //! The channels to hand to the streamer
+    EVB7DMAChannels channels(void);
+
+    //! The emulated device time
+    long long getTimeNs(void);
+
+    /*!
+     * Emulated FPGA registers: the proposed FPGA_REG_WR_RX_MIMO and
+     * FPGA_REG_WR_TX_MIMO, which no EVB7 gateware implements yet.
+     * In MIMO mode a sample time carries one word per channel.
+     */
+    void writeRegister(const unsigned addr, const unsigned value);
+
+private:
+    friend class EVB7LoopbackDMA;
+
+    //called with the lock held
+    void produce(EVB7LoopbackDMA &dma);
+    void consume(EVB7LoopbackDMA &dma, const size_t handle, const size_t len);
+    void framerCtrl(const void *buff);
+    void framerData(void);
+    void deframerData(const void *buff, const size_t len);
+    void deframerStat(const bool underflow, const int idTag, const bool hasTime, const long long timeTicks, const bool timeError, const bool burstEnd);
+    long long nowTicks(void) const;
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+
+    EVB7LoopbackDMA _rxData;
+    EVB7LoopbackDMA _rxCtrl;
+    EVB7LoopbackDMA _txData;
+    EVB7LoopbackDMA _txStat;
+
+    double _ticksPerSamp;
+    size_t _rxWordsPerSamp;
+    size_t _txWordsPerSamp;
+    size_t _overflowEvery;
+    bool _loopback;
+    size_t _frameCount;
+
+    //framer state
+    bool _rxActive;
+    int _rxIdTag;
+    bool _rxHasTime;
+    bool _rxTimeError;
+    bool _rxIsBurst;
+    size_t _rxFrameSize;
+    size_t _rxBurstLeft;
+    double _rxTicks;
+    uint32_t _rxCount;
+
+    //deframer state
+    double _txTicks;
+    std::deque<uint32_t> _loopSamps;
+};
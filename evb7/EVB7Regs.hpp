@@ -55,6 +55,21 @@
 #define FPGA_REG_WR_TX_TEST 36
 #define FPGA_REG_WR_TX_PHASE 40
 
+/***********************************************************************
+ * Proposed MIMO framer registers, NOT part of the EVB7 register map:
+ * no EVB7 gateware implements them yet. The device probes
+ * FPGA_REG_RD_CAPS so that gateware which adds them is picked up;
+ * current gateware does not read back the magic there, and streams
+ * stay single channel. The loopback emulation implements them.
+ **********************************************************************/
+#define FPGA_REG_RD_CAPS 36 //gateware capabilities, see FPGA_CAPS_*
+#define FPGA_REG_WR_RX_MIMO 44 //rx framer carries both LML sample pairs (A0 B0 A1 B1...)
+#define FPGA_REG_WR_TX_MIMO 48 //tx deframer carries both LML sample pairs
+
+//FPGA_REG_RD_CAPS holds the magic in its upper 16 bits when implemented
+#define FPGA_CAPS_MAGIC 0xCA75
+#define FPGA_CAPS_MIMO (1 << 0) //FPGA_REG_WR_RX/TX_MIMO are implemented
+
 /***********************************************************************
  * Settings for the AXI DMA and framer/deframer
  **********************************************************************/
@@ -66,6 +81,14 @@
 #define DATA_NUM_BUFFS 16
 #define DATA_BUFF_SIZE 4096
 
+//limits for the per-stream "buffers", "bufflen" and "framesize" args
+#define DATA_MIN_NUM_BUFFS 2
+#define DATA_MAX_NUM_BUFFS 256 //scatter gather descriptors per channel
+#define DATA_MIN_BUFF_SIZE 64
+#define DATA_MAX_BUFF_SIZE (1 << 18) //frame size field is 16 bits + hdrs
+#define DATA_MAX_RING_SIZE (16 << 20) //per channel, from the default CMA pool
+#define MAX_FRAME_SIZE (1 << 16)
+
 #define CTRL_NUM_BUFFS 16
 #define CTRL_BUFF_SIZE 64
 
@@ -0,0 +1,445 @@
+//
+// Host side harness for the EVB7 stream engine.
+// Runs readStream/writeStream against the loopback DMA backend
+// (no sample rate limit) and reports the per call overhead.
+//
+// Usage: EVB7StreamHarness [samples per call] [seconds] [args]
+// The args go to both the loopback and the streams.
+// Ex: EVB7StreamHarness 1000 1 overflow=100,buffers=64,bufflen=16384
+// With ingest=true the RX runs also check the reader fan-out.
+// The timed command queue runs against the host clock and an emulated SPI bus.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include "EVB7Streamer.hpp"
+#include "EVB7Loopback.hpp"
+#include "EVB7CommandQueue.hpp"
+#include <SoapySDR/Logger.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+static const char *formats[] = {"CS16", "CF32", "CF64", "CS12", "CS8", "CU8"};
+
+//bytes per complex sample in the user's buffer
+static size_t formatBytes(const std::string &format)
+{
+    if (format == "CF64") return 16;
+    if (format == "CF32") return 8;
+    if (format == "CS16") return 4;
+    if (format == "CS12") return 3;
+    return 2;
+}
+
+//the stream channels 0 to numChans-1
+static std::vector<size_t> streamChannels(const size_t numChans)
+{
+    std::vector<size_t> channels;
+    for (size_t i = 0; i < numChans; i++) channels.push_back(i);
+    return channels;
+}
+
+static double secondsSince(const std::chrono::high_resolution_clock::time_point &t0)
+{
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+}
+
+/*!
+ * Stream RX for the duration and check the counting pattern.
+ * \return the number of continuity errors
+ */
+static size_t runRx(EVB7Loopback &loopback, EVB7Streamer &streamer, const std::string &format, const size_t numChans, const size_t numElems, const double seconds, const SoapySDR::Kwargs &args)
+{
+    loopback.writeRegister(FPGA_REG_WR_RX_MIMO, (numChans == 2)?1:0);
+    auto stream = streamer.setupStream(SOAPY_SDR_RX, format, streamChannels(numChans), args);
+    std::vector<std::vector<char>> mem(numChans, std::vector<char>(numElems*formatBytes(format)));
+    std::vector<void *> buffs;
+    for (auto &m : mem) buffs.push_back(m.data());
+
+    streamer.activateStream(stream, 0, 0, 0);
+
+    size_t numCalls = 0, numSamps = 0, numOverflows = 0, numErrors = 0;
+    bool first = true;
+    uint32_t expected = 0;
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    while (secondsSince(t0) < seconds)
+    {
+        int flags = 0;
+        long long timeNs = 0;
+        const int ret = streamer.readStream(stream, buffs.data(), numElems, flags, timeNs, 100000);
+        if (ret == SOAPY_SDR_TIMEOUT) continue;
+        if (ret == SOAPY_SDR_OVERFLOW)
+        {
+            //ingest reader overrun: the next sample starts a new sequence
+            numOverflows++;
+            first = true;
+            continue;
+        }
+        if (ret < 0)
+        {
+            numErrors++;
+            continue;
+        }
+        numCalls++;
+        numSamps += ret;
+        if ((flags & SOAPY_SDR_END_ABRUPT) != 0) numOverflows++;
+
+        //the native SISO format carries the loopback counter unmodified
+        if (format != "CS16" or numChans != 1) continue;
+        const uint32_t *words = (const uint32_t *)buffs[0];
+        for (int i = 0; i < ret; i++)
+        {
+            if (words[i] != expected and not first and (flags & SOAPY_SDR_END_ABRUPT) == 0) numErrors++;
+            first = false;
+            expected = words[i]+1;
+        }
+    }
+    const double elapsed = secondsSince(t0);
+
+    streamer.deactivateStream(stream, 0, 0);
+    streamer.closeStream(stream);
+
+    //the packet times only jump with the injected overflows
+    const auto stats = streamer.getStreamStats();
+    if (stats.rx_gaps > stats.rx_overflows) numErrors++;
+
+    std::printf("RX %-4s %s %10.1f Msps %8.1f ns/call %6zu overflows %6zu errors %8llu dropped samples\n",
+        format.c_str(), (numChans == 2)?"MIMO":"SISO",
+        numSamps/elapsed/1e6, elapsed*1e9/std::max<size_t>(numCalls, 1),
+        numOverflows, numErrors, stats.rx_dropped_samples);
+    return numErrors;
+}
+
+/*!
+ * Stream TX bursts for the duration.
+ * \return the number of errors
+ */
+static size_t runTx(EVB7Loopback &loopback, EVB7Streamer &streamer, const std::string &format, const size_t numChans, const size_t numElems, const double seconds, const SoapySDR::Kwargs &args)
+{
+    loopback.writeRegister(FPGA_REG_WR_TX_MIMO, (numChans == 2)?1:0);
+    auto stream = streamer.setupStream(SOAPY_SDR_TX, format, streamChannels(numChans), args);
+    std::vector<std::vector<char>> mem(numChans, std::vector<char>(numElems*formatBytes(format)));
+    std::vector<const void *> buffs;
+    for (auto &m : mem) buffs.push_back(m.data());
+
+    streamer.activateStream(stream, 0, 0, 0);
+
+    size_t numCalls = 0, numSamps = 0, numErrors = 0;
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    while (secondsSince(t0) < seconds)
+    {
+        int flags = ((numCalls % 16) == 15)?SOAPY_SDR_END_BURST:0;
+        const int ret = streamer.writeStream(stream, buffs.data(), numElems, flags, 0, 100000);
+        if (ret == SOAPY_SDR_TIMEOUT) continue;
+        if (ret < 0)
+        {
+            numErrors++;
+            continue;
+        }
+        numCalls++;
+        numSamps += ret;
+    }
+    const double elapsed = secondsSince(t0);
+
+    //a burst timed in the past must come back as a time error,
+    //first let the status ring drain: the deframer drops stats when it is full
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    int flags = SOAPY_SDR_HAS_TIME | SOAPY_SDR_END_BURST;
+    streamer.writeStream(stream, buffs.data(), numElems, flags, 1, 100000);
+    size_t numTimeErrors = 0;
+    while (true)
+    {
+        size_t chanMask = 0;
+        long long timeNs = 0;
+        const int ret = streamer.readStreamStatus(stream, chanMask, flags, timeNs, 100000);
+        if (ret == SOAPY_SDR_TIMEOUT) break;
+        if (ret == SOAPY_SDR_TIME_ERROR) numTimeErrors++;
+    }
+    if (numTimeErrors != 1) numErrors++;
+    const auto stats = streamer.getStreamStats();
+
+    streamer.deactivateStream(stream, 0, 0);
+    streamer.closeStream(stream);
+
+    std::printf("TX %-4s %s %10.1f Msps %8.1f ns/call %6zu errors %8llu burst ends %6llu dropped status\n",
+        format.c_str(), (numChans == 2)?"MIMO":"SISO",
+        numSamps/elapsed/1e6, elapsed*1e9/std::max<size_t>(numCalls, 1),
+        numErrors, stats.tx_burst_ends, stats.tx_status_dropped);
+    return numErrors;
+}
+
+/*!
+ * Zero copy CS16 reads and batched buffer reads.
+ * \return the number of continuity errors
+ */
+static size_t runDirect(EVB7Loopback &loopback, EVB7Streamer &streamer, const size_t numElems, const double seconds, const SoapySDR::Kwargs &args)
+{
+    loopback.writeRegister(FPGA_REG_WR_RX_MIMO, 0);
+    size_t errors = 0;
+
+    //the counting pattern carries on across buffers unless an overflow hit
+    bool first = true;
+    uint32_t expected = 0;
+    const auto check = [&](const uint32_t *words, const size_t n, const int flags)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (words[i] != expected and not first and (flags & SOAPY_SDR_END_ABRUPT) == 0) errors++;
+            first = false;
+            expected = words[i]+1;
+        }
+    };
+
+    SoapySDR::Kwargs zcArgs(args);
+    zcArgs["zerocopy"] = "true";
+    zcArgs.erase("ingest");
+    auto stream = streamer.setupStream(SOAPY_SDR_RX, "CS16", streamChannels(1), zcArgs);
+    streamer.activateStream(stream, 0, 0, 0);
+    size_t numCalls = 0, numSamps = 0;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    while (secondsSince(t0) < seconds)
+    {
+        const void *view = nullptr;
+        int flags = 0;
+        long long timeNs = 0;
+        const int ret = streamer.readStreamView(stream, view, numElems, flags, timeNs, 100000);
+        if (ret <= 0) continue;
+        check((const uint32_t *)view, ret, flags);
+        numCalls++;
+        numSamps += ret;
+    }
+    double elapsed = secondsSince(t0);
+    streamer.deactivateStream(stream, 0, 0);
+    std::printf("RX CS16 zero copy %10.1f Msps %8.1f ns/call\n",
+        numSamps/elapsed/1e6, elapsed*1e9/std::max<size_t>(numCalls, 1));
+
+    //timed stream read in small views: each continuation fragment
+    //starts where the previous fragment of its packet ended
+    const double rate = (args.count("rate") != 0)?std::stod(args.at("rate")):1e6;
+    streamer.activateStream(stream, SOAPY_SDR_HAS_TIME, loopback.getTimeNs()+1000000, 0);
+    size_t numFragments = 0, timeErrors = 0;
+    long long nextTimeNs = -1;
+    for (size_t i = 0; i < 1000; i++)
+    {
+        const void *view = nullptr;
+        int flags = 0;
+        long long timeNs = 0;
+        const int ret = streamer.readStreamView(stream, view, 100, flags, timeNs, 100000);
+        if (ret <= 0) continue;
+        if ((flags & SOAPY_SDR_HAS_TIME) == 0) nextTimeNs = -1;
+        else
+        {
+            //the framer stamps whole ticks, allow a tick each way
+            if (nextTimeNs >= 0 and std::abs(timeNs - nextTimeNs) > 1e9/IF_TIME_CLK) timeErrors++;
+            if (nextTimeNs >= 0) numFragments++;
+            nextTimeNs = ((flags & SOAPY_SDR_MORE_FRAGMENTS) != 0)?timeNs + (long long)std::llround(ret*1e9/rate):-1;
+        }
+    }
+    streamer.deactivateStream(stream, 0, 0);
+    streamer.closeStream(stream);
+    std::printf("RX CS16 zero copy %zu timed fragments %6zu time errors\n", numFragments, timeErrors);
+    errors += timeErrors + ((numFragments == 0)?1:0);
+
+    SoapySDR::Kwargs batchArgs(args);
+    batchArgs.erase("ingest");
+    stream = streamer.setupStream(SOAPY_SDR_RX, "CS16", streamChannels(1), batchArgs);
+    streamer.activateStream(stream, 0, 0, 0);
+    const size_t maxBuffs = streamer.getNumDirectAccessBuffers(stream)/2;
+    std::vector<size_t> handles(maxBuffs), lens(maxBuffs);
+    std::vector<const void *> views(maxBuffs);
+    std::vector<int> flags(maxBuffs);
+    std::vector<long long> times(maxBuffs);
+    numCalls = 0;
+    numSamps = 0;
+    first = true;
+    t0 = std::chrono::high_resolution_clock::now();
+    while (secondsSince(t0) < seconds)
+    {
+        const int ret = streamer.acquireReadBuffers(stream, maxBuffs,
+            handles.data(), views.data(), lens.data(), flags.data(), times.data(), 100000);
+        if (ret <= 0) continue;
+        for (int i = 0; i < ret; i++)
+        {
+            check((const uint32_t *)views[i], lens[i], flags[i]);
+            numSamps += lens[i];
+        }
+        streamer.releaseReadBuffers(stream, ret, handles.data());
+        numCalls++;
+    }
+    elapsed = secondsSince(t0);
+    streamer.deactivateStream(stream, 0, 0);
+    streamer.closeStream(stream);
+    std::printf("RX CS16 batch %2zu   %10.1f Msps %8.1f ns/call %6zu errors\n",
+        maxBuffs, numSamps/elapsed/1e6, elapsed*1e9/std::max<size_t>(numCalls, 1), errors);
+    return errors;
+}
+
+/*!
+ * Ingest mode: several readers on their own threads, the last one slow.
+ * \return the number of continuity errors
+ */
+static size_t runFanout(EVB7Loopback &loopback, EVB7Streamer &streamer, const size_t numElems, const double seconds, const SoapySDR::Kwargs &args)
+{
+    loopback.writeRegister(FPGA_REG_WR_RX_MIMO, 0);
+    const size_t numReaders = 3;
+    std::vector<SoapySDR::Stream *> streams;
+    for (size_t r = 0; r < numReaders; r++)
+    {
+        streams.push_back(streamer.setupStream(SOAPY_SDR_RX, "CS16", streamChannels(1), args));
+    }
+
+    //a reader on another channel than the running ring is refused
+    size_t mismatches = 0;
+    try
+    {
+        streamer.closeStream(streamer.setupStream(SOAPY_SDR_RX, "CS16", std::vector<size_t>(1, 1), args));
+        mismatches++;
+    }
+    catch (const std::runtime_error &) {}
+    for (auto stream : streams) streamer.activateStream(stream, 0, 0, 0);
+
+    std::vector<size_t> numSamps(numReaders, 0), numErrors(numReaders, 0);
+    std::vector<std::thread> threads;
+    for (size_t r = 0; r < numReaders; r++)
+    {
+        threads.push_back(std::thread([&, r](void)
+        {
+            std::vector<uint32_t> buff(numElems);
+            void *buffs[] = {buff.data()};
+            bool first = true;
+            uint32_t expected = 0;
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            while (secondsSince(t0) < seconds)
+            {
+                int flags = 0;
+                long long timeNs = 0;
+                const int ret = streamer.readStream(streams[r], buffs, numElems, flags, timeNs, 100000);
+                if (ret == SOAPY_SDR_OVERFLOW) first = true;
+                if (ret <= 0) continue;
+                numSamps[r] += ret;
+                for (int i = 0; i < ret; i++)
+                {
+                    if (buff[i] != expected and not first and (flags & SOAPY_SDR_END_ABRUPT) == 0) numErrors[r]++;
+                    first = false;
+                    expected = buff[i]+1;
+                }
+                if (r == numReaders-1) std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }));
+    }
+    for (auto &t : threads) t.join();
+
+    size_t errors = mismatches;
+    if (mismatches != 0) std::printf("RX ingest reader on another channel was not refused\n");
+    for (size_t r = 0; r < numReaders; r++)
+    {
+        size_t overruns = 0;
+        unsigned long long lostFrames = 0;
+        streamer.getIngestOverruns(streams[r], overruns, lostFrames);
+        std::printf("RX ingest reader %zu%s %10.1f Msps %6zu overruns %8llu lost frames %6zu errors\n",
+            r, (r == numReaders-1)?" (slow)":"       ", numSamps[r]/seconds/1e6, overruns, lostFrames, numErrors[r]);
+        errors += numErrors[r];
+    }
+
+    for (auto stream : streams) streamer.deactivateStream(stream, 0, 0);
+    for (auto stream : streams) streamer.closeStream(stream);
+    return errors;
+}
+
+/*!
+ * Timed commands on an emulated SPI bus: 20 us per batch plus 2 us per word.
+ * \return the number of commands written out of order
+ */
+static size_t runCommands(void)
+{
+    const auto epoch = std::chrono::steady_clock::now();
+    const auto hostTime = [epoch](void)
+    {
+        return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    };
+
+    std::vector<int> written;
+    std::vector<long long> doneTimes;
+    EVB7CommandQueue queue(hostTime, [&](const int *addrs, const int *, const size_t num)
+    {
+        const long long doneNs = hostTime() + 20000 + 2000*num;
+        while (hostTime() < doneNs){}
+        written.push_back(addrs[0]);
+        doneTimes.push_back(hostTime());
+    }, 50000);
+    queue.calibrate(std::vector<int>(1, -1), std::vector<int>(1, 0), 8);
+    queue.calibrate(std::vector<int>(16, -1), std::vector<int>(16, 0), 8);
+    written.clear();
+    doneTimes.clear();
+
+    //retunes of 1 to 32 words every millisecond, queued out of order
+    const size_t numCmds = 200;
+    const long long t0 = hostTime() + 10000000;
+    for (size_t i = 0; i < numCmds; i++)
+    {
+        const size_t j = (i*7919) % numCmds;
+        const size_t numWords = 1 + (j*13) % 32;
+        queue.push(t0 + j*1000000, std::vector<int>(numWords, int(j)), std::vector<int>(numWords, 0));
+    }
+    while (queue.pending() != 0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    //the command number is the address, so the write knows its time
+    size_t order = 0;
+    std::vector<long long> absErrors;
+    for (size_t i = 0; i < written.size(); i++)
+    {
+        if (written[i] != int(i)) order++;
+        absErrors.push_back(std::abs(doneTimes[i] - (t0 + written[i]*1000000LL)));
+    }
+    std::sort(absErrors.begin(), absErrors.end());
+    const EVB7CommandStats stats = queue.getStats();
+    std::printf("CMD %llu commands, SPI model %.1f us + %.2f us/word, median error %.1f us, %llu late, max late %.1f us, %zu out of order\n",
+        stats.commands, stats.overheadNs/1e3, stats.wordNs/1e3, absErrors.empty()?0.0:absErrors[absErrors.size()/2]/1e3,
+        stats.late, stats.maxLateNs/1e3, order);
+    return order;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t numElems = (argc > 1)?std::strtoul(argv[1], NULL, 10):1000;
+    const double seconds = (argc > 2)?std::atof(argv[2]):0.5;
+    const SoapySDR::Kwargs args = (argc > 3)?SoapySDR::KwargsFromString(argv[3]):SoapySDR::Kwargs();
+
+    SoapySDR::setLogLevel(SOAPY_SDR_WARNING);
+
+    EVB7Loopback loopback(args);
+    EVB7Streamer streamer(loopback.channels(), [&loopback](void){return loopback.getTimeNs();});
+    streamer.setSampleRate(SOAPY_SDR_RX, (args.count("rate") != 0)?std::stod(args.at("rate")):1e6);
+
+    //the ring geometry from the stream args
+    auto stream = streamer.setupStream(SOAPY_SDR_RX, "CS16", streamChannels(1), args);
+    const EVB7StreamGeometry geom = streamer.getStreamGeometry(stream);
+    streamer.closeStream(stream);
+    std::printf("ring: %zu x %zu bytes, %zu words per frame, %zu samples deep\n",
+        geom.numBuffs, geom.buffSize, geom.frameSize, geom.ringSamps());
+
+    size_t errors = 0;
+    for (const auto format : formats)
+    {
+        for (size_t numChans = 1; numChans <= 2; numChans++)
+        {
+            errors += runRx(loopback, streamer, format, numChans, numElems, seconds, args);
+            errors += runTx(loopback, streamer, format, numChans, numElems, seconds, args);
+        }
+    }
+
+    errors += runDirect(loopback, streamer, numElems, seconds, args);
+    if (args.count("ingest") != 0) errors += runFanout(loopback, streamer, numElems, seconds, args);
+    errors += runCommands();
+
+    return (errors == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
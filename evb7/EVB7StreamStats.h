@@ -0,0 +1,47 @@
+///
+/// \file EVB7StreamStats.h
+///
+/// Stream health counters for the EVB7 streamer.
+/// Plain C so monitoring code can take a snapshot without C++.
+///
+/// \copyright
+/// Copyright (c) 2015-2017 Fairwaves, Inc.
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#pragma once
+
+/*!
+ * Totals since the stream of each direction was setup.
+ * Samples are counted per channel.
+ */
+typedef struct
+{
+    unsigned long long rx_packets; //!< RX data packets from the framer
+    unsigned long long rx_samples; //!< RX samples delivered by the framer
+    unsigned long long rx_overflows; //!< RX packets truncated by an overflow
+    unsigned long long rx_restarts; //!< continuous streaming restarts after an overflow
+    unsigned long long rx_gaps; //!< RX packets whose time does not follow the previous packet
+    unsigned long long rx_dropped_samples; //!< RX samples missing according to the packet times
+    unsigned long long rx_tag_errors; //!< RX packets with an unknown tag
+    unsigned long long rx_time_errors; //!< RX activations timed in the past
+    unsigned long long rx_ingest_overruns; //!< times an ingest reader fell a ring behind
+
+    unsigned long long tx_packets; //!< TX data packets to the deframer
+    unsigned long long tx_samples; //!< TX samples sent to the deframer
+    unsigned long long tx_underflows; //!< TX underflow status messages
+    unsigned long long tx_time_errors; //!< TX packets timed in the past
+    unsigned long long tx_burst_ends; //!< TX burst end status messages
+    unsigned long long tx_status_dropped; //!< TX status events lost to a full queue
+} EVB7_stream_stats_t;
+
+/*!
+ * The counter names, in struct order, used as the EVB7 sensor keys.
+ */
+#define EVB7_STREAM_STATS_NAMES \
+    "rx_packets", "rx_samples", "rx_overflows", "rx_restarts", \
+    "rx_gaps", "rx_dropped_samples", "rx_tag_errors", "rx_time_errors", \
+    "rx_ingest_overruns", \
+    "tx_packets", "tx_samples", "tx_underflows", "tx_time_errors", \
+    "tx_burst_ends", "tx_status_dropped"
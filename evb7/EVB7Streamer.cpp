@@ -0,0 +1,1245 @@
+//
+// Stream engine for the EVB7.
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include "EVB7Streamer.hpp"
+#include "twbw_helper.h"
+#include <SoapySDR/Logger.hpp>
+#include <LMS7002M/LMS7002M_convert.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <pthread.h>
+#include <sched.h>
+
+/*******************************************************************
+ * Conversions
+ ******************************************************************/
+void convert_cs16_to_word32(const void *inp, void *outp, const size_t n)
+{
+    std::memcpy(outp, inp, n*sizeof(uint32_t));
+}
+
+void convert_cf32_to_word32(const void *inp, void *outp, const size_t n)
+{
+    LMS7_conv_cf32_to_cs16(inp, outp, n, LMS7_CONV_FULL_SCALE);
+}
+
+void convert_word32_to_cs16(const void *inp, void *outp, const size_t n)
+{
+    std::memcpy(outp, inp, n*sizeof(uint32_t));
+}
+
+void convert_word32_to_cf32(const void *inp, void *outp, const size_t n)
+{
+    LMS7_conv_cs16_to_cf32(inp, outp, n, LMS7_CONV_FULL_SCALE);
+}
+
+void convert_cf64_to_word32(const void *inp, void *outp, const size_t n)
+{
+    LMS7_conv_cf64_to_cs16(inp, outp, n, LMS7_CONV_FULL_SCALE);
+}
+
+void convert_word32_to_cf64(const void *inp, void *outp, const size_t n)
+{
+    LMS7_conv_cs16_to_cf64(inp, outp, n, LMS7_CONV_FULL_SCALE);
+}
+
+void convert_cs12_to_word32(const void *inp, void *outp, const size_t n)
+{
+    LMS7_conv_cs12_to_cs16(inp, outp, n, LMS7_CONV_FULL_SCALE);
+}
+
+void convert_word32_to_cs12(const void *inp, void *outp, const size_t n)
+{
+    LMS7_conv_cs16_to_cs12(inp, outp, n, LMS7_CONV_FULL_SCALE);
+}
+
+void convert_cs8_to_word32(const void *inp, void *outp, const size_t n)
+{
+    LMS7_conv_cs8_to_cs16(inp, outp, n, LMS7_CONV_FULL_SCALE);
+}
+
+void convert_word32_to_cs8(const void *inp, void *outp, const size_t n)
+{
+    LMS7_conv_cs16_to_cs8(inp, outp, n, LMS7_CONV_FULL_SCALE);
+}
+
+void convert_cu8_to_word32(const void *inp, void *outp, const size_t n)
+{
+    LMS7_conv_cu8_to_cs16(inp, outp, n, LMS7_CONV_FULL_SCALE);
+}
+
+void convert_word32_to_cu8(const void *inp, void *outp, const size_t n)
+{
+    LMS7_conv_cs16_to_cu8(inp, outp, n, LMS7_CONV_FULL_SCALE);
+}
+
+typedef void (*ConvertFcn)(const void *, void *, const size_t);
+
+static ConvertFcn rxConverter(const EVB7Streamer::StreamFormat format)
+{
+    switch (format)
+    {
+    case EVB7Streamer::SF_CS16: return convert_word32_to_cs16;
+    case EVB7Streamer::SF_CF32: return convert_word32_to_cf32;
+    case EVB7Streamer::SF_CF64: return convert_word32_to_cf64;
+    case EVB7Streamer::SF_CS12: return convert_word32_to_cs12;
+    case EVB7Streamer::SF_CS8: return convert_word32_to_cs8;
+    case EVB7Streamer::SF_CU8: return convert_word32_to_cu8;
+    }
+    return nullptr;
+}
+
+static ConvertFcn txConverter(const EVB7Streamer::StreamFormat format)
+{
+    switch (format)
+    {
+    case EVB7Streamer::SF_CS16: return convert_cs16_to_word32;
+    case EVB7Streamer::SF_CF32: return convert_cf32_to_word32;
+    case EVB7Streamer::SF_CF64: return convert_cf64_to_word32;
+    case EVB7Streamer::SF_CS12: return convert_cs12_to_word32;
+    case EVB7Streamer::SF_CS8: return convert_cs8_to_word32;
+    case EVB7Streamer::SF_CU8: return convert_cu8_to_word32;
+    }
+    return nullptr;
+}
+
+//bytes per complex sample in the user's buffer
+static size_t formatSize(const EVB7Streamer::StreamFormat format)
+{
+    switch (format)
+    {
+    case EVB7Streamer::SF_CS16: return 4;
+    case EVB7Streamer::SF_CF32: return 8;
+    case EVB7Streamer::SF_CF64: return 16;
+    case EVB7Streamer::SF_CS12: return 3;
+    case EVB7Streamer::SF_CS8: return 2;
+    case EVB7Streamer::SF_CU8: return 2;
+    }
+    return 0;
+}
+
+//MIMO conversions split the words a block at a time,
+//2 channels x 512 words keeps the scratch within the L1 cache
+#define MIMO_SCRATCH_SAMPS 512
+
+static void convertRx(const EVB7Streamer::StreamFormat format, const size_t numChans, const uint32_t *in, void * const *buffs, const size_t numSamps)
+{
+    const ConvertFcn conv = rxConverter(format);
+
+    //SISO: convert straight into the user's buffer
+    if (numChans == 1) conv(in, buffs[0], numSamps);
+
+    //MIMO native format: split straight into the user's buffers
+    else if (format == EVB7Streamer::SF_CS16) LMS7_conv_deinterleave(in, buffs[0], buffs[1], numSamps);
+
+    //MIMO other formats: split into the scratch then convert each channel
+    else
+    {
+        uint32_t scratch[2][MIMO_SCRATCH_SAMPS];
+        const size_t size = formatSize(format);
+        for (size_t i = 0; i < numSamps; i += MIMO_SCRATCH_SAMPS)
+        {
+            const size_t n = std::min<size_t>(numSamps-i, MIMO_SCRATCH_SAMPS);
+            LMS7_conv_deinterleave(in+i*2, scratch[0], scratch[1], n);
+            conv(scratch[0], ((char *)buffs[0])+i*size, n);
+            conv(scratch[1], ((char *)buffs[1])+i*size, n);
+        }
+    }
+}
+
+static void convertTx(const EVB7Streamer::StreamFormat format, const size_t numChans, const void * const *buffs, uint32_t *out, const size_t numSamps)
+{
+    const ConvertFcn conv = txConverter(format);
+
+    //SISO: convert straight from the user's buffer
+    if (numChans == 1) conv(buffs[0], out, numSamps);
+
+    //MIMO native format: merge straight from the user's buffers
+    else if (format == EVB7Streamer::SF_CS16) LMS7_conv_interleave(buffs[0], buffs[1], out, numSamps);
+
+    //MIMO other formats: convert each channel into the scratch then merge
+    else
+    {
+        uint32_t scratch[2][MIMO_SCRATCH_SAMPS];
+        const size_t size = formatSize(format);
+        for (size_t i = 0; i < numSamps; i += MIMO_SCRATCH_SAMPS)
+        {
+            const size_t n = std::min<size_t>(numSamps-i, MIMO_SCRATCH_SAMPS);
+            conv(((const char *)buffs[0])+i*size, scratch[0], n);
+            conv(((const char *)buffs[1])+i*size, scratch[1], n);
+            LMS7_conv_interleave(scratch[0], scratch[1], out+i*2, n);
+        }
+    }
+}
+
+//status events kept for readStreamStatus(), about 2 events per burst
+#define TX_STATUS_QUEUE_DEPTH 64
+
+//ingest ring size in frames, 4096 x 1000 samples is about 130ms at 30Msps
+#define INGEST_NUM_FRAMES 4096
+#define INGEST_MAX_FRAMES (1 << 20)
+
+/*******************************************************************
+ * Stream geometry
+ ******************************************************************/
+static bool argToBool(const SoapySDR::Kwargs &args, const std::string &key)
+{
+    if (args.count(key) == 0) return false;
+    const std::string &value = args.at(key);
+    return value == "true" or value == "TRUE" or value == "1";
+}
+
+static size_t argToSize(const SoapySDR::Kwargs &args, const std::string &key, const size_t defaultValue, const size_t minValue, const size_t maxValue)
+{
+    if (args.count(key) == 0) return defaultValue;
+    size_t value = 0;
+    try
+    {
+        value = std::stoul(args.at(key));
+    }
+    catch (const std::exception &)
+    {
+        throw std::runtime_error("EVB7::setupStream: "+key+"="+args.at(key)+" not a number");
+    }
+    if (value < minValue or value > maxValue) throw std::runtime_error(
+        "EVB7::setupStream: "+key+"="+args.at(key)+" out of range ["+
+        std::to_string(minValue)+", "+std::to_string(maxValue)+"]");
+    return value;
+}
+
+static EVB7StreamGeometry parseGeometry(const SoapySDR::Kwargs &args, const size_t numChans)
+{
+    EVB7StreamGeometry geom;
+    geom.numChans = numChans;
+    geom.numBuffs = argToSize(args, "buffers", DATA_NUM_BUFFS, DATA_MIN_NUM_BUFFS, DATA_MAX_NUM_BUFFS);
+    geom.buffSize = argToSize(args, "bufflen", DATA_BUFF_SIZE, DATA_MIN_BUFF_SIZE, DATA_MAX_BUFF_SIZE);
+    if ((geom.buffSize % XFER_SIZE) != 0) throw std::runtime_error(
+        "EVB7::setupStream: bufflen must be a multiple of "+std::to_string(XFER_SIZE));
+    if (geom.numBuffs*geom.buffSize > DATA_MAX_RING_SIZE) throw std::runtime_error(
+        "EVB7::setupStream: buffers*bufflen exceeds "+std::to_string(DATA_MAX_RING_SIZE)+" bytes");
+
+    //the frame fills the buffer past the 4 header transfers
+    //keep the stock frame size unless the buffer size was changed
+    const size_t maxFrame = std::min<size_t>(geom.buffSize/XFER_SIZE - 4, MAX_FRAME_SIZE);
+    const size_t defaultFrame = (args.count("bufflen") == 0)?RX_FRAME_SIZE:maxFrame;
+    geom.frameSize = argToSize(args, "framesize", defaultFrame, numChans, maxFrame);
+
+    //MIMO frames must not split a sample pair
+    geom.frameSize -= geom.frameSize % numChans;
+
+    geom.memFlags = 0;
+    if (argToBool(args, "hugepages")) geom.memFlags |= EVB7_MEM_HUGEPAGES;
+    if (argToBool(args, "mlock")) geom.memFlags |= EVB7_MEM_LOCK;
+    return geom;
+}
+
+/*******************************************************************
+ * Constructor
+ ******************************************************************/
+EVB7Streamer::EVB7Streamer(const EVB7DMAChannels &dma, const std::function<long long(void)> &getTimeNs):
+    _dma(dma),
+    _getTimeNs(getTimeNs),
+    _remainderHandle(-1),
+    _remainderSamps(0),
+    _remainderBuff(nullptr),
+    _remainderOffset(0),
+    _remainderTimeNs(0),
+    _remainderHasTime(false),
+    _rxZeroCopy(false),
+    _txIdTag(0),
+    _rxFormat(SF_CS16),
+    _txFormat(SF_CS16),
+    _rxNumChans(1),
+    _txNumChans(1),
+    _rxChans(1, 0),
+    _rxGeom(parseGeometry(SoapySDR::Kwargs(), 1)),
+    _txGeom(parseGeometry(SoapySDR::Kwargs(), 1)),
+    _ingest(nullptr),
+    _ingestRunning(false),
+    _numActiveReaders(0),
+    _txStatRunning(false),
+    _rxTicksPerSamp(0.0),
+    _rxNextValid(false),
+    _rxNextTicks(0.0)
+{
+    std::memset(&_stats, 0, sizeof(_stats));
+}
+
+EVB7Streamer::~EVB7Streamer(void)
+{
+    this->stopIngest();
+    this->stopTxStatus();
+}
+
+/*******************************************************************
+ * Stream config
+ ******************************************************************/
+SoapySDR::Stream *EVB7Streamer::setupStream(
+    const int direction,
+    const std::string &format,
+    const std::vector<size_t> &channels,
+    const SoapySDR::Kwargs &args)
+{
+    const size_t numChans = channels.size();
+
+    //check the format config
+    StreamFormat f;
+    if (format == "CS16") f = SF_CS16;
+    else if (format == "CF32") f = SF_CF32;
+    else if (format == "CF64") f = SF_CF64;
+    else if (format == "CS12") f = SF_CS12;
+    else if (format == "CS8") f = SF_CS8;
+    else if (format == "CU8") f = SF_CU8;
+    else throw std::runtime_error("EVB7::setupStream: "+format);
+
+    //ingest mode: another reader on the running ring
+    if (direction == SOAPY_SDR_RX and _ingest != nullptr)
+    {
+        if (channels != _rxChans) throw std::runtime_error("EVB7::setupStream: ingest readers must use the same channels in the same order");
+        return this->setupReader(f, numChans);
+    }
+
+    //check the ring config
+    const EVB7StreamGeometry geom = parseGeometry(args, numChans);
+
+    //zero copy views are raw LML words: CS16 and one channel
+    const bool zeroCopy = direction == SOAPY_SDR_RX and argToBool(args, "zerocopy");
+    if (zeroCopy and (f != SF_CS16 or numChans != 1 or argToBool(args, "ingest")))
+    {
+        throw std::runtime_error("EVB7::setupStream: zerocopy needs a single channel CS16 stream without ingest");
+    }
+
+    //store the format
+    if (direction == SOAPY_SDR_TX) _txGeom = geom;
+    if (direction == SOAPY_SDR_RX) _rxGeom = geom;
+    if (direction == SOAPY_SDR_TX) _txFormat = f;
+    if (direction == SOAPY_SDR_RX) _rxFormat = f;
+    if (direction == SOAPY_SDR_TX) _txNumChans = numChans;
+    if (direction == SOAPY_SDR_RX) _rxNumChans = numChans;
+    if (direction == SOAPY_SDR_RX) _rxChans = channels;
+
+    if (direction == SOAPY_SDR_RX)
+    {
+        _rxZeroCopy = zeroCopy;
+        _remainderHandle = -1;
+        this->resetStats(direction);
+
+        //allocate dma memory
+        int ret = 0;
+        ret = _dma.rxData->alloc(geom.numBuffs, geom.buffSize, geom.memFlags);
+        if (ret != EVB7_DMA_OK) throw std::runtime_error("EVB7::setupStream: fail alloc rx data DMA");
+        ret = _dma.rxCtrl->alloc(CTRL_NUM_BUFFS, CTRL_BUFF_SIZE);
+        if (ret != EVB7_DMA_OK) throw std::runtime_error("EVB7::setupStream: fail alloc rx ctrl DMA");
+
+        //start the channels
+        ret = _dma.rxData->init();
+        if (ret != EVB7_DMA_OK) throw std::runtime_error("EVB7::setupStream: fail init rx data DMA");
+        ret = _dma.rxCtrl->init();
+        if (ret != EVB7_DMA_OK) throw std::runtime_error("EVB7::setupStream: fail init rx ctrl DMA");
+
+        //ensure stream inactive
+        this->sendControlMessage(RX_TAG_DEACTIVATE, false, true, geom.frameSize, 1, 0);
+
+        //flush
+        this->rxFlush();
+
+        //the ingest thread owns the DMA, the user gets a reader
+        if (argToBool(args, "ingest"))
+        {
+            this->startIngest(args);
+            return this->setupReader(f, numChans);
+        }
+
+        return reinterpret_cast<SoapySDR::Stream *>(_dma.rxData);
+    }
+
+    if (direction == SOAPY_SDR_TX)
+    {
+        this->resetStats(direction);
+
+        //allocate dma memory
+        int ret = 0;
+        ret = _dma.txData->alloc(geom.numBuffs, geom.buffSize, geom.memFlags);
+        if (ret != EVB7_DMA_OK) throw std::runtime_error("EVB7::setupStream: fail alloc tx data DMA");
+        ret = _dma.txStat->alloc(CTRL_NUM_BUFFS, CTRL_BUFF_SIZE);
+        if (ret != EVB7_DMA_OK) throw std::runtime_error("EVB7::setupStream: fail alloc tx stat DMA");
+
+        //start the channels
+        ret = _dma.txData->init();
+        if (ret != EVB7_DMA_OK) throw std::runtime_error("EVB7::setupStream: fail init tx data DMA");
+        ret = _dma.txStat->init();
+        if (ret != EVB7_DMA_OK) throw std::runtime_error("EVB7::setupStream: fail init tx stat DMA");
+
+        //drain the status channel in the background
+        this->startTxStatus();
+
+        return reinterpret_cast<SoapySDR::Stream *>(_dma.txData);
+    }
+
+    return nullptr;
+}
+
+void EVB7Streamer::rxFlush(void)
+{
+    while (true)
+    {
+        int ret = _dma.rxData->wait(1000);
+        if (ret != 0) break;
+        size_t len = 0;
+        int handle = _dma.rxData->acquire(len);
+        if (handle < 0) break;
+        _dma.rxData->release(handle, 0);
+    }
+}
+
+void EVB7Streamer::closeStream(SoapySDR::Stream *stream)
+{
+    auto reader = this->toReader(stream);
+    if (reader != nullptr)
+    {
+        if (reader->active) this->deactivateStream(stream, 0, 0);
+        {
+            std::lock_guard<std::mutex> lock(_ingestMutex);
+            _readers.erase(std::find(_readers.begin(), _readers.end(), reader));
+            delete reader;
+        }
+
+        //the last reader stops the ingest thread and closes the DMA
+        if (not _readers.empty()) return;
+        this->stopIngest();
+        stream = reinterpret_cast<SoapySDR::Stream *>(_dma.rxData);
+    }
+
+    if (isRx(stream))
+    {
+        //halt the channels
+        _dma.rxData->halt();
+        _dma.rxCtrl->halt();
+
+        //free dma memory
+        _dma.rxData->free();
+        _dma.rxCtrl->free();
+    }
+
+    if (isTx(stream))
+    {
+        this->stopTxStatus();
+
+        //halt the channels
+        _dma.txData->halt();
+        _dma.txStat->halt();
+
+        //free dma memory
+        _dma.txData->free();
+        _dma.txStat->free();
+    }
+}
+
+size_t EVB7Streamer::getStreamMTU(SoapySDR::Stream *stream) const
+{
+    if (isRx(stream) or toReader(stream) != nullptr) return _rxGeom.frameSamps();
+    if (isTx(stream)) return _txGeom.frameSamps();
+    return 0;
+}
+
+const EVB7StreamGeometry &EVB7Streamer::getStreamGeometry(SoapySDR::Stream *stream) const
+{
+    return isTx(stream)?_txGeom:_rxGeom;
+}
+
+int EVB7Streamer::sendControlMessage(const int tag, const bool timeFlag, const bool burstFlag, const int frameSize, const int burstSize, const long long time)
+{
+    std::lock_guard<std::mutex> lock(_ctrlMutex);
+    size_t len = 0;
+    int handle = _dma.rxCtrl->acquire(len);
+    if (handle < 0) return SOAPY_SDR_STREAM_ERROR;
+
+    twbw_framer_ctrl_packer(
+        _dma.rxCtrl->addr(handle), len,
+        tag, timeFlag, time,
+        burstFlag, frameSize, burstSize
+    );
+
+    _dma.rxCtrl->release(handle, len);
+    return 0;
+}
+
+int EVB7Streamer::activateStream(
+    SoapySDR::Stream *stream,
+    const int flags,
+    const long long timeNs,
+    const size_t numElems)
+{
+    auto reader = this->toReader(stream);
+    if (reader != nullptr)
+    {
+        //readers only see continuous streaming, the first one starts the framer
+        if ((flags & SOAPY_SDR_END_BURST) != 0) return SOAPY_SDR_NOT_SUPPORTED;
+        std::lock_guard<std::mutex> lock(_ingestMutex);
+        if (reader->active) return 0;
+        reader->seq = _ingest->head();
+        reader->offset = 0;
+        reader->active = true;
+        if (_numActiveReaders++ != 0) return 0;
+        this->resetStats(-1);
+        return sendControlMessage(
+            RX_TAG_ACTIVATE,
+            (flags & SOAPY_SDR_HAS_TIME) != 0, //timeFlag
+            false, //burstFlag
+            _rxGeom.frameSize, 0, this->timeNsToTicks(timeNs));
+    }
+
+    if (isRx(stream))
+    {
+        this->resetStats(-1);
+        return sendControlMessage(
+            RX_TAG_ACTIVATE,
+            (flags & SOAPY_SDR_HAS_TIME) != 0, //timeFlag
+            (flags & SOAPY_SDR_END_BURST) != 0, //burstFlag
+            _rxGeom.frameSize, numElems*_rxNumChans, this->timeNsToTicks(timeNs));
+    }
+
+    if (isTx(stream))
+    {
+        return 0;
+    }
+
+    return SOAPY_SDR_STREAM_ERROR;
+}
+
+int EVB7Streamer::deactivateStream(
+    SoapySDR::Stream *stream,
+    const int flags,
+    const long long timeNs)
+{
+    auto reader = this->toReader(stream);
+    if (reader != nullptr)
+    {
+        //the last reader stops the framer, the ingest thread drains the DMA
+        std::lock_guard<std::mutex> lock(_ingestMutex);
+        if (not reader->active) return 0;
+        reader->active = false;
+        if (--_numActiveReaders != 0) return 0;
+        return sendControlMessage(
+            RX_TAG_DEACTIVATE,
+            (flags & SOAPY_SDR_HAS_TIME) != 0, //timeFlag
+            true, //burstFlag
+            _rxGeom.frameSize, 1, this->timeNsToTicks(timeNs));
+    }
+
+    if (isRx(stream))
+    {
+        if (_remainderHandle != -1) this->releaseReadBuffer(stream, _remainderHandle);
+        _remainderHandle = -1;
+        int ret = sendControlMessage(
+            RX_TAG_DEACTIVATE,
+            (flags & SOAPY_SDR_HAS_TIME) != 0, //timeFlag
+            true, //burstFlag
+            _rxGeom.frameSize, 1, this->timeNsToTicks(timeNs));
+        this->rxFlush();
+        return ret;
+    }
+
+    if (isTx(stream))
+    {
+        return 0;
+    }
+
+    return SOAPY_SDR_STREAM_ERROR;
+}
+
+/*******************************************************************
+ * Stream read/write
+ ******************************************************************/
+bool EVB7Streamer::fragmentTime(const long long packetTimeNs, const size_t offsetSamps, long long &timeNs)
+{
+    double ticksPerSamp = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(_statsMutex);
+        ticksPerSamp = _rxTicksPerSamp;
+    }
+    if (ticksPerSamp == 0.0) return false;
+    timeNs = packetTimeNs + this->ticksToTimeNs(std::llround(offsetSamps*ticksPerSamp));
+    return true;
+}
+
+void EVB7Streamer::setRemainder(const size_t handle, const void *payload, const size_t numSamps, const int flags, const long long timeNs)
+{
+    _remainderHandle = handle;
+    _remainderBuff = (const uint32_t *)payload;
+    _remainderSamps = numSamps;
+    _remainderOffset = 0;
+    _remainderTimeNs = timeNs;
+    _remainderHasTime = (flags & SOAPY_SDR_HAS_TIME) != 0;
+}
+
+int EVB7Streamer::convertRemainder(SoapySDR::Stream *stream, void * const *buffs, const size_t numOutSamps, int &flags, long long &timeNs)
+{
+    if (_remainderHandle == -1) return 0; //nothing
+
+    //a continuation fragment carries the time of its first sample
+    if (_remainderOffset != 0)
+    {
+        flags = 0;
+        if (_remainderHasTime and this->fragmentTime(_remainderTimeNs, _remainderOffset, timeNs)) flags |= SOAPY_SDR_HAS_TIME;
+    }
+
+    //convert the maximum possible number of samples
+    const size_t n = std::min(_remainderSamps, numOutSamps);
+    convertRx(_rxFormat, _rxNumChans, _remainderBuff, buffs, n);
+
+    //deal with remainder and releasing buffer if done
+    _remainderBuff += n*_rxNumChans;
+    _remainderSamps -= n;
+    _remainderOffset += n;
+    if (_remainderSamps == 0)
+    {
+        this->releaseReadBuffer(stream, _remainderHandle);
+        _remainderHandle = -1;
+    }
+    else
+    {
+        flags |= SOAPY_SDR_MORE_FRAGMENTS;
+    }
+
+    return n;
+}
+
+int EVB7Streamer::readStream(
+    SoapySDR::Stream *stream,
+    void * const *buffs,
+    const size_t numElems,
+    int &flags,
+    long long &timeNs,
+    const long timeoutUs)
+{
+    auto reader = this->toReader(stream);
+    if (reader != nullptr) return this->readIngest(reader, buffs, numElems, flags, timeNs, timeoutUs);
+
+    //zero copy stream: copy out of the view
+    if (_rxZeroCopy)
+    {
+        const void *view = nullptr;
+        const int ret = this->readStreamView(stream, view, numElems, flags, timeNs, timeoutUs);
+        if (ret > 0) std::memcpy(buffs[0], view, ret*sizeof(uint32_t));
+        return ret;
+    }
+
+    int ret = 0;
+
+    //check remainder
+    ret = this->convertRemainder(stream, buffs, numElems, flags, timeNs);
+    if (ret != 0) return ret;
+
+    //call into direct buffer access
+    size_t handle;
+    const void *payload;
+    ret = this->acquireReadBuffer(stream, handle, &payload, flags, timeNs, timeoutUs);
+    if (ret < 0) return ret;
+
+    //no errors, convert good buffer
+    //stash conversion, MIMO buffers hold a word per channel per sample
+    this->setRemainder(handle, payload, ret/_rxNumChans, flags, timeNs);
+    const size_t numConvert(std::min(numElems, _remainderSamps));
+    return this->convertRemainder(stream, buffs, numConvert, flags, timeNs);
+}
+
+int EVB7Streamer::readStreamView(
+    SoapySDR::Stream *stream,
+    const void *&view,
+    const size_t numElems,
+    int &flags,
+    long long &timeNs,
+    const long timeoutUs)
+{
+    if (not _rxZeroCopy) return SOAPY_SDR_NOT_SUPPORTED;
+
+    //the view from the previous call is used up: give the buffer back
+    if (_remainderHandle != -1 and _remainderSamps == 0)
+    {
+        this->releaseReadBuffer(stream, _remainderHandle);
+        _remainderHandle = -1;
+    }
+
+    if (_remainderHandle == -1)
+    {
+        size_t handle;
+        const void *payload;
+        const int ret = this->acquireReadBuffer(stream, handle, &payload, flags, timeNs, timeoutUs);
+        if (ret < 0) return ret;
+        this->setRemainder(handle, payload, ret, flags, timeNs);
+    }
+
+    //a continuation fragment carries the time of its first sample
+    else
+    {
+        flags = 0;
+        if (_remainderHasTime and this->fragmentTime(_remainderTimeNs, _remainderOffset, timeNs)) flags |= SOAPY_SDR_HAS_TIME;
+    }
+
+    //hand out the next part of the buffer
+    const size_t n = std::min(numElems, _remainderSamps);
+    view = _remainderBuff;
+    _remainderBuff += n;
+    _remainderSamps -= n;
+    _remainderOffset += n;
+    if (_remainderSamps != 0) flags |= SOAPY_SDR_MORE_FRAGMENTS;
+    return n;
+}
+
+int EVB7Streamer::writeStream(
+    SoapySDR::Stream *stream,
+    const void * const *buffs,
+    const size_t numElems,
+    int &flags,
+    const long long timeNs,
+    const long timeoutUs)
+{
+    //acquire from direct buffer access
+    size_t handle;
+    void *payload;
+    int ret = this->acquireWriteBuffer(stream, handle, &payload, timeoutUs);
+    if (ret < 0) return ret;
+
+    //only end burst if the last sample can be released
+    const size_t numSamples = std::min<size_t>(ret/_txNumChans, numElems);
+    if (numSamples < numElems) flags &= ~(SOAPY_SDR_END_BURST);
+
+    //convert the samples
+    convertTx(_txFormat, _txNumChans, buffs, (uint32_t *)payload, numSamples);
+
+    //release to direct buffer access
+    this->releaseWriteBuffer(stream, handle, numSamples*_txNumChans, flags, timeNs);
+    return numSamples;
+}
+
+int EVB7Streamer::readStreamStatus(
+    SoapySDR::Stream *stream,
+    size_t &chanMask,
+    int &flags,
+    long long &timeNs,
+    const long timeoutUs)
+{
+    if (not isTx(stream)) return SOAPY_SDR_NOT_SUPPORTED;
+
+    chanMask = (_txNumChans == 2)?0x3:0x1; //stream channels
+
+    std::unique_lock<std::mutex> lock(_txStatMutex);
+    if (_txStatQueue.empty() and timeoutUs > 0)
+    {
+        _txStatCond.wait_for(lock, std::chrono::microseconds(timeoutUs),
+            [this](void){return not _txStatQueue.empty();});
+    }
+    if (_txStatQueue.empty()) return SOAPY_SDR_TIMEOUT;
+
+    const EVB7TxStatusEvent event = _txStatQueue.front();
+    _txStatQueue.pop_front();
+    flags = event.flags;
+    timeNs = event.timeNs;
+    return event.ret;
+}
+
+/*******************************************************************
+ * Stream health
+ ******************************************************************/
+EVB7_stream_stats_t EVB7Streamer::getStreamStats(void)
+{
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    return _stats;
+}
+
+void EVB7Streamer::resetStats(const int direction)
+{
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    _rxNextValid = false;
+    if (direction == SOAPY_SDR_RX)
+    {
+        _stats.rx_packets = 0;
+        _stats.rx_samples = 0;
+        _stats.rx_overflows = 0;
+        _stats.rx_restarts = 0;
+        _stats.rx_gaps = 0;
+        _stats.rx_dropped_samples = 0;
+        _stats.rx_tag_errors = 0;
+        _stats.rx_time_errors = 0;
+        _stats.rx_ingest_overruns = 0;
+    }
+    if (direction == SOAPY_SDR_TX)
+    {
+        _stats.tx_packets = 0;
+        _stats.tx_samples = 0;
+        _stats.tx_underflows = 0;
+        _stats.tx_time_errors = 0;
+        _stats.tx_burst_ends = 0;
+        _stats.tx_status_dropped = 0;
+    }
+}
+
+void EVB7Streamer::setSampleRate(const int direction, const double rate)
+{
+    if (direction != SOAPY_SDR_RX) return;
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    _rxTicksPerSamp = (rate > 0.0)?IF_TIME_CLK/rate:0.0;
+    _rxNextValid = false;
+}
+
+void EVB7Streamer::updateRxStats(const size_t numWords, const bool overflow, const long long timeTicks, const bool isBurst, const bool burstEnd)
+{
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    const size_t numSamps = numWords/_rxNumChans;
+    _stats.rx_packets++;
+    _stats.rx_samples += numSamps;
+    if (overflow) _stats.rx_overflows++;
+    if (_rxTicksPerSamp == 0.0) return;
+
+    //the packet should start where the previous one ended,
+    //the framer stamps whole ticks so allow for half a sample
+    if (_rxNextValid)
+    {
+        const double missing = (timeTicks - _rxNextTicks)/_rxTicksPerSamp;
+        if (std::abs(missing) >= 0.5) _stats.rx_gaps++;
+        if (missing >= 0.5) _stats.rx_dropped_samples += (unsigned long long)(missing + 0.5);
+    }
+
+    //a new burst can start at any time
+    _rxNextValid = not (isBurst and burstEnd);
+    _rxNextTicks = timeTicks + numSamps*_rxTicksPerSamp;
+}
+
+/*******************************************************************
+ * Direct buffer access
+ ******************************************************************/
+size_t EVB7Streamer::getNumDirectAccessBuffers(SoapySDR::Stream *stream)
+{
+    if (this->toReader(stream) != nullptr) return 0;
+    return this->getStreamGeometry(stream).numBuffs;
+}
+
+int EVB7Streamer::getDirectAccessBufferAddrs(SoapySDR::Stream *stream, const size_t handle, void **buffs)
+{
+    if (this->toReader(stream) != nullptr) return SOAPY_SDR_NOT_SUPPORTED;
+    buffs[0] = ((uint32_t *)reinterpret_cast<EVB7DMA *>(stream)->addr(handle)) + 4;
+    return 0;
+}
+
+int EVB7Streamer::acquireReadBuffer(
+    SoapySDR::Stream *stream,
+    size_t &handleOut,
+    const void **buffs,
+    int &flags,
+    long long &timeNs,
+    const long timeoutUs)
+{
+    if (this->toReader(stream) != nullptr) return SOAPY_SDR_NOT_SUPPORTED;
+    EVB7DMA *data_dma = reinterpret_cast<EVB7DMA *>(stream);
+
+    size_t len = 0;
+    int ret = 0;
+    flags = 0;
+
+    //wait with timeout then acquire
+    if (data_dma->wait(timeoutUs) != 0) return SOAPY_SDR_TIMEOUT;
+    int handle = data_dma->acquire(len);
+    if (handle == EVB7_DMA_CLAIMED) throw std::runtime_error("EVB7::readStream() all claimed");
+    if (handle < 0) return SOAPY_SDR_TIMEOUT;
+    handleOut = handle;
+
+    //unpack the header
+    size_t numSamples;
+    bool overflow;
+    int idTag;
+    bool hasTime;
+    long long timeTicks;
+    bool timeError;
+    bool isBurst;
+    bool burstEnd;
+    twbw_framer_data_unpacker(
+        data_dma->addr(handle), len, sizeof(uint32_t),
+        buffs[0], numSamples, overflow, idTag,
+        hasTime, timeTicks,
+        timeError, isBurst, burstEnd);
+
+    //gather time even if its not valid
+    timeNs = this->ticksToTimeNs(timeTicks);
+
+    //error indicators
+    if (overflow) flags |= SOAPY_SDR_END_ABRUPT;
+    if (hasTime) flags |= SOAPY_SDR_HAS_TIME;
+    if (burstEnd) flags |= SOAPY_SDR_END_BURST;
+
+    //old packet from the deactivate command, just ignore it with timeout
+    if (idTag == RX_TAG_DEACTIVATE)
+    {
+        ret = SOAPY_SDR_TIMEOUT;
+    }
+
+    //not an activate or deactivate tag, this is bad!
+    else if (idTag != RX_TAG_ACTIVATE)
+    {
+        SoapySDR::logf(SOAPY_SDR_ERROR,
+            "readStream tag error tag=0x%x, len=%d", idTag, int(len));
+        std::lock_guard<std::mutex> lock(_statsMutex);
+        _stats.rx_tag_errors++;
+        ret = SOAPY_SDR_STREAM_ERROR;
+    }
+
+    //a bad time was specified in the command packet
+    else if (timeError)
+    {
+        SoapySDR::logf(SOAPY_SDR_ERROR,
+            "readStream time error time now %f, time pkt %f, len=%d",
+            _getTimeNs()/1e9, timeNs/1e9, int(len));
+        std::lock_guard<std::mutex> lock(_statsMutex);
+        _stats.rx_time_errors++;
+        ret = SOAPY_SDR_STREAM_ERROR;
+    }
+
+    else this->updateRxStats(numSamples, overflow, timeTicks, isBurst, burstEnd);
+
+    //restart streaming when overflow in continuous mode
+    if (overflow and not isBurst)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_statsMutex);
+            _stats.rx_restarts++;
+        }
+        sendControlMessage( //restart streaming
+            RX_TAG_ACTIVATE,
+            false, //timeFlag
+            false, //burstFlag
+            _rxGeom.frameSize, 0, 0);
+    }
+
+    //the packet is not passed to the caller, release it here
+    if (ret != 0) data_dma->release(handle, 0);
+
+    return (ret == 0)?numSamples:ret;
+}
+
+void EVB7Streamer::releaseReadBuffer(
+    SoapySDR::Stream *stream,
+    const size_t handle)
+{
+    if (this->toReader(stream) != nullptr) return;
+    reinterpret_cast<EVB7DMA *>(stream)->release(handle, 0);
+}
+
+int EVB7Streamer::acquireReadBuffers(
+    SoapySDR::Stream *stream,
+    const size_t maxBuffs,
+    size_t *handles,
+    const void **buffs,
+    size_t *numElems,
+    int *flags,
+    long long *timeNs,
+    const long timeoutUs)
+{
+    //only the first buffer waits, then take what is already there
+    size_t n = 0;
+    while (n < maxBuffs)
+    {
+        const int ret = this->acquireReadBuffer(stream, handles[n], &buffs[n], flags[n], timeNs[n], (n == 0)?timeoutUs:0);
+        if (ret < 0)
+        {
+            if (n == 0) return ret;
+            break;
+        }
+        numElems[n++] = ret;
+    }
+    return n;
+}
+
+void EVB7Streamer::releaseReadBuffers(
+    SoapySDR::Stream *stream,
+    const size_t numBuffs,
+    const size_t *handles)
+{
+    for (size_t i = 0; i < numBuffs; i++) this->releaseReadBuffer(stream, handles[i]);
+}
+
+int EVB7Streamer::acquireWriteBuffer(
+    SoapySDR::Stream *stream,
+    size_t &handleOut,
+    void **buffs,
+    const long timeoutUs)
+{
+    EVB7DMA *data_dma = reinterpret_cast<EVB7DMA *>(stream);
+    size_t len = 0;
+
+    //wait with timeout then acquire
+    if (data_dma->wait(timeoutUs) != 0) return SOAPY_SDR_TIMEOUT;
+    int handle = data_dma->acquire(len);
+    if (handle == EVB7_DMA_CLAIMED) throw std::runtime_error("EVB7::writeStream() all claimed");
+    if (handle < 0) return SOAPY_SDR_TIMEOUT;
+    handleOut = handle;
+
+    //offset by header space, the frame size limits the packet
+    buffs[0] = ((uint32_t *)data_dma->addr(handle)) + 4;
+    return std::min((len/sizeof(uint32_t)) - 4, _txGeom.frameSize);
+}
+
+void EVB7Streamer::releaseWriteBuffer(
+    SoapySDR::Stream *stream,
+    const size_t handle,
+    const size_t numElems,
+    int &flags,
+    const long long timeNs)
+{
+    EVB7DMA *data_dma = reinterpret_cast<EVB7DMA *>(stream);
+
+    //pack the header
+    void *payload;
+    size_t len = 0;
+    const bool hasTime((flags & SOAPY_SDR_HAS_TIME) != 0);
+    const long long timeTicks(this->timeNsToTicks(timeNs));
+    const bool burstEnd((flags & SOAPY_SDR_END_BURST) != 0);
+
+    twbw_deframer_data_packer(
+        data_dma->addr(handle), len, sizeof(uint32_t),
+        payload, numElems, _txIdTag++, hasTime, timeTicks, burstEnd);
+
+    {
+        std::lock_guard<std::mutex> lock(_statsMutex);
+        _stats.tx_packets++;
+        _stats.tx_samples += numElems/_txNumChans;
+    }
+
+    //release the buffer back the SG engine
+    data_dma->release(handle, len);
+}
+
+/*******************************************************************
+ * RX ingest mode
+ ******************************************************************/
+SoapySDR::Stream *EVB7Streamer::setupReader(const StreamFormat format, const size_t numChans)
+{
+    auto reader = new EVB7IngestReader();
+    reader->format = format;
+    reader->numChans = numChans;
+    reader->active = false;
+    reader->seq = 0;
+    reader->offset = 0;
+    reader->overruns = 0;
+    reader->lostFrames = 0;
+
+    std::lock_guard<std::mutex> lock(_ingestMutex);
+    _readers.push_back(reader);
+    return reinterpret_cast<SoapySDR::Stream *>(reader);
+}
+
+void EVB7Streamer::startIngest(const SoapySDR::Kwargs &args)
+{
+    const size_t numFrames = argToSize(args, "ingestframes", INGEST_NUM_FRAMES, 2, INGEST_MAX_FRAMES);
+    if ((numFrames & (numFrames-1)) != 0) throw std::runtime_error("EVB7::setupStream: ingestframes must be a power of two");
+
+    //a slot holds the largest payload the DMA buffer can carry
+    _ingest = new EVB7IngestRing(numFrames, _rxGeom.buffSize/XFER_SIZE - 4, _rxGeom.memFlags);
+    _numActiveReaders = 0;
+    _ingestRunning = true;
+    _ingestThread = std::thread(&EVB7Streamer::ingestLoop, this);
+
+    if (args.count("ingestcpu") != 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(std::stoi(args.at("ingestcpu")), &cpus);
+        if (pthread_setaffinity_np(_ingestThread.native_handle(), sizeof(cpus), &cpus) != 0)
+        {
+            SoapySDR::logf(SOAPY_SDR_WARNING, "EVB7 ingest: fail to pin the thread to CPU %s", args.at("ingestcpu").c_str());
+        }
+    }
+
+    if (args.count("ingestprio") != 0)
+    {
+        sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        param.sched_priority = std::stoi(args.at("ingestprio"));
+        if (pthread_setschedparam(_ingestThread.native_handle(), SCHED_FIFO, &param) != 0)
+        {
+            SoapySDR::logf(SOAPY_SDR_WARNING, "EVB7 ingest: fail to set SCHED_FIFO priority %s", args.at("ingestprio").c_str());
+        }
+    }
+}
+
+void EVB7Streamer::stopIngest(void)
+{
+    if (_ingest == nullptr) return;
+    _ingestRunning = false;
+    _ingestThread.join();
+    _ingest->notify();
+
+    for (auto reader : _readers) delete reader;
+    _readers.clear();
+    delete _ingest;
+    _ingest = nullptr;
+}
+
+void EVB7Streamer::ingestLoop(void)
+{
+    auto stream = reinterpret_cast<SoapySDR::Stream *>(_dma.rxData);
+    while (_ingestRunning)
+    {
+        size_t handle = 0;
+        const void *payload = nullptr;
+        int flags = 0;
+        long long timeNs = 0;
+        const int ret = this->acquireReadBuffer(stream, handle, &payload, flags, timeNs, 100000);
+        if (ret < 0) continue;
+
+        //copy the raw words, the readers convert at their own pace
+        //an empty packet still holds its buffer until released
+        if (ret > 0)
+        {
+            const size_t numWords = std::min<size_t>(ret, _ingest->slotWords());
+            std::memcpy(_ingest->beginWrite(), payload, numWords*sizeof(uint32_t));
+            _ingest->endWrite(numWords, timeNs, flags);
+        }
+
+        this->releaseReadBuffer(stream, handle);
+    }
+}
+
+int EVB7Streamer::readIngest(EVB7IngestReader *reader, void * const *buffs, const size_t numElems, int &flags, long long &timeNs, const long timeoutUs)
+{
+    if (not reader->active) return SOAPY_SDR_STREAM_ERROR;
+    flags = 0;
+
+    if (not _ingest->wait(reader->seq, timeoutUs)) return SOAPY_SDR_TIMEOUT;
+
+    //fell a ring behind: skip ahead half a ring to get some margin back
+    const auto overrun = [this, reader](void)
+    {
+        const uint64_t head = _ingest->head();
+        const uint64_t seq = head - std::min<uint64_t>(head, _ingest->numSlots()/2);
+        reader->overruns++;
+        reader->lostFrames += seq - reader->seq;
+        {
+            std::lock_guard<std::mutex> lock(_statsMutex);
+            _stats.rx_ingest_overruns++;
+        }
+        reader->seq = seq;
+        reader->offset = 0;
+        return SOAPY_SDR_OVERFLOW;
+    };
+    const EVB7IngestSlot &slot = _ingest->slot(reader->seq);
+    if (not _ingest->valid(reader->seq)) return overrun();
+
+    //convert out of the slot, the sequence check below catches a torn read
+    const size_t numWords = std::min(slot.numWords, _ingest->slotWords());
+    const size_t offset = reader->offset;
+    const long long slotTimeNs = slot.timeNs;
+    const int slotFlags = slot.flags;
+    const size_t n = std::min(numElems, (numWords - std::min(offset, numWords))/reader->numChans);
+    convertRx(StreamFormat(reader->format), reader->numChans, slot.words + offset, buffs, n);
+
+    if (not _ingest->valid(reader->seq)) return overrun();
+
+    //the frame header applies to the first fragment,
+    //a continuation fragment carries the time of its first sample
+    if (offset == 0)
+    {
+        flags |= slotFlags;
+        timeNs = slotTimeNs;
+    }
+    else if ((slotFlags & SOAPY_SDR_HAS_TIME) != 0 and this->fragmentTime(slotTimeNs, offset/reader->numChans, timeNs))
+    {
+        flags |= SOAPY_SDR_HAS_TIME;
+    }
+
+    reader->offset += n*reader->numChans;
+    if (reader->offset >= numWords)
+    {
+        reader->seq++;
+        reader->offset = 0;
+    }
+    else flags |= SOAPY_SDR_MORE_FRAGMENTS;
+
+    return n;
+}
+
+bool EVB7Streamer::getIngestOverruns(SoapySDR::Stream *stream, size_t &overruns, unsigned long long &lostFrames)
+{
+    auto reader = this->toReader(stream);
+    if (reader == nullptr) return false;
+    overruns = reader->overruns;
+    lostFrames = reader->lostFrames;
+    return true;
+}
+
+/*******************************************************************
+ * TX status thread
+ ******************************************************************/
+void EVB7Streamer::startTxStatus(void)
+{
+    this->stopTxStatus();
+    {
+        std::lock_guard<std::mutex> lock(_txStatMutex);
+        _txStatQueue.clear();
+    }
+    _txStatRunning = true;
+    _txStatThread = std::thread(&EVB7Streamer::txStatusLoop, this);
+}
+
+void EVB7Streamer::stopTxStatus(void)
+{
+    if (not _txStatThread.joinable()) return;
+    _txStatRunning = false;
+    _txStatThread.join();
+}
+
+void EVB7Streamer::txStatusLoop(void)
+{
+    while (_txStatRunning)
+    {
+        if (_dma.txStat->wait(100000) != 0) continue;
+        size_t len = 0;
+        int handle = _dma.txStat->acquire(len);
+        if (handle < 0) continue;
+
+        bool underflow;
+        int idTag = 0;
+        bool hasTime;
+        long long timeTicks;
+        bool timeError;
+        bool burstEnd;
+        twbw_deframer_stat_unpacker(
+            _dma.txStat->addr(handle), len,
+            underflow, idTag, hasTime, timeTicks, timeError, burstEnd);
+        _dma.txStat->release(handle, len);
+
+        //gather time even if its not valid
+        EVB7TxStatusEvent event;
+        event.timeNs = this->ticksToTimeNs(timeTicks);
+        event.flags = 0;
+        if (hasTime) event.flags |= SOAPY_SDR_HAS_TIME;
+        if (burstEnd) event.flags |= SOAPY_SDR_END_BURST;
+        event.ret = 0;
+        if (underflow) event.ret = SOAPY_SDR_UNDERFLOW;
+        if (timeError) event.ret = SOAPY_SDR_TIME_ERROR;
+
+        //SoapySDR::logf(SOAPY_SDR_TRACE, "handle=%d, TxStat=%d", handle, idTag);
+        //underflows and time errors are reported in the events and the stats
+        std::lock_guard<std::mutex> statsLock(_statsMutex);
+        if (underflow) _stats.tx_underflows++;
+        if (timeError) _stats.tx_time_errors++;
+        if (burstEnd) _stats.tx_burst_ends++;
+
+        std::lock_guard<std::mutex> lock(_txStatMutex);
+        if (_txStatQueue.size() >= TX_STATUS_QUEUE_DEPTH)
+        {
+            _txStatQueue.pop_front();
+            _stats.tx_status_dropped++;
+        }
+        _txStatQueue.push_back(event);
+        _txStatCond.notify_all();
+    }
+}
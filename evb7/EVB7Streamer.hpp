@@ -0,0 +1,371 @@
+//
+// Stream engine for the EVB7: framing, conversion and burst handling
+// on top of a DMA backend (hardware DMA or the in-process loopback).
+//
+// Copyright (c) 2015-2017 Fairwaves, Inc.
+// Copyright (c) 2015-2015 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#pragma once
+#include "EVB7Regs.hpp"
+#include "EVB7DMA.hpp"
+#include "EVB7Ingest.hpp"
+#include "EVB7StreamStats.h"
+#include <SoapySDR/Device.hpp>
+#include <SoapySDR/Time.hpp>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <string>
+
+/*!
+ * The ring geometry of a stream, from the stream args.
+ * A frame is one DMA buffer worth of LML words,
+ * MIMO frames hold a word per channel per sample.
+ */
+struct EVB7StreamGeometry
+{
+    size_t numBuffs; //buffers in the data ring
+    size_t buffSize; //bytes per buffer
+    size_t frameSize; //LML words per frame
+    size_t numChans;
+    int memFlags; //EVB7_MEM_* for host memory rings
+
+    //! Samples per channel in one frame
+    size_t frameSamps(void) const
+    {
+        return frameSize/numChans;
+    }
+
+    //! Samples per channel the ring holds before the framer overflows
+    size_t ringSamps(void) const
+    {
+        return numBuffs*this->frameSamps();
+    }
+};
+
+/*!
+ * One TX status message from the deframer.
+ */
+struct EVB7TxStatusEvent
+{
+    int ret; //0, SOAPY_SDR_UNDERFLOW or SOAPY_SDR_TIME_ERROR
+    int flags; //SOAPY_SDR_HAS_TIME, SOAPY_SDR_END_BURST
+    long long timeNs;
+};
+
+class EVB7Streamer
+{
+public:
+
+    /*!
+     * Create a streamer on the given DMA channels.
+     * The channels are owned by the caller and must outlive the streamer.
+     * \param dma the four DMA channels
+     * \param getTimeNs the device time, only used for diagnostics
+     */
+    EVB7Streamer(const EVB7DMAChannels &dma, const std::function<long long(void)> &getTimeNs);
+
+    ~EVB7Streamer(void);
+
+    /*!
+     * Setup the stream for a direction.
+     * The channel muxes and FPGA stream modes are configured by the device.
+     * \param direction SOAPY_SDR_RX or SOAPY_SDR_TX
+     * \param format the host sample format (see getStreamFormats)
+     * \param channels the stream channels in order: one for SISO,
+     *        two for interleaved MIMO words (first channel first);
+     *        MIMO needs framer gateware that does not exist for EVB7 yet
+     *        (see the proposed registers in EVB7Regs.hpp), the device
+     *        rejects two channels without it, the loopback emulates it
+     * \param args the stream args
+     *
+     * Stream args:
+     *  - "buffers" the number of buffers in the data ring (default 16)
+     *  - "bufflen" the size of a buffer in bytes (default 4096)
+     *  - "framesize" LML words per frame (default 1000, or the whole buffer with "bufflen")
+     *  - "hugepages" back host memory rings with hugepages (default false)
+     *  - "mlock" lock host memory rings into RAM (default false)
+     *  - "zerocopy" RX CS16 single channel only: readStreamView() hands out
+     *    views into the DMA buffers instead of copying (default false)
+     *
+     * RX ingest args:
+     *  - "ingest" drain the DMA on a thread into a large ring (default false)
+     *  - "ingestframes" frames in the ring, a power of two (default 4096)
+     *  - "ingestcpu" pin the ingest thread to this CPU (default unpinned)
+     *  - "ingestprio" SCHED_FIFO priority for the ingest thread (default none)
+     *
+     * While the ingest thread runs, every RX setupStream() adds a reader
+     * with its own format and position; readers must use the same channels
+     * in the same order, and the framer runs while at least one reader is active.
+     */
+    SoapySDR::Stream *setupStream(
+        const int direction,
+        const std::string &format,
+        const std::vector<size_t> &channels,
+        const SoapySDR::Kwargs &args);
+
+    void closeStream(SoapySDR::Stream *stream);
+
+    size_t getStreamMTU(SoapySDR::Stream *stream) const;
+
+    //! The ring geometry of a stream from setupStream()
+    const EVB7StreamGeometry &getStreamGeometry(SoapySDR::Stream *stream) const;
+
+    //! True when RX streams are ingest ring readers
+    bool ingestActive(void) const
+    {
+        return _ingest != nullptr;
+    }
+
+    /*!
+     * The overrun accounting of an ingest reader.
+     * \param stream an RX stream in ingest mode
+     * \param [out] overruns times the reader fell a ring behind
+     * \param [out] lostFrames frames skipped by the overruns
+     * \return false when the stream is not an ingest reader
+     */
+    bool getIngestOverruns(SoapySDR::Stream *stream, size_t &overruns, unsigned long long &lostFrames);
+
+    int activateStream(
+        SoapySDR::Stream *stream,
+        const int flags,
+        const long long timeNs,
+        const size_t numElems);
+
+    int deactivateStream(
+        SoapySDR::Stream *stream,
+        const int flags,
+        const long long timeNs);
+
+    int readStream(
+        SoapySDR::Stream *stream,
+        void * const *buffs,
+        const size_t numElems,
+        int &flags,
+        long long &timeNs,
+        const long timeoutUs);
+
+    /*!
+     * Read a view of the samples of a "zerocopy" RX stream, without copying.
+     * The view is valid until the next read or deactivateStream().
+     * A call returns at most the rest of the current DMA buffer;
+     * readStream() on the same stream copies out of the view.
+     * \param [out] view the address of the first CS16 sample
+     * \return the number of samples or an error code
+     */
+    int readStreamView(
+        SoapySDR::Stream *stream,
+        const void *&view,
+        const size_t numElems,
+        int &flags,
+        long long &timeNs,
+        const long timeoutUs);
+
+    int writeStream(
+        SoapySDR::Stream *stream,
+        const void * const *buffs,
+        const size_t numElems,
+        int &flags,
+        const long long timeNs,
+        const long timeoutUs);
+
+    /*!
+     * Pop the oldest TX status event.
+     * A thread drains the status DMA into a bounded queue while the
+     * TX stream is open, the oldest events are dropped when it is full.
+     */
+    int readStreamStatus(
+        SoapySDR::Stream *stream,
+        size_t &chanMask,
+        int &flags,
+        long long &timeNs,
+        const long timeoutUs);
+
+    //! A snapshot of the stream health counters
+    EVB7_stream_stats_t getStreamStats(void);
+
+    /*!
+     * Set the sample rate of a direction.
+     * The rate converts RX packet times into samples
+     * to detect the samples lost between packets.
+     */
+    void setSampleRate(const int direction, const double rate);
+
+    size_t getNumDirectAccessBuffers(SoapySDR::Stream *stream);
+
+    int getDirectAccessBufferAddrs(SoapySDR::Stream *stream, const size_t handle, void **buffs);
+
+    int acquireReadBuffer(
+        SoapySDR::Stream *stream,
+        size_t &handle,
+        const void **buffs,
+        int &flags,
+        long long &timeNs,
+        const long timeoutUs);
+
+    void releaseReadBuffer(
+        SoapySDR::Stream *stream,
+        const size_t handle);
+
+    /*!
+     * Acquire several RX buffers in one call.
+     * Waits up to the timeout for the first buffer,
+     * then takes the buffers that are already available.
+     * The arrays hold maxBuffs entries, one per buffer acquired.
+     * \return the number of buffers acquired or an error code
+     */
+    int acquireReadBuffers(
+        SoapySDR::Stream *stream,
+        const size_t maxBuffs,
+        size_t *handles,
+        const void **buffs,
+        size_t *numElems,
+        int *flags,
+        long long *timeNs,
+        const long timeoutUs);
+
+    //! Release the buffers from acquireReadBuffers()
+    void releaseReadBuffers(
+        SoapySDR::Stream *stream,
+        const size_t numBuffs,
+        const size_t *handles);
+
+    int acquireWriteBuffer(
+        SoapySDR::Stream *stream,
+        size_t &handle,
+        void **buffs,
+        const long timeoutUs);
+
+    void releaseWriteBuffer(
+        SoapySDR::Stream *stream,
+        const size_t handle,
+        const size_t numElems,
+        int &flags,
+        const long long timeNs);
+
+    //stream configuration
+    enum StreamFormat
+    {
+        SF_CS16,
+        SF_CF32,
+        SF_CF64,
+        SF_CS12, //packed 12-bit, 3 bytes per sample
+        SF_CS8,
+        SF_CU8,
+    };
+
+private:
+
+    long long ticksToTimeNs(const long long ticks) const
+    {
+        return SoapySDR::ticksToTimeNs(ticks, IF_TIME_CLK);
+    }
+
+    long long timeNsToTicks(const long long timeNs) const
+    {
+        return SoapySDR::timeNsToTicks(timeNs, IF_TIME_CLK);
+    }
+
+    bool isRx(SoapySDR::Stream *stream) const
+    {
+        return stream == reinterpret_cast<SoapySDR::Stream *>(_dma.rxData);
+    }
+
+    bool isTx(SoapySDR::Stream *stream) const
+    {
+        return stream == reinterpret_cast<SoapySDR::Stream *>(_dma.txData);
+    }
+
+    //in ingest mode the RX handles are readers, not the DMA channel
+    EVB7IngestReader *toReader(SoapySDR::Stream *stream) const
+    {
+        if (_ingest == nullptr or isRx(stream) or isTx(stream)) return nullptr;
+        return reinterpret_cast<EVB7IngestReader *>(stream);
+    }
+
+    void rxFlush(void);
+
+    //clear the counters of a direction, any direction restarts the time check
+    void resetStats(const int direction);
+
+    void updateRxStats(const size_t numWords, const bool overflow, const long long timeTicks, const bool isBurst, const bool burstEnd);
+
+    int sendControlMessage(const int tag, const bool timeFlag, const bool burstFlag, const int frameSize, const int burstSize, const long long time);
+
+    int convertRemainder(SoapySDR::Stream *stream, void * const *buffs, const size_t numOutSamps, int &flags, long long &timeNs);
+
+    //stash an acquired RX buffer as the remainder
+    void setRemainder(const size_t handle, const void *payload, const size_t numSamps, const int flags, const long long timeNs);
+
+    //the time of a fragment that starts offsetSamps into a packet
+    bool fragmentTime(const long long packetTimeNs, const size_t offsetSamps, long long &timeNs);
+
+    SoapySDR::Stream *setupReader(const StreamFormat format, const size_t numChans);
+
+    void startIngest(const SoapySDR::Kwargs &args);
+
+    void stopIngest(void);
+
+    void ingestLoop(void);
+
+    int readIngest(EVB7IngestReader *reader, void * const *buffs, const size_t numElems, int &flags, long long &timeNs, const long timeoutUs);
+
+    EVB7DMAChannels _dma;
+    std::function<long long(void)> _getTimeNs;
+
+    //rx streaming
+    int _remainderHandle;
+    size_t _remainderSamps;
+    const uint32_t *_remainderBuff;
+    size_t _remainderOffset; //samples handed out from the remainder packet
+    long long _remainderTimeNs; //time of the remainder packet
+    bool _remainderHasTime;
+    bool _rxZeroCopy; //the remainder is the view handed to the user
+
+    //tx streaming
+    int _txIdTag;
+
+    StreamFormat _rxFormat;
+    StreamFormat _txFormat;
+
+    //1 for SISO, 2 for MIMO: LML words are interleaved A0 B0 A1 B1...
+    size_t _rxNumChans;
+    size_t _txNumChans;
+    std::vector<size_t> _rxChans; //the channels ingest readers must match
+
+    EVB7StreamGeometry _rxGeom;
+    EVB7StreamGeometry _txGeom;
+
+    //rx ingest mode
+    std::mutex _ctrlMutex; //control messages come from the ingest thread too
+    std::mutex _ingestMutex;
+    EVB7IngestRing *_ingest;
+    std::thread _ingestThread;
+    std::atomic<bool> _ingestRunning;
+    std::vector<EVB7IngestReader *> _readers;
+    size_t _numActiveReaders;
+
+    //tx status thread
+    void startTxStatus(void);
+    void stopTxStatus(void);
+    void txStatusLoop(void);
+    std::thread _txStatThread;
+    std::atomic<bool> _txStatRunning;
+    std::mutex _txStatMutex;
+    std::condition_variable _txStatCond;
+    std::deque<EVB7TxStatusEvent> _txStatQueue;
+
+    //health counters and the time continuity check
+    std::mutex _statsMutex;
+    EVB7_stream_stats_t _stats;
+    double _rxTicksPerSamp; //0.0 when the rate is unknown
+    bool _rxNextValid;
+    double _rxNextTicks; //expected time of the next packet
+};
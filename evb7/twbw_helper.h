@@ -184,3 +184,156 @@ static inline void twbw_deframer_stat_unpacker(
     //gather time even if its not valid
     timeTicks = (((long long)msg[2]) << 32) | msg[3];
 }
+
+////////////////////////////////////////////////////////////////////////
+// Framer/deframer side of the formats above (used for emulation)
+////////////////////////////////////////////////////////////////////////
+
+/*!
+ * Parse a control buffer written by twbw_framer_ctrl_packer().
+ * \param buff the pointer to frame start
+ * \param [out] idTag 8-bit ID tag forwarded to data header
+ * \param [out] hasTime true when timeTicks is valid
+ * \param [out] timeTicks 64-bit tick count for stream start time
+ * \param [out] isBurst true for burst mode, false continuous streaming
+ * \param [out] frameSize number of sample transfers per frame
+ * \param [out] burstSize number of sample transfers burst (in burst mode)
+ */
+static inline void twbw_framer_ctrl_unpacker(
+    const void *buff,
+    int &idTag,
+    bool &hasTime,
+    long long &timeTicks,
+    bool &isBurst,
+    size_t &frameSize,
+    size_t &burstSize
+)
+{
+    const uint32_t *msg = (const uint32_t *)buff;
+    hasTime = ((msg[0] >> 31) & 0x1) != 0;
+    isBurst = ((msg[0] >> 28) & 0x1) != 0;
+    idTag = (msg[0] >> 16) & 0xff;
+    frameSize = (msg[0] & 0xffff) + 1;
+    burstSize = size_t(msg[1]) + 1;
+    timeTicks = (((long long)msg[2]) << 32) | msg[3];
+}
+
+/*!
+ * Load an RX data packet as parsed by twbw_framer_data_unpacker().
+ * A packet shorter than frameSize that does not end a burst is an overflow.
+ * \param buff the pointer to frame start
+ * \param [out] length the packet length in bytes
+ * \param width the transfer size in bytes (4, 8, ...)
+ * \param [out] payload the start of the payload (offset from header)
+ * \param numSamps the number of samples in this packet
+ * \param idTag 8-bit ID tag forwarded from the control msg
+ * \param hasTime true when this packet starts a timed burst
+ * \param timeTicks 64-bit tick count of the first sample
+ * \param timeError true when a time error occurs
+ * \param isBurst true for burst mode, false continuous streaming
+ * \param frameSize number of sample transfers per frame
+ * \param burstCount the samples left in the burst including this packet
+ */
+static inline void twbw_framer_data_packer(
+    void *buff,
+    size_t &length,
+    const size_t width,
+    void *&payload,
+    const size_t numSamps,
+    const int idTag,
+    const bool hasTime,
+    const long long timeTicks,
+    const bool timeError,
+    const bool isBurst,
+    const size_t frameSize,
+    const size_t burstCount
+)
+{
+    uint32_t *hdr = (uint32_t *)buff;
+    uint32_t &word0 = hdr[0*(width/sizeof(uint32_t))];
+    uint32_t &word1 = hdr[1*(width/sizeof(uint32_t))];
+    uint32_t &word2 = hdr[2*(width/sizeof(uint32_t))];
+    uint32_t &word3 = hdr[3*(width/sizeof(uint32_t))];
+    payload = (void *)&hdr[4*(width/sizeof(uint32_t))];
+
+    word0 = ((frameSize-1) & 0xffff) | ((idTag & 0xff) << 16);
+    if (hasTime) word0 |= (1 << 31);
+    if (timeError) word0 |= (1 << 30);
+    if (isBurst) word0 |= (1 << 28);
+    word1 = (burstCount == 0)?0:(burstCount - 1);
+    word2 = timeTicks >> 32;
+    word3 = timeTicks & 0xffffffff;
+
+    length = width*(4 + numSamps);
+}
+
+/*!
+ * Parse a TX data packet written by twbw_deframer_data_packer().
+ * \param buff the pointer to frame start
+ * \param length the packet length in bytes
+ * \param width the transfer size in bytes (4, 8, ...)
+ * \param [out] payload the start of the payload (offset from header)
+ * \param [out] numSamps the number of samples in this packet
+ * \param [out] idTag 8-bit ID tag forwarded to the status
+ * \param [out] hasTime true when timeTicks is valid
+ * \param [out] timeTicks 64-bit tick count for the first sample
+ * \param [out] burstEnd true when this packet ends a burst
+ */
+static inline void twbw_deframer_data_unpacker(
+    const void *buff,
+    const size_t length,
+    const size_t width,
+    const void *&payload,
+    size_t &numSamps,
+    int &idTag,
+    bool &hasTime,
+    long long &timeTicks,
+    bool &burstEnd
+)
+{
+    const uint32_t *hdr = (const uint32_t *)buff;
+    const uint32_t word0 = hdr[0*(width/sizeof(uint32_t))];
+    const uint32_t word2 = hdr[2*(width/sizeof(uint32_t))];
+    const uint32_t word3 = hdr[3*(width/sizeof(uint32_t))];
+    payload = (const void *)&hdr[4*(width/sizeof(uint32_t))];
+    numSamps = (length/width) - 4;
+
+    hasTime = ((word0 >> 31) & 0x1) != 0;
+    burstEnd = ((word0 >> 27) & 0x1) == 0;
+    idTag = (word0 >> 16) & 0xff;
+    timeTicks = (((long long)word2) << 32) | word3;
+}
+
+/*!
+ * Load a status message as parsed by twbw_deframer_stat_unpacker().
+ * \param buff the pointer to frame start
+ * \param [out] length the message length in bytes
+ * \param underflow true when the deframer experiences an underflow
+ * \param idTag 8-bit ID tag forwarded from the data packet
+ * \param hasTime true when this status is for a timed burst
+ * \param timeTicks 64-bit tick count of the event
+ * \param timeError true when a time error occurs
+ * \param burstEnd true when this status ends a burst
+ */
+static inline void twbw_deframer_stat_packer(
+    void *buff,
+    size_t &length,
+    const bool underflow,
+    const int idTag,
+    const bool hasTime,
+    const long long timeTicks,
+    const bool timeError,
+    const bool burstEnd
+)
+{
+    uint32_t *msg = (uint32_t *)buff;
+    msg[0] = ((idTag & 0xff) << 16);
+    if (hasTime) msg[0] |= (1 << 31);
+    if (timeError) msg[0] |= (1 << 30);
+    if (underflow) msg[0] |= (1 << 29);
+    if (burstEnd) msg[0] |= (1 << 28);
+    msg[1] = 0;
+    msg[2] = timeTicks >> 32;
+    msg[3] = timeTicks & 0xffffffff;
+    length = 4*sizeof(uint32_t);
+}
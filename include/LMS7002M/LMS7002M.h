@@ -13,6 +13,7 @@
 
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <LMS7002M/LMS7002M_config.h>
 #include <LMS7002M/LMS7002M_regs.h>
@@ -70,6 +71,17 @@ typedef enum
  */
 typedef uint32_t (*LMS7002M_spi_transact_t)(void *handle, const uint32_t data, const bool readback);
 
+/*!
+ * Function typedef for a function that writes several SPI words at once.
+ * Each 32-bit word is a complete write transaction, as for transact.
+ * Implementors can queue all of the words into a single bus transfer.
+ *
+ * \param handle handle provided data
+ * \param data the 32-bit write data words
+ * \param num the number of words
+ */
+typedef void (*LMS7002M_spi_batch_t)(void *handle, const uint32_t *data, const size_t num);
+
 //! The opaque instance of the LMS7002M instance
 struct LMS7002M_struct;
 
@@ -123,6 +135,37 @@ LMS7002M_API void LMS7002M_spi_write(LMS7002M_t *self, const int addr, const int
  */
 LMS7002M_API int LMS7002M_spi_read(LMS7002M_t *self, const int addr);
 
+/*!
+ * Set the optional function used to write SPI words in batches.
+ * Without a batch function, batches are written word by word with transact.
+ * The handle is the same handle passed into LMS7002M_create().
+ * \param self an instance of the LMS7002M driver
+ * \param batch the batch function or NULL to clear it
+ */
+LMS7002M_API void LMS7002M_set_spi_batch(LMS7002M_t *self, LMS7002M_spi_batch_t batch);
+
+/*!
+ * Perform several SPI write transactions in order.
+ * Like LMS7002M_spi_write(), the register shadows are not updated.
+ * \param self an instance of the LMS7002M driver
+ * \param addrs the 16 bit register addresses
+ * \param values the 16 bit register values
+ * \param num the number of writes
+ */
+LMS7002M_API void LMS7002M_spi_write_batch(LMS7002M_t *self, const int *addrs, const int *values, const size_t num);
+
+/*!
+ * Update the register shadows with writes done behind the driver,
+ * such as a raw LMS7002M_spi_write_batch(). A write of the MAC 0x0020
+ * selects the shadow banks for the channel registers after it,
+ * and the registers below 0x0100 are set in both banks.
+ * \param self an instance of the LMS7002M driver
+ * \param addrs the 16 bit register addresses
+ * \param values the 16 bit register values
+ * \param num the number of writes
+ */
+LMS7002M_API void LMS7002M_regs_update(LMS7002M_t *self, const int *addrs, const int *values, const size_t num);
+
 /*!
  * Write a spi register using values from the regs structure.
  * \param self an instance of the LMS7002M driver
@@ -261,6 +304,16 @@ LMS7002M_API void LMS7002M_setup_rx_lfsr(LMS7002M_t *self);
  */
 LMS7002M_API void LMS7002M_set_mac_ch(LMS7002M_t *self, const LMS7002M_chan_t channel);
 
+/*!
+ * Get the MAC register 0x0020 value that selects a channel,
+ * with the other fields of 0x0020 from the register shadow.
+ * Use it to select the channel inside a raw LMS7002M_spi_write_batch().
+ * \param self an instance of the LMS7002M driver
+ * \param channel the channel LMS_CHA, LMS_CHB, or LMS_CHAB
+ * \return the 16 bit register value
+ */
+LMS7002M_API int LMS7002M_mac_value(LMS7002M_t *self, const LMS7002M_chan_t channel);
+
 /*!
  * Set the MAC mux for direction TX/RX shadow registers.
  * For SXT and SXR, MAX is used for direction and not channel control.
@@ -284,6 +337,15 @@ LMS7002M_API void LMS7002M_set_mac_dir(LMS7002M_t *self, const LMS7002M_dir_t di
  */
 LMS7002M_API void LMS7002M_set_diq_mux(LMS7002M_t *self, const LMS7002M_dir_t direction, const int positions[4]);
 
+/*!
+ * Select MIMO or SISO framing on the lime light interface.
+ * In MIMO mode each frame carries 4 sample positions (AI, AQ, BI, BQ),
+ * in SISO mode only channel A is carried and channel B is disabled.
+ * \param self an instance of the LMS7002M driver
+ * \param enable true for MIMO framing, false for SISO
+ */
+LMS7002M_API void LMS7002M_set_lml_mimo(LMS7002M_t *self, const bool enable);
+
 
 LMS7002M_API void LMS7002M_set_jesd207_latency(LMS7002M_t *self, const LMS7002M_dir_t direction, int start, int stop);
 
@@ -382,9 +444,14 @@ LMS7002M_API void LMS7002M_set_nco_freq(LMS7002M_t *self, const LMS7002M_dir_t d
  * or if a non-existent filter is selected (use 1, 2, or 3).
  * Filters 1 and 2 are 40 taps, while filter 3 is 120 taps.
  *
+ * The driver keeps the taps last written per channel and only
+ * uploads the taps that differ, in one batch. With verify enabled
+ * (LMS7002M_set_gfir_verify), the taps are read back and -3 is
+ * returned on a mismatch.
+ *
  * \param self an instance of the LMS7002M driver
  * \param direction the direction LMS_TX or LMS_RX
- * \param channel the channel LMS_CHA or LMS_CHB
+ * \param channel the channel LMS_CHA, LMS_CHB, or LMS_CHAB
  * \param which which FIR filter 1, 2, or 3
  * \param taps a pointer to an array of taps
  * \param ntaps the size of the taps array
@@ -398,6 +465,105 @@ LMS7002M_API int LMS7002M_set_gfir_taps(
     const short *taps,
     const size_t ntaps);
 
+/*!
+ * Get the filter taps last written to one of the TSP FIR filters,
+ * as LMS7002M_set_gfir_taps() wrote them, without a readback.
+ * An error is returned when the taps are not known,
+ * such as before the first write or after a reset.
+ * \param self an instance of the LMS7002M driver
+ * \param direction the direction LMS_TX or LMS_RX
+ * \param channel the channel LMS_CHA or LMS_CHB
+ * \param which which FIR filter 1, 2, or 3
+ * \param [out] taps a pointer to an array of taps
+ * \param ntaps the size of the taps array, 40 or 120
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_get_gfir_taps(
+    LMS7002M_t *self,
+    const LMS7002M_dir_t direction,
+    const LMS7002M_chan_t channel,
+    const int which,
+    short *taps,
+    const size_t ntaps);
+
+/*!
+ * Read back and compare the taps after each LMS7002M_set_gfir_taps().
+ * \param self an instance of the LMS7002M driver
+ * \param enable true to verify the uploads, off by default
+ */
+LMS7002M_API void LMS7002M_set_gfir_verify(LMS7002M_t *self, const bool enable);
+
+#define LMS7002M_GFIR_KAISER (int)'K' //!< Kaiser windowed sinc design
+#define LMS7002M_GFIR_REMEZ (int)'R' //!< Parks-McClellan equiripple design
+
+//! The most taps of a TSP FIR filter: 15 banks of 8 for GFIR3
+#define LMS7002M_GFIR_MAX_TAPS 120
+
+/*!
+ * Lowpass specification for LMS7002M_gfir_design().
+ * The rate is that of the samples the filter sees: the RxTSP rate
+ * after the decimation, or the TxTSP rate before the interpolation.
+ */
+typedef struct
+{
+    int method; //!< LMS7002M_GFIR_KAISER or LMS7002M_GFIR_REMEZ
+    int which; //!< the FIR filter 1, 2 (5 banks) or 3 (15 banks)
+    size_t ratio; //!< decimation or interpolation ratio, 1 without
+    double rate; //!< sample rate of the filter in Hz
+    double passband; //!< passband edge in Hz
+    double stopband; //!< stopband edge in Hz, at most rate/2
+} LMS7002M_gfir_spec_t;
+
+/*!
+ * Quantized lowpass taps from LMS7002M_gfir_design().
+ * The filter runs one tap of each bank per clock and has ratio clocks
+ * per sample, so each bank of 8 registers holds bank_len taps:
+ * tap k*bank_len+i of the filter is taps[k*8+i], the rest are 0.
+ */
+typedef struct
+{
+    short taps[LMS7002M_GFIR_MAX_TAPS]; //!< taps for LMS7002M_set_gfir_taps()
+    size_t ntaps; //!< 40 or 120 for LMS7002M_set_gfir_taps()
+    int bank_len; //!< taps per bank, the GFIRn_L field plus 1
+    int length; //!< filter length, bank_len per bank
+    double passband_ripple; //!< predicted peak to peak passband ripple in dB
+    double stopband_atten; //!< predicted minimum stopband attenuation in dB
+} LMS7002M_gfir_design_t;
+
+/*!
+ * Design lowpass taps for one of the TSP FIR filters.
+ * The filter length is the most the ratio allows,
+ * the taps are Q15 with unity gain at DC.
+ * \param spec the lowpass specification
+ * \param [out] design the quantized taps and their predicted response
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_gfir_design(const LMS7002M_gfir_spec_t *spec, LMS7002M_gfir_design_t *design);
+
+/*!
+ * The response of designed taps at a frequency.
+ * \param design the taps from LMS7002M_gfir_design()
+ * \param freq the frequency relative to the filter sample rate
+ * \return the gain in dB
+ */
+LMS7002M_API double LMS7002M_gfir_response(const LMS7002M_gfir_design_t *design, const double freq);
+
+/*!
+ * Filter a channel with a lowpass in the TSP FIR filters.
+ * GFIR2 and GFIR3 are designed for the current CGEN rate
+ * and decimation or interpolation, GFIR1 is bypassed.
+ * The stopband starts at least 10% past the passband edge bw/2,
+ * further for a filter too short to reach about 40 dB in that
+ * transition, and at most at 0.495 of the sample rate.
+ * The passband edge must leave a 5% transition below that.
+ * \param self an instance of the LMS7002M driver
+ * \param direction the direction LMS_TX or LMS_RX
+ * \param channel the channel LMS_CHA, LMS_CHB, or LMS_CHAB
+ * \param bw the two sided bandwidth in Hz or 0 to bypass the filters
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_set_gfir_lowpass(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double bw);
+
 //=====================================================================//
 // SXR and SXT (LO synthesizers)
 //=====================================================================//
@@ -433,6 +599,260 @@ LMS7002M_API int LMS7002M_set_lo_freq(LMS7002M_t *self, const LMS7002M_dir_t dir
  */
 LMS7002M_API void LMS7002M_sxt_to_sxr(LMS7002M_t *self, const bool enable);
 
+//=====================================================================//
+// Calibration cache
+//=====================================================================//
+
+/*!
+ * Enable the filter calibration cache.
+ * LMS7002M_rbb_set_filter_bw() and LMS7002M_tbb_set_filter_bw()
+ * then apply the stored results for a known channel, direction,
+ * requested bandwidth, CGEN reference and chip revision,
+ * and only run the calibration for new settings.
+ * With a path, the cache is loaded from and saved to that file;
+ * a file from another cache version is ignored and replaced.
+ * \param self an instance of the LMS7002M driver
+ * \param path the cache file path or NULL for a memory only cache
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_cal_cache_open(LMS7002M_t *self, const char *path);
+
+/*!
+ * Disable the filter calibration cache and free it.
+ * The file, if any, is kept.
+ * \param self an instance of the LMS7002M driver
+ */
+LMS7002M_API void LMS7002M_cal_cache_close(LMS7002M_t *self);
+
+/*!
+ * Force the filter calibrations to run even when cached.
+ * The new results replace the cached entries.
+ * \param self an instance of the LMS7002M driver
+ * \param force true to always calibrate
+ */
+LMS7002M_API void LMS7002M_cal_cache_force(LMS7002M_t *self, const bool force);
+
+/*!
+ * Synthesizer tunes done by the filter calibrations.
+ * The calibrations remember the CGEN, SXR and SXT frequencies they tune:
+ * a frequency still programmed is not written again,
+ * and a frequency tuned before gets its stored VCO setting back,
+ * checked with one comparator read, instead of a new VCO search.
+ */
+typedef struct
+{
+    unsigned long long full; //!< tunes with a complete VCO search
+    unsigned long long restored; //!< tunes that restored a stored VCO setting
+    unsigned long long avoided; //!< tunes skipped, the frequency was programmed
+} LMS7002M_cal_tune_stats_t;
+
+/*!
+ * Get the synthesizer tune counters of the filter calibrations.
+ * \param self an instance of the LMS7002M driver
+ * \param [out] stats the counters since the driver was created
+ */
+LMS7002M_API void LMS7002M_cal_tune_stats(LMS7002M_t *self, LMS7002M_cal_tune_stats_t *stats);
+
+/*!
+ * Register searches done by the filter calibrations.
+ * Each search probes register codes, one RSSI measurement per probe,
+ * starting from the analytic code scaled by what earlier searches found.
+ */
+typedef struct
+{
+    unsigned long long searches; //!< completed searches
+    unsigned long long probes; //!< RSSI measurements over all searches
+} LMS7002M_cal_search_stats_t;
+
+/*!
+ * Get the register search counters of the filter calibrations.
+ * \param self an instance of the LMS7002M driver
+ * \param [out] stats the counters since the driver was created
+ */
+LMS7002M_API void LMS7002M_cal_search_stats(LMS7002M_t *self, LMS7002M_cal_search_stats_t *stats);
+
+//! The most RSSI reads a calibration measurement takes
+#define LMS7002M_CAL_RSSI_MAX_READS 16
+
+/*!
+ * RSSI measurement settings of the filter calibrations.
+ * A measurement waits for the RSSI averaging window of the RxTSP
+ * to fill, as given by the CGEN rate, the decimation and AGC_AVG,
+ * then reads once per window: the first reads are dropped,
+ * and the reads stop early once their mean is stable.
+ */
+typedef struct
+{
+    int num_reads; //!< the most reads, up to LMS7002M_CAL_RSSI_MAX_READS (default 4)
+    int num_dropped; //!< the first reads dropped, less than num_reads (default 1)
+    double tolerance; //!< stop when the standard error of the mean is below this fraction of it, 0 to always take num_reads (default 0.002)
+} LMS7002M_cal_rssi_config_t;
+
+/*!
+ * Set how the filter calibrations measure the RSSI.
+ * \param self an instance of the LMS7002M driver
+ * \param config the new settings
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_cal_rssi_config(LMS7002M_t *self, const LMS7002M_cal_rssi_config_t *config);
+
+//=====================================================================//
+// IQ and DC calibration
+//=====================================================================//
+
+/*!
+ * IQ imbalance and DC offset corrections measured on the chip.
+ * The RX calibration sends a tone from the TX chain over the RF
+ * loopback, with SXT offset from SXR, and minimizes the RxTSP RSSI
+ * at DC for the DC offset, then at the image of the tone for the IQ
+ * imbalance, with the RxTSP NCO moving each frequency to DC.
+ * The TX calibration offsets SXR from SXT instead, and minimizes
+ * the RSSI at the TX LO leakage, then at the image of the TX tone.
+ */
+typedef struct
+{
+    double freq; //!< the LO frequency calibrated in Hz
+    int dc_i; //!< DC correction of I: RFE DCOFFI for RX (-63 to 63), TxTSP DCCORRI for TX (-128 to 127)
+    int dc_q; //!< DC correction of Q: RFE DCOFFQ for RX (-63 to 63), TxTSP DCCORRQ for TX (-128 to 127)
+    int gain; //!< gain correction (-2047 to 2047), positive scales Q down, negative scales I down
+    int phase; //!< phase correction IQCORR (-2048 to 2047), 2047 is pi/2
+    int tone_rssi; //!< RSSI of the loopback tone
+    int dc_rssi[2]; //!< RSSI at DC (the LO leakage for TX) before and after the correction
+    int image_rssi[2]; //!< RSSI at the image before and after the correction
+    int probes; //!< RSSI measurements taken, the search iterations
+    long long elapsed; //!< calibration time in LMS7_time_tps() ticks
+} LMS7002M_iq_cal_t;
+
+/*!
+ * Calibrate the RX DC offset and IQ imbalance at the current RX LO.
+ * The TX chain of the channel must be enabled with SXT running.
+ * All other registers are left as they were,
+ * and the result is stored for LMS7002M_iq_cal_apply().
+ * \param self an instance of the LMS7002M driver
+ * \param channel the channel LMS_CHA, LMS_CHB, or LMS_CHAB (A then B)
+ * \param [out] result the corrections found or NULL, an array of two for LMS_CHAB
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_rx_iq_calibrate(LMS7002M_t *self, const LMS7002M_chan_t channel, LMS7002M_iq_cal_t *result);
+
+/*!
+ * Calibrate the TX LO leakage and IQ imbalance at the current TX LO.
+ * The TX tone returns over the TRF loopback into the RFE loopback path
+ * with SXR tuned below SXT, so the RX chain of the channel must be
+ * enabled; SXR returns to its frequency after. All other registers
+ * are left as they were, and the result is stored for LMS7002M_iq_cal_apply().
+ * \param self an instance of the LMS7002M driver
+ * \param channel the channel LMS_CHA, LMS_CHB, or LMS_CHAB (A then B)
+ * \param [out] result the corrections found or NULL, an array of two for LMS_CHAB
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_tx_iq_calibrate(LMS7002M_t *self, const LMS7002M_chan_t channel, LMS7002M_iq_cal_t *result);
+
+/*!
+ * Write the DC, gain and phase corrections of a channel.
+ * The corrections that changed are written in one SPI batch.
+ * Like LMS7002M_txtsp_set_dc_correction() and the set_iq_correction()
+ * calls, a correction at its identity value (0) is bypassed.
+ * \param self an instance of the LMS7002M driver
+ * \param direction the direction LMS_RX or LMS_TX
+ * \param channel the channel LMS_CHA or LMS_CHB
+ * \param cal the corrections, the other fields are not used
+ * \param dc false to leave the DC correction as it is and write gain and phase only
+ */
+LMS7002M_API void LMS7002M_iq_cal_write(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const LMS7002M_iq_cal_t *cal, const bool dc);
+
+/*!
+ * Run the IQ calibration at each frequency of a list.
+ * The LO of the direction is tuned to each frequency in turn,
+ * then back to its frequency with the corrections for it applied.
+ * The RF paths stay as they are, so they must suit every frequency.
+ * A failed frequency is logged and skipped.
+ * \param self an instance of the LMS7002M driver
+ * \param direction the direction LMS_RX or LMS_TX
+ * \param channel the channel LMS_CHA, LMS_CHB, or LMS_CHAB
+ * \param freqs the LO frequencies in Hz
+ * \param num the number of frequencies
+ * \return 0 for success or the error code of the last failure
+ */
+LMS7002M_API int LMS7002M_iq_cal_sweep(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double *freqs, const size_t num);
+
+/*!
+ * Save the stored calibration results to a binary table file.
+ * \param self an instance of the LMS7002M driver
+ * \param path the table file path
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_iq_cal_save(LMS7002M_t *self, const char *path);
+
+/*!
+ * Replace the stored calibration results with a table file.
+ * A file from another table version or chip revision is ignored.
+ * \param self an instance of the LMS7002M driver
+ * \param path the table file path
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_iq_cal_load(LMS7002M_t *self, const char *path);
+
+/*!
+ * Forget the stored calibration results.
+ * \param self an instance of the LMS7002M driver
+ */
+LMS7002M_API void LMS7002M_iq_cal_clear(LMS7002M_t *self);
+
+/*!
+ * Look up the corrections for a frequency in the stored results.
+ * The corrections are linear between the two results around the frequency,
+ * and those of the closest result outside of the calibrated range.
+ * \param self an instance of the LMS7002M driver
+ * \param direction the direction LMS_RX or LMS_TX
+ * \param channel the channel LMS_CHA or LMS_CHB
+ * \param freq the LO frequency in Hz
+ * \param [out] cal the corrections for the frequency
+ * \return 0 for success or error code when nothing is stored
+ */
+LMS7002M_API int LMS7002M_iq_cal_lookup(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double freq, LMS7002M_iq_cal_t *cal);
+
+/*!
+ * Apply the corrections for a frequency from the stored results.
+ * See LMS7002M_iq_cal_lookup() for how the corrections are found.
+ * \param self an instance of the LMS7002M driver
+ * \param direction the direction LMS_RX or LMS_TX
+ * \param channel the channel LMS_CHA or LMS_CHB
+ * \param freq the LO frequency in Hz
+ * \param [out] applied the corrections applied or NULL
+ * \return 0 for success or error code when nothing is stored
+ */
+LMS7002M_API int LMS7002M_iq_cal_apply(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double freq, LMS7002M_iq_cal_t *applied);
+
+//=====================================================================//
+// TDD switching
+//=====================================================================//
+
+/*!
+ * Store the current TX or RX state for fast TDD switching.
+ * Configure the chip for the state with the regular calls first,
+ * ex: LMS7002M_trf_enable(), LMS7002M_rfe_enable(), LMS7002M_sxx_enable()
+ * and LMS7002M_sxt_to_sxr(), then store it. The state covers the
+ * AFE, TRF, TBB, RFE, RBB and SXX power and enable registers.
+ * Once both states are stored, each profile is compiled to the registers
+ * that differ from the other state. Store again after changing either state.
+ * \param self an instance of the LMS7002M driver
+ * \param direction the state to store LMS_TX or LMS_RX
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_tdd_store(LMS7002M_t *self, const LMS7002M_dir_t direction);
+
+/*!
+ * Switch to a stored TX or RX state.
+ * Only the compiled register deltas are written, in a single SPI batch,
+ * so the chip must be in the other stored state.
+ * \param self an instance of the LMS7002M driver
+ * \param direction the state to enter LMS_TX or LMS_RX
+ * \param elapsed the switch time in LMS7_time_tps() ticks (or NULL)
+ * \return 0 for success or error code when the states are not stored
+ */
+LMS7002M_API int LMS7002M_tdd_switch(LMS7002M_t *self, const LMS7002M_dir_t direction, long long *elapsed);
+
 //=====================================================================//
 // TxTSP (transmit DSP chain)
 //=====================================================================//
@@ -576,8 +996,9 @@ LMS7002M_API void LMS7002M_tbb_enable_loopback(LMS7002M_t *self, const LMS7002M_
 /*!
  * Set the TX baseband filter bandwidth.
  * The actual bandwidth will be greater than or equal to the requested bandwidth.
+ * LMS_CHAB calibrates channel A and then channel B.
  * \param self an instance of the LMS7002M driver
- * \param channel the channel LMS_CHA or LMS_CHB
+ * \param channel the channel LMS_CHA, LMS_CHB, or LMS_CHAB
  * \param bw the complex bandwidth in Hz
  * \param bwactual the actual filter width in Hz or NULL
  * \return 0 for success or error code on failure
@@ -687,6 +1108,62 @@ LMS7002M_API void LMS7002M_rxtsp_tsg_tone(LMS7002M_t *self, const LMS7002M_chan_
  */
 LMS7002M_API uint16_t LMS7002M_rxtsp_read_rssi(LMS7002M_t *self, const LMS7002M_chan_t channel);
 
+/*!
+ * One sample of the RSSI monitor.
+ */
+typedef struct
+{
+    long long time; //!< when the RSSI was captured in LMS7_time_now() ticks
+    int rssi[2]; //!< the RSSI of channel A and B, -1 when not monitored
+} LMS7002M_rssi_sample_t;
+
+/*!
+ * Configure the Rx TSP RSSI capture once for continuous monitoring.
+ * After this, each sample costs the capture toggle and two reads per channel,
+ * and with LMS_CHAB one capture toggle covers both channels.
+ * Another call that reconfigures the Rx TSP AGC or capture
+ * requires the monitor to be started again.
+ * \param self an instance of the LMS7002M driver
+ * \param channel the channel LMS_CHA, LMS_CHB, or LMS_CHAB
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7002M_rssi_monitor_start(LMS7002M_t *self, const LMS7002M_chan_t channel);
+
+/*!
+ * Stop the RSSI monitor. The Rx TSP configuration is left as is.
+ * \param self an instance of the LMS7002M driver
+ */
+LMS7002M_API void LMS7002M_rssi_monitor_stop(LMS7002M_t *self);
+
+/*!
+ * Capture and read one RSSI sample of the monitored channels.
+ * \param self an instance of the LMS7002M driver
+ * \param [out] sample the capture time and RSSI per channel
+ * \return 0 for success or error code when the monitor is stopped
+ */
+LMS7002M_API int LMS7002M_rssi_monitor_read(LMS7002M_t *self, LMS7002M_rssi_sample_t *sample);
+
+/*!
+ * Receive RSSI monitor samples from LMS7002M_rssi_monitor_poll().
+ * \param arg the argument given to the poll call
+ * \param sample the latest sample
+ * \return true to keep polling, false to stop
+ */
+typedef bool (*LMS7002M_rssi_callback_t)(void *arg, const LMS7002M_rssi_sample_t *sample);
+
+/*!
+ * Read RSSI monitor samples at a fixed rate in the calling thread.
+ * Sample times follow a fixed schedule: a late sample does not
+ * delay the ones after it, unless it is more than a period late.
+ * \param self an instance of the LMS7002M driver
+ * \param rate the samples per second
+ * \param num the number of samples or 0 until the callback returns false
+ * \param callback called with each sample
+ * \param arg passed to the callback
+ * \return the number of samples delivered or error code on failure
+ */
+LMS7002M_API int LMS7002M_rssi_monitor_poll(LMS7002M_t *self, const double rate, const size_t num, LMS7002M_rssi_callback_t callback, void *arg);
+
 /*!
  * DC offset correction value for Rx TSP chain.
  * This subtracts out the average signal level.
@@ -772,8 +1249,10 @@ LMS7002M_API double LMS7002M_rbb_set_pga(LMS7002M_t *self, const LMS7002M_chan_t
 /*!
  * Set the RX baseband filter bandwidth.
  * The actual bandwidth will be greater than or equal to the requested bandwidth.
+ * LMS_CHAB calibrates both channels in one pass: the clocking and LO setup
+ * is shared and the search steps of both channels settle together.
  * \param self an instance of the LMS7002M driver
- * \param channel the channel LMS_CHA or LMS_CHB
+ * \param channel the channel LMS_CHA, LMS_CHB, or LMS_CHAB
  * \param bw the complex bandwidth in Hz
  * \param bwactual the actual filter width in Hz or NULL
  * \return 0 for success or error code on failure
@@ -0,0 +1,183 @@
+///
+/// \file LMS7002M/LMS7002M_convert.h
+///
+/// Sample format converters for LMS7002M based streamers.
+/// The converters translate between the LML wire format
+/// (complex signed 16-bit, I then Q) and host sample formats.
+/// Each conversion has scalar and SIMD kernels,
+/// the fastest kernel supported by the CPU is selected at runtime.
+///
+/// \copyright
+/// Copyright (c) 2015-2017 Fairwaves, Inc.
+/// Copyright (c) 2015-2015 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#pragma once
+#include <LMS7002M/LMS7002M_config.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! The default full scale for converting integer samples to floats
+#define LMS7_CONV_FULL_SCALE 32768.0f
+
+//! Instruction set used by the converter kernels
+typedef enum
+{
+    LMS7_CONV_SCALAR = 0, //!< portable C kernels
+    LMS7_CONV_SSE2 = 1, //!< x86 SSE2 kernels
+    LMS7_CONV_AVX2 = 2, //!< x86 AVX2 kernels
+    LMS7_CONV_NEON = 3, //!< ARM NEON kernels
+} LMS7_conv_isa_t;
+
+/*!
+ * Generic converter function.
+ * \param in the input samples
+ * \param out the output samples
+ * \param n the number of complex samples
+ * \param scale the integer value that corresponds to 1.0 for float formats
+ */
+typedef void (*LMS7_conv_fcn_t)(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Split interleaved two channel words into per channel buffers.
+ * Each 32-bit word is one complex int16 sample, ordered A0 B0 A1 B1...
+ * as carried by the lime light interface in MIMO mode.
+ * \param in the interleaved input (2*n words)
+ * \param outA the channel A output (n words)
+ * \param outB the channel B output (n words)
+ * \param n the number of complex samples per channel
+ */
+typedef void (*LMS7_conv_deint_fcn_t)(const void *in, void *outA, void *outB, const size_t n);
+
+/*!
+ * Merge per channel buffers into interleaved two channel words.
+ * The inverse of the deinterleave function.
+ * \param inA the channel A input (n words)
+ * \param inB the channel B input (n words)
+ * \param out the interleaved output (2*n words)
+ * \param n the number of complex samples per channel
+ */
+typedef void (*LMS7_conv_int_fcn_t)(const void *inA, const void *inB, void *out, const size_t n);
+
+/*!
+ * Is the instruction set available on this build and CPU?
+ * \param isa the instruction set
+ * \return true when the kernels can be used
+ */
+LMS7002M_API bool LMS7_conv_isa_supported(const LMS7_conv_isa_t isa);
+
+/*!
+ * Get the instruction set used by the converters.
+ * The first call probes the CPU and selects the fastest kernels,
+ * set the environment variable LMS7_CONV_ISA to force one (Ex "scalar").
+ * \return the active instruction set
+ */
+LMS7002M_API LMS7_conv_isa_t LMS7_conv_get_isa(void);
+
+/*!
+ * Force the instruction set used by the converters.
+ * \param isa the instruction set
+ * \return 0 for success or -1 when not supported
+ */
+LMS7002M_API int LMS7_conv_set_isa(const LMS7_conv_isa_t isa);
+
+/*!
+ * Get a printable name for the instruction set.
+ * \param isa the instruction set
+ * \return the name string, Ex "SSE2"
+ */
+LMS7002M_API const char *LMS7_conv_isa_name(const LMS7_conv_isa_t isa);
+
+/*!
+ * Convert complex int16 to complex float32.
+ * out = in / scale
+ */
+LMS7002M_API void LMS7_conv_cs16_to_cf32(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Convert complex float32 to complex int16.
+ * out = round(in * scale) saturated to the int16 range,
+ * rounding is to nearest with ties to even for every kernel.
+ */
+LMS7002M_API void LMS7_conv_cf32_to_cs16(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Convert complex int16 to complex float64.
+ * out = in / scale
+ */
+LMS7002M_API void LMS7_conv_cs16_to_cf64(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Convert complex float64 to complex int16.
+ * Same rounding and saturation as LMS7_conv_cf32_to_cs16().
+ */
+LMS7002M_API void LMS7_conv_cf64_to_cs16(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Convert complex int16 to complex int8 (the upper byte), scale is ignored.
+ */
+LMS7002M_API void LMS7_conv_cs16_to_cs8(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Convert complex int8 to complex int16 (shifted into the upper byte), scale is ignored.
+ */
+LMS7002M_API void LMS7_conv_cs8_to_cs16(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Convert complex int16 to complex offset binary uint8 (128 is zero), scale is ignored.
+ */
+LMS7002M_API void LMS7_conv_cs16_to_cu8(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Convert complex offset binary uint8 to complex int16, scale is ignored.
+ */
+LMS7002M_API void LMS7_conv_cu8_to_cs16(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Pack complex int16 into complex int12 (the upper 12 bits), scale is ignored.
+ * Each complex sample takes 3 bytes in the SoapySDR CS12 layout:
+ * byte0 = I[7:0], byte1 = Q[3:0] I[11:8], byte2 = Q[11:4]
+ */
+LMS7002M_API void LMS7_conv_cs16_to_cs12(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Unpack complex int12 into complex int16 (the upper 12 bits), scale is ignored.
+ */
+LMS7002M_API void LMS7_conv_cs12_to_cs16(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Copy complex int16 samples (no conversion).
+ */
+LMS7002M_API void LMS7_conv_cs16_to_cs16(const void *in, void *out, const size_t n, const float scale);
+
+/*!
+ * Split A0 B0 A1 B1... complex int16 words into channel A and B buffers.
+ * See LMS7_conv_deint_fcn_t for the parameters.
+ */
+LMS7002M_API void LMS7_conv_deinterleave(const void *in, void *outA, void *outB, const size_t n);
+
+/*!
+ * Merge channel A and B complex int16 buffers into A0 B0 A1 B1... words.
+ * See LMS7_conv_int_fcn_t for the parameters.
+ */
+LMS7002M_API void LMS7_conv_interleave(const void *inA, const void *inB, void *out, const size_t n);
+
+/*!
+ * Lookup a converter given a pair of SoapySDR style format strings.
+ * Ex: LMS7_conv_lookup("CS16", "CF32") for receive samples.
+ * \param from the input format string
+ * \param to the output format string
+ * \return the converter function or NULL when not supported
+ */
+LMS7002M_API LMS7_conv_fcn_t LMS7_conv_lookup(const char *from, const char *to);
+
+#ifdef __cplusplus
+}
+#endif
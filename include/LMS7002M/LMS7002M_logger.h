@@ -12,6 +12,7 @@
 
 #pragma once
 #include <LMS7002M/LMS7002M_config.h>
+#include <stddef.h>
 #include <stdarg.h>
 
 #ifdef __cplusplus
@@ -40,6 +41,14 @@ struct LMS7002M_struct;
  */
 LMS7002M_API void LMS7_set_log_level(const LMS7_log_level_t level);
 
+/*!
+ * Set the logger level for a single instance.
+ * This overrides the module-wide level for messages about obj.
+ * \param obj the LMS7002M instance
+ * \param level a possible logging level or 0 to follow LMS7_set_log_level()
+ */
+LMS7002M_API void LMS7_set_obj_log_level(struct LMS7002M_struct *obj, const LMS7_log_level_t level);
+
 /*!
  * Send a message to the registered logger.
  * \param level a possible logging level
@@ -58,21 +67,26 @@ LMS7002M_API void LMS7_vlogf(const LMS7_log_level_t level, struct LMS7002M_struc
 /*!
  * Send a message to the registered logger.
  * \param level a possible logging level
+ * \param obj the LMS7002M instance or NULL
  * \param format a printf style format string
  */
-static inline void LMS7_logf(const LMS7_log_level_t level, struct LMS7002M_struct *obj, const char *format, ...)
+LMS7002M_API void LMS7_logf(const LMS7_log_level_t level, struct LMS7002M_struct *obj, const char *format, ...)
 #if (defined( __GNUC__) && (__GNUC__ > 3)) || defined(__clang__)
   __attribute__ ((format (printf, 3, 4)))
 #endif
 ;
 
-void LMS7_logf(const LMS7_log_level_t level, struct LMS7002M_struct *obj, const char *format, ...)
-{
-    va_list args;
-    va_start(args, format);
-    LMS7_vlogf(level, obj, format, args);
-    va_end(args);
-}
+/*!
+ * Compile-time minimum logging level, undefined by default.
+ * When it is defined, calls to LMS7_logf() with a level above it
+ * are removed entirely by the compiler (arguments included).
+ * LMS7_logf() stays an exported function either way.
+ * Ex: -DLMS7_LOG_COMPILE_LEVEL=LMS7_INFO
+ */
+#ifdef LMS7_LOG_COMPILE_LEVEL
+#define LMS7_logf(level, obj, ...) \
+    do { if ((level) <= LMS7_LOG_COMPILE_LEVEL) (LMS7_logf)((level), (obj), __VA_ARGS__); } while (0)
+#endif
 
 /*!
  * Typedef for a user specified log handler function.
@@ -85,6 +99,40 @@ typedef void (*LMS7_log_handler_t)(const LMS7_log_level_t logLevel, struct LMS70
  */
 LMS7002M_API void LMS7_set_log_handler(const LMS7_log_handler_t handler);
 
+/*!
+ * Register a log handler for a single instance.
+ * This overrides the module-wide handler for messages about obj.
+ * \param obj the LMS7002M instance
+ * \param handler the log handler or NULL to follow LMS7_set_log_handler()
+ */
+LMS7002M_API void LMS7_set_obj_log_handler(struct LMS7002M_struct *obj, const LMS7_log_handler_t handler);
+
+/*!
+ * Enable asynchronous logging for an instance.
+ * Messages are not formatted in the caller's context:
+ * the format pointer and arguments are copied into a multiple producer,
+ * single consumer ring and a background thread formats and delivers them.
+ * Any thread may log through the instance while the ring is enabled,
+ * including while LMS7_log_async_stop() runs.
+ * The format string must be a literal or otherwise outlive the message;
+ * string arguments are copied when the message is queued.
+ * When the ring is full new messages are dropped and counted.
+ * \param obj the LMS7002M instance
+ * \param depth the ring depth in messages (rounded up to a power of 2)
+ * \return 0 for success or error code on failure
+ */
+LMS7002M_API int LMS7_log_async_start(struct LMS7002M_struct *obj, const size_t depth);
+
+/*!
+ * Disable asynchronous logging for an instance.
+ * Pending messages are delivered before this call returns.
+ * The ring is unpublished first and freed once no thread still uses it,
+ * messages logged by other threads meanwhile are delivered synchronously.
+ * This is called automatically by LMS7002M_destroy().
+ * \param obj the LMS7002M instance
+ */
+LMS7002M_API void LMS7_log_async_stop(struct LMS7002M_struct *obj);
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,13 +26,11 @@ extern "C" {
  */
 LMS7002M_API long long LMS7_time_tps(void);
 
-#if 0
 /*!
  * Query the current time in tick counts.
  * \return an absolute time in tick counts
  */
 LMS7002M_API long long LMS7_time_now(void);
-#endif
 
 /*!
  * Sleep the caller for the specified number of ticks.
@@ -0,0 +1,116 @@
+///
+/// \file LMS7002M/LMS7002M_tsp_model.h
+///
+/// Fixed point software model of the RxTSP and TxTSP chains.
+/// A model is built from a register bank and the GFIR taps,
+/// then processes blocks of complex int16 samples (I then Q)
+/// the way the chain configured by those registers would.
+///
+/// Only the GFIRs (taps, bank order and length from GFIRn_L) and the
+/// gain, phase and DC corrections are taken from the registers, and the
+/// NCO mixer only for its frequency and sign. The rest are choices of
+/// the model, as the chip does not document them: the HBD and HBI
+/// halfbands are 23 tap Blackman windowed designs, the NCO phase has
+/// 12 bits, and the internal word widths are its own. The output of a
+/// chain through the halfbands or the NCO is therefore not a reference
+/// for the hardware output, only an approximation of it.
+/// The model is bit-exact between its scalar and SIMD kernels.
+///
+/// Modeled order, bypass flags in 0x040C and 0x0208 respected:
+///  - RX: DC tracking, gain, phase, CMIX, HBD, GFIR1, GFIR2, GFIR3
+///  - TX: GFIR1, GFIR2, GFIR3, gain, phase, DC, ISINC, HBI, CMIX
+/// The test signal generators (INSEL) are not modeled.
+///
+/// \copyright
+/// Copyright (c) 2016-2017 Fairwaves, Inc.
+/// Copyright (c) 2016-2016 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#pragma once
+#include <LMS7002M/LMS7002M.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Opaque TSP model instance
+struct LMS7002M_tsp_model_struct;
+typedef struct LMS7002M_tsp_model_struct LMS7002M_tsp_model_t;
+
+/*!
+ * Create a model of a TSP chain from a register bank.
+ * The taps are in the layout of LMS7002M_set_gfir_taps():
+ * 40 taps for filters 1 and 2, 120 taps for filter 3.
+ * \param direction the direction LMS_TX or LMS_RX
+ * \param regs the register bank of the channel, copied
+ * \param gfir_taps the taps of GFIR1-3, NULL entries only for bypassed filters
+ * \return a new model or NULL on error
+ */
+LMS7002M_API LMS7002M_tsp_model_t *LMS7002M_tsp_model_create(
+    const LMS7002M_dir_t direction,
+    const LMS7002M_regs_t *regs,
+    const short *const gfir_taps[3]);
+
+/*!
+ * Create a model of a TSP chain as the driver last programmed it:
+ * the register shadow of the channel and the taps last written by
+ * LMS7002M_set_gfir_taps(). Enabled filters must have known taps.
+ * \param self an instance of the LMS7002M driver
+ * \param direction the direction LMS_TX or LMS_RX
+ * \param channel the channel LMS_CHA or LMS_CHB
+ * \return a new model or NULL on error
+ */
+LMS7002M_API LMS7002M_tsp_model_t *LMS7002M_tsp_model_from_chip(
+    LMS7002M_t *self,
+    const LMS7002M_dir_t direction,
+    const LMS7002M_chan_t channel);
+
+/*!
+ * Destroy a model created by LMS7002M_tsp_model_create().
+ * \param model the model or NULL
+ */
+LMS7002M_API void LMS7002M_tsp_model_destroy(LMS7002M_tsp_model_t *model);
+
+/*!
+ * Clear the filter histories, the DC estimate and the NCO phase.
+ * \param model the TSP model
+ */
+LMS7002M_API void LMS7002M_tsp_model_reset(LMS7002M_tsp_model_t *model);
+
+/*!
+ * The decimation (RX) or interpolation (TX) ratio of the model.
+ * \param model the TSP model
+ * \return the ratio, 1 when HBD or HBI is bypassed
+ */
+LMS7002M_API size_t LMS7002M_tsp_model_ratio(const LMS7002M_tsp_model_t *model);
+
+/*!
+ * Use the SIMD kernels when the CPU supports them, the default.
+ * The scalar kernels are the reference for the SIMD ones.
+ * \param model the TSP model
+ * \param enable false to force the scalar kernels
+ */
+LMS7002M_API void LMS7002M_tsp_model_set_simd(LMS7002M_tsp_model_t *model, const bool enable);
+
+/*!
+ * Process a block of samples, the state carries over between blocks.
+ * RX: the input is at the TSP rate, at most num/ratio+1 samples come out.
+ * TX: the input is at the host rate, num*ratio samples come out.
+ * Inputs of -32768 are taken as -32767, the model saturates symmetric.
+ * \param model the TSP model
+ * \param in the input samples, num complex int16
+ * \param [out] out the output samples, complex int16
+ * \param num the number of complex input samples
+ * \return the number of complex output samples
+ */
+LMS7002M_API size_t LMS7002M_tsp_model_process(
+    LMS7002M_tsp_model_t *model,
+    const int16_t *in,
+    int16_t *out,
+    const size_t num);
+
+#ifdef __cplusplus
+}
+#endif
@@ -12,6 +12,7 @@
 
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 
 /*!
@@ -32,6 +33,12 @@ static inline void spidev_interface_close(void *handle);
  */
 static inline uint32_t spidev_interface_transact(void *handle, const uint32_t data, const bool readback);
 
+/*!
+ * The SPI batch write implementation - pass this to LMS7002M_set_spi_batch().
+ * The words go out in one ioctl, with chip select released between words.
+ */
+static inline void spidev_interface_transact_batch(void *handle, const uint32_t *data, const size_t num);
+
 /***********************************************************************
  * Implementation details below
  **********************************************************************/
@@ -102,3 +109,40 @@ static inline uint32_t spidev_interface_transact(void *handle, const uint32_t da
         (((uint32_t)rxbuf[2]) << 8) |
         (((uint32_t)rxbuf[3]) << 0);
 }
+
+//transfers per ioctl, the message size must fit in the ioctl size field
+#define SPIDEV_BATCH_MAX 64
+
+static inline void spidev_interface_transact_batch(void *handle, const uint32_t *data, const size_t num)
+{
+    int *fd = (int *)handle;
+
+    //transaction data structures
+    struct spi_ioc_transfer xfer[SPIDEV_BATCH_MAX];
+    unsigned char txbuf[SPIDEV_BATCH_MAX][4];
+
+    for (size_t i = 0; i < num; i += SPIDEV_BATCH_MAX)
+    {
+        const size_t n = ((num - i) < SPIDEV_BATCH_MAX)?(num - i):SPIDEV_BATCH_MAX;
+
+        //setup transactions, each word is a complete register write
+        memset(xfer, 0, n*sizeof(xfer[0]));
+        for (size_t j = 0; j < n; j++)
+        {
+            txbuf[j][0] = (data[i+j] >> 24);
+            txbuf[j][1] = (data[i+j] >> 16);
+            txbuf[j][2] = (data[i+j] >> 8);
+            txbuf[j][3] = (data[i+j] >> 0);
+            xfer[j].tx_buf = (unsigned long)txbuf[j];
+            xfer[j].len = 4; //bytes
+            xfer[j].cs_change = (j+1 < n)?1:0;
+        }
+
+        //SPI_IOC_MESSAGE(n) with a runtime n
+        long status = ioctl(*fd, _IOC(_IOC_WRITE, SPI_IOC_MAGIC, 0, n*sizeof(xfer[0])), xfer);
+        if (status < 0)
+        {
+            perror("SPI_IOC_MESSAGE");
+        }
+    }
+}
@@ -0,0 +1,209 @@
+///
+/// \file LMS7002M_cal_cache.c
+///
+/// Filter calibration result cache for the LMS7002M C driver.
+/// Results are kept in memory and optionally in a small text file,
+/// so repeat bandwidth settings and restarts skip the RSSI search.
+///
+/// \copyright
+/// Copyright (c) 2016-2017 Fairwaves, Inc.
+/// Copyright (c) 2016-2016 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "LMS7002M_impl.h"
+#include "LMS7002M_filter_cal.h"
+#include <LMS7002M/LMS7002M_logger.h>
+
+//! Bump when the cached fields or the cal algorithms change
+#define CAL_CACHE_VERSION 1
+
+//! The oldest entries are replaced past this size
+#define CAL_CACHE_MAX_ENTRIES 256
+
+typedef struct
+{
+    int direction; //LMS_RX or LMS_TX
+    int channel; //LMS_CHA or LMS_CHB
+    int rev; //chip revision register 0x002F
+    long long fref; //CGEN reference in Hz
+    long long bw; //requested bandwidth in Hz
+    int num;
+    int values[CAL_CACHE_MAX_VALUES];
+} cal_cache_entry_t;
+
+struct LMS7_cal_cache
+{
+    char *path; //NULL for a memory only cache
+    bool force;
+    size_t num;
+    size_t next; //replaced next when full
+    cal_cache_entry_t entries[CAL_CACHE_MAX_ENTRIES];
+};
+
+/***********************************************************************
+ * File format: a version line, then one entry per line
+ * "RX A 0x3841 30720000 10000000 8 v0 v1 ..."
+ **********************************************************************/
+static void cal_cache_read(LMS7002M_t *self, struct LMS7_cal_cache *cache)
+{
+    FILE *p = fopen(cache->path, "r");
+    if (p == NULL) return; //no file yet
+
+    int version = 0;
+    if (fscanf(p, "LMS7002M cal cache v%d\n", &version) != 1 || version != CAL_CACHE_VERSION)
+    {
+        LMS7_logf(LMS7_WARNING, self, "%s: cal cache version %d not %d, ignored", cache->path, version, CAL_CACHE_VERSION);
+        fclose(p);
+        return;
+    }
+
+    char dir[3];
+    char chan;
+    cal_cache_entry_t e;
+    while (cache->num < CAL_CACHE_MAX_ENTRIES &&
+        fscanf(p, "%2s %c %i %lld %lld %d", dir, &chan, &e.rev, &e.fref, &e.bw, &e.num) == 6)
+    {
+        if (e.num < 0 || e.num > CAL_CACHE_MAX_VALUES) break;
+        int i = 0;
+        while (i < e.num && fscanf(p, "%d", &e.values[i]) == 1) i++;
+        if (i != e.num) break;
+        e.direction = (strcmp(dir, "TX") == 0)?LMS_TX:LMS_RX;
+        e.channel = (chan == 'B')?LMS_CHB:LMS_CHA;
+        cache->entries[cache->num++] = e;
+    }
+    fclose(p);
+    LMS7_logf(LMS7_DEBUG, self, "%s: %d cached cal results", cache->path, (int)cache->num);
+}
+
+static int cal_cache_write(LMS7002M_t *self, struct LMS7_cal_cache *cache)
+{
+    //write aside and rename so a crash never leaves a partial file
+    const size_t len = strlen(cache->path);
+    char *tmp = (char *)malloc(len + 5);
+    if (tmp == NULL) return -1;
+    memcpy(tmp, cache->path, len);
+    memcpy(tmp + len, ".tmp", 5);
+
+    FILE *p = fopen(tmp, "w");
+    if (p == NULL)
+    {
+        LMS7_logf(LMS7_WARNING, self, "%s: cannot write cal cache", tmp);
+        free(tmp);
+        return -1;
+    }
+    fprintf(p, "LMS7002M cal cache v%d\n", CAL_CACHE_VERSION);
+    for (size_t n = 0; n < cache->num; n++)
+    {
+        const cal_cache_entry_t *e = &cache->entries[n];
+        fprintf(p, "%s %c 0x%04x %lld %lld %d",
+            (e->direction == LMS_TX)?"TX":"RX", (e->channel == LMS_CHB)?'B':'A',
+            e->rev, e->fref, e->bw, e->num);
+        for (int i = 0; i < e->num; i++) fprintf(p, " %d", e->values[i]);
+        fprintf(p, "\n");
+    }
+    const int ret = (fclose(p) == 0)?rename(tmp, cache->path):-1;
+    free(tmp);
+    return ret;
+}
+
+/***********************************************************************
+ * Public API
+ **********************************************************************/
+int LMS7002M_cal_cache_open(LMS7002M_t *self, const char *path)
+{
+    LMS7002M_cal_cache_close(self);
+
+    struct LMS7_cal_cache *cache = (struct LMS7_cal_cache *)calloc(1, sizeof(struct LMS7_cal_cache));
+    if (cache == NULL) return -1;
+    if (path != NULL)
+    {
+        cache->path = strdup(path);
+        if (cache->path == NULL)
+        {
+            free(cache);
+            return -1;
+        }
+        cal_cache_read(self, cache);
+    }
+    self->cal_cache = cache;
+    return 0;
+}
+
+void LMS7002M_cal_cache_close(LMS7002M_t *self)
+{
+    struct LMS7_cal_cache *cache = self->cal_cache;
+    if (cache == NULL) return;
+    self->cal_cache = NULL;
+    free(cache->path);
+    free(cache);
+}
+
+void LMS7002M_cal_cache_force(LMS7002M_t *self, const bool force)
+{
+    if (self->cal_cache != NULL) self->cal_cache->force = force;
+}
+
+/***********************************************************************
+ * Calibration hooks
+ **********************************************************************/
+static void cal_cache_key(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double bw, cal_cache_entry_t *key)
+{
+    key->direction = direction;
+    key->channel = channel;
+    key->rev = LMS7002M_spi_read(self, 0x002f); //global, read under any MAC
+    key->fref = llround(self->cgen_fref);
+    key->bw = llround(bw);
+}
+
+static cal_cache_entry_t *cal_cache_find(struct LMS7_cal_cache *cache, const cal_cache_entry_t *key)
+{
+    for (size_t n = 0; n < cache->num; n++)
+    {
+        cal_cache_entry_t *e = &cache->entries[n];
+        if (e->direction == key->direction && e->channel == key->channel &&
+            e->rev == key->rev && e->fref == key->fref && e->bw == key->bw) return e;
+    }
+    return NULL;
+}
+
+int cal_cache_lookup(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double bw, int *values, const int num)
+{
+    struct LMS7_cal_cache *cache = self->cal_cache;
+    if (cache == NULL || cache->force) return -1;
+
+    cal_cache_entry_t key;
+    cal_cache_key(self, direction, channel, bw, &key);
+    const cal_cache_entry_t *e = cal_cache_find(cache, &key);
+    if (e == NULL || e->num != num) return -1;
+
+    memcpy(values, e->values, num*sizeof(int));
+    LMS7_logf(LMS7_DEBUG, self, "cached %s filter cal [%c] %f MHz", (direction == LMS_TX)?"TX":"RX", channel, bw/1e6);
+    return 0;
+}
+
+void cal_cache_store(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double bw, const int *values, const int num)
+{
+    struct LMS7_cal_cache *cache = self->cal_cache;
+    if (cache == NULL || num > CAL_CACHE_MAX_VALUES) return;
+
+    cal_cache_entry_t key;
+    cal_cache_key(self, direction, channel, bw, &key);
+    cal_cache_entry_t *e = cal_cache_find(cache, &key);
+    if (e == NULL && cache->num < CAL_CACHE_MAX_ENTRIES) e = &cache->entries[cache->num++];
+    if (e == NULL)
+    {
+        e = &cache->entries[cache->next];
+        cache->next = (cache->next + 1) % CAL_CACHE_MAX_ENTRIES;
+    }
+    *e = key;
+    e->num = num;
+    memcpy(e->values, values, num*sizeof(int));
+
+    if (cache->path != NULL) cal_cache_write(self, cache);
+}
@@ -10,49 +10,122 @@
 /// http://www.apache.org/licenses/LICENSE-2.0
 ///
 
+#include <math.h>
+#include <string.h> //memcpy
 #include "LMS7002M_impl.h"
 #include "LMS7002M_filter_cal.h"
+#include "LMS7002M_vco.h"
 #include <LMS7002M/LMS7002M_logger.h>
 #include <LMS7002M/LMS7002M_time.h>
 
-static long long cal_rssi_sleep_ticks(void)
+/***********************************************************************
+ * RSSI measurement
+ * The RxTSP RSSI is the average over a window of 2^(AGC_AVG+7) samples
+ * at the decimated RxTSP rate (CGEN/4 over the HBD decimation).
+ * A measurement sleeps one window so the samples from before the last
+ * register write leave it, then reads once per window.
+ **********************************************************************/
+static long long cal_rssi_window_ticks(LMS7002M_t *self, const LMS7002M_chan_t channel)
 {
-    return (LMS7_time_tps())/1000; //1 ms -> ticks
+    //rate unknown: the fixed 1 ms settle, reads every 0.25 ms
+    if (self->cgen_freq <= 0.0) return 0;
+
+    const LMS7002M_regs_t *regs = &self->_regs[(channel == LMS_CHB)?1:0];
+    const int hbd_ovr = regs->reg_0x0403_hbd_ovr;
+    const int decim = (hbd_ovr == REG_0X0403_HBD_OVR_BYPASS)?1:(2 << hbd_ovr);
+    const double rate = self->cgen_freq/4/decim;
+    const double samples = (double)(1 << ((regs->reg_0x040a_agc_avg & 0x7) + 7));
+    long long ticks = llround(samples/rate*LMS7_time_tps());
+    if (ticks < 1) ticks = 1;
+    return ticks;
+}
+
+int LMS7002M_cal_rssi_config(LMS7002M_t *self, const LMS7002M_cal_rssi_config_t *config)
+{
+    if (config->num_reads < 1 || config->num_reads > LMS7002M_CAL_RSSI_MAX_READS) return -1;
+    if (config->num_dropped < 0 || config->num_dropped >= config->num_reads) return -1;
+    if (config->tolerance < 0.0) return -1;
+    self->cal_rssi = *config;
+    return 0;
 }
 
 uint16_t cal_read_rssi(LMS7002M_t *self, const LMS7002M_chan_t channel)
 {
-    const unsigned N = 4;
-    const unsigned S = 1;
-    unsigned i;
-    int rssi_v[N];
-    int rssi_avg = 0;
+    int rssi = 0;
+    cal_read_rssi_chans(self, channel, &rssi);
+    return rssi;
+}
 
-    LMS7_sleep_for(cal_rssi_sleep_ticks());
+int cal_num_chans(const LMS7002M_chan_t channel)
+{
+    return (channel == LMS_CHAB)?2:1;
+}
 
-    for (i = 0; i < N; i++)
-    {
-        LMS7_sleep_for(cal_rssi_sleep_ticks()/4);
+LMS7002M_chan_t cal_chan(const LMS7002M_chan_t channel, const int i)
+{
+    if (channel != LMS_CHAB) return channel;
+    return (i == 0)?LMS_CHA:LMS_CHB;
+}
 
-        rssi_v[i] = LMS7002M_rxtsp_read_rssi(self, channel);
-        if (i >= S)
-            rssi_avg += rssi_v[i];
+int *cal_chan_field(LMS7002M_t *self, const LMS7002M_chan_t channel, int *field)
+{
+    const size_t offset = (size_t)((char *)field - (char *)self->_regs) % sizeof(LMS7002M_regs_t);
+    return (int *)((char *)&self->_regs[(channel == LMS_CHB)?1:0] + offset);
+}
+
+void cal_read_rssi_chans(LMS7002M_t *self, const LMS7002M_chan_t channel, int *rssi)
+{
+    const LMS7002M_cal_rssi_config_t *config = &self->cal_rssi;
+    const int num = cal_num_chans(channel);
+    long long window = cal_rssi_window_ticks(self, cal_chan(channel, 0));
+    long long settle = window;
+    if (window == 0)
+    {
+        settle = LMS7_time_tps()/1000;
+        window = settle/4;
     }
-#if 0
-    LMS7_logf(LMS7_FATAL, self, "RSSI: %d [%d %d %d %d  %d %d %d %d  %d %d %d %d  %d %d %d %d ]",
-              2 * rssi_avg / N,
-              rssi_v[0], rssi_v[1], rssi_v[2], rssi_v[3],
-            rssi_v[4], rssi_v[5], rssi_v[6], rssi_v[7],
-            rssi_v[8], rssi_v[9], rssi_v[10], rssi_v[11],
-            rssi_v[12], rssi_v[13], rssi_v[14], rssi_v[15]);
-#else
-    LMS7_logf(LMS7_FATAL, self, "RSSI: %d [%d %d %d %d]",
-              rssi_avg / (N - S),
-              rssi_v[0], rssi_v[1], rssi_v[2], rssi_v[3]);
-#endif
+    double sum[2] = {0.0, 0.0};
+    double sum_sq[2] = {0.0, 0.0};
+    int kept = 0;
+    int i;
 
+    //the channels settle together: with LMS_CHAB the writes
+    //to both channels came before this one sleep
+    LMS7_sleep_for(settle);
+
+    for (i = 0; i < config->num_reads; i++)
+    {
+        LMS7_sleep_for(window);
+
+        for (int c = 0; c < num; c++)
+        {
+            const int value = LMS7002M_rxtsp_read_rssi(self, cal_chan(channel, c));
+            if (i < config->num_dropped) continue;
+            sum[c] += value;
+            sum_sq[c] += (double)value*value;
+        }
+        if (i >= config->num_dropped) kept++;
 
-    return rssi_avg / (N - S);
+        //stop once the standard error of the mean is within tolerance on all channels
+        if (kept < 2 || config->tolerance <= 0.0) continue;
+        bool stable = true;
+        for (int c = 0; c < num; c++)
+        {
+            const double mean = sum[c]/kept;
+            const double var = (sum_sq[c] - kept*mean*mean)/(kept - 1);
+            const double limit = config->tolerance*mean;
+            if (var/kept > limit*limit) stable = false;
+        }
+        if (stable) break;
+    }
+
+    for (int c = 0; c < num; c++)
+    {
+        rssi[c] = (int)(sum[c]/kept);
+        LMS7_logf(LMS7_TRACE, self, "RSSI: [%c] %d (%d reads, window %lld us)",
+                  cal_chan(channel, c), rssi[c], kept,
+                  (window*1000000)/LMS7_time_tps());
+    }
 }
 
 void set_addrs_to_default(LMS7002M_t *self, const LMS7002M_chan_t channel, const int start_addr, const int stop_addr)
@@ -67,111 +140,263 @@ void set_addrs_to_default(LMS7002M_t *self, const LMS7002M_chan_t channel, const
     }
 }
 
-int cal_gain_selection(LMS7002M_t *self, const LMS7002M_chan_t channel, int rssi_level)
+void cal_gain_selection(LMS7002M_t *self, const LMS7002M_chan_t channel, int rssi_level, int *rssi)
 {
     // TODO find optimal PGA & TBB ( & RFE loopback ) that don't saturate
     // RX and TX
-    int rssi_max;
-    int rssi;
+    //with LMS_CHAB both channels search in lockstep until each is done
+    const int num = cal_num_chans(channel);
+    int rssi_max[2] = {0, 0};
+    bool done[2] = {false, false};
+    int pending = num;
 
-    while (true)
+    while (pending > 0)
     {
-#if 0
-        const int rssi_value_50k = cal_read_rssi(self, channel);
-
-        LMS7_logf(LMS7_FATAL, self, "RSSI: %d TBB: %d PGA: %d",
-                  rssi_value_50k,
-                  LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb,
-                  LMS7002M_regs(self)->reg_0x0119_g_pga_rbb);
-
-        if (rssi_value_50k > 0x8400) break;
+        int best_lo[2] = {-1, -1}; //int rssi_lo = -1;
+        int best_hi[2] = {-1, -1}; //int rssi_hi = -1;
+        int rssi_value_50k[2];
+        int range = 32;
 
-        LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb++;
-        if (LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb > 63)
+        for (int c = 0; c < num; c++)
         {
-            if (LMS7002M_regs(self)->reg_0x0119_g_pga_rbb > 31) break;
-            LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb = 1;
-            LMS7002M_regs(self)->reg_0x0119_g_pga_rbb += 6;
+            if (done[c]) continue;
+            LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+            LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb = range;
+            rssi_max[c] = 0;
         }
 
-        LMS7002M_regs_spi_write(self, 0x0108);
-        LMS7002M_regs_spi_write(self, 0x0119);
-#else
-        int best_lo = -1; //int rssi_lo = -1;
-        int best_hi = -1; //int rssi_hi = -1;
-
-        int range = LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb = 32;
-        int rssi_value_50k;
-
-        rssi_max = 0;
-
         do
         {
-            int old_cg_iamp_tbb = LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb;
-            LMS7002M_regs_spi_write(self, 0x0108);
-
-            rssi_value_50k = cal_read_rssi(self, channel);
-            if (rssi_value_50k > rssi_max)
-                rssi_max = rssi_value_50k;
-
-            if (rssi_value_50k > rssi_level/*0.8 * 65536*/)
+            for (int c = 0; c < num; c++)
             {
-                best_hi = LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb;
-                //rssi_hi = rssi_value_50k;
-                LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb -= range/2;
+                if (done[c]) continue;
+                LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+                LMS7002M_regs_spi_write(self, 0x0108);
             }
-            else
+
+            cal_read_rssi_chans(self, channel, rssi_value_50k);
+
+            for (int c = 0; c < num; c++)
             {
-                best_lo = LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb;
-                //rssi_lo = rssi_value_50k;
-                LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb += range/2;
-            }
+                if (done[c]) continue;
+                LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+                int *cg_iamp_tbb = &LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb;
+                if (rssi_value_50k[c] > rssi_max[c])
+                    rssi_max[c] = rssi_value_50k[c];
 
-            LMS7_logf(LMS7_FATAL, self, "RSSI: %d -- %d (range %d)",
-                      rssi_value_50k,
-                      old_cg_iamp_tbb,
-                      range);
+                LMS7_logf(LMS7_TRACE, self, "RSSI: [%c] %d -- %d (range %d)",
+                          cal_chan(channel, c),
+                          rssi_value_50k[c],
+                          *cg_iamp_tbb,
+                          range);
+
+                if (rssi_value_50k[c] > rssi_level/*0.8 * 65536*/)
+                {
+                    best_hi[c] = *cg_iamp_tbb;
+                    *cg_iamp_tbb -= range/2;
+                }
+                else
+                {
+                    best_lo[c] = *cg_iamp_tbb;
+                    *cg_iamp_tbb += range/2;
+                }
+            }
             range /= 2;
         }
         while (range != 0);
 
-        if (best_hi != -1)
+        for (int c = 0; c < num; c++)
         {
-            if (best_lo != -1)
+            if (done[c]) continue;
+            LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+
+            if (best_hi[c] != -1)
             {
-                LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb = best_lo;
-                LMS7002M_regs_spi_write(self, 0x0108);
+                if (best_lo[c] != -1)
+                {
+                    LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb = best_lo[c];
+                    LMS7002M_regs_spi_write(self, 0x0108);
+                }
+                else if (LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb != best_hi[c])
+                {
+                    LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb = best_hi[c];
+                    LMS7002M_regs_spi_write(self, 0x0108);
+                }
+                done[c] = true;
+                pending--;
+                continue;
             }
-            else if (LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb != best_hi)
+
+            if (LMS7002M_regs(self)->reg_0x0119_g_pga_rbb == 31)
             {
-                LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb = best_hi;
-                LMS7002M_regs_spi_write(self, 0x0108);
+                // unable to tune!
+                done[c] = true;
+                pending--;
+                continue;
             }
-            break;
+
+            // Not enough gain in the loopback
+            LMS7002M_regs(self)->reg_0x0119_g_pga_rbb += 6;
+            if (LMS7002M_regs(self)->reg_0x0119_g_pga_rbb > 31)
+            {
+                LMS7002M_regs(self)->reg_0x0119_g_pga_rbb = 31;
+            }
+            LMS7002M_regs_spi_write(self, 0x0119);
         }
+    }
+
+    cal_read_rssi_chans(self, channel, rssi);
+    for (int c = 0; c < num; c++)
+    {
+        LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+        LMS7_logf(LMS7_DEBUG, self, "RSSI: [%c] %d (MAX %d) TBB: %d PGA: %d",
+                  cal_chan(channel, c),
+                  rssi[c], rssi_max[c],
+                  LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb,
+                  LMS7002M_regs(self)->reg_0x0119_g_pga_rbb);
+    }
+    LMS7002M_set_mac_ch(self, channel);
+}
+
+/***********************************************************************
+ * Synthesizer tunes remembered across calibration stages
+ **********************************************************************/
+#define CAL_TUNE_CGEN 0
+#define CAL_TUNE_SXR 1
+#define CAL_TUNE_SXT 2
+
+//the registers written by a tune, the VCO capacitor last
+static const int cal_tune_addrs[3][LMS7_CAL_TUNE_REGS] = {
+    {0x0086, 0x0087, 0x0088, 0x0089, 0x008b},
+    {0x011c, 0x011d, 0x011e, 0x011f, 0x0121},
+    {0x011c, 0x011d, 0x011e, 0x011f, 0x0121},
+};
+
+static void cal_tune_select(LMS7002M_t *self, const int synth)
+{
+    if (synth == CAL_TUNE_CGEN) LMS7002M_set_mac_ch(self, LMS_CHA);
+    if (synth == CAL_TUNE_SXR) LMS7002M_set_mac_dir(self, LMS_RX);
+    if (synth == CAL_TUNE_SXT) LMS7002M_set_mac_dir(self, LMS_TX);
+}
+
+static int cal_tune_full(LMS7002M_t *self, const int synth, const double fref, const double fout, double *factual)
+{
+    if (synth == CAL_TUNE_CGEN) return LMS7002M_set_data_clock(self, fref, fout, factual);
+    return LMS7002M_set_lo_freq(self, (synth == CAL_TUNE_SXR)?LMS_RX:LMS_TX, fref, fout, factual);
+}
+
+//restart the CGEN loop on restored dividers, as LMS7002M_set_data_clock() does
+static void cal_tune_reset(LMS7002M_t *self, const int synth)
+{
+    if (synth != CAL_TUNE_CGEN) return;
+    self->regs->reg_0x0086_reset_n_cgen = 0;
+    LMS7002M_regs_spi_write(self, 0x0086);
+    self->regs->reg_0x0086_reset_n_cgen = 1;
+    LMS7002M_regs_spi_write(self, 0x0086);
+}
+
+static bool cal_tune_locked(LMS7002M_t *self, const int synth)
+{
+    if (synth == CAL_TUNE_CGEN) return LMS7002M_check_vco(self,
+        &self->regs->reg_0x008c_vco_cmpho_cgen,
+        &self->regs->reg_0x008c_vco_cmplo_cgen, 0x008C) == 0;
+    return LMS7002M_check_vco(self,
+        &self->regs->reg_0x0123_vco_cmpho,
+        &self->regs->reg_0x0123_vco_cmplo, 0x0123) == 0;
+}
+
+//the driver state a tune leaves behind besides the registers
+static void cal_tune_done(LMS7002M_t *self, const int synth, const double fref, const double fout)
+{
+    if (synth == CAL_TUNE_CGEN)
+    {
+        self->cgen_freq = fout;
+        self->cgen_fref = fref;
+        return;
+    }
+    if (synth == CAL_TUNE_SXR) self->sxr_freq = fout;
+    if (synth == CAL_TUNE_SXT) self->sxt_freq = fout;
+    if (synth == CAL_TUNE_SXR) self->sxr_fref = fref;
+    if (synth == CAL_TUNE_SXT) self->sxt_fref = fref;
+    self->regs->reg_0x0100_en_nexttx_trf = true;
+    self->regs->reg_0x010d_en_nextrx_rfe = true;
+}
+
+static int cal_tune(LMS7002M_t *self, const int synth, const double fref, const double fout, double *factual)
+{
+    const int *addrs = cal_tune_addrs[synth];
+    LMS7002M_cal_tune_t *memo = NULL;
+    for (int i = 0; i < LMS7_CAL_TUNE_MEMO; i++)
+    {
+        LMS7002M_cal_tune_t *t = &self->cal_tune[synth][i];
+        if (t->valid && t->fref == fref && t->fout == fout) memo = t;
+    }
 
-        if (LMS7002M_regs(self)->reg_0x0119_g_pga_rbb == 31)
+    cal_tune_select(self, synth);
+    if (memo != NULL)
+    {
+        //still programmed: the shadows hold the registers of the tune
+        bool programmed = true;
+        for (int j = 0; j < LMS7_CAL_TUNE_REGS; j++)
+        {
+            if (LMS7002M_regs_get(self->regs, addrs[j]) != memo->values[j]) programmed = false;
+        }
+        if (programmed)
         {
-            // unable to tune!
-            break;
+            LMS7_logf(LMS7_DEBUG, self, "cal tune %f MHz still programmed", fout/1e6);
+            self->cal_tune_stats.avoided++;
+            goto done;
         }
 
-        // Not enough gain in the loopback
-        LMS7002M_regs(self)->reg_0x0119_g_pga_rbb += 6;
-        if (LMS7002M_regs(self)->reg_0x0119_g_pga_rbb > 31)
+        //tuned before: restore the VCO setting, restart the loop and check the comparators
+        for (int j = 0; j < LMS7_CAL_TUNE_REGS; j++)
         {
-            LMS7002M_regs(self)->reg_0x0119_g_pga_rbb = 31;
+            LMS7002M_regs_set(self->regs, addrs[j], memo->values[j]);
+            LMS7002M_regs_spi_write(self, addrs[j]);
         }
-        LMS7002M_regs_spi_write(self, 0x0119);
-#endif
+        cal_tune_reset(self, synth);
+        if (cal_tune_locked(self, synth))
+        {
+            LMS7_logf(LMS7_DEBUG, self, "cal tune %f MHz restored", fout/1e6);
+            self->cal_tune_stats.restored++;
+            goto done;
+        }
+        LMS7_logf(LMS7_DEBUG, self, "cal tune %f MHz not locked after restore", fout/1e6);
+        memo->valid = false; //drifted, search again
     }
 
-    rssi = cal_read_rssi(self, channel);
-    LMS7_logf(LMS7_FATAL, self, "RSSI: %d (MAX %d) TBB: %d PGA: %d",
-              rssi, rssi_max,
-              LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb,
-              LMS7002M_regs(self)->reg_0x0119_g_pga_rbb);
-    return rssi;
+    double actual = 0.0;
+    const int status = cal_tune_full(self, synth, fref, fout, &actual);
+    if (status != 0) return status;
+    self->cal_tune_stats.full++;
+
+    //remember the tune, replacing the oldest
+    memo = &self->cal_tune[synth][self->cal_tune_next[synth]];
+    self->cal_tune_next[synth] = (self->cal_tune_next[synth] + 1) % LMS7_CAL_TUNE_MEMO;
+    cal_tune_select(self, synth);
+    memo->valid = true;
+    memo->fref = fref;
+    memo->fout = fout;
+    memo->factual = actual;
+    for (int j = 0; j < LMS7_CAL_TUNE_REGS; j++)
+    {
+        memo->values[j] = LMS7002M_regs_get(self->regs, addrs[j]);
+    }
+
+    done:
+    cal_tune_done(self, synth, fref, fout);
+    if (factual != NULL) *factual = memo->factual;
+    return 0;
+}
+
+void LMS7002M_cal_tune_stats(LMS7002M_t *self, LMS7002M_cal_tune_stats_t *stats)
+{
+    *stats = self->cal_tune_stats;
+}
+
+int cal_set_lo_freq(LMS7002M_t *self, const LMS7002M_dir_t direction, const double fref, const double fout, double *factual)
+{
+    return cal_tune(self, (direction == LMS_RX)?CAL_TUNE_SXR:CAL_TUNE_SXT, fref, fout, factual);
 }
 
 int cal_setup_cgen(LMS7002M_t *self, const double bw)
@@ -180,5 +405,232 @@ int cal_setup_cgen(LMS7002M_t *self, const double bw)
     if (cgen_freq < 60e6) cgen_freq = 60e6;
     if (cgen_freq > 640e6) cgen_freq = 640e6;
     while ((int)(cgen_freq/1e6) == (int)(bw/16e6)) cgen_freq -= 10e6;
-    return LMS7002M_set_data_clock(self, self->cgen_fref, cgen_freq, NULL);
+    return cal_tune(self, CAL_TUNE_CGEN, self->cgen_fref, cgen_freq, NULL);
+}
+
+/***********************************************************************
+ * Register search for an RSSI crossing
+ **********************************************************************/
+void cal_search_init(cal_search_t *s, const int seed, const int reg_max, const int target)
+{
+    s->reg_max = reg_max;
+    s->target = target;
+    s->code = (seed < 0)?0:(seed > reg_max)?reg_max:seed;
+    s->hi_code = s->hi_rssi = -1;
+    s->lo_code = s->lo_rssi = -1;
+    s->prev_code = s->prev_rssi = -1;
+    s->step = ((s->code > reg_max/8)?s->code:reg_max/8) / 8; //the seed is rarely off by more
+    if (s->step < 1) s->step = 1;
+    s->side = 0;
+    s->stall = 0;
+    s->bisect = false;
+    s->probes = 0;
+    s->result = CAL_NONE;
+}
+
+static bool cal_search_done(LMS7002M_t *self, cal_search_t *s, const cal_result_t result)
+{
+    s->result = result;
+    self->cal_search_stats.searches++;
+    self->cal_search_stats.probes += s->probes;
+    return true;
+}
+
+//the code where the line through two probes crosses the target, false without a falling line
+static bool cal_search_secant(const cal_search_t *s, const int x0, const int r0, const int x1, const int r1, double *cross)
+{
+    if (x0 == x1 || r0 == r1) return false;
+    const double slope = (double)(r1 - r0)/(x1 - x0);
+    if (slope >= 0.0) return false;
+    *cross = x0 + (s->target - r0)/slope;
+    return true;
+}
+
+bool cal_search_update(LMS7002M_t *self, cal_search_t *s, const int rssi)
+{
+    const int x = s->code;
+    const bool bracketed = s->hi_code != -1 && s->lo_code != -1;
+    const int side = (rssi >= s->target)?+1:-1;
+    const int prev_code = s->prev_code, prev_rssi = s->prev_rssi;
+    s->prev_code = x;
+    s->prev_rssi = rssi;
+    s->probes++;
+
+    //a monotonic response stays between the bracket ends
+    if (bracketed && (rssi > s->hi_rssi || rssi < s->lo_rssi)) s->bisect = true;
+    if (side > 0 && s->lo_code != -1 && x >= s->lo_code) s->bisect = true;
+    if (side < 0 && s->hi_code != -1 && x <= s->hi_code) s->bisect = true;
+
+    if (side > 0 && x > s->hi_code)
+    {
+        s->hi_code = x;
+        s->hi_rssi = rssi;
+    }
+    if (side < 0 && (s->lo_code == -1 || x < s->lo_code))
+    {
+        s->lo_code = x;
+        s->lo_rssi = rssi;
+    }
+    s->stall = (side == s->side)?s->stall+1:1;
+    s->side = side;
+
+    double cross = 0.0;
+    const bool secant = prev_code != -1 && cal_search_secant(s, prev_code, prev_rssi, x, rssi, &cross);
+
+    //bracket the crossing: extrapolate past it, else step further each time
+    if (s->lo_code == -1 || s->hi_code == -1)
+    {
+        const int dir = (s->lo_code == -1)?+1:-1;
+        if (dir > 0 && x == s->reg_max) return cal_search_done(self, s, CAL_LOW);
+        if (dir < 0 && x == 0) return cal_search_done(self, s, CAL_HIGH);
+        int next = x + dir*s->step;
+        if (secant)
+        {
+            //overshoot a little so that the next probe lands past the crossing
+            const int over = (int)(dir*(cross - x)*1.1) + 1;
+            if (over > 0 && over < 4*s->step) next = x + dir*over;
+        }
+        s->step *= 2;
+        s->code = (next < 0)?0:(next > s->reg_max)?s->reg_max:next;
+        return false;
+    }
+
+    //adjacent codes: keep the one closer to the target
+    if (s->lo_code - s->hi_code <= 1)
+    {
+        s->code = (s->hi_rssi - s->target <= s->target - s->lo_rssi)?s->hi_code:s->lo_code;
+        return cal_search_done(self, s, CAL_OK);
+    }
+
+    //secant through the last two probes, the bracket ends when those
+    //do not fall, and bisection when the response or the steps misbehave
+    int next;
+    const bool fallback = s->bisect || s->stall > 2;
+    if (!fallback && (secant || cal_search_secant(s, s->hi_code, s->hi_rssi, s->lo_code, s->lo_rssi, &cross)))
+    {
+        next = (int)floor(cross);
+    }
+    else
+    {
+        next = (s->hi_code + s->lo_code) / 2;
+    }
+    if (next <= s->hi_code) next = s->hi_code + 1;
+    if (next >= s->lo_code) next = s->lo_code - 1;
+    LMS7_logf(LMS7_TRACE, self, "search [%d %d] -> %d%s", s->hi_code, s->lo_code, next, fallback?" (bisect)":"");
+    s->code = next;
+    return false;
+}
+
+static LMS7002M_cal_model_t *cal_model_find(LMS7002M_t *self, const LMS7002M_chan_t channel, const int addr, const bool add)
+{
+    LMS7002M_cal_model_t *models = self->cal_model[(channel == LMS_CHB)?1:0];
+    for (int i = 0; i < LMS7_CAL_MODEL_SIZE; i++)
+    {
+        if (models[i].addr == addr) return models+i;
+        if (models[i].addr != 0 || !add) continue;
+        models[i].addr = addr;
+        return models+i;
+    }
+    return NULL;
+}
+
+int cal_search_seed(LMS7002M_t *self, const LMS7002M_chan_t channel, const int addr, const int analytic)
+{
+    const LMS7002M_cal_model_t *m = cal_model_find(self, channel, addr, false);
+    if (m == NULL || analytic <= 0) return analytic;
+    return (int)(analytic*m->ratio + 0.5);
+}
+
+void cal_search_learn(LMS7002M_t *self, const LMS7002M_chan_t channel, const int addr, const int analytic, const int code)
+{
+    if (analytic <= 0 || code <= 0) return;
+    LMS7002M_cal_model_t *m = cal_model_find(self, channel, addr, true);
+    if (m != NULL) m->ratio = (double)code/analytic;
+}
+
+void LMS7002M_cal_search_stats(LMS7002M_t *self, LMS7002M_cal_search_stats_t *stats)
+{
+    *stats = self->cal_search_stats;
+}
+
+/***********************************************************************
+ * Register restore after a calibration
+ **********************************************************************/
+int cal_restore_regs(LMS7002M_t *self, LMS7002M_regs_t *saved)
+{
+    int num = 0;
+    for (int bank = 0; bank < 2; bank++)
+    {
+        for (const int *addrp = LMS7002M_regs_addrs(); *addrp != 0; addrp++)
+        {
+            //MAC is restored last, the registers below 0x0100 do not depend on it
+            if (*addrp == 0x0020) continue;
+            if (bank == 1 && *addrp < 0x0100) continue;
+            const int value = LMS7002M_regs_get(&saved[bank], *addrp);
+            if (value == LMS7002M_regs_get(&self->_regs[bank], *addrp)) continue;
+            if (*addrp >= 0x0100) LMS7002M_set_mac_ch(self, (bank == 0)?LMS_CHA:LMS_CHB);
+            LMS7002M_regs_set(&self->_regs[bank], *addrp, value);
+            LMS7002M_spi_write(self, *addrp, value);
+            num++;
+        }
+    }
+
+    const int mac = LMS7002M_regs_get(&saved[0], 0x0020);
+    if (mac != LMS7002M_regs_get(&self->_regs[0], 0x0020))
+    {
+        LMS7002M_regs_set(&self->_regs[0], 0x0020, mac);
+        LMS7002M_spi_write(self, 0x0020, mac);
+        num++;
+    }
+    self->regs = &self->_regs[(self->_regs[0].reg_0x0020_mac == REG_0X0020_MAC_CHB)?1:0];
+    LMS7_logf(LMS7_DEBUG, self, "cal restored %d registers", num);
+    return num;
+}
+
+/***********************************************************************
+ * Coordinate search for a cost minimum
+ * Each coordinate in turn steps both ways from the best point
+ * and keeps walking while the cost falls.
+ * The step of a coordinate halves when neither way improves.
+ **********************************************************************/
+int cal_minimize(LMS7002M_t *self, cal_cost_t cost, void *arg, const int num,
+                 int *x, const int *x_min, const int *x_max, const int *step, const int max_probes)
+{
+    int s[CAL_MINIMIZE_MAX_DIMS];
+    int y[CAL_MINIMIZE_MAX_DIMS];
+    bool searching = true;
+    for (int i = 0; i < num; i++) s[i] = step[i];
+    int best = cost(self, arg, x);
+    int probes = 1;
+
+    while (searching && probes < max_probes)
+    {
+        searching = false;
+        for (int i = 0; i < num && probes < max_probes; i++)
+        {
+            if (s[i] < 1) continue;
+            searching = true;
+            bool improved = false;
+            for (int dir = +1; dir >= -1 && !improved; dir -= 2)
+            {
+                for (;;)
+                {
+                    memcpy(y, x, num*sizeof(int));
+                    y[i] += dir*s[i];
+                    if (y[i] < x_min[i]) y[i] = x_min[i];
+                    if (y[i] > x_max[i]) y[i] = x_max[i];
+                    if (y[i] == x[i] || probes >= max_probes) break;
+                    const int c = cost(self, arg, y);
+                    probes++;
+                    if (c >= best) break;
+                    memcpy(x, y, num*sizeof(int));
+                    best = c;
+                    improved = true;
+                }
+            }
+            if (!improved) s[i] /= 2;
+        }
+    }
+    LMS7_logf(LMS7_DEBUG, self, "cal minimum %d after %d probes", best, probes);
+    return probes;
 }
@@ -15,14 +15,112 @@
 //! Prevent calibration loops from getting stuck
 #define MAX_CAL_LOOP_ITERS 512
 
-//! Read the RSSI from RxTSP with small sleep for settling
+typedef enum cal_result {
+    CAL_NONE, // not searched yet
+    CAL_OK,
+    CAL_LOW,  // coudn't satisfy desired RSSI -- rssi < desired_rssi
+    CAL_HIGH, // coudn't satisfy desired RSSI -- rssi > desired_rssi
+} cal_result_t;
+
+/*!
+ * Search state for the register code where the RSSI crosses a target.
+ * The RSSI falls as the code rises. The search brackets the crossing
+ * from a seed, stepping by secant extrapolation of the last two probes,
+ * then narrows the bracket with secant steps on the measured RSSI.
+ * It bisects after a non-monotonic response
+ * or when the secant steps keep moving the same end.
+ */
+typedef struct
+{
+    int reg_max;
+    int target; //desired RSSI
+    int code; //the code to probe next, the result when done
+    int hi_code, hi_rssi; //largest code with rssi >= target or -1
+    int lo_code, lo_rssi; //smallest code with rssi < target or -1
+    int prev_code, prev_rssi; //the probe before the last or -1
+    int step; //expansion step while bracketing
+    int side, stall; //end moved by the last probes
+    bool bisect; //the response was not monotonic
+    int probes;
+    cal_result_t result;
+} cal_search_t;
+
+//! Start a search from a seed code
+void cal_search_init(cal_search_t *s, const int seed, const int reg_max, const int target);
+
+//! Record the RSSI at s->code and pick the next code, true when done
+bool cal_search_update(LMS7002M_t *self, cal_search_t *s, const int rssi);
+
+//! The seed for a search given the analytic code, scaled by what earlier searches found
+int cal_search_seed(LMS7002M_t *self, const LMS7002M_chan_t channel, const int addr, const int analytic);
+
+//! Learn from a search that found code where the analytic model gave analytic
+void cal_search_learn(LMS7002M_t *self, const LMS7002M_chan_t channel, const int addr, const int analytic, const int code);
+
+//! Read the RSSI from RxTSP after the averaging window settles
 uint16_t cal_read_rssi(LMS7002M_t *self, const LMS7002M_chan_t channel);
 
+//! The number of channels a calibration covers, 2 for LMS_CHAB
+int cal_num_chans(const LMS7002M_chan_t channel);
+
+//! The single channel at index i of the channels a calibration covers
+LMS7002M_chan_t cal_chan(const LMS7002M_chan_t channel, const int i);
+
+//! The same register field as field (from either bank) in the bank of a single channel
+int *cal_chan_field(LMS7002M_t *self, const LMS7002M_chan_t channel, int *field);
+
+//! Read the RSSI of each channel covered with one settling sleep for all of them,
+//! averaging up to the configured number of reads, one per averaging window
+void cal_read_rssi_chans(LMS7002M_t *self, const LMS7002M_chan_t channel, int *rssi);
+
 //! Helper to set a range of addresses to default
 void set_addrs_to_default(LMS7002M_t *self, const LMS7002M_chan_t channel, const int start_addr, const int stop_addr);
 
-//! Helper to perform the calibration baseband gain selection
-int cal_gain_selection(LMS7002M_t *self, const LMS7002M_chan_t channel, int rssi_level);
+//! Helper to perform the calibration baseband gain selection, the RSSI per channel covered
+void cal_gain_selection(LMS7002M_t *self, const LMS7002M_chan_t channel, int rssi_level, int *rssi);
 
 //! Helper to setup clocking for calibration
 int cal_setup_cgen(LMS7002M_t *self, const double bw);
+
+//! Tune a LO for calibration, reusing a remembered tune when possible
+int cal_set_lo_freq(LMS7002M_t *self, const LMS7002M_dir_t direction, const double fref, const double fout, double *factual);
+
+//! Write back the registers that differ from a saved register map, the number written
+int cal_restore_regs(LMS7002M_t *self, LMS7002M_regs_t *saved);
+
+//! The cost of a point for cal_minimize(), a measured RSSI
+typedef int (*cal_cost_t)(LMS7002M_t *self, void *arg, const int *x);
+
+//! The most coordinates cal_minimize() searches
+#define CAL_MINIMIZE_MAX_DIMS 4
+
+//! Search the point x in [x_min, x_max] of the lowest cost from x, the number of probes
+int cal_minimize(LMS7002M_t *self, cal_cost_t cost, void *arg, const int num,
+                 int *x, const int *x_min, const int *x_max, const int *step, const int max_probes);
+
+//! Write the RFE DC offset correction of one channel
+void cal_rx_iq_write_dc(LMS7002M_t *self, const LMS7002M_chan_t channel, const int dc_i, const int dc_q);
+
+//! Write the RxTSP gain and phase correction of one channel
+void cal_rx_iq_write_iq(LMS7002M_t *self, const LMS7002M_chan_t channel, const int gain, const int phase);
+
+//! Write the TxTSP DC correction of one channel
+void cal_tx_iq_write_dc(LMS7002M_t *self, const LMS7002M_chan_t channel, const int dc_i, const int dc_q);
+
+//! Write the TxTSP gain and phase correction of one channel
+void cal_tx_iq_write_iq(LMS7002M_t *self, const LMS7002M_chan_t channel, const int gain, const int phase);
+
+//! Send a TX tone at f_tone over the RF loopback of a channel, RSSI after decim
+void cal_iq_loopback(LMS7002M_t *self, const LMS7002M_chan_t channel, const double f_tone, const size_t decim, const int agc_avg);
+
+//! Store an IQ calibration result for LMS7002M_iq_cal_apply()
+void cal_iq_store(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const LMS7002M_iq_cal_t *cal);
+
+//! The most results stored per cache entry
+#define CAL_CACHE_MAX_VALUES 8
+
+//! Look up cached filter calibration results, 0 on a hit
+int cal_cache_lookup(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double bw, int *values, const int num);
+
+//! Store filter calibration results in the cache and its file
+void cal_cache_store(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double bw, const int *values, const int num);
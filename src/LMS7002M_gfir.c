@@ -11,7 +11,46 @@
 ///
 
 #include <stdlib.h>
+#include <string.h> //memcpy
+#include <math.h> //M_PI
 #include "LMS7002M_impl.h"
+#include <LMS7002M/LMS7002M_logger.h>
+
+//register of tap i of a filter, in the bank order of LMS7002M_set_gfir_taps()
+static int gfir_tap_addr(const LMS7002M_dir_t direction, const int which, const size_t i)
+{
+    if (which == 1) return ((direction == LMS_RX)?0x0480:0x0280) + (int)i;
+    if (which == 2) return ((direction == LMS_RX)?0x04c0:0x02c0) + (int)i;
+
+    //filter 3 is 3 blocks of 40 taps, each followed by 24 reserved registers
+    return ((direction == LMS_RX)?0x0500:0x0300) + (int)(i/40)*64 + (int)(i%40);
+}
+
+//read back the taps of each bank and compare with the shadow
+static int gfir_verify_taps(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const int which, const size_t ntaps)
+{
+    const int dir = (direction == LMS_RX)?1:0;
+    int ret = 0;
+    for (int bank = 0; bank < 2; bank++)
+    {
+        if (channel == ((bank == 0)?LMS_CHB:LMS_CHA)) continue;
+        LMS7002M_set_mac_ch(self, (bank == 0)?LMS_CHA:LMS_CHB);
+        for (size_t i = 0; i < ntaps; i++)
+        {
+            const int addr = gfir_tap_addr(direction, which, i);
+            const int value = LMS7002M_spi_read(self, addr);
+            if (value == (unsigned short)self->gfir_taps[dir][bank][which-1][i]) continue;
+            LMS7_logf(LMS7_ERROR, self, "GFIR%d verify [%c]: 0x%04x reads 0x%04x, wrote 0x%04x",
+                which, (bank == 0)?'A':'B', addr, value, (unsigned short)self->gfir_taps[dir][bank][which-1][i]);
+            //the next upload writes every tap again
+            self->gfir_known[dir][bank][which-1] = false;
+            ret = -3;
+            break;
+        }
+    }
+    LMS7002M_set_mac_ch(self, channel);
+    return ret;
+}
 
 int LMS7002M_set_gfir_taps(
     LMS7002M_t *self,
@@ -50,52 +89,138 @@ int LMS7002M_set_gfir_taps(
     if (which == 2 && ntaps != 5*8) return -2;
     if (which == 3 && ntaps != 3*5*8) return -2;
 
-    //taps configuration logic from LMS7002_MainControl::LoadGFIRCoefficients
-    if (which == 1)
+    //only the taps that differ from the shadow of a written bank go out
+    const int dir = (direction == LMS_RX)?1:0;
+    const bool banks[2] = {channel != LMS_CHB, channel != LMS_CHA};
+    int addrs[LMS7002M_GFIR_MAX_TAPS], values[LMS7002M_GFIR_MAX_TAPS];
+    size_t num = 0;
+    for (size_t i = 0; i < ntaps; i++)
     {
-        int addr = (direction == LMS_RX)?0x0480:0x0280;
-        for (int k=0; k<5; ++k)
+        bool changed = false;
+        for (int bank = 0; bank < 2; bank++)
         {
-            for (int i=0; i<8; ++i)
-            {
-                LMS7002M_spi_write(self, addr, taps[k*8+i]);
-                ++addr;
-            }
+            if (!banks[bank]) continue;
+            if (!self->gfir_known[dir][bank][which-1]) changed = true;
+            else if (self->gfir_taps[dir][bank][which-1][i] != taps[i]) changed = true;
         }
+        if (!changed) continue;
+        addrs[num] = gfir_tap_addr(direction, which, i);
+        values[num] = (unsigned short)taps[i];
+        num++;
     }
-    else if (which == 2)
+    LMS7002M_spi_write_batch(self, addrs, values, num);
+
+    for (int bank = 0; bank < 2; bank++)
     {
-        int addr = (direction == LMS_RX)?0x04c0:0x02c0;
-        for (int k=0; k<5; ++k)
-        {
-            for (int i=0; i<8; ++i)
-            {
-                LMS7002M_spi_write(self, addr, taps[k*8+i]);
-                ++addr;
-            }
-        }
+        if (!banks[bank]) continue;
+        memcpy(self->gfir_taps[dir][bank][which-1], taps, ntaps*sizeof(short));
+        self->gfir_known[dir][bank][which-1] = true;
     }
-    else if (which == 3)
+
+    if (!self->gfir_verify) return 0;
+    return gfir_verify_taps(self, direction, channel, which, ntaps);
+}
+
+int LMS7002M_get_gfir_taps(
+    LMS7002M_t *self,
+    const LMS7002M_dir_t direction,
+    const LMS7002M_chan_t channel,
+    const int which,
+    short *taps,
+    const size_t ntaps)
+{
+    if (channel != LMS_CHA && channel != LMS_CHB) return -1;
+    if (which < 1 || which > 3) return -1;
+    if (ntaps != ((which == 3)?3*5*8:5*8)) return -2;
+
+    const int dir = (direction == LMS_RX)?1:0;
+    const int bank = (channel == LMS_CHB)?1:0;
+    if (!self->gfir_known[dir][bank][which-1]) return -1;
+    memcpy(taps, self->gfir_taps[dir][bank][which-1], ntaps*sizeof(short));
+    return 0;
+}
+
+void LMS7002M_set_gfir_verify(LMS7002M_t *self, const bool enable)
+{
+    self->gfir_verify = enable;
+}
+
+int LMS7002M_set_gfir_lowpass(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double bw)
+{
+    //bypass all filters for no bandwidth
+    if (bw <= 0.0)
     {
-        int addr = (direction == LMS_RX)?0x0500:0x0300;
-        int coefIndex = 0;
-        unsigned short coefValue = 0;
-        for (int n=0; n<3; ++n)
-        {
-            for (int k=0; k<5; ++k)
-            {
-                for (int i=0; i<8; ++i)
-                {
-                    coefValue = taps[coefIndex];
-                    ++coefIndex;
-
-                    LMS7002M_spi_write(self, addr, coefValue);
-                    ++addr;
-                }
-            }
-            addr += 24; //skip reserved
-        }
+        for (int which = 1; which <= 3; which++) LMS7002M_set_gfir_taps(self, direction, channel, which, NULL, 0);
+        return 0;
     }
+    if (self->cgen_freq == 0.0) return -1;
+
+    //the filters run at the rate of the host side of the TSP
+    LMS7002M_set_mac_ch(self, channel);
+    const int ovr = (direction == LMS_RX)?self->regs->reg_0x0403_hbd_ovr:self->regs->reg_0x0203_hbi_ovr;
+    const size_t ratio = (ovr == 7)?1:(2 << ovr);
+    const double tsp_rate = (direction == LMS_RX)?(self->cgen_freq/4):self->cgen_freq;
+
+    LMS7002M_gfir_spec_t spec;
+    spec.ratio = ratio;
+    spec.rate = tsp_rate/ratio;
+    spec.passband = bw/2;
+    if (spec.passband*1.05 > spec.rate*0.495) return -2;
+
+    LMS7002M_gfir_design_t design[2];
+    for (int i = 0; i < 2; i++)
+    {
+        //the transition a filter this long can take to about 40 dB (Kaiser estimate),
+        //a shorter one only trades the passband ripple for the stopband
+        const int length = ((i == 0)?5:15)*(int)((ratio < 8)?ratio:8);
+        const double transition = spec.rate*(40 - 8)/(2.285*2*M_PI*(length - 1));
+        spec.stopband = spec.passband + transition;
+        if (spec.stopband < spec.passband*1.1) spec.stopband = spec.passband*1.1;
+        if (spec.stopband > spec.rate*0.495) spec.stopband = spec.rate*0.495;
+
+        spec.which = i+2;
+        spec.method = LMS7002M_GFIR_REMEZ;
+        if (LMS7002M_gfir_design(&spec, &design[i]) == 0) continue;
+        //no equiripple solution at this length, the window always designs
+        spec.method = LMS7002M_GFIR_KAISER;
+        if (LMS7002M_gfir_design(&spec, &design[i]) != 0) return -2;
+    }
+
+    //taps per bank and clocks per sample of each filter
+    const int l = design[0].bank_len - 1;
+    const int n = (int)ratio - 1;
+    if (direction == LMS_RX)
+    {
+        self->regs->reg_0x0405_gfir1_l = l;
+        self->regs->reg_0x0405_gfir1_n = n;
+        self->regs->reg_0x0406_gfir2_l = l;
+        self->regs->reg_0x0406_gfir2_n = n;
+        self->regs->reg_0x0407_gfir3_l = l;
+        self->regs->reg_0x0407_gfir3_n = n;
+        LMS7002M_regs_spi_write(self, 0x0405);
+        LMS7002M_regs_spi_write(self, 0x0406);
+        LMS7002M_regs_spi_write(self, 0x0407);
+    }
+    else
+    {
+        self->regs->reg_0x0205_gfir1_l = l;
+        self->regs->reg_0x0205_gfir1_n = n;
+        self->regs->reg_0x0206_gfir2_l = l;
+        self->regs->reg_0x0206_gfir2_n = n;
+        self->regs->reg_0x0207_gfir3_l = l;
+        self->regs->reg_0x0207_gfir3_n = n;
+        LMS7002M_regs_spi_write(self, 0x0205);
+        LMS7002M_regs_spi_write(self, 0x0206);
+        LMS7002M_regs_spi_write(self, 0x0207);
+    }
+
+    LMS7002M_set_gfir_taps(self, direction, channel, 1, NULL, 0);
+    int ret = LMS7002M_set_gfir_taps(self, direction, channel, 2, design[0].taps, design[0].ntaps);
+    if (ret == 0) ret = LMS7002M_set_gfir_taps(self, direction, channel, 3, design[1].taps, design[1].ntaps);
+    if (ret != 0) return ret;
 
-    return 0; //OK
+    LMS7_logf(LMS7_DEBUG, self, "GFIR %s lowpass %f MHz at %f Msps: %d and %d taps, ripple %f dB, attenuation %f and %f dB",
+        (direction == LMS_RX)?"RX":"TX", bw/1e6, spec.rate/1e6, design[0].length, design[1].length,
+        design[1].passband_ripple, design[0].stopband_atten, design[1].stopband_atten);
+    return 0;
 }
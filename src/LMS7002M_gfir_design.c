@@ -0,0 +1,302 @@
+///
+/// \file LMS7002M_gfir_design.c
+///
+/// Lowpass tap design for the TSP FIR filters of the LMS7002M C driver:
+/// a Kaiser windowed sinc or a Parks-McClellan equiripple filter,
+/// quantized and laid out in the bank order of the GFIR registers.
+///
+/// \copyright
+/// Copyright (c) 2016-2017 Fairwaves, Inc.
+/// Copyright (c) 2016-2016 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h> //M_PI
+#include "LMS7002M_impl.h"
+
+//! Full scale of a quantized tap, unity DC gain sums to this
+#define GFIR_TAP_SCALE 32767.0
+
+//! Remez exchange iterations before giving up
+#define GFIR_REMEZ_MAX_ITER 40
+
+//! Remez grid points per extremal frequency
+#define GFIR_REMEZ_DENSITY 16
+
+//! Remez extremal points of the longest odd length filter
+#define GFIR_MAX_REMEZ_POINTS (LMS7002M_GFIR_MAX_TAPS/2 + 2)
+
+//! Local extrema of the error considered per Remez exchange
+#define GFIR_MAX_REMEZ_CAND (2*GFIR_MAX_REMEZ_POINTS)
+
+/***********************************************************************
+ * Kaiser windowed sinc
+ **********************************************************************/
+//modified Bessel function of the first kind, order 0
+static double gfir_bessel_i0(const double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50 && term > 1e-12*sum; k++)
+    {
+        term *= (x/(2*k))*(x/(2*k));
+        sum += term;
+    }
+    return sum;
+}
+
+static void gfir_kaiser(const int n, const double fp, const double fs, double *h)
+{
+    //the attenuation this length reaches over the transition sets the window
+    const double atten = 2.285*(n - 1)*2*M_PI*(fs - fp) + 8;
+    double beta = 0.0;
+    if (atten > 50) beta = 0.1102*(atten - 8.7);
+    else if (atten > 21) beta = 0.5842*pow(atten - 21, 0.4) + 0.07886*(atten - 21);
+
+    const double fc = (fp + fs)/2;
+    const double mid = (n - 1)/2.0;
+    for (int i = 0; i < n; i++)
+    {
+        const double t = i - mid;
+        const double sinc = (t == 0.0)?2*fc:sin(2*M_PI*fc*t)/(M_PI*t);
+        const double r = (mid > 0)?(t/mid):0.0;
+        h[i] = sinc*gfir_bessel_i0(beta*sqrt(1 - r*r))/gfir_bessel_i0(beta);
+    }
+}
+
+/***********************************************************************
+ * Parks-McClellan equiripple, odd length n = 2m+1, equal weights:
+ * the amplitude is a cosine polynomial of degree m in w,
+ * so a polynomial in x = cos(w) found by the Remez exchange
+ * on a grid over the passband [0, fp] and the stopband [fs, 0.5].
+ **********************************************************************/
+typedef struct
+{
+    int num; //extremal points, m+2
+    double x[GFIR_MAX_REMEZ_POINTS]; //cos(w) of the points
+    double b[GFIR_MAX_REMEZ_POINTS]; //barycentric weights
+    double c[GFIR_MAX_REMEZ_POINTS]; //amplitude at the points
+    double delta; //the ripple of the current set
+} gfir_remez_t;
+
+//interpolate the amplitude at x through the first num-1 points
+static double gfir_remez_eval(const gfir_remez_t *r, const double x)
+{
+    double num = 0.0, den = 0.0;
+    for (int k = 0; k < r->num - 1; k++)
+    {
+        const double d = x - r->x[k];
+        if (fabs(d) < 1e-14) return r->c[k];
+        num += r->b[k]/d*r->c[k];
+        den += r->b[k]/d;
+    }
+    return num/den;
+}
+
+static void gfir_remez_solve(gfir_remez_t *r, const double *desired)
+{
+    //weights through all points for the ripple
+    double b[GFIR_MAX_REMEZ_POINTS];
+    double num = 0.0, den = 0.0;
+    for (int k = 0; k < r->num; k++)
+    {
+        //scaled by 2 per factor, the product stays in range for long filters
+        b[k] = 1.0;
+        for (int j = 0; j < r->num; j++) if (j != k) b[k] *= 2*(r->x[k] - r->x[j]);
+        b[k] = 1.0/b[k];
+        num += b[k]*desired[k];
+        den += ((k % 2 == 0)?1:-1)*b[k];
+    }
+    r->delta = num/den;
+
+    //weights through the first num-1 points for the interpolation
+    for (int k = 0; k < r->num - 1; k++)
+    {
+        r->b[k] = 1.0;
+        for (int j = 0; j < r->num - 1; j++) if (j != k) r->b[k] *= 2*(r->x[k] - r->x[j]);
+        r->b[k] = 1.0/r->b[k];
+        r->c[k] = desired[k] - ((k % 2 == 0)?1:-1)*r->delta;
+    }
+}
+
+static int gfir_remez(const int n, const double fp, const double fs, double *h)
+{
+    const int m = (n - 1)/2;
+    const int num = m + 2;
+    if (num > GFIR_MAX_REMEZ_POINTS) return -1;
+
+    //the grid, with each band edge on it
+    const int size = GFIR_REMEZ_DENSITY*num;
+    const int pass = (int)ceil(size*fp/(fp + 0.5 - fs));
+    const int grid_num = size + 2;
+    double *w = (double *)malloc(grid_num*sizeof(double));
+    double *err = (double *)malloc(grid_num*sizeof(double));
+    if (w == NULL || err == NULL)
+    {
+        free(w);
+        free(err);
+        return -1;
+    }
+    for (int i = 0; i <= pass; i++) w[i] = 2*M_PI*fp*i/pass;
+    //a stopband at or just below rate/2 gets the single point at its edge
+    const int stop = grid_num - pass - 1;
+    if (stop < 2) w[pass + 1] = 2*M_PI*fs;
+    else for (int i = 0; i < stop; i++) w[pass + 1 + i] = 2*M_PI*(fs + (0.5 - fs)*i/(stop - 1));
+
+    //start from points spread evenly over the grid
+    int ext[GFIR_MAX_REMEZ_POINTS];
+    for (int k = 0; k < num; k++) ext[k] = (int)((double)k*(grid_num - 1)/(num - 1));
+
+    gfir_remez_t r;
+    r.num = num;
+    bool converged = false;
+    for (int iter = 0; iter < GFIR_REMEZ_MAX_ITER; iter++)
+    {
+        double desired[GFIR_MAX_REMEZ_POINTS];
+        for (int k = 0; k < num; k++)
+        {
+            r.x[k] = cos(w[ext[k]]);
+            desired[k] = (ext[k] <= pass)?1.0:0.0;
+        }
+        gfir_remez_solve(&r, desired);
+
+        //the error over the grid
+        double max_err = 0.0;
+        for (int i = 0; i < grid_num; i++)
+        {
+            err[i] = ((i <= pass)?1.0:0.0) - gfir_remez_eval(&r, cos(w[i]));
+            if (fabs(err[i]) > max_err) max_err = fabs(err[i]);
+        }
+        converged = max_err - fabs(r.delta) < 1e-6*fabs(r.delta);
+        if (converged) break;
+
+        //the local extrema of the error, the grid ends included
+        int cand[GFIR_MAX_REMEZ_CAND];
+        int count = 0;
+        for (int i = 0; i < grid_num && count < GFIR_MAX_REMEZ_CAND; i++)
+        {
+            const double e = err[i];
+            const double prev = (i == 0)?0.0:err[i-1];
+            const double next = (i == grid_num - 1)?0.0:err[i+1];
+            const bool up = (e > 0.0) && (i == 0 || e >= prev) && (i == grid_num - 1 || e > next);
+            const bool down = (e < 0.0) && (i == 0 || e <= prev) && (i == grid_num - 1 || e < next);
+            if (up || down) cand[count++] = i;
+        }
+        //no better set: a ripple below the double precision of a long filter
+        if (count < num) break;
+
+        //too many: drop the smaller of two extrema of the same sign,
+        //else the smaller end, which keeps the alternation
+        while (count > num)
+        {
+            int drop = (fabs(err[cand[0]]) < fabs(err[cand[count-1]]))?0:(count-1);
+            for (int j = 1; j < count; j++)
+            {
+                if ((err[cand[j]] > 0.0) != (err[cand[j-1]] > 0.0)) continue;
+                drop = (fabs(err[cand[j]]) < fabs(err[cand[j-1]]))?j:(j-1);
+                break;
+            }
+            memmove(cand + drop, cand + drop + 1, (count - drop - 1)*sizeof(int));
+            count--;
+        }
+        memcpy(ext, cand, num*sizeof(int));
+    }
+    free(w);
+    free(err);
+
+    //the taps from the amplitude at n frequencies, a cosine transform
+    for (int i = 0; i < n; i++)
+    {
+        double sum = 0.0;
+        for (int k = 0; k < n; k++)
+        {
+            const double a = gfir_remez_eval(&r, cos(2*M_PI*k/n));
+            sum += a*cos(2*M_PI*k*(i - m)/n);
+        }
+        h[i] = sum/n;
+    }
+    return converged?0:-1;
+}
+
+/***********************************************************************
+ * Predicted response of the quantized taps
+ **********************************************************************/
+double LMS7002M_gfir_response(const LMS7002M_gfir_design_t *design, const double freq)
+{
+    double re = 0.0, im = 0.0;
+    for (int i = 0; i < design->length; i++)
+    {
+        //tap i of the filter is register k*8+j
+        const double h = design->taps[(i/design->bank_len)*8 + i%design->bank_len]/GFIR_TAP_SCALE;
+        re += h*cos(2*M_PI*freq*i);
+        im -= h*sin(2*M_PI*freq*i);
+    }
+    return 10*log10(re*re + im*im + 1e-20);
+}
+
+static void gfir_predict(const LMS7002M_gfir_spec_t *spec, LMS7002M_gfir_design_t *design)
+{
+    const double fp = spec->passband/spec->rate;
+    const double fs = spec->stopband/spec->rate;
+    double pass_min = HUGE_VAL, pass_max = -HUGE_VAL, stop_max = -HUGE_VAL;
+    for (int i = 0; i <= 256; i++)
+    {
+        const double p = LMS7002M_gfir_response(design, fp*i/256);
+        if (p < pass_min) pass_min = p;
+        if (p > pass_max) pass_max = p;
+        const double s = LMS7002M_gfir_response(design, fs + (0.5 - fs)*i/256);
+        if (s > stop_max) stop_max = s;
+    }
+    design->passband_ripple = pass_max - pass_min;
+    design->stopband_atten = -stop_max;
+}
+
+/***********************************************************************
+ * Design and quantize into the bank order
+ **********************************************************************/
+int LMS7002M_gfir_design(const LMS7002M_gfir_spec_t *spec, LMS7002M_gfir_design_t *design)
+{
+    if (spec->which < 1 || spec->which > 3 || spec->ratio < 1) return -1;
+    if (spec->rate <= 0.0 || spec->passband <= 0.0) return -1;
+    if (spec->stopband <= spec->passband || spec->stopband > spec->rate/2) return -1;
+    if (spec->method != LMS7002M_GFIR_KAISER && spec->method != LMS7002M_GFIR_REMEZ) return -1;
+
+    //the filter runs ratio clocks per sample, each clock one tap of every bank
+    const int banks = (spec->which == 3)?15:5;
+    const int bank_len = (spec->ratio < 8)?(int)spec->ratio:8;
+    memset(design, 0, sizeof(*design));
+    design->ntaps = banks*8;
+    design->bank_len = bank_len;
+    design->length = banks*bank_len;
+
+    //the equiripple design is of odd length, the last tap stays 0
+    double h[LMS7002M_GFIR_MAX_TAPS];
+    memset(h, 0, sizeof(h));
+    const double fp = spec->passband/spec->rate;
+    const double fs = spec->stopband/spec->rate;
+    int n = design->length;
+    if (spec->method == LMS7002M_GFIR_REMEZ)
+    {
+        if (n % 2 == 0) n--;
+        if (n < 3 || gfir_remez(n, fp, fs, h) != 0) return -2;
+    }
+    else gfir_kaiser(n, fp, fs, h);
+
+    //unity gain at DC
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += h[i];
+    if (sum == 0.0) return -2;
+
+    //a tap past full scale means a passband too short to hold the gain
+    for (int i = 0; i < design->length; i++)
+    {
+        const long tap = lround(h[i]/sum*GFIR_TAP_SCALE);
+        if (tap > 32767 || tap < -32768) return -2;
+        design->taps[(i/bank_len)*8 + i%bank_len] = (short)tap;
+    }
+
+    gfir_predict(spec, design);
+    return 0;
+}
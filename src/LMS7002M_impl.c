@@ -28,6 +28,7 @@ LMS7002M_t *LMS7002M_create(LMS7002M_spi_transact_t transact, void *handle)
     if (self == NULL) return NULL;
     self->spi_transact = transact;
     self->spi_transact_handle = handle;
+    self->spi_batch = NULL;
     LMS7002M_regs_init(&self->_regs[0]);
     LMS7002M_regs_init(&self->_regs[1]);
     self->regs = self->_regs;
@@ -37,11 +38,36 @@ LMS7002M_t *LMS7002M_create(LMS7002M_spi_transact_t transact, void *handle)
     self->cgen_fref = 0.0;
     self->sxr_fref = 0.0;
     self->sxt_fref = 0.0;
+    self->log_level = (LMS7_log_level_t)0;
+    self->log_handler = NULL;
+    self->log_ring = NULL;
+    self->log_users = 0;
+    self->cal_cache = NULL;
+    self->tdd_stored[0] = false;
+    self->tdd_stored[1] = false;
+    memset(self->cal_tune, 0, sizeof(self->cal_tune));
+    memset(self->cal_tune_next, 0, sizeof(self->cal_tune_next));
+    memset(&self->cal_tune_stats, 0, sizeof(self->cal_tune_stats));
+    memset(self->cal_model, 0, sizeof(self->cal_model));
+    memset(&self->cal_search_stats, 0, sizeof(self->cal_search_stats));
+    self->cal_rssi.num_reads = 4;
+    self->cal_rssi.num_dropped = 1;
+    self->cal_rssi.tolerance = 0.002;
+    self->rssi_monitor = 0;
+    self->rssi_monitor_chab = false;
+    self->iq_cal = NULL;
+    self->iq_cal_num = 0;
+    self->iq_cal_size = 0;
+    memset(self->gfir_known, 0, sizeof(self->gfir_known));
+    self->gfir_verify = false;
     return self;
 }
 
 void LMS7002M_destroy(LMS7002M_t *self)
 {
+    LMS7_log_async_stop(self);
+    LMS7002M_cal_cache_close(self);
+    LMS7002M_iq_cal_clear(self);
     free(self);
 }
 
@@ -64,6 +90,51 @@ int LMS7002M_spi_read(LMS7002M_t *self, const int addr)
     return self->spi_transact(self->spi_transact_handle, data, true/*readback*/) & 0xffff;
 }
 
+void LMS7002M_set_spi_batch(LMS7002M_t *self, LMS7002M_spi_batch_t batch)
+{
+    self->spi_batch = batch;
+}
+
+//words formatted on the stack per call to the batch function
+#define SPI_BATCH_CHUNK 64
+
+void LMS7002M_spi_write_batch(LMS7002M_t *self, const int *addrs, const int *values, const size_t num)
+{
+    if (self->spi_batch == NULL)
+    {
+        for (size_t i = 0; i < num; i++) LMS7002M_spi_write(self, addrs[i], values[i]);
+        return;
+    }
+
+    uint32_t data[SPI_BATCH_CHUNK];
+    for (size_t i = 0; i < num; i += SPI_BATCH_CHUNK)
+    {
+        const size_t n = ((num - i) < SPI_BATCH_CHUNK)?(num - i):SPI_BATCH_CHUNK;
+        for (size_t j = 0; j < n; j++)
+        {
+            data[j] = (((uint32_t)1) << 31) | (((uint32_t)addrs[i+j]) << 16) | (values[i+j] & 0xffff);
+        }
+        self->spi_batch(self->spi_transact_handle, data, n);
+    }
+}
+
+void LMS7002M_regs_update(LMS7002M_t *self, const int *addrs, const int *values, const size_t num)
+{
+    for (size_t i = 0; i < num; i++)
+    {
+        if (addrs[i] == 0x0020)
+        {
+            //the MAC lives in the first bank, like LMS7002M_set_mac_ch()
+            LMS7002M_regs_set(&self->_regs[0], 0x0020, values[i]);
+            self->regs = &self->_regs[(self->_regs[0].reg_0x0020_mac == REG_0X0020_MAC_CHB)?1:0];
+            continue;
+        }
+        const int mac = (addrs[i] < 0x0100)?REG_0X0020_MAC_CHAB:self->_regs[0].reg_0x0020_mac;
+        if ((mac & REG_0X0020_MAC_CHA) != 0) LMS7002M_regs_set(&self->_regs[0], addrs[i], values[i]);
+        if ((mac & REG_0X0020_MAC_CHB) != 0) LMS7002M_regs_set(&self->_regs[1], addrs[i], values[i]);
+    }
+}
+
 void LMS7002M_regs_spi_write(LMS7002M_t *self, const int addr)
 {
     int value = LMS7002M_regs_get(self->regs, addr);
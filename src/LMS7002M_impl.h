@@ -12,6 +12,67 @@
 
 #pragma once
 #include <LMS7002M/LMS7002M.h>
+#include <LMS7002M/LMS7002M_logger.h>
+
+//! Asynchronous logger state (LMS7002M_logger.c)
+struct LMS7_log_ring;
+
+//! Filter calibration cache (LMS7002M_cal_cache.c)
+struct LMS7_cal_cache;
+
+//! Registers held by a TDD profile (LMS7002M_tdd.c)
+#define LMS7_TDD_NUM_REGS 8
+
+/*!
+ * The register deltas written to enter one TDD state.
+ * Bank 0 holds the global and CHA registers, bank 1 the CHB registers.
+ */
+typedef struct
+{
+    int num;
+    int bank[2*LMS7_TDD_NUM_REGS];
+    int addr[2*LMS7_TDD_NUM_REGS];
+    int value[2*LMS7_TDD_NUM_REGS];
+} LMS7002M_tdd_profile_t;
+
+//! Tunes remembered per synthesizer by the filter calibrations
+#define LMS7_CAL_TUNE_MEMO 4
+
+//! Synthesizer registers stored per remembered tune
+#define LMS7_CAL_TUNE_REGS 5
+
+/*!
+ * A synthesizer frequency tuned by a filter calibration
+ * and the synthesizer registers that programmed it.
+ */
+typedef struct
+{
+    bool valid;
+    double fref;
+    double fout;
+    double factual;
+    int values[LMS7_CAL_TUNE_REGS];
+} LMS7002M_cal_tune_t;
+
+//! Registers with a learned calibration search seed
+#define LMS7_CAL_MODEL_SIZE 4
+
+//! The ratio of the code found to the analytic code for a searched register
+typedef struct
+{
+    int addr; //0 when unused
+    double ratio;
+} LMS7002M_cal_model_t;
+
+//! IQ and DC calibration table entries first allocated (LMS7002M_iq_cal.c)
+#define LMS7_IQ_CAL_INIT_SIZE 32
+
+typedef struct
+{
+    LMS7002M_dir_t direction;
+    LMS7002M_chan_t channel;
+    LMS7002M_iq_cal_t cal;
+} LMS7002M_iq_cal_entry_t;
 
 /*!
  * Implementation of the LMS7002M data structure.
@@ -21,6 +82,7 @@ struct LMS7002M_struct
 {
     LMS7002M_spi_transact_t spi_transact;
     void *spi_transact_handle;
+    LMS7002M_spi_batch_t spi_batch; //!< optional batch writer or NULL
 
     //register shadows per channel (actual data)
     LMS7002M_regs_t _regs[2];
@@ -35,4 +97,39 @@ struct LMS7002M_struct
     double cgen_fref; //!< last written CGEN ref frequency in Hz
     double sxr_fref; //!< last written RX ref frequency in Hz
     double sxt_fref; //!< last written TX ref frequency in Hz
+
+    LMS7_log_level_t log_level; //!< instance log level or 0 for the module level
+    LMS7_log_handler_t log_handler; //!< instance log handler or NULL for the module handler
+    struct LMS7_log_ring *log_ring; //!< asynchronous logger or NULL when synchronous, accessed atomically
+    int log_users; //!< threads between loading log_ring and finishing with it
+    struct LMS7_cal_cache *cal_cache; //!< filter calibration cache or NULL when disabled
+
+    //TDD profiles indexed by 0 for TX and 1 for RX
+    int tdd_state[2][2][LMS7_TDD_NUM_REGS]; //!< stored register values per bank
+    bool tdd_stored[2]; //!< the state was stored
+    LMS7002M_tdd_profile_t tdd_profile[2]; //!< deltas from the other state
+
+    //filter calibration tunes indexed by 0 for CGEN, 1 for SXR, 2 for SXT
+    LMS7002M_cal_tune_t cal_tune[3][LMS7_CAL_TUNE_MEMO];
+    int cal_tune_next[3]; //!< replaced next when full
+    LMS7002M_cal_tune_stats_t cal_tune_stats;
+
+    //filter calibration searches
+    LMS7002M_cal_model_t cal_model[2][LMS7_CAL_MODEL_SIZE]; //!< learned seeds per channel
+    LMS7002M_cal_search_stats_t cal_search_stats;
+    LMS7002M_cal_rssi_config_t cal_rssi; //!< RSSI measurement settings
+
+    //RSSI monitor
+    int rssi_monitor; //!< the monitored LMS7002M_chan_t or 0 when stopped
+    bool rssi_monitor_chab; //!< both channels capture with one 0x0400 write
+
+    //IQ and DC calibration results
+    LMS7002M_iq_cal_entry_t *iq_cal; //!< sorted by direction, channel, then frequency
+    size_t iq_cal_num; //!< entries used
+    size_t iq_cal_size; //!< entries allocated
+
+    //GFIR taps indexed by 0 for TX and 1 for RX, the bank, then the filter 1-3 as 0-2
+    short gfir_taps[2][2][3][LMS7002M_GFIR_MAX_TAPS]; //!< taps last written
+    bool gfir_known[2][2][3]; //!< the chip holds the taps in gfir_taps
+    bool gfir_verify; //!< read back the taps after an upload
 };
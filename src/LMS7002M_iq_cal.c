@@ -0,0 +1,287 @@
+///
+/// \file LMS7002M_iq_cal.c
+///
+/// IQ and DC calibration results for the LMS7002M C driver:
+/// the correction register writers and the results stored per frequency.
+///
+/// \copyright
+/// Copyright (c) 2016-2017 Fairwaves, Inc.
+/// Copyright (c) 2016-2016 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include <stdlib.h>
+#include <string.h> //memmove
+#include <math.h>
+#include "LMS7002M_impl.h"
+#include "LMS7002M_filter_cal.h"
+#include <LMS7002M/LMS7002M_logger.h>
+
+/***********************************************************************
+ * Correction registers
+ **********************************************************************/
+//the RFE DC offsets are sign and magnitude
+static int iq_cal_sign_mag(const int value)
+{
+    return (value < 0)?(0x40 | (-value & 0x3f)):(value & 0x3f);
+}
+
+void cal_rx_iq_write_dc(LMS7002M_t *self, const LMS7002M_chan_t channel, const int dc_i, const int dc_q)
+{
+    LMS7002M_set_mac_ch(self, channel);
+    self->regs->reg_0x010e_dcoffi_rfe = iq_cal_sign_mag(dc_i);
+    self->regs->reg_0x010e_dcoffq_rfe = iq_cal_sign_mag(dc_q);
+    LMS7002M_regs_spi_write(self, 0x010e);
+}
+
+void cal_rx_iq_write_iq(LMS7002M_t *self, const LMS7002M_chan_t channel, const int gain, const int phase)
+{
+    LMS7002M_set_mac_ch(self, channel);
+
+    if (self->regs->reg_0x040c_gc_byp != 0 || self->regs->reg_0x040c_ph_byp != 0)
+    {
+        self->regs->reg_0x040c_gc_byp = 0;
+        self->regs->reg_0x040c_ph_byp = 0;
+        LMS7002M_regs_spi_write(self, 0x040c);
+    }
+
+    self->regs->reg_0x0403_iqcorr = phase;
+    self->regs->reg_0x0402_gcorri = (gain < 0)?(2047 + gain):2047;
+    self->regs->reg_0x0401_gcorrq = (gain > 0)?(2047 - gain):2047;
+    LMS7002M_regs_spi_write(self, 0x0403);
+    LMS7002M_regs_spi_write(self, 0x0402);
+    LMS7002M_regs_spi_write(self, 0x0401);
+}
+
+void cal_tx_iq_write_dc(LMS7002M_t *self, const LMS7002M_chan_t channel, const int dc_i, const int dc_q)
+{
+    LMS7002M_set_mac_ch(self, channel);
+
+    if (self->regs->reg_0x0208_dc_byp != 0)
+    {
+        self->regs->reg_0x0208_dc_byp = 0;
+        LMS7002M_regs_spi_write(self, 0x0208);
+    }
+
+    self->regs->reg_0x0204_dccorri = dc_i;
+    self->regs->reg_0x0204_dccorrq = dc_q;
+    LMS7002M_regs_spi_write(self, 0x0204);
+}
+
+void cal_tx_iq_write_iq(LMS7002M_t *self, const LMS7002M_chan_t channel, const int gain, const int phase)
+{
+    LMS7002M_set_mac_ch(self, channel);
+
+    if (self->regs->reg_0x0208_gc_byp != 0 || self->regs->reg_0x0208_ph_byp != 0)
+    {
+        self->regs->reg_0x0208_gc_byp = 0;
+        self->regs->reg_0x0208_ph_byp = 0;
+        LMS7002M_regs_spi_write(self, 0x0208);
+    }
+
+    self->regs->reg_0x0203_iqcorr = phase;
+    self->regs->reg_0x0202_gcorri = (gain < 0)?(2047 + gain):2047;
+    self->regs->reg_0x0201_gcorrq = (gain > 0)?(2047 - gain):2047;
+    LMS7002M_regs_spi_write(self, 0x0203);
+    LMS7002M_regs_spi_write(self, 0x0202);
+    LMS7002M_regs_spi_write(self, 0x0201);
+}
+
+/***********************************************************************
+ * All corrections of a channel in one SPI batch
+ **********************************************************************/
+//set a register of the bank shadow and append it when it changed
+static size_t iq_cal_batch(LMS7002M_regs_t *regs, const int addr, const int old, int *addrs, int *values, size_t num)
+{
+    const int value = LMS7002M_regs_get(regs, addr);
+    if (value == old) return num;
+    addrs[num] = addr;
+    values[num] = value;
+    return num+1;
+}
+
+void LMS7002M_iq_cal_write(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const LMS7002M_iq_cal_t *cal, const bool dc)
+{
+    LMS7002M_regs_t *regs = &self->_regs[(channel == LMS_CHB)?1:0];
+    const int rx_addrs[5] = {0x010e, 0x040c, 0x0403, 0x0402, 0x0401};
+    const int tx_addrs[5] = {0x0204, 0x0208, 0x0203, 0x0202, 0x0201};
+    const int *cal_addrs = (direction == LMS_RX)?rx_addrs:tx_addrs;
+    int old[5];
+    for (int i = 0; i < 5; i++) old[i] = LMS7002M_regs_get(regs, cal_addrs[i]);
+
+    //the identity corrections are bypassed, like the set_*_correction() calls
+    if (direction == LMS_RX)
+    {
+        if (dc)
+        {
+            regs->reg_0x010e_dcoffi_rfe = iq_cal_sign_mag(cal->dc_i);
+            regs->reg_0x010e_dcoffq_rfe = iq_cal_sign_mag(cal->dc_q);
+        }
+        regs->reg_0x040c_gc_byp = (cal->gain == 0)?1:0;
+        regs->reg_0x040c_ph_byp = (cal->phase == 0)?1:0;
+        regs->reg_0x0403_iqcorr = cal->phase;
+        regs->reg_0x0402_gcorri = (cal->gain < 0)?(2047 + cal->gain):2047;
+        regs->reg_0x0401_gcorrq = (cal->gain > 0)?(2047 - cal->gain):2047;
+    }
+    else
+    {
+        if (dc)
+        {
+            regs->reg_0x0204_dccorri = cal->dc_i;
+            regs->reg_0x0204_dccorrq = cal->dc_q;
+            regs->reg_0x0208_dc_byp = (cal->dc_i == 0 && cal->dc_q == 0)?1:0;
+        }
+        regs->reg_0x0208_gc_byp = (cal->gain == 0)?1:0;
+        regs->reg_0x0208_ph_byp = (cal->phase == 0)?1:0;
+        regs->reg_0x0203_iqcorr = cal->phase;
+        regs->reg_0x0202_gcorri = (cal->gain < 0)?(2047 + cal->gain):2047;
+        regs->reg_0x0201_gcorrq = (cal->gain > 0)?(2047 - cal->gain):2047;
+    }
+
+    //MAC must select exactly the bank, CHAB would also write the other one
+    int addrs[6], values[6];
+    size_t num = 0;
+    const int mac = (channel == LMS_CHB)?REG_0X0020_MAC_CHB:REG_0X0020_MAC_CHA;
+    if (self->_regs[0].reg_0x0020_mac != mac)
+    {
+        self->_regs[0].reg_0x0020_mac = mac;
+        addrs[num] = 0x0020;
+        values[num] = LMS7002M_regs_get(&self->_regs[0], 0x0020);
+        num++;
+    }
+    const size_t mac_num = num;
+    for (int i = 0; i < 5; i++) num = iq_cal_batch(regs, cal_addrs[i], old[i], addrs, values, num);
+    self->regs = regs;
+
+    //nothing changed: the MAC write is not needed either
+    if (num == mac_num) return;
+    LMS7002M_spi_write_batch(self, addrs, values, num);
+}
+
+/***********************************************************************
+ * TX tone over the RF loopback into a narrow RSSI
+ **********************************************************************/
+void cal_iq_loopback(LMS7002M_t *self, const LMS7002M_chan_t channel, const double f_tone, const size_t decim, const int agc_avg)
+{
+    //the TxTSP constant shifted by the TX NCO
+    const double txtsp_rate = self->cgen_freq;
+    LMS7002M_txtsp_tsg_const(self, channel, 0x3fff, 0);
+    LMS7002M_txtsp_set_freq(self, channel, f_tone/txtsp_rate);
+
+    LMS7002M_trf_enable_loopback(self, channel, true);
+    LMS7002M_set_mac_ch(self, channel);
+    LMS7002M_rfe_set_path(self, channel, (LMS7002M_regs(self)->reg_0x0103_sel_band1_trf != 0)?LMS7002M_RFE_LB1:LMS7002M_RFE_LB2);
+
+    //the decimation limits the RSSI to the frequency the NCO moves to DC
+    LMS7002M_rxtsp_set_decim(self, channel, decim);
+    LMS7002M_set_mac_ch(self, channel);
+    LMS7002M_regs(self)->reg_0x0400_insel = REG_0X0400_INSEL_LML;
+    LMS7002M_regs(self)->reg_0x040a_agc_avg = agc_avg;
+    LMS7002M_regs(self)->reg_0x040c_dc_byp = 1;
+    LMS7002M_regs(self)->reg_0x040c_gfir3_byp = 1;
+    LMS7002M_regs(self)->reg_0x040c_gfir2_byp = 1;
+    LMS7002M_regs(self)->reg_0x040c_gfir1_byp = 1;
+    LMS7002M_regs_spi_write(self, 0x0400);
+    LMS7002M_regs_spi_write(self, 0x040a);
+    LMS7002M_regs_spi_write(self, 0x040c);
+}
+
+/***********************************************************************
+ * Results per frequency
+ * The table is sorted by direction, channel, then frequency,
+ * so a lookup is a binary search for the two points around it.
+ **********************************************************************/
+//the first entry not before the key
+static size_t iq_cal_lower_bound(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double freq)
+{
+    size_t lo = 0, hi = self->iq_cal_num;
+    while (lo < hi)
+    {
+        const size_t mid = lo + (hi - lo)/2;
+        const LMS7002M_iq_cal_entry_t *e = &self->iq_cal[mid];
+        const bool before = (e->direction != direction)?(e->direction < direction):
+            (e->channel != channel)?(e->channel < channel):(e->cal.freq < freq);
+        if (before) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void cal_iq_store(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const LMS7002M_iq_cal_t *cal)
+{
+    //a new result within 1 Hz replaces the old one
+    size_t i = iq_cal_lower_bound(self, direction, channel, cal->freq - 1.0);
+    LMS7002M_iq_cal_entry_t *e = (i < self->iq_cal_num)?&self->iq_cal[i]:NULL;
+    if (e == NULL || e->direction != direction || e->channel != channel || fabs(e->cal.freq - cal->freq) >= 1.0)
+    {
+        if (self->iq_cal_num == self->iq_cal_size)
+        {
+            const size_t size = (self->iq_cal_size == 0)?LMS7_IQ_CAL_INIT_SIZE:2*self->iq_cal_size;
+            LMS7002M_iq_cal_entry_t *table = (LMS7002M_iq_cal_entry_t *)realloc(self->iq_cal, size*sizeof(LMS7002M_iq_cal_entry_t));
+            if (table == NULL)
+            {
+                LMS7_log(LMS7_ERROR, self, "IQ cal table allocation failed");
+                return;
+            }
+            self->iq_cal = table;
+            self->iq_cal_size = size;
+        }
+        i = iq_cal_lower_bound(self, direction, channel, cal->freq);
+        memmove(&self->iq_cal[i+1], &self->iq_cal[i], (self->iq_cal_num - i)*sizeof(LMS7002M_iq_cal_entry_t));
+        self->iq_cal_num++;
+        e = &self->iq_cal[i];
+    }
+    e->direction = direction;
+    e->channel = channel;
+    e->cal = *cal;
+}
+
+void LMS7002M_iq_cal_clear(LMS7002M_t *self)
+{
+    free(self->iq_cal);
+    self->iq_cal = NULL;
+    self->iq_cal_num = 0;
+    self->iq_cal_size = 0;
+}
+
+int LMS7002M_iq_cal_lookup(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double freq, LMS7002M_iq_cal_t *cal)
+{
+    const size_t first = iq_cal_lower_bound(self, direction, channel, -HUGE_VAL);
+    const size_t last = iq_cal_lower_bound(self, direction, channel, HUGE_VAL);
+    if (first == last) return -1;
+
+    //outside the table the closest end holds
+    const size_t i = iq_cal_lower_bound(self, direction, channel, freq);
+    if (i == first || i == last)
+    {
+        *cal = self->iq_cal[(i == last)?(last-1):first].cal;
+        return 0;
+    }
+
+    //linear between the points around the frequency,
+    //the other fields from the closer point
+    const LMS7002M_iq_cal_t *a = &self->iq_cal[i-1].cal;
+    const LMS7002M_iq_cal_t *b = &self->iq_cal[i].cal;
+    const double t = (freq - a->freq)/(b->freq - a->freq);
+    *cal = (t < 0.5)?*a:*b;
+    cal->freq = freq;
+    cal->dc_i = (int)lround(a->dc_i + t*(b->dc_i - a->dc_i));
+    cal->dc_q = (int)lround(a->dc_q + t*(b->dc_q - a->dc_q));
+    cal->gain = (int)lround(a->gain + t*(b->gain - a->gain));
+    cal->phase = (int)lround(a->phase + t*(b->phase - a->phase));
+    return 0;
+}
+
+int LMS7002M_iq_cal_apply(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double freq, LMS7002M_iq_cal_t *applied)
+{
+    LMS7002M_iq_cal_t cal;
+    if (LMS7002M_iq_cal_lookup(self, direction, channel, freq, &cal) != 0) return -1;
+
+    LMS7002M_iq_cal_write(self, direction, channel, &cal, true);
+
+    LMS7_logf(LMS7_DEBUG, self, "%s IQ cal [%c] applied at %f MHz",
+        (direction == LMS_TX)?"TX":"RX", channel, freq/1e6);
+    if (applied != NULL) *applied = cal;
+    return 0;
+}
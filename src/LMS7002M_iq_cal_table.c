@@ -0,0 +1,185 @@
+///
+/// \file LMS7002M_iq_cal_table.c
+///
+/// IQ and DC calibration tables for the LMS7002M C driver:
+/// a sweep of the on-chip calibrations over a list of frequencies,
+/// and a compact binary file so a restart skips the sweep.
+///
+/// \copyright
+/// Copyright (c) 2016-2017 Fairwaves, Inc.
+/// Copyright (c) 2016-2016 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "LMS7002M_impl.h"
+#include "LMS7002M_filter_cal.h"
+#include <LMS7002M/LMS7002M_logger.h>
+
+//! Bump when the table fields or the cal algorithms change
+#define IQ_CAL_TABLE_VERSION 1
+
+//! Bytes per entry: direction, channel, frequency in Hz, then 4 corrections
+#define IQ_CAL_TABLE_ENTRY_SIZE (1+1+8+4*2)
+
+/***********************************************************************
+ * Sweep the calibrations over a frequency list
+ **********************************************************************/
+int LMS7002M_iq_cal_sweep(LMS7002M_t *self, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const double *freqs, const size_t num)
+{
+    if (direction != LMS_RX && direction != LMS_TX) return -1;
+    const double fref = (direction == LMS_RX)?self->sxr_fref:self->sxt_fref;
+    const double freq = (direction == LMS_RX)?self->sxr_freq:self->sxt_freq;
+    if (fref == 0.0 || freq == 0.0)
+    {
+        LMS7_logf(LMS7_ERROR, self, "IQ cal sweep needs the %s LO tuned", (direction == LMS_RX)?"RX":"TX");
+        return -1;
+    }
+
+    //a failed point is skipped, the table keeps what the rest found
+    int status = 0;
+    for (size_t i = 0; i < num; i++)
+    {
+        int ret = cal_set_lo_freq(self, direction, fref, freqs[i], NULL);
+        if (ret == 0) ret = (direction == LMS_RX)?
+            LMS7002M_rx_iq_calibrate(self, channel, NULL):
+            LMS7002M_tx_iq_calibrate(self, channel, NULL);
+        if (ret == 0) continue;
+        LMS7_logf(LMS7_WARNING, self, "IQ cal sweep: %f MHz failed (%d)", freqs[i]/1e6, ret);
+        status = ret;
+    }
+
+    //back to the LO of the application, with its corrections
+    const int ret = cal_set_lo_freq(self, direction, fref, freq, NULL);
+    if (ret != 0) return ret;
+    for (int c = 0; c < cal_num_chans(channel); c++)
+    {
+        LMS7002M_iq_cal_apply(self, direction, cal_chan(channel, c), freq, NULL);
+    }
+    return status;
+}
+
+/***********************************************************************
+ * File format, little endian: a header "LMS7IQ", the version,
+ * the chip revision register 0x002F, and the entry count,
+ * then the entries as a direction, a channel, the frequency,
+ * and the DC I, DC Q, gain and phase corrections.
+ **********************************************************************/
+static void iq_cal_put(unsigned char *p, const long long value, const int bytes)
+{
+    for (int i = 0; i < bytes; i++) p[i] = (unsigned char)((unsigned long long)value >> (8*i));
+}
+
+static long long iq_cal_get(const unsigned char *p, const int bytes)
+{
+    unsigned long long value = 0;
+    for (int i = 0; i < bytes; i++) value |= (unsigned long long)p[i] << (8*i);
+
+    //sign extend the shorter fields
+    if (bytes < 8 && (value >> (8*bytes-1)) != 0) value |= ~0ULL << (8*bytes);
+    return (long long)value;
+}
+
+int LMS7002M_iq_cal_save(LMS7002M_t *self, const char *path)
+{
+    //write aside and rename so a crash never leaves a partial file
+    const size_t len = strlen(path);
+    char *tmp = (char *)malloc(len + 5);
+    if (tmp == NULL) return -1;
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", 5);
+
+    FILE *p = fopen(tmp, "wb");
+    if (p == NULL)
+    {
+        LMS7_logf(LMS7_WARNING, self, "%s: cannot write IQ cal table", tmp);
+        free(tmp);
+        return -1;
+    }
+
+    unsigned char header[12];
+    memcpy(header, "LMS7IQ", 6);
+    iq_cal_put(header+6, IQ_CAL_TABLE_VERSION, 1);
+    iq_cal_put(header+7, 0, 1);
+    iq_cal_put(header+8, LMS7002M_spi_read(self, 0x002f), 2); //global, read under any MAC
+    iq_cal_put(header+10, (long long)self->iq_cal_num, 2);
+    bool ok = self->iq_cal_num <= 0xffff && fwrite(header, sizeof(header), 1, p) == 1;
+
+    for (size_t n = 0; ok && n < self->iq_cal_num; n++)
+    {
+        const LMS7002M_iq_cal_entry_t *e = &self->iq_cal[n];
+        unsigned char entry[IQ_CAL_TABLE_ENTRY_SIZE];
+        iq_cal_put(entry+0, e->direction, 1);
+        iq_cal_put(entry+1, e->channel, 1);
+        iq_cal_put(entry+2, llround(e->cal.freq), 8);
+        iq_cal_put(entry+10, e->cal.dc_i, 2);
+        iq_cal_put(entry+12, e->cal.dc_q, 2);
+        iq_cal_put(entry+14, e->cal.gain, 2);
+        iq_cal_put(entry+16, e->cal.phase, 2);
+        ok = fwrite(entry, sizeof(entry), 1, p) == 1;
+    }
+
+    ok = (fclose(p) == 0) && ok;
+    const int ret = ok?rename(tmp, path):-1;
+    if (!ok) remove(tmp);
+    free(tmp);
+    return ret;
+}
+
+int LMS7002M_iq_cal_load(LMS7002M_t *self, const char *path)
+{
+    FILE *p = fopen(path, "rb");
+    if (p == NULL) return -1;
+
+    unsigned char header[12];
+    if (fread(header, sizeof(header), 1, p) != 1 || memcmp(header, "LMS7IQ", 6) != 0 ||
+        iq_cal_get(header+6, 1) != IQ_CAL_TABLE_VERSION)
+    {
+        LMS7_logf(LMS7_WARNING, self, "%s: not an IQ cal table v%d, ignored", path, IQ_CAL_TABLE_VERSION);
+        fclose(p);
+        return -1;
+    }
+    const int rev = (int)(iq_cal_get(header+8, 2) & 0xffff);
+    if (rev != LMS7002M_spi_read(self, 0x002f))
+    {
+        LMS7_logf(LMS7_WARNING, self, "%s: IQ cal table for chip revision 0x%04x, ignored", path, rev);
+        fclose(p);
+        return -1;
+    }
+
+    //read everything before replacing the table
+    const size_t num = (size_t)(iq_cal_get(header+10, 2) & 0xffff);
+    unsigned char *entries = (unsigned char *)malloc(num*IQ_CAL_TABLE_ENTRY_SIZE + 1);
+    const bool ok = entries != NULL && fread(entries, IQ_CAL_TABLE_ENTRY_SIZE, num, p) == num;
+    fclose(p);
+    if (!ok)
+    {
+        LMS7_logf(LMS7_WARNING, self, "%s: IQ cal table truncated, ignored", path);
+        free(entries);
+        return -1;
+    }
+
+    LMS7002M_iq_cal_clear(self);
+    for (size_t n = 0; n < num; n++)
+    {
+        const unsigned char *entry = entries + n*IQ_CAL_TABLE_ENTRY_SIZE;
+        const LMS7002M_dir_t direction = (LMS7002M_dir_t)iq_cal_get(entry+0, 1);
+        const LMS7002M_chan_t channel = (LMS7002M_chan_t)iq_cal_get(entry+1, 1);
+        if ((direction != LMS_RX && direction != LMS_TX) || (channel != LMS_CHA && channel != LMS_CHB)) continue;
+        LMS7002M_iq_cal_t cal;
+        memset(&cal, 0, sizeof(cal));
+        cal.freq = (double)iq_cal_get(entry+2, 8);
+        cal.dc_i = (int)iq_cal_get(entry+10, 2);
+        cal.dc_q = (int)iq_cal_get(entry+12, 2);
+        cal.gain = (int)iq_cal_get(entry+14, 2);
+        cal.phase = (int)iq_cal_get(entry+16, 2);
+        cal_iq_store(self, direction, channel, &cal);
+    }
+    free(entries);
+    LMS7_logf(LMS7_DEBUG, self, "%s: %d IQ cal entries", path, (int)self->iq_cal_num);
+    return 0;
+}
@@ -11,6 +11,7 @@
 ///
 
 #include <stdlib.h>
+#include <string.h> //memset
 #include "LMS7002M_impl.h"
 
 void LMS7002M_set_spi_mode(LMS7002M_t *self, const int numWires)
@@ -31,6 +32,9 @@ void LMS7002M_reset(LMS7002M_t *self)
     LMS7002M_spi_write(self, 0x0020, 0x0);
     LMS7002M_regs_spi_write(self, 0x0020);
     LMS7002M_regs_spi_write(self, 0x002E);//must write
+
+    //the next upload writes every tap
+    memset(self->gfir_known, 0, sizeof(self->gfir_known));
 }
 
 void LMS7002M_reset_lml_fifo(LMS7002M_t *self, const LMS7002M_dir_t direction)
@@ -330,6 +334,18 @@ void LMS7002M_set_mac_ch(LMS7002M_t *self, const LMS7002M_chan_t channel)
     self->regs = regs;
 }
 
+int LMS7002M_mac_value(LMS7002M_t *self, const LMS7002M_chan_t channel)
+{
+    LMS7002M_regs_t regs = self->_regs[0];
+    switch (channel)
+    {
+    case LMS_CHA: regs.reg_0x0020_mac = REG_0X0020_MAC_CHA; break;
+    case LMS_CHB: regs.reg_0x0020_mac = REG_0X0020_MAC_CHB; break;
+    case LMS_CHAB: regs.reg_0x0020_mac = REG_0X0020_MAC_CHAB; break;
+    }
+    return LMS7002M_regs_get(&regs, 0x0020);
+}
+
 void LMS7002M_set_mac_dir(LMS7002M_t *self, const LMS7002M_dir_t direction)
 {
     switch (direction)
@@ -384,6 +400,15 @@ void LMS7002M_set_diq_mux(LMS7002M_t *self, const LMS7002M_dir_t direction, cons
     LMS7002M_regs_spi_write(self, 0x0027);
 }
 
+void LMS7002M_set_lml_mimo(LMS7002M_t *self, const bool enable)
+{
+    //LML is in global register space
+    LMS7002M_set_mac_ch(self, LMS_CHAB);
+
+    self->regs->reg_0x002e_mimo_siso = enable?0:1;
+    LMS7002M_regs_spi_write(self, 0x002E);
+}
+
 void LMS7002M_set_jesd207_latency(LMS7002M_t *self, const LMS7002M_dir_t direction, int start, int stop)
 {
     //LML is in global register space
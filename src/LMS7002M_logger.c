@@ -13,8 +13,14 @@
 //TODO ifdef this for printing on other platforms, ex kprintf
 
 #include <LMS7002M/LMS7002M_logger.h>
+#include <LMS7002M/LMS7002M_time.h>
+#include "LMS7002M_impl.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
 
 /***********************************************************************
  * ANSI terminal colors for default logger
@@ -28,6 +34,9 @@
 #define ANSI_COLOR_RESET   "\x1b[0m"
 #define ANSI_COLOR_BOLD    "\x1b[1m"
 
+//messages up to this length are formatted without a heap allocation
+#define LMS7_LOG_MSG_SIZE 512
+
 /***********************************************************************
  * Default log message handler implementation
  **********************************************************************/
@@ -47,30 +56,349 @@ void default_handler(const LMS7_log_level_t level, struct LMS7002M_struct *obj,
     }
 }
 
+/***********************************************************************
+ * Deferred message record
+ *
+ * The producer walks the format string once and copies each argument
+ * by its conversion type; the consumer replays the conversions one at
+ * a time with snprintf. Anything the walker does not understand
+ * (positional or '*' arguments, %n, long double, too many arguments)
+ * is formatted immediately into the record text instead.
+ **********************************************************************/
+#define LMS7_LOG_MAX_ARGS 16
+#define LMS7_LOG_STR_SIZE 192
+
+typedef enum
+{
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_INTMAX,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_PTR,
+    ARG_STR,
+} log_arg_kind_t;
+
+typedef union
+{
+    int i;
+    long l;
+    long long ll;
+    size_t z;
+    intmax_t j;
+    ptrdiff_t t;
+    double d;
+    const void *p;
+    size_t s; //offset into the record string storage
+} log_arg_t;
+
+typedef struct
+{
+    size_t seq; //sequence number: the slot is free at head, filled at head+1
+    LMS7_log_level_t level;
+    const char *format; //NULL when text holds a preformatted message
+    unsigned nargs;
+    unsigned char kinds[LMS7_LOG_MAX_ARGS];
+    log_arg_t args[LMS7_LOG_MAX_ARGS];
+    size_t text_len;
+    char text[LMS7_LOG_STR_SIZE];
+} log_record_t;
+
+struct LMS7_log_ring
+{
+    struct LMS7002M_struct *obj;
+    log_record_t *records;
+    size_t mask;
+    size_t head; //claimed by the producers with a compare and swap
+    size_t tail; //written by the consumer
+    size_t dropped; //incremented by the producers
+    size_t reported; //written by the consumer
+    int running;
+    pthread_t thread;
+};
+
+/*!
+ * Parse a single conversion specification starting at the '%'.
+ * \param spec the position of the '%' character
+ * \param kind the argument kind (output)
+ * \return the length of the specification or 0 when unsupported
+ */
+static size_t log_parse_spec(const char *spec, log_arg_kind_t *kind)
+{
+    const char *p = spec + 1;
+    int len_mod = 0; //0 none, 'H' hh, 'h', 'l', 'q' ll, 'z', 'j', 't', 'L'
+
+    while (*p != '\0' && strchr("-+ #0'", *p) != NULL) p++;
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.')
+    {
+        p++;
+        while (*p >= '0' && *p <= '9') p++;
+    }
+
+    switch (*p)
+    {
+    case 'h': p++; len_mod = 'h'; if (*p == 'h') {p++; len_mod = 'H';} break;
+    case 'l': p++; len_mod = 'l'; if (*p == 'l') {p++; len_mod = 'q';} break;
+    case 'z': case 'j': case 't': case 'L': len_mod = *p++; break;
+    default: break;
+    }
+
+    switch (*p)
+    {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+        switch (len_mod)
+        {
+        case 0: case 'h': case 'H': *kind = ARG_INT; break;
+        case 'l': *kind = ARG_LONG; break;
+        case 'q': *kind = ARG_LLONG; break;
+        case 'z': *kind = ARG_SIZE; break;
+        case 'j': *kind = ARG_INTMAX; break;
+        case 't': *kind = ARG_PTRDIFF; break;
+        default: return 0;
+        }
+        if (*p == 'c' && len_mod != 0) return 0;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        if (len_mod != 0 && len_mod != 'l') return 0;
+        *kind = ARG_DOUBLE;
+        break;
+    case 's':
+        if (len_mod != 0) return 0;
+        *kind = ARG_STR;
+        break;
+    case 'p':
+        if (len_mod != 0) return 0;
+        *kind = ARG_PTR;
+        break;
+    default: return 0; //%n, '*' width, positional and unknown conversions
+    }
+
+    return (size_t)(p - spec) + 1;
+}
+
+/*!
+ * Capture the arguments of a message into the record.
+ * \return true when the record can be formatted later
+ */
+static bool log_capture(log_record_t *rec, const char *format, va_list args)
+{
+    rec->nargs = 0;
+    rec->text_len = 0;
+
+    for (const char *p = format; *p != '\0'; p++)
+    {
+        if (*p != '%') continue;
+        if (p[1] == '%') {p++; continue;}
+
+        log_arg_kind_t kind;
+        const size_t len = log_parse_spec(p, &kind);
+        if (len == 0 || rec->nargs == LMS7_LOG_MAX_ARGS) return false;
+
+        log_arg_t *arg = rec->args + rec->nargs;
+        switch (kind)
+        {
+        case ARG_INT: arg->i = va_arg(args, int); break;
+        case ARG_LONG: arg->l = va_arg(args, long); break;
+        case ARG_LLONG: arg->ll = va_arg(args, long long); break;
+        case ARG_SIZE: arg->z = va_arg(args, size_t); break;
+        case ARG_INTMAX: arg->j = va_arg(args, intmax_t); break;
+        case ARG_PTRDIFF: arg->t = va_arg(args, ptrdiff_t); break;
+        case ARG_DOUBLE: arg->d = va_arg(args, double); break;
+        case ARG_PTR: arg->p = va_arg(args, void *); break;
+        case ARG_STR:
+        {
+            const char *str = va_arg(args, const char *);
+            if (str == NULL) str = "(null)";
+            const size_t n = strlen(str) + 1;
+            if (rec->text_len + n > sizeof(rec->text)) return false;
+            memcpy(rec->text + rec->text_len, str, n);
+            arg->s = rec->text_len;
+            rec->text_len += n;
+        } break;
+        }
+        rec->kinds[rec->nargs++] = (unsigned char)kind;
+        p += len - 1;
+    }
+
+    rec->format = format;
+    return true;
+}
+
+/*!
+ * Replay the captured conversions into the message buffer.
+ */
+static void log_render(const log_record_t *rec, char *out, const size_t size)
+{
+    size_t pos = 0;
+    unsigned argi = 0;
+
+    for (const char *p = rec->format; *p != '\0' && pos + 1 < size;)
+    {
+        if (*p != '%' || p[1] == '%')
+        {
+            out[pos++] = *p;
+            p += (*p == '%')?2:1;
+            continue;
+        }
+
+        log_arg_kind_t kind;
+        char spec[32];
+        const size_t len = log_parse_spec(p, &kind);
+        if (len >= sizeof(spec)) break;
+        memcpy(spec, p, len);
+        spec[len] = '\0';
+        p += len;
+
+        const log_arg_t *arg = rec->args + argi++;
+        char *dst = out + pos;
+        const size_t left = size - pos;
+        int r = 0;
+        switch (kind)
+        {
+        case ARG_INT: r = snprintf(dst, left, spec, arg->i); break;
+        case ARG_LONG: r = snprintf(dst, left, spec, arg->l); break;
+        case ARG_LLONG: r = snprintf(dst, left, spec, arg->ll); break;
+        case ARG_SIZE: r = snprintf(dst, left, spec, arg->z); break;
+        case ARG_INTMAX: r = snprintf(dst, left, spec, arg->j); break;
+        case ARG_PTRDIFF: r = snprintf(dst, left, spec, arg->t); break;
+        case ARG_DOUBLE: r = snprintf(dst, left, spec, arg->d); break;
+        case ARG_PTR: r = snprintf(dst, left, spec, arg->p); break;
+        case ARG_STR: r = snprintf(dst, left, spec, rec->text + arg->s); break;
+        }
+        if (r < 0) break;
+        pos += ((size_t)r < left)?(size_t)r:left-1;
+    }
+    out[pos] = '\0';
+}
+
 /***********************************************************************
  * logging api implementation
  **********************************************************************/
 static LMS7_log_level_t _log_level = LMS7_NOTICE;
 static LMS7_log_handler_t _log_handler = default_handler;
 
+static LMS7_log_level_t log_level_for(struct LMS7002M_struct *obj)
+{
+    if (obj != NULL && obj->log_level != 0) return obj->log_level;
+    return _log_level;
+}
+
+static void log_deliver(const LMS7_log_level_t level, struct LMS7002M_struct *obj, const char *message)
+{
+    if (obj != NULL && obj->log_handler != NULL) obj->log_handler(level, obj, message);
+    else _log_handler(level, obj, message);
+}
+
 void LMS7_set_log_level(const LMS7_log_level_t level)
 {
     _log_level = level;
 }
 
+void LMS7_set_obj_log_level(struct LMS7002M_struct *obj, const LMS7_log_level_t level)
+{
+    obj->log_level = level;
+}
+
 void LMS7_log(const LMS7_log_level_t level, struct LMS7002M_struct *obj, const char *message)
 {
-    if (level > _log_level) return;
-    _log_handler(level, obj, message);
+    if (level > log_level_for(obj)) return;
+    if (obj != NULL && __atomic_load_n(&obj->log_ring, __ATOMIC_SEQ_CST) != NULL)
+    {
+        //route through the ring so ordering with formatted messages is kept
+        LMS7_logf(level, obj, "%s", message);
+        return;
+    }
+    log_deliver(level, obj, message);
+}
+
+static void log_enqueue(struct LMS7_log_ring *ring, const LMS7_log_level_t level, const char *format, va_list args)
+{
+    //claim a slot: several threads may log through the same instance
+    log_record_t *rec;
+    size_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    while (true)
+    {
+        rec = ring->records + (head & ring->mask);
+        const size_t seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+        const ptrdiff_t diff = (ptrdiff_t)(seq - head);
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&ring->head, &head, head+1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        }
+        else if (diff < 0)
+        {
+            //the consumer has not freed this slot yet: the ring is full
+            __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        else head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    }
+
+    rec->level = level;
+
+    va_list capture;
+    va_copy(capture, args);
+    const bool deferred = log_capture(rec, format, capture);
+    va_end(capture);
+
+    //fallback: format now into the record without touching the heap
+    if (!deferred)
+    {
+        rec->format = NULL;
+        vsnprintf(rec->text, sizeof(rec->text), format, args);
+    }
+
+    //publish the record to the consumer
+    __atomic_store_n(&rec->seq, head+1, __ATOMIC_RELEASE);
 }
 
 void LMS7_vlogf(const LMS7_log_level_t level, struct LMS7002M_struct *obj, const char *format, va_list args)
 {
-    if (level > _log_level) return;
-    char *message;
-    vasprintf(&message, format, args);
-    LMS7_log(level, obj, message);
-    free(message);
+    if (level > log_level_for(obj)) return;
+
+    if (obj != NULL)
+    {
+        //announce the use before loading the ring, LMS7_log_async_stop() waits for it
+        __atomic_fetch_add(&obj->log_users, 1, __ATOMIC_SEQ_CST);
+        struct LMS7_log_ring *ring = __atomic_load_n(&obj->log_ring, __ATOMIC_SEQ_CST);
+        if (ring != NULL) log_enqueue(ring, level, format, args);
+        __atomic_fetch_sub(&obj->log_users, 1, __ATOMIC_RELEASE);
+        if (ring != NULL) return;
+    }
+
+    char buff[LMS7_LOG_MSG_SIZE];
+    va_list copy;
+    va_copy(copy, args);
+    const int len = vsnprintf(buff, sizeof(buff), format, copy);
+    va_end(copy);
+
+    //only very long messages need the heap
+    if (len >= (int)sizeof(buff))
+    {
+        char *message;
+        if (vasprintf(&message, format, args) >= 0)
+        {
+            log_deliver(level, obj, message);
+            free(message);
+            return;
+        }
+    }
+    if (len >= 0) log_deliver(level, obj, buff);
+}
+
+#ifdef LMS7_logf
+#undef LMS7_logf
+#endif
+
+void LMS7_logf(const LMS7_log_level_t level, struct LMS7002M_struct *obj, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    LMS7_vlogf(level, obj, format, args);
+    va_end(args);
 }
 
 void LMS7_set_log_handler(const LMS7_log_handler_t handler)
@@ -78,4 +406,102 @@ void LMS7_set_log_handler(const LMS7_log_handler_t handler)
     _log_handler = handler;
 }
 
+void LMS7_set_obj_log_handler(struct LMS7002M_struct *obj, const LMS7_log_handler_t handler)
+{
+    obj->log_handler = handler;
+}
+
+/***********************************************************************
+ * asynchronous delivery
+ **********************************************************************/
+static bool log_drain(struct LMS7_log_ring *ring)
+{
+    char buff[LMS7_LOG_MSG_SIZE];
+    const size_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
 
+    if (dropped != ring->reported)
+    {
+        snprintf(buff, sizeof(buff), "logger dropped %zu messages", dropped - ring->reported);
+        log_deliver(LMS7_WARNING, ring->obj, buff);
+        ring->reported = dropped;
+    }
+
+    //records are delivered in claim order, up to the first one not yet published
+    bool delivered = false;
+    for (size_t tail = ring->tail;; tail++)
+    {
+        log_record_t *rec = ring->records + (tail & ring->mask);
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != tail+1) break;
+        if (rec->format == NULL) log_deliver(rec->level, ring->obj, rec->text);
+        else
+        {
+            log_render(rec, buff, sizeof(buff));
+            log_deliver(rec->level, ring->obj, buff);
+        }
+
+        //free the slot for the producers one lap ahead
+        __atomic_store_n(&rec->seq, tail + ring->mask + 1, __ATOMIC_RELEASE);
+        ring->tail = tail+1;
+        delivered = true;
+    }
+    return delivered;
+}
+
+static void *log_thread(void *arg)
+{
+    struct LMS7_log_ring *ring = (struct LMS7_log_ring *)arg;
+    while (__atomic_load_n(&ring->running, __ATOMIC_ACQUIRE))
+    {
+        //poll so that producers never make a system call
+        if (!log_drain(ring)) LMS7_sleep_for(LMS7_time_tps()/1000);
+    }
+    log_drain(ring);
+    return NULL;
+}
+
+int LMS7_log_async_start(struct LMS7002M_struct *obj, const size_t depth)
+{
+    if (__atomic_load_n(&obj->log_ring, __ATOMIC_SEQ_CST) != NULL) return 0;
+
+    size_t size = 1;
+    while (size < depth) size <<= 1;
+
+    struct LMS7_log_ring *ring = (struct LMS7_log_ring *)calloc(1, sizeof(struct LMS7_log_ring));
+    if (ring == NULL) return -1;
+    ring->records = (log_record_t *)calloc(size, sizeof(log_record_t));
+    if (ring->records == NULL)
+    {
+        free(ring);
+        return -1;
+    }
+    for (size_t i = 0; i < size; i++) ring->records[i].seq = i;
+    ring->obj = obj;
+    ring->mask = size-1;
+    ring->running = 1;
+
+    if (pthread_create(&ring->thread, NULL, log_thread, ring) != 0)
+    {
+        free(ring->records);
+        free(ring);
+        return -1;
+    }
+
+    __atomic_store_n(&obj->log_ring, ring, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+void LMS7_log_async_stop(struct LMS7002M_struct *obj)
+{
+    //unpublish first: new messages take the synchronous path
+    struct LMS7_log_ring *ring = __atomic_exchange_n(&obj->log_ring, NULL, __ATOMIC_SEQ_CST);
+    if (ring == NULL) return;
+
+    //wait out the producers that loaded the ring before, the final drain gets their messages
+    while (__atomic_load_n(&obj->log_users, __ATOMIC_ACQUIRE) != 0) sched_yield();
+
+    __atomic_store_n(&ring->running, 0, __ATOMIC_RELEASE);
+    pthread_join(ring->thread, NULL);
+
+    free(ring->records);
+    free(ring);
+}
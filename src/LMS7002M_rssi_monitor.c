@@ -0,0 +1,175 @@
+///
+/// \file LMS7002M_rssi_monitor.c
+///
+/// Continuous RSSI monitoring for the LMS7002M C driver.
+/// The capture is configured at start, then each sample
+/// only toggles the capture and reads the result.
+/// Each sample checks the configuration against the shadows,
+/// and rewrites it when another call (a calibration) changed it.
+///
+/// \copyright
+/// Copyright (c) 2015-2017 Fairwaves, Inc.
+/// Copyright (c) 2015-2015 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include <stdlib.h>
+#include <math.h>
+#include "LMS7002M_impl.h"
+#include <LMS7002M/LMS7002M_time.h>
+
+//put the RSSI capture configuration of a bank back, writing only what changed
+static void rssi_monitor_config(LMS7002M_t *self, const int bank)
+{
+    LMS7002M_regs_t *regs = &self->_regs[bank];
+    if (regs->reg_0x040c_agc_byp == 0 && regs->reg_0x040a_agc_mode == REG_0X040A_AGC_MODE_RSSI) return;
+    LMS7002M_set_mac_ch(self, (bank == 0)?LMS_CHA:LMS_CHB);
+
+    if (regs->reg_0x040c_agc_byp != 0)
+    {
+        regs->reg_0x040c_agc_byp = 0;
+        LMS7002M_regs_spi_write(self, 0x040c);
+    }
+
+    if (regs->reg_0x040a_agc_mode != REG_0X040A_AGC_MODE_RSSI)
+    {
+        regs->reg_0x040a_agc_mode = REG_0X040A_AGC_MODE_RSSI;
+        LMS7002M_regs_spi_write(self, 0x040a);
+    }
+}
+
+//select the RSSI capture in the shadows, the capture toggle writes 0x0400;
+//MAC CHAB writes 0x0400 of both channels at once,
+//which is only harmless when the rest of the register matches
+static void rssi_monitor_capsel(LMS7002M_t *self)
+{
+    for (int bank = 0; bank < 2; bank++)
+    {
+        if (self->rssi_monitor == ((bank == 0)?LMS_CHB:LMS_CHA)) continue;
+        self->_regs[bank].reg_0x0400_capsel = REG_0X0400_CAPSEL_RSSI;
+        self->_regs[bank].reg_0x0400_capture = 0;
+    }
+    self->rssi_monitor_chab = (self->rssi_monitor == LMS_CHAB) &&
+        LMS7002M_regs_get(&self->_regs[0], 0x0400) == LMS7002M_regs_get(&self->_regs[1], 0x0400);
+}
+
+int LMS7002M_rssi_monitor_start(LMS7002M_t *self, const LMS7002M_chan_t channel)
+{
+    if (channel != LMS_CHA && channel != LMS_CHB && channel != LMS_CHAB) return -1;
+
+    for (int bank = 0; bank < 2; bank++)
+    {
+        if (channel == ((bank == 0)?LMS_CHB:LMS_CHA)) continue;
+        rssi_monitor_config(self, bank);
+        LMS7002M_set_mac_ch(self, (bank == 0)?LMS_CHA:LMS_CHB);
+        self->regs->reg_0x0400_capsel = REG_0X0400_CAPSEL_RSSI;
+        self->regs->reg_0x0400_capture = 0;
+        LMS7002M_regs_spi_write(self, 0x0400);
+    }
+
+    self->rssi_monitor = channel;
+    rssi_monitor_capsel(self);
+    return 0;
+}
+
+void LMS7002M_rssi_monitor_stop(LMS7002M_t *self)
+{
+    self->rssi_monitor = 0;
+    self->rssi_monitor_chab = false;
+}
+
+//append a MAC write unless the shadow already selects mac
+static size_t rssi_monitor_mac(LMS7002M_t *self, const int mac, int *addrs, int *values, size_t num)
+{
+    if (self->_regs[0].reg_0x0020_mac == mac) return num;
+    self->_regs[0].reg_0x0020_mac = mac;
+    addrs[num] = 0x0020;
+    values[num] = LMS7002M_regs_get(&self->_regs[0], 0x0020);
+    return num+1;
+}
+
+//append the capture toggle of a bank, a rising edge latches the RSSI
+static size_t rssi_monitor_capture(LMS7002M_t *self, const int bank, int *addrs, int *values, size_t num)
+{
+    LMS7002M_regs_t *regs = &self->_regs[bank];
+    regs->reg_0x0400_capture = 0;
+    addrs[num] = 0x0400;
+    values[num] = LMS7002M_regs_get(regs, 0x0400);
+    num++;
+    regs->reg_0x0400_capture = 1;
+    addrs[num] = 0x0400;
+    values[num] = LMS7002M_regs_get(regs, 0x0400);
+    return num+1;
+}
+
+int LMS7002M_rssi_monitor_read(LMS7002M_t *self, LMS7002M_rssi_sample_t *sample)
+{
+    if (self->rssi_monitor == 0) return -1;
+    const bool monitored[2] = {self->rssi_monitor != LMS_CHB, self->rssi_monitor != LMS_CHA};
+
+    //revalidate: a calibration may have rewritten the RSSI configuration
+    for (int bank = 0; bank < 2; bank++)
+    {
+        if (monitored[bank]) rssi_monitor_config(self, bank);
+    }
+    rssi_monitor_capsel(self);
+
+    //the capture toggles of all channels in one batch
+    int addrs[6], values[6];
+    size_t num = 0;
+    if (self->rssi_monitor_chab)
+    {
+        num = rssi_monitor_mac(self, REG_0X0020_MAC_CHAB, addrs, values, num);
+        num = rssi_monitor_capture(self, 0, addrs, values, num);
+        self->_regs[1].reg_0x0400_capture = 1;
+    }
+    else for (int bank = 0; bank < 2; bank++)
+    {
+        if (!monitored[bank]) continue;
+        num = rssi_monitor_mac(self, (bank == 0)?REG_0X0020_MAC_CHA:REG_0X0020_MAC_CHB, addrs, values, num);
+        num = rssi_monitor_capture(self, bank, addrs, values, num);
+    }
+    LMS7002M_spi_write_batch(self, addrs, values, num);
+    sample->time = LMS7_time_now();
+
+    for (int bank = 0; bank < 2; bank++)
+    {
+        sample->rssi[bank] = -1;
+        if (!monitored[bank]) continue;
+        if (rssi_monitor_mac(self, (bank == 0)?REG_0X0020_MAC_CHA:REG_0X0020_MAC_CHB, addrs, values, 0) != 0)
+        {
+            LMS7002M_spi_write(self, addrs[0], values[0]);
+        }
+        const int rssi_lo = LMS7002M_spi_read(self, 0x040E);
+        const int rssi_hi = LMS7002M_spi_read(self, 0x040F);
+        sample->rssi[bank] = (rssi_hi << 2) | rssi_lo;
+    }
+
+    //the active shadow follows the MAC left on the chip
+    self->regs = &self->_regs[(self->_regs[0].reg_0x0020_mac == REG_0X0020_MAC_CHB)?1:0];
+    return 0;
+}
+
+int LMS7002M_rssi_monitor_poll(LMS7002M_t *self, const double rate, const size_t num, LMS7002M_rssi_callback_t callback, void *arg)
+{
+    if (self->rssi_monitor == 0 || rate <= 0.0 || callback == NULL) return -1;
+
+    const long long period = llround(LMS7_time_tps()/rate);
+    long long next = LMS7_time_now();
+    size_t count = 0;
+    while (num == 0 || count < num)
+    {
+        //sleep overshoot is taken from the next wait, not added to the schedule
+        const long long wait = next - LMS7_time_now();
+        if (wait > 0) LMS7_sleep_for(wait);
+        else if (-wait > period) next = LMS7_time_now();
+        next += period;
+
+        LMS7002M_rssi_sample_t sample;
+        LMS7002M_rssi_monitor_read(self, &sample);
+        count++;
+        if (!callback(arg, &sample)) break;
+    }
+    return (int)count;
+}
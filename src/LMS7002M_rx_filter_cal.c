@@ -29,7 +29,7 @@ static int setup_rx_cal_tone(LMS7002M_t *self, const LMS7002M_chan_t channel, co
     LMS7002M_set_mac_ch(self, channel);
     const double sxr_freq = self->sxt_freq-bw-sxr_extra_off;
     double sxr_freq_actual = 0;
-    status = LMS7002M_set_lo_freq(self, LMS_RX, self->sxr_fref, sxr_freq, &sxr_freq_actual);
+    status = cal_set_lo_freq(self, LMS_RX, self->sxr_fref, sxr_freq, &sxr_freq_actual);
     LMS7002M_set_mac_ch(self, channel);
     if (status != 0)
     {
@@ -43,112 +43,147 @@ static int setup_rx_cal_tone(LMS7002M_t *self, const LMS7002M_chan_t channel, co
     return status;
 }
 
-typedef enum cal_result {
-    CAL_OK,
-    CAL_LOW,  // coudn't satisfy desired RSSI -- rssi < desired_rssi
-    CAL_HIGH, // coudn't satisfy desired RSSI -- rssi > desired_rssi
-} cal_result_t;
-
 /***********************************************************************
  * Rx calibration loop
+ * The search starts from the analytic code in the register.
+ * With LMS_CHAB the channels probe together:
+ * both are written, then both RSSIs settle during the same sleep.
+ * Channels whose result is already CAL_OK are left alone.
  **********************************************************************/
-static cal_result_t rx_cal_loop_inner(
+static void rx_cal_loop_inner(
         LMS7002M_t *self, const LMS7002M_chan_t channel,
         int *reg_ptr, const int reg_addr, const int reg_max, const char *reg_name,
-        int desired_rssi_value)
+        const int *desired_rssi_value, cal_result_t *result)
 {
-    //--- binary search ----//
-    int rssi_value;
-    int best_lo = -1;
-    int best_hi = -1;
-    int range = (reg_max + 1) / 2;
-    int initial = *reg_ptr;
-
-    *reg_ptr = range;
-    do {
-        LMS7002M_regs_spi_write(self, reg_addr);
-        rssi_value = cal_read_rssi(self, channel);
-
-        LMS7_logf(LMS7_FATAL, self, "RSSI: [%c] %d -- %d (range %d) (val: %d)",
-                  channel,
-                  desired_rssi_value,
-                  rssi_value,
-                  range,
-                  *reg_ptr);
-
-        if (rssi_value < desired_rssi_value) {
-            best_lo = *reg_ptr ;
-            *reg_ptr -= range/2;
-        } else {
-            best_hi = *reg_ptr;
-            *reg_ptr += range/2;
+    const int num = cal_num_chans(channel);
+    cal_search_t search[2];
+    bool active[2] = {false, false};
+    int initial[2] = {0, 0};
+    int rssi_value[2];
+    int pending = 0;
+
+    for (int c = 0; c < num; c++)
+    {
+        if (result[c] == CAL_OK) continue;
+        initial[c] = *cal_chan_field(self, cal_chan(channel, c), reg_ptr);
+        cal_search_init(&search[c], cal_search_seed(self, cal_chan(channel, c), reg_addr, initial[c]),
+                        reg_max, desired_rssi_value[c]);
+        active[c] = true;
+        pending++;
+    }
+
+    while (pending > 0) {
+        for (int c = 0; c < num; c++)
+        {
+            if (!active[c]) continue;
+            LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+            *cal_chan_field(self, cal_chan(channel, c), reg_ptr) = search[c].code;
+            LMS7002M_regs_spi_write(self, reg_addr);
         }
 
-        // TODO check clamping exit conditiohns
-        if (*reg_ptr < 0)
-            *reg_ptr = 0;
-        else if (*reg_ptr > reg_max)
-            *reg_ptr = reg_max;
+        cal_read_rssi_chans(self, channel, rssi_value);
+
+        for (int c = 0; c < num; c++)
+        {
+            if (!active[c]) continue;
+
+            LMS7_logf(LMS7_TRACE, self, "RSSI: [%c] %d -- %d (val: %d)",
+                      cal_chan(channel, c),
+                      desired_rssi_value[c],
+                      rssi_value[c],
+                      search[c].code);
+
+            if (!cal_search_update(self, &search[c], rssi_value[c])) continue;
+            active[c] = false;
+            pending--;
+        }
+    }
 
-        range /= 2;
-    } while (range != 0);
+    for (int c = 0; c < num; c++)
+    {
+        if (result[c] == CAL_OK) continue;
+        const LMS7002M_chan_t ch = cal_chan(channel, c);
 
+        //the result may be the code probed before the last one
+        int *reg = cal_chan_field(self, ch, reg_ptr);
+        if (*reg != search[c].code)
+        {
+            LMS7002M_set_mac_ch(self, ch);
+            *reg = search[c].code;
+            LMS7002M_regs_spi_write(self, reg_addr);
+        }
 
-    LMS7_logf(LMS7_FATAL, self, "RSSI: %d -- %d [%d %d] <= %d",
-              desired_rssi_value,
-              rssi_value, best_lo, best_hi, initial);
+        LMS7_logf(LMS7_DEBUG, self, "RSSI: [%c] %d -- [%d %d] [%d %d] <= %d",
+                  ch, desired_rssi_value[c],
+                  search[c].hi_code, search[c].hi_rssi,
+                  search[c].lo_code, search[c].lo_rssi, initial[c]);
 
-    LMS7_logf(LMS7_DEBUG, self, "%s = %d", reg_name, *reg_ptr);
+        LMS7_logf(LMS7_DEBUG, self, "%s = %d (%d probes)", reg_name, *reg, search[c].probes);
 
-    if (best_lo == -1)
-        return CAL_LOW;
-    else if (best_hi == -1)
-        return CAL_HIGH;
-    return CAL_OK;
+        result[c] = search[c].result;
+        if (result[c] == CAL_OK) cal_search_learn(self, ch, reg_addr, initial[c], *reg);
+    }
 }
 
 static int rx_cal_loop(
         LMS7002M_t *self, const LMS7002M_chan_t channel, const double bw,
         int *reg_ptr, const int reg_addr, const int reg_max, const char *reg_name,
-        int desired_rssi_value)
+        const int *desired_rssi_value)
 {
+    const int num = cal_num_chans(channel);
     LMS7002M_set_mac_ch(self, channel);
 
     int status = setup_rx_cal_tone(self, channel, bw, 50e3);
     if (status != 0) return -1;
 
     //--- calibration ---//
+    cal_result_t cres[2] = {CAL_NONE, CAL_NONE};
+    int analytic[2];
+    for (int c = 0; c < num; c++) analytic[c] = *cal_chan_field(self, cal_chan(channel, c), reg_ptr);
+
     unsigned r_range = 8;
     for (;;) {
-        cal_result_t cres;
-        cres = rx_cal_loop_inner(self, channel, reg_ptr, reg_addr,
-                                 reg_max, reg_name, desired_rssi_value);
-
-        if (cres == CAL_OK) {
-            return 0;
-        } else if (cres == CAL_LOW) {
-            if (LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb == 0 || r_range == 0)
-                return -1;
-            LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb -= r_range;
-        } else if (cres == CAL_HIGH) {
-            if (LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb == 31 || r_range == 0)
-                return -1;
-            LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb += r_range;
-        } else {
-            return  -1;
+        //every search starts over from the analytic code
+        for (int c = 0; c < num; c++)
+        {
+            if (cres[c] != CAL_OK) *cal_chan_field(self, cal_chan(channel, c), reg_ptr) = analytic[c];
         }
 
-        r_range /= 2;
+        rx_cal_loop_inner(self, channel, reg_ptr, reg_addr,
+                          reg_max, reg_name, desired_rssi_value, cres);
 
-        if (LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb < 0)
-            LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = 0;
-        else if (LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb > 31)
-            LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = 31;
-        LMS7002M_regs_spi_write(self, 0x0116);
+        int pending = 0;
+        for (int c = 0; c < num; c++)
+        {
+            if (cres[c] == CAL_OK) continue;
+            LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+
+            if (cres[c] == CAL_LOW) {
+                if (LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb == 0 || r_range == 0)
+                    return -1;
+                LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb -= r_range;
+            } else if (cres[c] == CAL_HIGH) {
+                if (LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb == 31 || r_range == 0)
+                    return -1;
+                LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb += r_range;
+            } else {
+                return  -1;
+            }
+
+            if (LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb < 0)
+                LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = 0;
+            else if (LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb > 31)
+                LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = 31;
+            LMS7002M_regs_spi_write(self, 0x0116);
+
+            LMS7_logf(LMS7_DEBUG, self, "%s R: [%c] %d",
+                      reg_name, cal_chan(channel, c),
+                      LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb);
+            pending++;
+        }
 
-        LMS7_logf(LMS7_ERROR, self, "%s R: %d",
-                  reg_name,
-                  LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb);
+        if (pending == 0) return 0;
+        r_range /= 2;
     }
 }
 
@@ -232,7 +267,7 @@ static int rx_cal_init(LMS7002M_t *self, const LMS7002M_chan_t channel)
 
     //--- sxt ---
     const double sxt_freq = 550e6;
-    status = LMS7002M_set_lo_freq(self, LMS_TX, self->sxt_fref, sxt_freq, NULL);
+    status = cal_set_lo_freq(self, LMS_TX, self->sxt_fref, sxt_freq, NULL);
     LMS7002M_set_mac_ch(self, channel);
     if (status != 0)
     {
@@ -274,8 +309,8 @@ static int rx_cal_init(LMS7002M_t *self, const LMS7002M_chan_t channel)
 /***********************************************************************
  * Perform RFE TIA filter calibration [0.5; 54] Mhz IF
  **********************************************************************/
-static int rx_cal_tia_rfe(LMS7002M_t *self, const LMS7002M_chan_t channel,
-                          const double bw, int rssi_value_50k)
+static int rx_cal_tia_rfe_setup(LMS7002M_t *self, const LMS7002M_chan_t channel,
+                                const double bw)
 {
     int status = 0;
     LMS7002M_set_mac_ch(self, channel);
@@ -323,24 +358,43 @@ static int rx_cal_tia_rfe(LMS7002M_t *self, const LMS7002M_chan_t channel,
     if (bw <= 0.5e6) {
         LMS7002M_regs(self)->reg_0x0112_cfb_tia_rfe = 4095;
         LMS7002M_regs_spi_write(self, 0x0112);
-        goto done;
     }
     else if (bw > 54e6) {
         LMS7002M_regs(self)->reg_0x0112_ccomp_tia_rfe = 0;
         LMS7002M_regs(self)->reg_0x0112_cfb_tia_rfe = 0;
         LMS7002M_regs_spi_write(self, 0x0112);
-        goto done;
     }
 
+    done:
+    return status;
+}
+
+static int rx_cal_tia_rfe(LMS7002M_t *self, const LMS7002M_chan_t channel,
+                          const double bw, const int *rssi_value_50k)
+{
+    const int num = cal_num_chans(channel);
+    int desired_rssi_value[2];
+    int status = 0;
+
+    for (int c = 0; c < num; c++)
+    {
+        status = rx_cal_tia_rfe_setup(self, cal_chan(channel, c), bw);
+        if (status != 0) return status;
+        desired_rssi_value[c] = (int)(rssi_value_50k[c]*0.7071);
+    }
+
+    //fixed settings at the ends of the range
+    if (bw <= 0.5e6 || bw > 54e6) return 0;
+
     status = setup_rx_cal_tone(self, channel, bw, 50e3);
     if (status != 0) return -1;
 
     //--- calibration ---//
+    cal_result_t cres[2] = {CAL_NONE, CAL_NONE};
     rx_cal_loop_inner(self, channel,
         &LMS7002M_regs(self)->reg_0x0112_cfb_tia_rfe,
-        0x0112, 4095, "cfb_tia_rfe", (int)(rssi_value_50k*0.7071));
+        0x0112, 4095, "cfb_tia_rfe", desired_rssi_value, cres);
 
-    done:
     return status;
 }
 
@@ -348,13 +402,13 @@ static int rx_cal_tia_rfe(LMS7002M_t *self, const LMS7002M_chan_t channel,
  * Perform RBB LPFL filter calibration
  **********************************************************************/
 static int rx_cal_rbb_lpfl(LMS7002M_t *self, const LMS7002M_chan_t channel,
-                           const double bw, int rssi_value_50k)
+                           const double bw, const int *rssi_value_50k)
 {
+    const int num = cal_num_chans(channel);
+    int desired_rssi_value[2];
     int rcc_ctl_lpfl_rbb = 0;
-    LMS7002M_set_mac_ch(self, channel);
 
     //--- c_ctl_lpfl_rbb, rcc_ctl_lpfl_rbb ---//
-    LMS7002M_regs(self)->reg_0x0117_c_ctl_lpfl_rbb = (int)(2160e6/bw - 103);
     if      (bw > 15e6)  rcc_ctl_lpfl_rbb = 5;
     else if (bw > 10e6)  rcc_ctl_lpfl_rbb = 4;
     else if (bw > 5e6)   rcc_ctl_lpfl_rbb = 3;
@@ -362,15 +416,28 @@ static int rx_cal_rbb_lpfl(LMS7002M_t *self, const LMS7002M_chan_t channel,
     else if (bw > 1.4e6) rcc_ctl_lpfl_rbb = 1;
     else                 rcc_ctl_lpfl_rbb = 0;
 
-    LMS7002M_regs(self)->reg_0x0115_pd_lpfh_rbb = 1;
-    LMS7002M_regs(self)->reg_0x0115_pd_lpfl_rbb = 0; // power up LPFL block
-    LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = 16;
-    LMS7002M_regs(self)->reg_0x0117_rcc_ctl_lpfl_rbb = rcc_ctl_lpfl_rbb;
-    LMS7002M_regs(self)->reg_0x0118_input_ctl_pga_rbb = 0;
-    LMS7002M_regs_spi_write(self, 0x0115);
-    LMS7002M_regs_spi_write(self, 0x0116);
-    LMS7002M_regs_spi_write(self, 0x0117);
-    LMS7002M_regs_spi_write(self, 0x0118);
+    for (int c = 0; c < num; c++)
+    {
+        LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+        LMS7002M_regs(self)->reg_0x0117_c_ctl_lpfl_rbb = (int)(2160e6/bw - 103);
+        LMS7002M_regs(self)->reg_0x0115_pd_lpfh_rbb = 1;
+        LMS7002M_regs(self)->reg_0x0115_pd_lpfl_rbb = 0; // power up LPFL block
+        LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = 16;
+        LMS7002M_regs(self)->reg_0x0117_rcc_ctl_lpfl_rbb = rcc_ctl_lpfl_rbb;
+        LMS7002M_regs(self)->reg_0x0118_input_ctl_pga_rbb = 0;
+
+        if (bw <= 0.5e6) {
+            // No need to tune set the best possible filtration
+            LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = 0;
+            LMS7002M_regs(self)->reg_0x0117_c_ctl_lpfl_rbb = 2047;
+        }
+
+        LMS7002M_regs_spi_write(self, 0x0115);
+        LMS7002M_regs_spi_write(self, 0x0116);
+        LMS7002M_regs_spi_write(self, 0x0117);
+        LMS7002M_regs_spi_write(self, 0x0118);
+        desired_rssi_value[c] = (int)(rssi_value_50k[c]*0.7071);
+    }
 
 #if 0
     //--- tia rfe registers ---//
@@ -383,27 +450,22 @@ static int rx_cal_rbb_lpfl(LMS7002M_t *self, const LMS7002M_chan_t channel,
     LMS7002M_regs_spi_write(self, 0x0114);
 #endif
 
-    if (bw <= 0.5e6) {
-        // No need to tune set the best possible filtration
-        LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = 0;
-        LMS7002M_regs(self)->reg_0x0117_c_ctl_lpfl_rbb = 2047;
-        LMS7002M_regs_spi_write(self, 0x0116);
-        LMS7002M_regs_spi_write(self, 0x0117);
-        return 0;
-    }
+    if (bw <= 0.5e6) return 0;
 
     return rx_cal_loop(self, channel, bw,
                        &LMS7002M_regs(self)->reg_0x0117_c_ctl_lpfl_rbb,
-                       0x0117, 2047, "c_ctl_lpfl_rbb", (int)(rssi_value_50k*0.7071));
+                       0x0117, 2047, "c_ctl_lpfl_rbb", desired_rssi_value);
 }
 
 /***********************************************************************
  * Perform RBB LPFH filter calibration
  **********************************************************************/
 static int rx_cal_rbb_lpfh(LMS7002M_t *self, const LMS7002M_chan_t channel,
-                           const double bw, int rssi_value_50k)
+                           const double bw)
 {
-    LMS7002M_set_mac_ch(self, channel);
+    const int num = cal_num_chans(channel);
+    int rssi_value_50k[2];
+    int desired_rssi_value[2];
 
     //--- check filter bounds ---//
     if (bw < 20e6 || bw > 130e6)
@@ -413,46 +475,96 @@ static int rx_cal_rbb_lpfh(LMS7002M_t *self, const LMS7002M_chan_t channel,
     }
 
     //--- c_ctl_lpfl_rbb, rcc_ctl_lpfl_rbb ---//
-    LMS7002M_regs(self)->reg_0x0116_c_ctl_lpfh_rbb = (int)(6000e6/bw - 50);
     int rcc_ctl_lpfh_rbb = (int)(bw/10e6 - 3);
     if (rcc_ctl_lpfh_rbb < 0) rcc_ctl_lpfh_rbb = 0;
-    LMS7002M_regs(self)->reg_0x0116_rcc_ctl_lpfh_rbb = rcc_ctl_lpfh_rbb;
-    LMS7002M_regs_spi_write(self, 0x0116);
 
-    //--- tia rfe registers and rbb ---//
+    for (int c = 0; c < num; c++)
+    {
+        LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+        LMS7002M_regs(self)->reg_0x0116_c_ctl_lpfh_rbb = (int)(6000e6/bw - 50);
+        LMS7002M_regs(self)->reg_0x0116_rcc_ctl_lpfh_rbb = rcc_ctl_lpfh_rbb;
+
+        //--- tia rfe registers and rbb ---//
 #if 0
-    LMS7002M_regs(self)->reg_0x0112_cfb_tia_rfe = 15;
-    LMS7002M_regs(self)->reg_0x0112_ccomp_tia_rfe = 1;
-    LMS7002M_regs(self)->reg_0x0114_rcomp_tia_rfe = 15;
-    LMS7002M_regs(self)->reg_0x0113_g_tia_rfe = 1;
+        LMS7002M_regs(self)->reg_0x0112_cfb_tia_rfe = 15;
+        LMS7002M_regs(self)->reg_0x0112_ccomp_tia_rfe = 1;
+        LMS7002M_regs(self)->reg_0x0114_rcomp_tia_rfe = 15;
+        LMS7002M_regs(self)->reg_0x0113_g_tia_rfe = 1;
 #endif
-    LMS7002M_regs(self)->reg_0x0115_pd_lpfh_rbb = 0;
-	LMS7002M_regs(self)->reg_0x0115_pd_lpfl_rbb = 1;
-    LMS7002M_regs(self)->reg_0x0118_input_ctl_pga_rbb = 1;
+        LMS7002M_regs(self)->reg_0x0115_pd_lpfh_rbb = 0;
+        LMS7002M_regs(self)->reg_0x0115_pd_lpfl_rbb = 1;
+        LMS7002M_regs(self)->reg_0x0118_input_ctl_pga_rbb = 1;
 #if 0
-    LMS7002M_regs_spi_write(self, 0x0112);
-    LMS7002M_regs_spi_write(self, 0x0113);
-    LMS7002M_regs_spi_write(self, 0x0114);
+        LMS7002M_regs_spi_write(self, 0x0112);
+        LMS7002M_regs_spi_write(self, 0x0113);
+        LMS7002M_regs_spi_write(self, 0x0114);
 #endif
-    LMS7002M_regs_spi_write(self, 0x0115);
-    LMS7002M_regs_spi_write(self, 0x0118);
+        LMS7002M_regs_spi_write(self, 0x0115);
+        LMS7002M_regs_spi_write(self, 0x0118);
 
-    LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = 16;
-    LMS7002M_regs_spi_write(self, 0x0116);
+        LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = 16;
+        LMS7002M_regs_spi_write(self, 0x0116);
+    }
 
     // CHECK ME!!
     int status = setup_rx_cal_tone(self, channel, 4e5, 1e5);
     if (status != 0) return status;
 
-    rssi_value_50k = cal_gain_selection(self, channel, 0x05000);
+    cal_gain_selection(self, channel, 0x05000, rssi_value_50k);
 
-    LMS7_logf(LMS7_ERROR, self, "LPFH ini %d C=%d", rssi_value_50k,
-              LMS7002M_regs(self)->reg_0x0116_c_ctl_lpfh_rbb);
+    for (int c = 0; c < num; c++)
+    {
+        LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+        LMS7_logf(LMS7_DEBUG, self, "LPFH ini [%c] %d C=%d", cal_chan(channel, c), rssi_value_50k[c],
+                  LMS7002M_regs(self)->reg_0x0116_c_ctl_lpfh_rbb);
+        desired_rssi_value[c] = (int)(rssi_value_50k[c]*0.7071);
+    }
 
     //--- calibration ---//
     return rx_cal_loop(self, channel, bw,
                        &LMS7002M_regs(self)->reg_0x0116_c_ctl_lpfh_rbb,
-                       0x0116, 255, "c_ctl_lpfl_rbb", (int)(rssi_value_50k*0.7071));
+                       0x0116, 255, "c_ctl_lpfl_rbb", desired_rssi_value);
+}
+
+/***********************************************************************
+ * Apply the results of a calibration or of the cache
+ **********************************************************************/
+#define RX_CAL_NUM_VALUES 8
+
+static void rx_cal_apply(LMS7002M_t *self, const LMS7002M_chan_t channel, const int path, const int *cal_values)
+{
+    ////////////////////////////////////////////////////////////////////
+    // apply tia calibration results
+    ////////////////////////////////////////////////////////////////////
+    LMS7002M_set_mac_ch(self, channel);
+    LMS7002M_regs(self)->reg_0x010f_ict_tiamain_rfe = 2;
+    LMS7002M_regs(self)->reg_0x010f_ict_tiaout_rfe = 2;
+    LMS7002M_regs(self)->reg_0x0114_rfb_tia_rfe = 16;
+    LMS7002M_regs(self)->reg_0x0112_cfb_tia_rfe = cal_values[0];
+    LMS7002M_regs(self)->reg_0x0112_ccomp_tia_rfe = cal_values[1];
+    LMS7002M_regs(self)->reg_0x0114_rcomp_tia_rfe = cal_values[2];
+    LMS7002M_regs_spi_write(self, 0x010f);
+    LMS7002M_regs_spi_write(self, 0x0114);
+    LMS7002M_regs_spi_write(self, 0x0112);
+
+    ////////////////////////////////////////////////////////////////////
+    // apply rbb calibration results
+    ////////////////////////////////////////////////////////////////////
+    LMS7002M_regs(self)->reg_0x0117_rcc_ctl_lpfl_rbb = cal_values[3];
+    LMS7002M_regs(self)->reg_0x0117_c_ctl_lpfl_rbb = cal_values[4];
+    LMS7002M_regs(self)->reg_0x0116_rcc_ctl_lpfh_rbb = cal_values[5];
+    LMS7002M_regs(self)->reg_0x0116_c_ctl_lpfh_rbb = cal_values[6];
+    LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = cal_values[7];
+    LMS7002M_regs(self)->reg_0x0119_ict_pga_out_rbb = 20;
+    LMS7002M_regs(self)->reg_0x0119_ict_pga_in_rbb = 20;
+    LMS7002M_regs_spi_write(self, 0x0117);
+    LMS7002M_regs_spi_write(self, 0x0119);
+    LMS7002M_regs_spi_write(self, 0x0116);
+
+    ////////////////////////////////////////////////////////////////////
+    // set the filter selection
+    ////////////////////////////////////////////////////////////////////
+    LMS7002M_rbb_set_path(self, channel, path);
 }
 
 /***********************************************************************
@@ -483,6 +595,24 @@ int LMS7002M_rbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel,
         return -1;
     }
 
+    ////////////////////////////////////////////////////////////////////
+    // Cached results: no calibration needed
+    // with LMS_CHAB both channels calibrate unless both are cached
+    ////////////////////////////////////////////////////////////////////
+    const int num = cal_num_chans(channel);
+    int cal_values[2][RX_CAL_NUM_VALUES];
+    int hits = 0;
+    for (int c = 0; c < num; c++)
+    {
+        if (cal_cache_lookup(self, LMS_RX, cal_chan(channel, c), rfbw, cal_values[c], RX_CAL_NUM_VALUES) == 0) hits++;
+    }
+    if (hits == num)
+    {
+        for (int c = 0; c < num; c++) rx_cal_apply(self, cal_chan(channel, c), path, cal_values[c]);
+        if (bwactual != NULL) *bwactual = bw;
+        return 0;
+    }
+
     ////////////////////////////////////////////////////////////////////
     // Save register map
     ////////////////////////////////////////////////////////////////////
@@ -494,7 +624,8 @@ int LMS7002M_rbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel,
     ////////////////////////////////////////////////////////////////////
 
     const uint16_t saturation_level = 0x05000; //-3dBFS
-    int rssi_value_50k;
+    int rssi_value_50k[2];
+    int rssi_value_tia[2];
 
     if (bw > 0.5e6) {
         status = cal_setup_cgen(self, bw);
@@ -515,6 +646,8 @@ int LMS7002M_rbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel,
         }
      }
 
+     //same settings for all channels, LMS_CHAB writes both
+     LMS7002M_set_mac_ch(self, channel);
      LMS7002M_regs(self)->reg_0x0112_cfb_tia_rfe = 1;
      LMS7002M_regs(self)->reg_0x0112_ccomp_tia_rfe = 0;
      LMS7002M_regs(self)->reg_0x0114_rcomp_tia_rfe = 15;
@@ -530,15 +663,16 @@ int LMS7002M_rbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel,
         status = setup_rx_cal_tone(self, channel, 4e5, 1e5);
         if (status != 0) goto done;
 
-        rssi_value_50k = cal_gain_selection(self, channel, saturation_level);
+        cal_gain_selection(self, channel, saturation_level, rssi_value_50k);
     } else {
-        rssi_value_50k = saturation_level;
+        rssi_value_50k[0] = rssi_value_50k[1] = saturation_level;
     }
 
     ////////////////////////////////////////////////////////////////////
     // RFE TIA calibration
     ////////////////////////////////////////////////////////////////////
-    status = rx_cal_tia_rfe(self, channel, bw, rssi_value_50k * 1.26);
+    for (int c = 0; c < num; c++) rssi_value_tia[c] = (int)(rssi_value_50k[c] * 1.26);
+    status = rx_cal_tia_rfe(self, channel, bw, rssi_value_tia);
     if (status != 0)
     {
         LMS7_log(LMS7_ERROR, self, "rx_cal_tia_rfe() failed");
@@ -548,7 +682,7 @@ int LMS7002M_rbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel,
     // RBB LPF calibration
     ////////////////////////////////////////////////////////////////////
     if (path == LMS7002M_RBB_LBF) status = rx_cal_rbb_lpfl(self, channel, bw, rssi_value_50k);
-    if (path == LMS7002M_RBB_HBF) status = rx_cal_rbb_lpfh(self, channel, bw, rssi_value_50k);
+    if (path == LMS7002M_RBB_HBF) status = rx_cal_rbb_lpfh(self, channel, bw);
     if (status != 0)
     {
         LMS7_log(LMS7_ERROR, self, "rx_cal_rbb_lpf() failed");
@@ -560,15 +694,18 @@ int LMS7002M_rbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel,
     ////////////////////////////////////////////////////////////////////
     // stash tia + rbb calibration results
     ////////////////////////////////////////////////////////////////////
-    LMS7002M_set_mac_ch(self, channel);
-    const int cfb_tia_rfe = LMS7002M_regs(self)->reg_0x0112_cfb_tia_rfe;
-    const int ccomp_tia_rfe = LMS7002M_regs(self)->reg_0x0112_ccomp_tia_rfe;
-    const int rcomp_tia_rfe = LMS7002M_regs(self)->reg_0x0114_rcomp_tia_rfe;
-    const int rcc_ctl_lpfl_rbb = LMS7002M_regs(self)->reg_0x0117_rcc_ctl_lpfl_rbb;
-    const int c_ctl_lpfl_rbb = LMS7002M_regs(self)->reg_0x0117_c_ctl_lpfl_rbb;
-    const int rcc_ctl_lpfh_rbb = LMS7002M_regs(self)->reg_0x0116_rcc_ctl_lpfh_rbb;
-    const int c_ctl_lpfh_rbb = LMS7002M_regs(self)->reg_0x0116_c_ctl_lpfh_rbb;
-    const int r_ctl_lpf_rbb = LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb;
+    for (int c = 0; c < num; c++)
+    {
+        LMS7002M_set_mac_ch(self, cal_chan(channel, c));
+        cal_values[c][0] = LMS7002M_regs(self)->reg_0x0112_cfb_tia_rfe;
+        cal_values[c][1] = LMS7002M_regs(self)->reg_0x0112_ccomp_tia_rfe;
+        cal_values[c][2] = LMS7002M_regs(self)->reg_0x0114_rcomp_tia_rfe;
+        cal_values[c][3] = LMS7002M_regs(self)->reg_0x0117_rcc_ctl_lpfl_rbb;
+        cal_values[c][4] = LMS7002M_regs(self)->reg_0x0117_c_ctl_lpfl_rbb;
+        cal_values[c][5] = LMS7002M_regs(self)->reg_0x0116_rcc_ctl_lpfh_rbb;
+        cal_values[c][6] = LMS7002M_regs(self)->reg_0x0116_c_ctl_lpfh_rbb;
+        cal_values[c][7] = LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb;
+    }
 
     ////////////////////////////////////////////////////////////////////
     // restore original register values
@@ -577,38 +714,11 @@ int LMS7002M_rbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel,
     LMS7002M_regs_to_rfic(self);
     LMS7002M_set_mac_ch(self, channel);
 
-    ////////////////////////////////////////////////////////////////////
-    // apply tia calibration results
-    ////////////////////////////////////////////////////////////////////
-    LMS7002M_set_mac_ch(self, channel);
-    LMS7002M_regs(self)->reg_0x010f_ict_tiamain_rfe = 2;
-    LMS7002M_regs(self)->reg_0x010f_ict_tiaout_rfe = 2;
-    LMS7002M_regs(self)->reg_0x0114_rfb_tia_rfe = 16;
-    LMS7002M_regs(self)->reg_0x0112_cfb_tia_rfe = cfb_tia_rfe;
-    LMS7002M_regs(self)->reg_0x0112_ccomp_tia_rfe = ccomp_tia_rfe;
-    LMS7002M_regs(self)->reg_0x0114_rcomp_tia_rfe = rcomp_tia_rfe;
-    LMS7002M_regs_spi_write(self, 0x010f);
-    LMS7002M_regs_spi_write(self, 0x0114);
-    LMS7002M_regs_spi_write(self, 0x0112);
-
-    ////////////////////////////////////////////////////////////////////
-    // apply rbb calibration results
-    ////////////////////////////////////////////////////////////////////
-    LMS7002M_regs(self)->reg_0x0117_rcc_ctl_lpfl_rbb = rcc_ctl_lpfl_rbb;
-    LMS7002M_regs(self)->reg_0x0117_c_ctl_lpfl_rbb = c_ctl_lpfl_rbb;
-    LMS7002M_regs(self)->reg_0x0116_rcc_ctl_lpfh_rbb = rcc_ctl_lpfh_rbb;
-    LMS7002M_regs(self)->reg_0x0116_c_ctl_lpfh_rbb = c_ctl_lpfh_rbb;
-    LMS7002M_regs(self)->reg_0x0116_r_ctl_lpf_rbb = r_ctl_lpf_rbb;
-    LMS7002M_regs(self)->reg_0x0119_ict_pga_out_rbb = 20;
-    LMS7002M_regs(self)->reg_0x0119_ict_pga_in_rbb = 20;
-    LMS7002M_regs_spi_write(self, 0x0117);
-    LMS7002M_regs_spi_write(self, 0x0119);
-    LMS7002M_regs_spi_write(self, 0x0116);
-
-    ////////////////////////////////////////////////////////////////////
-    // set the filter selection
-    ////////////////////////////////////////////////////////////////////
-    LMS7002M_rbb_set_path(self, channel, path);
+    for (int c = 0; c < num; c++)
+    {
+        rx_cal_apply(self, cal_chan(channel, c), path, cal_values[c]);
+        if (status == 0) cal_cache_store(self, LMS_RX, cal_chan(channel, c), rfbw, cal_values[c], RX_CAL_NUM_VALUES);
+    }
 
     if (bwactual != NULL) *bwactual = bw;
     return status;
@@ -0,0 +1,175 @@
+///
+/// \file LMS7002M_rx_iq_cal.c
+///
+/// Rx DC offset and IQ imbalance calibration for the LMS7002M C driver.
+///
+/// \copyright
+/// Copyright (c) 2016-2017 Fairwaves, Inc.
+/// Copyright (c) 2016-2016 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include <string.h> //memcpy
+#include "LMS7002M_impl.h"
+#include "LMS7002M_filter_cal.h"
+#include <LMS7002M/LMS7002M_logger.h>
+#include <LMS7002M/LMS7002M_time.h>
+
+//! The weakest loopback tone RSSI to calibrate with
+#define RX_IQ_CAL_MIN_TONE 0x100
+
+//! The most RSSI measurements per search
+#define RX_IQ_CAL_MAX_PROBES 64
+
+/***********************************************************************
+ * Cost functions: the RSSI at the frequency the NCO moves to DC
+ **********************************************************************/
+static int rx_iq_cal_dc_cost(LMS7002M_t *self, void *arg, const int *x)
+{
+    const LMS7002M_chan_t channel = *(const LMS7002M_chan_t *)arg;
+    cal_rx_iq_write_dc(self, channel, x[0], x[1]);
+    return cal_read_rssi(self, channel);
+}
+
+static int rx_iq_cal_image_cost(LMS7002M_t *self, void *arg, const int *x)
+{
+    const LMS7002M_chan_t channel = *(const LMS7002M_chan_t *)arg;
+    cal_rx_iq_write_iq(self, channel, x[0], x[1]);
+    return cal_read_rssi(self, channel);
+}
+
+/***********************************************************************
+ * Loopback tone setup
+ * The TX tone is at SXT + f_tone, with SXT at SXR + f_off,
+ * so that the RX sees the tone at f_off + f_tone, the TX LO leakage
+ * at f_off and the TX image at f_off - f_tone: the RX images of these
+ * stay clear of the image of the tone after the decimation by 32.
+ **********************************************************************/
+static int rx_iq_cal_setup(LMS7002M_t *self, const LMS7002M_chan_t channel, double *f_rx)
+{
+    const double rxtsp_rate = self->cgen_freq/4;
+    const double f_tone = rxtsp_rate/64;
+    const double f_off = rxtsp_rate/32;
+
+    LMS7002M_sxx_enable(self, LMS_TX, true);
+    LMS7002M_sxt_to_sxr(self, false);
+    double sxt_actual = 0.0;
+    const int status = cal_set_lo_freq(self, LMS_TX, self->sxt_fref, self->sxr_freq+f_off, &sxt_actual);
+    if (status != 0)
+    {
+        LMS7_logf(LMS7_ERROR, self, "LMS7002M_set_lo_freq(LMS_TX, %f MHz)", (self->sxr_freq+f_off)/1e6);
+        return status;
+    }
+
+    cal_iq_loopback(self, channel, f_tone, 32, 1);
+
+    //TX corrections off: the TX image stays where it is
+    LMS7002M_set_mac_ch(self, channel);
+    LMS7002M_regs(self)->reg_0x0208_dc_byp = 1;
+    LMS7002M_regs(self)->reg_0x0208_gc_byp = 1;
+    LMS7002M_regs(self)->reg_0x0208_ph_byp = 1;
+    LMS7002M_regs_spi_write(self, 0x0208);
+
+    *f_rx = (sxt_actual - self->sxr_freq) + f_tone;
+    return 0;
+}
+
+/***********************************************************************
+ * Calibrate one channel
+ **********************************************************************/
+static int rx_iq_calibrate(LMS7002M_t *self, const LMS7002M_chan_t channel, LMS7002M_iq_cal_t *result)
+{
+    const double rxtsp_rate = self->cgen_freq/4;
+    LMS7002M_chan_t arg = channel;
+    LMS7002M_iq_cal_t cal;
+    memset(&cal, 0, sizeof(cal));
+    cal.freq = self->sxr_freq;
+    const long long t0 = LMS7_time_now();
+
+    //the RX LO stays, the TX LO returns to its frequency after
+    LMS7002M_regs_t saved_map[2];
+    memcpy(saved_map, self->_regs, sizeof(saved_map));
+    const double sxt_freq = self->sxt_freq;
+    const double sxt_fref = self->sxt_fref;
+
+    double f_rx = 0.0;
+    int status = rx_iq_cal_setup(self, channel, &f_rx);
+    if (status != 0) goto done;
+
+    //--- tone level ---
+    LMS7002M_rxtsp_set_freq(self, channel, f_rx/rxtsp_rate);
+    cal.tone_rssi = cal_read_rssi(self, channel);
+    cal.probes++;
+    if (cal.tone_rssi < RX_IQ_CAL_MIN_TONE)
+    {
+        LMS7_logf(LMS7_ERROR, self, "RX IQ cal [%c]: loopback tone RSSI %d too low", channel, cal.tone_rssi);
+        status = -1;
+        goto done;
+    }
+
+    //--- DC offset ---
+    {
+        LMS7002M_rxtsp_set_freq(self, channel, 0.0);
+        int x[2] = {0, 0};
+        const int x_min[2] = {-63, -63};
+        const int x_max[2] = {63, 63};
+        const int step[2] = {16, 16};
+        cal.dc_rssi[0] = rx_iq_cal_dc_cost(self, &arg, x);
+        cal.probes += 1 + cal_minimize(self, rx_iq_cal_dc_cost, &arg, 2, x, x_min, x_max, step, RX_IQ_CAL_MAX_PROBES);
+        cal_rx_iq_write_dc(self, channel, x[0], x[1]);
+        cal.dc_i = x[0];
+        cal.dc_q = x[1];
+        cal.dc_rssi[1] = cal_read_rssi(self, channel);
+        cal.probes++;
+    }
+
+    //--- IQ imbalance at the image of the tone ---
+    {
+        LMS7002M_rxtsp_set_freq(self, channel, -f_rx/rxtsp_rate);
+        int x[2] = {0, 0};
+        const int x_min[2] = {-512, -512};
+        const int x_max[2] = {512, 512};
+        const int step[2] = {64, 64};
+        cal.image_rssi[0] = rx_iq_cal_image_cost(self, &arg, x);
+        cal.probes += 1 + cal_minimize(self, rx_iq_cal_image_cost, &arg, 2, x, x_min, x_max, step, RX_IQ_CAL_MAX_PROBES);
+        cal_rx_iq_write_iq(self, channel, x[0], x[1]);
+        cal.gain = x[0];
+        cal.phase = x[1];
+        cal.image_rssi[1] = cal_read_rssi(self, channel);
+        cal.probes++;
+    }
+
+    cal.elapsed = LMS7_time_now() - t0;
+    LMS7_logf(LMS7_INFO, self, "RX IQ cal [%c] %f MHz: DC %d,%d (RSSI %d -> %d), IQ %d,%d (image RSSI %d -> %d, tone %d), %d probes",
+        channel, cal.freq/1e6, cal.dc_i, cal.dc_q, cal.dc_rssi[0], cal.dc_rssi[1],
+        cal.gain, cal.phase, cal.image_rssi[0], cal.image_rssi[1], cal.tone_rssi, cal.probes);
+
+    done:
+    //only the registers the calibration changed go back
+    cal_restore_regs(self, saved_map);
+    self->sxt_freq = sxt_freq;
+    self->sxt_fref = sxt_fref;
+
+    if (status != 0) return status;
+    cal_rx_iq_write_dc(self, channel, cal.dc_i, cal.dc_q);
+    cal_rx_iq_write_iq(self, channel, cal.gain, cal.phase);
+    cal_iq_store(self, LMS_RX, channel, &cal);
+    if (result != NULL) *result = cal;
+    return 0;
+}
+
+int LMS7002M_rx_iq_calibrate(LMS7002M_t *self, const LMS7002M_chan_t channel, LMS7002M_iq_cal_t *result)
+{
+    if (self->cgen_freq == 0.0 || self->sxr_freq == 0.0 || self->sxt_fref == 0.0)
+    {
+        LMS7_log(LMS7_ERROR, self, "RX IQ cal needs CGEN, SXR and the SXT reference set");
+        return -1;
+    }
+
+    if (channel != LMS_CHAB) return rx_iq_calibrate(self, channel, result);
+
+    const int status = rx_iq_calibrate(self, LMS_CHA, result);
+    if (status != 0) return status;
+    return rx_iq_calibrate(self, LMS_CHB, (result == NULL)?NULL:result+1);
+}
@@ -0,0 +1,122 @@
+///
+/// \file LMS7002M_tdd.c
+///
+/// Fast TDD switching between stored TX and RX states
+/// for the LMS7002M C driver.
+///
+/// \copyright
+/// Copyright (c) 2015-2017 Fairwaves, Inc.
+/// Copyright (c) 2015-2015 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include <stdlib.h>
+#include "LMS7002M_impl.h"
+#include <LMS7002M/LMS7002M_time.h>
+#include <LMS7002M/LMS7002M_logger.h>
+
+//the power and enable registers that differ between TX and RX states
+static const int tdd_regs[LMS7_TDD_NUM_REGS] = {
+    0x0082, //AFE power downs
+    0x0100, //TRF enable and PAD power down
+    0x0105, //TBB power downs
+    0x010c, //RFE enable and LNA power down
+    0x010d, //RFE chB LO enable
+    0x0115, //RBB power downs
+    0x011c, //SXR/SXT enable and LO sharing
+    0x0124, //direct control enables
+};
+
+static int tdd_index(const LMS7002M_dir_t direction)
+{
+    switch (direction)
+    {
+    case LMS_TX: return 0;
+    case LMS_RX: return 1;
+    default: return -1;
+    }
+}
+
+//compile the registers of state "to" that differ from state "from"
+static void tdd_compile(LMS7002M_t *self, const int to, const int from)
+{
+    LMS7002M_tdd_profile_t *p = &self->tdd_profile[to];
+    p->num = 0;
+    for (int bank = 0; bank < 2; bank++)
+    {
+        for (int i = 0; i < LMS7_TDD_NUM_REGS; i++)
+        {
+            //the registers below 0x0100 do not depend on MAC
+            if (bank == 1 && tdd_regs[i] < 0x0100) continue;
+            const int value = self->tdd_state[to][bank][i];
+            if (value == self->tdd_state[from][bank][i]) continue;
+            p->bank[p->num] = bank;
+            p->addr[p->num] = tdd_regs[i];
+            p->value[p->num] = value;
+            p->num++;
+        }
+    }
+}
+
+int LMS7002M_tdd_store(LMS7002M_t *self, const LMS7002M_dir_t direction)
+{
+    const int d = tdd_index(direction);
+    if (d < 0) return -1;
+
+    for (int bank = 0; bank < 2; bank++)
+    {
+        for (int i = 0; i < LMS7_TDD_NUM_REGS; i++)
+        {
+            self->tdd_state[d][bank][i] = LMS7002M_regs_get(&self->_regs[bank], tdd_regs[i]);
+        }
+    }
+    self->tdd_stored[d] = true;
+
+    if (self->tdd_stored[0] && self->tdd_stored[1])
+    {
+        tdd_compile(self, 0, 1);
+        tdd_compile(self, 1, 0);
+        LMS7_logf(LMS7_DEBUG, self, "TDD profiles: %d TX deltas, %d RX deltas",
+            self->tdd_profile[0].num, self->tdd_profile[1].num);
+    }
+    return 0;
+}
+
+int LMS7002M_tdd_switch(LMS7002M_t *self, const LMS7002M_dir_t direction, long long *elapsed)
+{
+    const int d = tdd_index(direction);
+    if (d < 0) return -1;
+    if (!self->tdd_stored[0] || !self->tdd_stored[1]) return -2;
+
+    //the deltas plus up to two MAC changes, bank 0 comes first
+    int addrs[2*LMS7_TDD_NUM_REGS+2];
+    int values[2*LMS7_TDD_NUM_REGS+2];
+    size_t num = 0;
+
+    const long long t0 = LMS7_time_now();
+    const LMS7002M_tdd_profile_t *p = &self->tdd_profile[d];
+    for (int i = 0; i < p->num; i++)
+    {
+        //MAC must select exactly the bank, CHAB would also write the other one
+        const int mac = (p->bank[i] == 0)?REG_0X0020_MAC_CHA:REG_0X0020_MAC_CHB;
+        if (p->addr[i] >= 0x0100 && self->_regs[0].reg_0x0020_mac != mac)
+        {
+            self->_regs[0].reg_0x0020_mac = mac;
+            addrs[num] = 0x0020;
+            values[num] = LMS7002M_regs_get(&self->_regs[0], 0x0020);
+            num++;
+        }
+
+        //the shadows follow the chip
+        LMS7002M_regs_set(&self->_regs[p->bank[i]], p->addr[i], p->value[i]);
+        addrs[num] = p->addr[i];
+        values[num] = p->value[i];
+        num++;
+    }
+    self->regs = &self->_regs[(self->_regs[0].reg_0x0020_mac == REG_0X0020_MAC_CHB)?1:0];
+
+    LMS7002M_spi_write_batch(self, addrs, values, num);
+    if (elapsed != NULL) *elapsed = LMS7_time_now() - t0;
+    return 0;
+}
@@ -54,12 +54,21 @@ void LMS7_sleep_until(const long long ticks)
 }
 #else
 #include <unistd.h>
+#include <time.h>
 
 long long LMS7_time_tps(void)
 {
     return 1000000;
 }
 
+long long LMS7_time_now(void)
+{
+    //monotonic: durations stay valid across wall clock changes
+    struct timespec now_ts;
+    clock_gettime(CLOCK_MONOTONIC, &now_ts);
+    return (LMS7_time_tps()*now_ts.tv_sec) + now_ts.tv_nsec/1000;
+}
+
 void LMS7_sleep_for(const long long ticks)
 {
     usleep((useconds_t)ticks);
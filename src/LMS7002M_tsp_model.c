@@ -0,0 +1,488 @@
+///
+/// \file LMS7002M_tsp_model.c
+///
+/// Fixed point software model of the RxTSP and TxTSP chains.
+/// The FIR dot products have SSE2 and NEON kernels,
+/// the x86 kernel uses a function target attribute
+/// and is only selected when the CPU supports it.
+///
+/// \copyright
+/// Copyright (c) 2016-2017 Fairwaves, Inc.
+/// Copyright (c) 2016-2016 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h> //M_PI
+#include "LMS7002M_impl.h"
+#include <LMS7002M/LMS7002M_tsp_model.h>
+#include <LMS7002M/LMS7002M_logger.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SSE2 __attribute__((target("sse2")))
+#endif
+
+#ifdef __aarch64__
+#include <arm_neon.h>
+#endif
+
+//! Halfband filter length of each HBD/HBI stage, a model choice
+#define TSP_HB_LEN 23
+
+//! Halfband stages of the largest ratio, 32
+#define TSP_HB_MAX_STAGES 5
+
+//! NCO phase bits that index the sine table, a model choice
+#define TSP_NCO_BITS 12
+
+//! Samples saturate symmetric, so no product pair overflows 32 bits
+#define TSP_SAMPLE_MAX 32767
+
+/***********************************************************************
+ * FIR dot product kernels: the sum of n int16 products in 64 bits
+ **********************************************************************/
+typedef int64_t (*tsp_dot_fcn_t)(const int16_t *x, const int16_t *h, const size_t n);
+
+static int64_t tsp_dot_scalar(const int16_t *x, const int16_t *h, const size_t n)
+{
+    int64_t acc = 0;
+    for (size_t i = 0; i < n; i++) acc += (int32_t)x[i]*h[i];
+    return acc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+SSE2 static int64_t tsp_dot_sse2(const int16_t *x, const int16_t *h, const size_t n)
+{
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        //pairs of products in 32 bits, then sign extended into 64 bits
+        const __m128i p = _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(x+i)), _mm_loadu_si128((const __m128i *)(h+i)));
+        const __m128i sign = _mm_srai_epi32(p, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(p, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(p, sign));
+    }
+
+    int64_t sum[2];
+    _mm_storeu_si128((__m128i *)sum, acc);
+    return sum[0] + sum[1] + tsp_dot_scalar(x+i, h+i, n-i);
+}
+#endif
+
+#ifdef __aarch64__
+static int64_t tsp_dot_neon(const int16_t *x, const int16_t *h, const size_t n)
+{
+    int64x2_t acc = vdupq_n_s64(0);
+    size_t i = 0;
+
+    for (; i+8 <= n; i+=8)
+    {
+        const int16x8_t a = vld1q_s16(x+i);
+        const int16x8_t b = vld1q_s16(h+i);
+        acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(a), vget_low_s16(b)));
+        acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(a), vget_high_s16(b)));
+    }
+
+    return vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1) + tsp_dot_scalar(x+i, h+i, n-i);
+}
+#endif
+
+static tsp_dot_fcn_t tsp_dot_simd(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("sse2")) return tsp_dot_sse2;
+#endif
+#ifdef __aarch64__
+    return tsp_dot_neon;
+#endif
+    return tsp_dot_scalar;
+}
+
+/***********************************************************************
+ * Streaming FIR filter over I and Q
+ **********************************************************************/
+typedef struct
+{
+    int16_t taps[LMS7002M_GFIR_MAX_TAPS];
+    size_t len;
+    size_t pos; //newest sample in the history
+    int shift; //15 for unity gain taps, 14 to double the gain
+    int16_t hist[2][2*LMS7002M_GFIR_MAX_TAPS]; //each sample stored twice, the window is contiguous
+} tsp_fir_t;
+
+static inline int tsp_sat(const int64_t x)
+{
+    if (x > TSP_SAMPLE_MAX) return TSP_SAMPLE_MAX;
+    if (x < -TSP_SAMPLE_MAX) return -TSP_SAMPLE_MAX;
+    return (int)x;
+}
+
+//round a product sum of the given fraction bits
+static inline int tsp_round(const int64_t acc, const int shift)
+{
+    return tsp_sat((acc + (1LL << (shift-1))) >> shift);
+}
+
+static inline void tsp_fir_push(tsp_fir_t *fir, const int i, const int q)
+{
+    fir->pos = (fir->pos == 0)?(fir->len-1):(fir->pos-1);
+    fir->hist[0][fir->pos] = fir->hist[0][fir->pos+fir->len] = (int16_t)i;
+    fir->hist[1][fir->pos] = fir->hist[1][fir->pos+fir->len] = (int16_t)q;
+}
+
+static inline void tsp_fir_out(const tsp_fir_t *fir, tsp_dot_fcn_t dot, int *i, int *q)
+{
+    *i = tsp_round(dot(fir->hist[0]+fir->pos, fir->taps, fir->len), fir->shift);
+    *q = tsp_round(dot(fir->hist[1]+fir->pos, fir->taps, fir->len), fir->shift);
+}
+
+/***********************************************************************
+ * Model state
+ **********************************************************************/
+struct LMS7002M_tsp_model_struct
+{
+    LMS7002M_dir_t direction;
+    tsp_dot_fcn_t dot;
+
+    //corrections
+    bool dc_en, gc_en, ph_en, isinc_en;
+    int dc_shift; //RX DC tracking window of 2^dc_shift samples
+    int dc_i, dc_q; //TX DC offsets
+    int64_t dc_est[2]; //RX DC estimates with dc_shift fraction bits
+    int gain_i, gain_q; //Q15, 32768 for unity
+    int phase; //Q15 sine of the phase correction
+    int isinc_hist[2][2];
+
+    //NCO mixer
+    bool cmix_en;
+    uint32_t fcw, nco_phase;
+    int nco_sign; //+1 multiplies by exp(j phase), -1 by exp(-j phase)
+    int cmix_shift; //15 for 0 dB, 14 for +6 dB, 16 for -6 dB
+    int16_t cos_table[1 << TSP_NCO_BITS];
+    int16_t sin_table[1 << TSP_NCO_BITS];
+
+    //rate change: RX keeps one of 2 per stage, TX makes 2 of 1
+    size_t hb_num;
+    tsp_fir_t hb[TSP_HB_MAX_STAGES];
+    int hb_phase[TSP_HB_MAX_STAGES];
+
+    bool gfir_en[3];
+    tsp_fir_t gfir[3];
+};
+
+//halfband taps: a Blackman windowed sinc with the odd zeros exact
+static void tsp_hb_design(tsp_fir_t *fir, const int shift)
+{
+    const int mid = TSP_HB_LEN/2;
+    int sum = 0;
+    memset(fir, 0, sizeof(*fir));
+    for (int i = 0; i < TSP_HB_LEN; i++)
+    {
+        const int t = i - mid;
+        if (t == 0 || t % 2 == 0) continue;
+        const double w = 0.42 + 0.5*cos(M_PI*t/(mid+1)) + 0.08*cos(2*M_PI*t/(mid+1));
+        fir->taps[i] = (int16_t)lround(32768*sin(M_PI*t/2)/(M_PI*t)*w);
+        sum += fir->taps[i];
+    }
+    fir->taps[mid] = (int16_t)(32768 - sum); //unity gain at DC
+    fir->len = TSP_HB_LEN;
+    fir->shift = shift;
+}
+
+//GFIR taps from the bank layout: filter tap k*L+i is register k*8+i
+static void tsp_gfir_load(tsp_fir_t *fir, const short *taps, const size_t banks, const int bank_len)
+{
+    memset(fir, 0, sizeof(*fir));
+    for (size_t k = 0; k < banks; k++)
+    {
+        for (int i = 0; i < bank_len; i++) fir->taps[k*bank_len+i] = taps[k*8+i];
+    }
+    fir->len = banks*bank_len;
+    fir->shift = 15;
+}
+
+static inline int tsp_sign_extend(const int value, const int bits)
+{
+    return (value & (1 << (bits-1)))?(value - (1 << bits)):value;
+}
+
+LMS7002M_tsp_model_t *LMS7002M_tsp_model_create(
+    const LMS7002M_dir_t direction,
+    const LMS7002M_regs_t *regs,
+    const short *const gfir_taps[3])
+{
+    if (direction != LMS_TX && direction != LMS_RX) return NULL;
+
+    //the bank as the chip holds it: each field in its register width
+    LMS7002M_regs_t r = *regs;
+    for (const int *addrp = LMS7002M_regs_addrs(); *addrp != 0; addrp++)
+    {
+        LMS7002M_regs_set(&r, *addrp, LMS7002M_regs_get(&r, *addrp));
+    }
+
+    const bool rx = (direction == LMS_RX);
+    const bool gfir_byp[3] = {
+        (rx?r.reg_0x040c_gfir1_byp:r.reg_0x0208_gfir1_byp) != 0,
+        (rx?r.reg_0x040c_gfir2_byp:r.reg_0x0208_gfir2_byp) != 0,
+        (rx?r.reg_0x040c_gfir3_byp:r.reg_0x0208_gfir3_byp) != 0};
+    for (int j = 0; j < 3; j++)
+    {
+        if (!gfir_byp[j] && (gfir_taps == NULL || gfir_taps[j] == NULL)) return NULL;
+    }
+
+    LMS7002M_tsp_model_t *model = (LMS7002M_tsp_model_t *)calloc(1, sizeof(LMS7002M_tsp_model_t));
+    if (model == NULL) return NULL;
+    model->direction = direction;
+    model->dot = tsp_dot_simd();
+
+    //corrections: gain and phase as LMS7002M_rxtsp/txtsp_set_iq_correction() program them
+    const int gcorri = rx?r.reg_0x0402_gcorri:r.reg_0x0202_gcorri;
+    const int gcorrq = rx?r.reg_0x0401_gcorrq:r.reg_0x0201_gcorrq;
+    const int iqcorr = tsp_sign_extend(rx?r.reg_0x0403_iqcorr:r.reg_0x0203_iqcorr, 12);
+    model->gc_en = (rx?r.reg_0x040c_gc_byp:r.reg_0x0208_gc_byp) == 0;
+    model->ph_en = (rx?r.reg_0x040c_ph_byp:r.reg_0x0208_ph_byp) == 0;
+    model->dc_en = (rx?r.reg_0x040c_dc_byp:r.reg_0x0208_dc_byp) == 0;
+    model->gain_i = (int)lround(gcorri*32768.0/2047);
+    model->gain_q = (int)lround(gcorrq*32768.0/2047);
+    model->phase = (int)lround(32767*sin(iqcorr*(M_PI/2)/2047));
+    model->dc_shift = r.reg_0x0404_dccorr_avg + 12;
+    model->dc_i = tsp_sign_extend(r.reg_0x0204_dccorri, 8)*256;
+    model->dc_q = tsp_sign_extend(r.reg_0x0204_dccorrq, 8)*256;
+    model->isinc_en = !rx && r.reg_0x0208_isinc_byp == 0;
+
+    //NCO: LMS7002M_rxtsp_set_freq(f) moves +f to DC, LMS7002M_txtsp_set_freq(f) moves DC to +f
+    const int sel = rx?r.reg_0x0440_sel:r.reg_0x0240_sel;
+    const int fcw_addr = (rx?0x0442:0x0242) + 2*sel;
+    model->cmix_en = (rx?r.reg_0x040c_cmix_byp:r.reg_0x0208_cmix_byp) == 0;
+    model->fcw = ((uint32_t)LMS7002M_regs_get(&r, fcw_addr) << 16) | (uint32_t)LMS7002M_regs_get(&r, fcw_addr+1);
+    model->nco_sign = rx?((r.reg_0x002f_mask != 0)?1:-1):1;
+    if ((rx?r.reg_0x040c_cmix_sc:r.reg_0x0208_cmix_sc) == REG_0X0208_CMIX_SC_DOWNCONVERT) model->nco_sign = -model->nco_sign;
+    const int cmix_gain = rx?r.reg_0x040c_cmix_gain:r.reg_0x0208_cmix_gain;
+    model->cmix_shift = (cmix_gain == REG_0X0208_CMIX_GAIN_POS6DB)?14:((cmix_gain == REG_0X0208_CMIX_GAIN_NEG6DB)?16:15);
+    for (int k = 0; k < (1 << TSP_NCO_BITS); k++)
+    {
+        const double phi = 2*M_PI*k/(1 << TSP_NCO_BITS);
+        model->cos_table[k] = (int16_t)lround(32767*cos(phi));
+        model->sin_table[k] = (int16_t)lround(32767*sin(phi));
+    }
+
+    //a ratio of 2 << ovr is ovr+1 halfband stages, 7 is bypass
+    const int ovr = rx?r.reg_0x0403_hbd_ovr:r.reg_0x0203_hbi_ovr;
+    model->hb_num = (ovr == 7)?0:(size_t)(ovr+1);
+    if (model->hb_num > TSP_HB_MAX_STAGES)
+    {
+        free(model);
+        return NULL;
+    }
+    for (size_t s = 0; s < model->hb_num; s++) tsp_hb_design(&model->hb[s], rx?15:14);
+
+    //the taps per bank, the GFIRn_L field plus 1
+    const int gfir_l[3] = {
+        (rx?r.reg_0x0405_gfir1_l:r.reg_0x0205_gfir1_l) + 1,
+        (rx?r.reg_0x0406_gfir2_l:r.reg_0x0206_gfir2_l) + 1,
+        (rx?r.reg_0x0407_gfir3_l:r.reg_0x0207_gfir3_l) + 1};
+    for (int j = 0; j < 3; j++)
+    {
+        model->gfir_en[j] = !gfir_byp[j];
+        if (!model->gfir_en[j]) continue;
+        tsp_gfir_load(&model->gfir[j], gfir_taps[j], (j == 2)?15:5, (gfir_l[j] > 8)?8:gfir_l[j]);
+    }
+
+    return model;
+}
+
+LMS7002M_tsp_model_t *LMS7002M_tsp_model_from_chip(
+    LMS7002M_t *self,
+    const LMS7002M_dir_t direction,
+    const LMS7002M_chan_t channel)
+{
+    if (channel != LMS_CHA && channel != LMS_CHB) return NULL;
+    const int dir = (direction == LMS_RX)?1:0;
+    const int bank = (channel == LMS_CHB)?1:0;
+
+    const short *taps[3];
+    for (int j = 0; j < 3; j++)
+    {
+        taps[j] = self->gfir_known[dir][bank][j]?self->gfir_taps[dir][bank][j]:NULL;
+    }
+
+    LMS7002M_tsp_model_t *model = LMS7002M_tsp_model_create(direction, &self->_regs[bank], taps);
+    if (model == NULL) LMS7_logf(LMS7_ERROR, self, "TSP model [%c]: an enabled GFIR has no known taps", channel);
+    return model;
+}
+
+void LMS7002M_tsp_model_destroy(LMS7002M_tsp_model_t *model)
+{
+    free(model);
+}
+
+void LMS7002M_tsp_model_reset(LMS7002M_tsp_model_t *model)
+{
+    model->dc_est[0] = model->dc_est[1] = 0;
+    memset(model->isinc_hist, 0, sizeof(model->isinc_hist));
+    model->nco_phase = 0;
+    for (size_t s = 0; s < model->hb_num; s++)
+    {
+        memset(model->hb[s].hist, 0, sizeof(model->hb[s].hist));
+        model->hb[s].pos = 0;
+        model->hb_phase[s] = 0;
+    }
+    for (int j = 0; j < 3; j++)
+    {
+        memset(model->gfir[j].hist, 0, sizeof(model->gfir[j].hist));
+        model->gfir[j].pos = 0;
+    }
+}
+
+size_t LMS7002M_tsp_model_ratio(const LMS7002M_tsp_model_t *model)
+{
+    return (size_t)1 << model->hb_num;
+}
+
+void LMS7002M_tsp_model_set_simd(LMS7002M_tsp_model_t *model, const bool enable)
+{
+    model->dot = enable?tsp_dot_simd():tsp_dot_scalar;
+}
+
+/***********************************************************************
+ * Processing stages, one complex sample at a time
+ **********************************************************************/
+static void tsp_gain_phase(LMS7002M_tsp_model_t *model, int *i, int *q)
+{
+    if (model->gc_en)
+    {
+        *i = tsp_round((int64_t)*i*model->gain_i, 15);
+        *q = tsp_round((int64_t)*q*model->gain_q, 15);
+    }
+    //first order: the phase error moves a part of I into Q
+    if (model->ph_en) *q = tsp_sat(*q + tsp_round((int64_t)*i*model->phase, 15));
+}
+
+static void tsp_cmix(LMS7002M_tsp_model_t *model, int *i, int *q)
+{
+    if (!model->cmix_en) return;
+    const uint32_t k = model->nco_phase >> (32 - TSP_NCO_BITS);
+    const int64_t c = model->cos_table[k];
+    const int64_t s = model->nco_sign*model->sin_table[k];
+    const int64_t i0 = *i, q0 = *q;
+    *i = tsp_round(i0*c - q0*s, model->cmix_shift);
+    *q = tsp_round(i0*s + q0*c, model->cmix_shift);
+    model->nco_phase += model->fcw;
+}
+
+static void tsp_gfirs(LMS7002M_tsp_model_t *model, int *i, int *q)
+{
+    for (int j = 0; j < 3; j++)
+    {
+        if (!model->gfir_en[j]) continue;
+        tsp_fir_push(&model->gfir[j], *i, *q);
+        tsp_fir_out(&model->gfir[j], model->dot, i, q);
+    }
+}
+
+//RX: DC tracking loop, the estimate follows with a 2^dc_shift time constant
+static void tsp_rx_dc(LMS7002M_tsp_model_t *model, int *i, int *q)
+{
+    if (!model->dc_en) return;
+    int *x[2] = {i, q};
+    for (int c = 0; c < 2; c++)
+    {
+        model->dc_est[c] += *x[c] - (model->dc_est[c] >> model->dc_shift);
+        *x[c] = tsp_sat(*x[c] - (model->dc_est[c] >> model->dc_shift));
+    }
+}
+
+//RX: each halfband stage keeps every second output
+static size_t tsp_rx_hbd(LMS7002M_tsp_model_t *model, const size_t stage, int i, int q, int16_t *out)
+{
+    if (stage == model->hb_num)
+    {
+        tsp_gfirs(model, &i, &q);
+        out[0] = (int16_t)i;
+        out[1] = (int16_t)q;
+        return 1;
+    }
+
+    tsp_fir_push(&model->hb[stage], i, q);
+    model->hb_phase[stage] ^= 1;
+    if (model->hb_phase[stage] != 0) return 0;
+    tsp_fir_out(&model->hb[stage], model->dot, &i, &q);
+    return tsp_rx_hbd(model, stage+1, i, q, out);
+}
+
+//TX: inverse sinc, a 3 tap (-1, 18, -1)/16 compensation
+static void tsp_tx_isinc(LMS7002M_tsp_model_t *model, int *i, int *q)
+{
+    if (!model->isinc_en) return;
+    int *x[2] = {i, q};
+    for (int c = 0; c < 2; c++)
+    {
+        int *h = model->isinc_hist[c];
+        const int y = tsp_sat((18*h[0] - *x[c] - h[1] + 8) >> 4);
+        h[1] = h[0];
+        h[0] = *x[c];
+        *x[c] = y;
+    }
+}
+
+//TX: each halfband stage makes two outputs of a zero stuffed input
+static size_t tsp_tx_hbi(LMS7002M_tsp_model_t *model, const size_t stage, int i, int q, int16_t *out)
+{
+    if (stage == model->hb_num)
+    {
+        tsp_cmix(model, &i, &q);
+        out[0] = (int16_t)i;
+        out[1] = (int16_t)q;
+        return 1;
+    }
+
+    size_t num = 0;
+    for (int phase = 0; phase < 2; phase++)
+    {
+        tsp_fir_push(&model->hb[stage], (phase == 0)?i:0, (phase == 0)?q:0);
+        int yi, yq;
+        tsp_fir_out(&model->hb[stage], model->dot, &yi, &yq);
+        num += tsp_tx_hbi(model, stage+1, yi, yq, out+2*num);
+    }
+    return num;
+}
+
+size_t LMS7002M_tsp_model_process(
+    LMS7002M_tsp_model_t *model,
+    const int16_t *in,
+    int16_t *out,
+    const size_t num)
+{
+    size_t count = 0;
+    for (size_t n = 0; n < num; n++)
+    {
+        int i = tsp_sat(in[2*n+0]);
+        int q = tsp_sat(in[2*n+1]);
+
+        if (model->direction == LMS_RX)
+        {
+            tsp_rx_dc(model, &i, &q);
+            tsp_gain_phase(model, &i, &q);
+            tsp_cmix(model, &i, &q);
+            count += tsp_rx_hbd(model, 0, i, q, out+2*count);
+        }
+        else
+        {
+            tsp_gfirs(model, &i, &q);
+            tsp_gain_phase(model, &i, &q);
+            if (model->dc_en)
+            {
+                i = tsp_sat(i + model->dc_i);
+                q = tsp_sat(q + model->dc_q);
+            }
+            tsp_tx_isinc(model, &i, &q);
+            count += tsp_tx_hbi(model, 0, i, q, out+2*count);
+        }
+    }
+    return count;
+}
@@ -44,15 +44,19 @@ static int tx_cal_loop(
 
     //--- gain selection ---//
     const uint16_t saturation_level = 0x05000; //-3dBFS
-    const int rssi_value_50k = cal_gain_selection(self, channel, saturation_level);
+    int rssi_value_50k = 0;
+    cal_gain_selection(self, channel, saturation_level, &rssi_value_50k);
 
     //--- setup calibration tone ---//
     setup_tx_cal_tone(self, channel, bw);
 
     //--- calibration loop ---//
+    //search ccal_lpflad_tbb, the coarse register moves when ccal runs out of range
+    const int desired_rssi_value = (int)(rssi_value_50k*0.7071);
+    const int analytic = LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb;
+    const int coarse_analytic = *reg_ptr;
+    int seed = cal_search_seed(self, channel, 0x010a, analytic);
     size_t iter = 0;
-    uint16_t rssi_value = cal_read_rssi(self, channel);
-    int adjust = (rssi_value < rssi_value_50k*0.7071)?-1:+1;
     while (true)
     {
         if (iter++ == MAX_CAL_LOOP_ITERS)
@@ -61,17 +65,32 @@ static int tx_cal_loop(
             return -1;
         }
 
-        LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb += adjust;
-        LMS7002M_regs_spi_write(self, 0x010a);
+        cal_search_t search;
+        cal_search_init(&search, seed, 31, desired_rssi_value);
+        bool done = false;
+        while (!done)
+        {
+            LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb = search.code;
+            LMS7002M_regs_spi_write(self, 0x010a);
+            done = cal_search_update(self, &search, cal_read_rssi(self, channel));
+        }
+        if (LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb != search.code)
+        {
+            LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb = search.code;
+            LMS7002M_regs_spi_write(self, 0x010a);
+        }
+        LMS7_logf(LMS7_DEBUG, self, "ccal_lpflad_tbb search %d probes", search.probes);
 
-        rssi_value = cal_read_rssi(self, channel);
-        if (rssi_value > rssi_value_50k*0.7071 && adjust < 0) break;
-        if (rssi_value < rssi_value_50k*0.7071 && adjust > 0) break;
-        if (LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb != 0 &&
-            LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb != 31) continue;
+        if (search.result == CAL_OK)
+        {
+            //the offset only applies to the analytic coarse setting
+            if (*reg_ptr == coarse_analytic) cal_search_learn(self, channel, 0x010a, analytic, search.code);
+            break;
+        }
 
-        *reg_ptr -= adjust*5;
-        LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb = 16;
+        //CAL_LOW: the RSSI stayed above the target over the ccal range
+        *reg_ptr += (search.result == CAL_LOW)?-5:+5;
+        LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb = seed = 16;
         LMS7002M_regs_spi_write(self, 0x010a);
         LMS7002M_regs_spi_write(self, reg_addr);
 
@@ -80,9 +99,6 @@ static int tx_cal_loop(
             LMS7_logf(LMS7_ERROR, self, "failed to cal %s -> %d", reg_name, *reg_ptr);
             return -1;
         }
-
-        rssi_value = cal_read_rssi(self, channel);
-        adjust = (rssi_value < rssi_value_50k*0.7071)?-1:+1;
     }
     LMS7_logf(LMS7_DEBUG, self, "%s = %d", reg_name, *reg_ptr);
     LMS7_logf(LMS7_DEBUG, self, "ccal_lpflad_tbb = %d", LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb);
@@ -273,13 +289,52 @@ static int tx_cal_tbb_lpfh(LMS7002M_t *self, const LMS7002M_chan_t channel, cons
     return status;
 }
 
+/***********************************************************************
+ * Apply the results of a calibration or of the cache
+ **********************************************************************/
+#define TX_CAL_NUM_VALUES 5
+
+static void tx_cal_apply(LMS7002M_t *self, const LMS7002M_chan_t channel, const int path, const int *cal_values)
+{
+    ////////////////////////////////////////////////////////////////////
+    // apply tbb calibration results
+    ////////////////////////////////////////////////////////////////////
+    LMS7002M_set_mac_ch(self, channel);
+    LMS7002M_regs(self)->reg_0x0109_rcal_lpflad_tbb = cal_values[0];
+    LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb = cal_values[1];
+    LMS7002M_regs(self)->reg_0x010a_rcal_lpfs5_tbb = cal_values[2];
+    LMS7002M_regs(self)->reg_0x0109_rcal_lpfh_tbb = cal_values[3];
+    LMS7002M_regs(self)->reg_0x0108_ict_iamp_frp_tbb = 1;
+    LMS7002M_regs(self)->reg_0x0108_ict_iamp_gg_frp_tbb = 6;
+    LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb = cal_values[4];
+    LMS7002M_regs_spi_write(self, 0x0108);
+    LMS7002M_regs_spi_write(self, 0x0109);
+    LMS7002M_regs_spi_write(self, 0x010a);
+
+    LMS7_logf(LMS7_DEBUG, self, "restore reg_0x0108_cg_iamp_tbb = %d", cal_values[4]);
+
+    ////////////////////////////////////////////////////////////////////
+    // set the filter selection
+    ////////////////////////////////////////////////////////////////////
+    LMS7002M_tbb_set_path(self, channel, path);
+}
+
 /***********************************************************************
  * Tx calibration dispatcher
  **********************************************************************/
 int LMS7002M_tbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel, double bw, double *bwactual)
 {
+    //the TX search steps one register at a time, each channel in turn
+    if (channel == LMS_CHAB)
+    {
+        const int status = LMS7002M_tbb_set_filter_bw(self, LMS_CHA, bw, bwactual);
+        if (status != 0) return status;
+        return LMS7002M_tbb_set_filter_bw(self, LMS_CHB, bw, bwactual);
+    }
+
     LMS7002M_set_mac_ch(self, channel);
     int status = 0;
+    const double requested_bw = bw;
 
     //ranges to work around filter tuning issues
     //LPFLAD does not calibrate near extreme ranges
@@ -293,6 +348,17 @@ int LMS7002M_tbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel,
     if (bw > lpflad_stop && bw < lpfh_start) bw = lpfh_start; //clip up to high-band
     const int path = (bw < lpflad_start)?LMS7002M_TBB_S5:(bw <= lpflad_stop)?LMS7002M_TBB_LAD:LMS7002M_RBB_HBF;
 
+    ////////////////////////////////////////////////////////////////////
+    // Cached results: no calibration needed
+    ////////////////////////////////////////////////////////////////////
+    int cal_values[TX_CAL_NUM_VALUES];
+    if (cal_cache_lookup(self, LMS_TX, channel, requested_bw, cal_values, TX_CAL_NUM_VALUES) == 0)
+    {
+        tx_cal_apply(self, channel, path, cal_values);
+        if (bwactual != NULL) *bwactual = bw;
+        return 0;
+    }
+
     ////////////////////////////////////////////////////////////////////
     // Save register map
     ////////////////////////////////////////////////////////////////////
@@ -340,11 +406,11 @@ int LMS7002M_tbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel,
     // stash tbb calibration results
     ////////////////////////////////////////////////////////////////////
     LMS7002M_set_mac_ch(self, channel);
-    const int rcal_lpflad_tbb = LMS7002M_regs(self)->reg_0x0109_rcal_lpflad_tbb;
-    const int ccal_lpflad_tbb = LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb;
-    const int rcal_lpfs5_tbb = LMS7002M_regs(self)->reg_0x010a_rcal_lpfs5_tbb;
-    const int rcal_lpfh_tbb = LMS7002M_regs(self)->reg_0x0109_rcal_lpfh_tbb;
-    const int cg_iamp_tbb = LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb;
+    cal_values[0] = LMS7002M_regs(self)->reg_0x0109_rcal_lpflad_tbb;
+    cal_values[1] = LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb;
+    cal_values[2] = LMS7002M_regs(self)->reg_0x010a_rcal_lpfs5_tbb;
+    cal_values[3] = LMS7002M_regs(self)->reg_0x0109_rcal_lpfh_tbb;
+    cal_values[4] = LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb;
 
     ////////////////////////////////////////////////////////////////////
     // restore original register values
@@ -353,27 +419,8 @@ int LMS7002M_tbb_set_filter_bw(LMS7002M_t *self, const LMS7002M_chan_t channel,
     LMS7002M_regs_to_rfic(self);
     LMS7002M_set_mac_ch(self, channel);
 
-    ////////////////////////////////////////////////////////////////////
-    // apply tbb calibration results
-    ////////////////////////////////////////////////////////////////////
-    LMS7002M_set_mac_ch(self, channel);
-    LMS7002M_regs(self)->reg_0x0109_rcal_lpflad_tbb = rcal_lpflad_tbb;
-    LMS7002M_regs(self)->reg_0x010a_ccal_lpflad_tbb = ccal_lpflad_tbb;
-    LMS7002M_regs(self)->reg_0x010a_rcal_lpfs5_tbb = rcal_lpfs5_tbb;
-    LMS7002M_regs(self)->reg_0x0109_rcal_lpfh_tbb = rcal_lpfh_tbb;
-    LMS7002M_regs(self)->reg_0x0108_ict_iamp_frp_tbb = 1;
-    LMS7002M_regs(self)->reg_0x0108_ict_iamp_gg_frp_tbb = 6;
-    LMS7002M_regs(self)->reg_0x0108_cg_iamp_tbb = cg_iamp_tbb;
-    LMS7002M_regs_spi_write(self, 0x0108);
-    LMS7002M_regs_spi_write(self, 0x0109);
-    LMS7002M_regs_spi_write(self, 0x010a);
-
-    LMS7_logf(LMS7_ERROR, self, "restore reg_0x0108_cg_iamp_tbb = %d", cg_iamp_tbb);
-
-    ////////////////////////////////////////////////////////////////////
-    // set the filter selection
-    ////////////////////////////////////////////////////////////////////
-    LMS7002M_tbb_set_path(self, channel, path);
+    tx_cal_apply(self, channel, path, cal_values);
+    if (status == 0) cal_cache_store(self, LMS_TX, channel, requested_bw, cal_values, TX_CAL_NUM_VALUES);
 
     if (bwactual != NULL) *bwactual = bw;
     return status;
@@ -0,0 +1,173 @@
+///
+/// \file LMS7002M_tx_iq_cal.c
+///
+/// Tx LO leakage and IQ imbalance calibration for the LMS7002M C driver.
+///
+/// \copyright
+/// Copyright (c) 2016-2017 Fairwaves, Inc.
+/// Copyright (c) 2016-2016 Rice University
+/// SPDX-License-Identifier: Apache-2.0
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+
+#include <string.h> //memcpy
+#include "LMS7002M_impl.h"
+#include "LMS7002M_filter_cal.h"
+#include <LMS7002M/LMS7002M_logger.h>
+#include <LMS7002M/LMS7002M_time.h>
+
+//! The weakest loopback tone RSSI to calibrate with
+#define TX_IQ_CAL_MIN_TONE 0x100
+
+//! The most RSSI measurements per search
+#define TX_IQ_CAL_MAX_PROBES 48
+
+/***********************************************************************
+ * Cost functions: the RSSI at the frequency the NCO moves to DC
+ **********************************************************************/
+static int tx_iq_cal_dc_cost(LMS7002M_t *self, void *arg, const int *x)
+{
+    const LMS7002M_chan_t channel = *(const LMS7002M_chan_t *)arg;
+    cal_tx_iq_write_dc(self, channel, x[0], x[1]);
+    return cal_read_rssi(self, channel);
+}
+
+static int tx_iq_cal_image_cost(LMS7002M_t *self, void *arg, const int *x)
+{
+    const LMS7002M_chan_t channel = *(const LMS7002M_chan_t *)arg;
+    cal_tx_iq_write_iq(self, channel, x[0], x[1]);
+    return cal_read_rssi(self, channel);
+}
+
+/***********************************************************************
+ * Loopback tone setup
+ * The TX tone is at SXT + f_tone, with SXR at SXT - f_off,
+ * so that the RX sees the tone at f_off + f_tone, the LO leakage
+ * at f_off and the TX image at f_off - f_tone, all on the positive
+ * side where the RX images cannot land. The wider spacing than the
+ * RX calibration allows a decimation by 16 and the shortest RSSI
+ * average, so each measurement takes a fraction of a millisecond.
+ **********************************************************************/
+static int tx_iq_cal_setup(LMS7002M_t *self, const LMS7002M_chan_t channel, double *f_off, double *f_tone)
+{
+    const double rxtsp_rate = self->cgen_freq/4;
+    *f_tone = rxtsp_rate/16;
+
+    LMS7002M_sxx_enable(self, LMS_RX, true);
+    LMS7002M_sxt_to_sxr(self, false);
+    double sxr_actual = 0.0;
+    const int status = cal_set_lo_freq(self, LMS_RX, self->sxr_fref, self->sxt_freq-rxtsp_rate/8, &sxr_actual);
+    if (status != 0)
+    {
+        LMS7_logf(LMS7_ERROR, self, "LMS7002M_set_lo_freq(LMS_RX, %f MHz)", (self->sxt_freq-rxtsp_rate/8)/1e6);
+        return status;
+    }
+    *f_off = self->sxt_freq - sxr_actual;
+
+    cal_iq_loopback(self, channel, *f_tone, 16, 0);
+
+    //the search starts from no correction
+    cal_tx_iq_write_dc(self, channel, 0, 0);
+    cal_tx_iq_write_iq(self, channel, 0, 0);
+    return 0;
+}
+
+/***********************************************************************
+ * Calibrate one channel
+ **********************************************************************/
+static int tx_iq_calibrate(LMS7002M_t *self, const LMS7002M_chan_t channel, LMS7002M_iq_cal_t *result)
+{
+    const double rxtsp_rate = self->cgen_freq/4;
+    LMS7002M_chan_t arg = channel;
+    LMS7002M_iq_cal_t cal;
+    memset(&cal, 0, sizeof(cal));
+    cal.freq = self->sxt_freq;
+    const long long t0 = LMS7_time_now();
+
+    //the TX LO stays, the RX LO returns to its frequency after
+    LMS7002M_regs_t saved_map[2];
+    memcpy(saved_map, self->_regs, sizeof(saved_map));
+    const double sxr_freq = self->sxr_freq;
+    const double sxr_fref = self->sxr_fref;
+
+    double f_off = 0.0, f_tone = 0.0;
+    int status = tx_iq_cal_setup(self, channel, &f_off, &f_tone);
+    if (status != 0) goto done;
+
+    //--- tone level ---
+    LMS7002M_rxtsp_set_freq(self, channel, (f_off+f_tone)/rxtsp_rate);
+    cal.tone_rssi = cal_read_rssi(self, channel);
+    cal.probes++;
+    if (cal.tone_rssi < TX_IQ_CAL_MIN_TONE)
+    {
+        LMS7_logf(LMS7_ERROR, self, "TX IQ cal [%c]: loopback tone RSSI %d too low", channel, cal.tone_rssi);
+        status = -1;
+        goto done;
+    }
+
+    //--- LO leakage ---
+    {
+        LMS7002M_rxtsp_set_freq(self, channel, f_off/rxtsp_rate);
+        int x[2] = {0, 0};
+        const int x_min[2] = {-128, -128};
+        const int x_max[2] = {127, 127};
+        const int step[2] = {16, 16};
+        cal.dc_rssi[0] = tx_iq_cal_dc_cost(self, &arg, x);
+        cal.probes += 1 + cal_minimize(self, tx_iq_cal_dc_cost, &arg, 2, x, x_min, x_max, step, TX_IQ_CAL_MAX_PROBES);
+        cal_tx_iq_write_dc(self, channel, x[0], x[1]);
+        cal.dc_i = x[0];
+        cal.dc_q = x[1];
+        cal.dc_rssi[1] = cal_read_rssi(self, channel);
+        cal.probes++;
+    }
+
+    //--- IQ imbalance at the image of the tone ---
+    {
+        LMS7002M_rxtsp_set_freq(self, channel, (f_off-f_tone)/rxtsp_rate);
+        int x[2] = {0, 0};
+        const int x_min[2] = {-512, -512};
+        const int x_max[2] = {512, 512};
+        const int step[2] = {64, 64};
+        cal.image_rssi[0] = tx_iq_cal_image_cost(self, &arg, x);
+        cal.probes += 1 + cal_minimize(self, tx_iq_cal_image_cost, &arg, 2, x, x_min, x_max, step, TX_IQ_CAL_MAX_PROBES);
+        cal_tx_iq_write_iq(self, channel, x[0], x[1]);
+        cal.gain = x[0];
+        cal.phase = x[1];
+        cal.image_rssi[1] = cal_read_rssi(self, channel);
+        cal.probes++;
+    }
+
+    cal.elapsed = LMS7_time_now() - t0;
+    LMS7_logf(LMS7_INFO, self, "TX IQ cal [%c] %f MHz: DC %d,%d (LO RSSI %d -> %d), IQ %d,%d (image RSSI %d -> %d, tone %d), %d probes, %f ms",
+        channel, cal.freq/1e6, cal.dc_i, cal.dc_q, cal.dc_rssi[0], cal.dc_rssi[1],
+        cal.gain, cal.phase, cal.image_rssi[0], cal.image_rssi[1], cal.tone_rssi, cal.probes,
+        (1e3*cal.elapsed)/LMS7_time_tps());
+
+    done:
+    //only the registers the calibration changed go back
+    cal_restore_regs(self, saved_map);
+    self->sxr_freq = sxr_freq;
+    self->sxr_fref = sxr_fref;
+
+    if (status != 0) return status;
+    cal_tx_iq_write_dc(self, channel, cal.dc_i, cal.dc_q);
+    cal_tx_iq_write_iq(self, channel, cal.gain, cal.phase);
+    cal_iq_store(self, LMS_TX, channel, &cal);
+    if (result != NULL) *result = cal;
+    return 0;
+}
+
+int LMS7002M_tx_iq_calibrate(LMS7002M_t *self, const LMS7002M_chan_t channel, LMS7002M_iq_cal_t *result)
+{
+    if (self->cgen_freq == 0.0 || self->sxt_freq == 0.0 || self->sxr_fref == 0.0)
+    {
+        LMS7_log(LMS7_ERROR, self, "TX IQ cal needs CGEN, SXT and the SXR reference set");
+        return -1;
+    }
+
+    if (channel != LMS_CHAB) return tx_iq_calibrate(self, channel, result);
+
+    const int status = tx_iq_calibrate(self, LMS_CHA, result);
+    if (status != 0) return status;
+    return tx_iq_calibrate(self, LMS_CHB, (result == NULL)?NULL:result+1);
+}
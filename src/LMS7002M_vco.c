@@ -157,3 +157,15 @@ int LMS7002M_tune_vco(
     }
     return 0;
 }
+
+int LMS7002M_check_vco(
+    LMS7002M_t *self,
+    int *vco_cmpho_reg,
+    int *vco_cmplo_reg,
+    const int vco_cmp_addr
+)
+{
+    LMS7002M_read_vco_cmp(self, vco_cmp_addr);
+    LMS7_logf(LMS7_DEBUG, self, "hi=%d, lo=%d", *vco_cmpho_reg, *vco_cmplo_reg);
+    return (*vco_cmpho_reg != 0 && *vco_cmplo_reg == 0)?0:-1;
+}
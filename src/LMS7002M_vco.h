@@ -20,3 +20,14 @@ int LMS7002M_tune_vco(
     int *vco_cmplo_reg,
     const int vco_cmp_addr
 );
+
+/*!
+ * Check the VCO comparators for the current setting.
+ * \return 0 when the VCO is within its tuning window
+ */
+int LMS7002M_check_vco(
+    LMS7002M_t *self,
+    int *vco_cmpho_reg,
+    int *vco_cmplo_reg,
+    const int vco_cmp_addr
+);
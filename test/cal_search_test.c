@@ -0,0 +1,207 @@
+//
+// Test the register search of the filter calibrations against RSSI models
+//
+// The search runs on a monotonic response from seeds off by up to 30%,
+// on a rippled response that forces it to bisect, and on responses that
+// never cross the target. It must end with the result of the binary
+// search it replaced, on the code of a crossing, and on the monotonic
+// response in less than half of the probes of the binary search.
+//
+// Copyright (c) 2016-2017 Fairwaves, Inc.
+// Copyright (c) 2016-2016 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include <LMS7002M/LMS7002M.h>
+#include <LMS7002M/LMS7002M_logger.h>
+#include "LMS7002M_filter_cal.h" //the search is internal to the driver
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "spi_emu.h"
+
+#define REG_MAX 4095 //cfb_tia_rfe
+#define CORNER 800 //the code at -3 dB
+#define TARGET 28284 //-3 dB of the full scale
+
+typedef int (*rssi_model_t)(const int code);
+
+//the RSSI of a lowpass corner moving down as the code rises
+static int monotonic(const int code)
+{
+    return (int)(40000/sqrt(1 + (code/(double)CORNER)*(code/(double)CORNER)));
+}
+
+//the same with a ripple steeper than the slope: not monotonic around the corner
+static int rippled(const int code)
+{
+    return monotonic(code) + (int)(2500*sin(code/20.0));
+}
+
+static const char *result_name(const cal_result_t result)
+{
+    if (result == CAL_OK) return "OK";
+    if (result == CAL_LOW) return "LOW";
+    if (result == CAL_HIGH) return "HIGH";
+    return "NONE";
+}
+
+//the binary search of rx_cal_loop_inner() before the seeded search, its probes
+static int binary_search(rssi_model_t rssi, const int target, cal_result_t *result)
+{
+    int best_lo = -1, best_hi = -1, probes = 0;
+    int range = (REG_MAX + 1) / 2;
+    int reg = range;
+    do {
+        probes++;
+        if (rssi(reg) < target) {
+            best_lo = reg;
+            reg -= range/2;
+        } else {
+            best_hi = reg;
+            reg += range/2;
+        }
+        if (reg < 0) reg = 0;
+        else if (reg > REG_MAX) reg = REG_MAX;
+        range /= 2;
+    } while (range != 0);
+
+    if (best_lo == -1) *result = CAL_LOW;
+    else if (best_hi == -1) *result = CAL_HIGH;
+    else *result = CAL_OK;
+    return probes;
+}
+
+//run a search from a seed, the probes, -1 when it does not end
+static int run_search(LMS7002M_t *lms, rssi_model_t rssi, const int target, const int seed, cal_search_t *s)
+{
+    cal_search_init(s, seed, REG_MAX, target);
+    for (int i = 0; i < MAX_CAL_LOOP_ITERS; i++)
+    {
+        if (cal_search_update(lms, s, rssi(s->code))) return s->probes;
+    }
+    return -1;
+}
+
+//a found code must be the end of a crossing closest to the target
+static bool at_crossing(rssi_model_t rssi, const int target, const int code)
+{
+    for (int hi = code-1; hi <= code; hi++)
+    {
+        if (hi < 0 || hi >= REG_MAX) continue;
+        if (rssi(hi) < target || rssi(hi+1) >= target) continue;
+        const int best = (rssi(hi) - target <= target - rssi(hi+1))?hi:hi+1;
+        if (best == code) return true;
+    }
+    return false;
+}
+
+static int check_search(LMS7002M_t *lms, const char *what, rssi_model_t rssi, const int target,
+    const int seed, const bool bisect, int *probes)
+{
+    cal_result_t old_result;
+    const int old_probes = binary_search(rssi, target, &old_result);
+
+    cal_search_t s;
+    *probes = run_search(lms, rssi, target, seed, &s);
+    printf("%s, seed %d: %s at %d, %d probes, binary search %s in %d probes%s\n", what, seed,
+        result_name(s.result), s.code, *probes, result_name(old_result), old_probes, s.bisect?" (bisect)":"");
+
+    int errors = 0;
+    if (*probes < 0)
+    {
+        printf("  no result after %d probes\n", MAX_CAL_LOOP_ITERS);
+        return 1;
+    }
+    if (s.result != old_result)
+    {
+        printf("  the result differs from the binary search\n");
+        errors++;
+    }
+    if (s.result == CAL_OK && !at_crossing(rssi, target, s.code))
+    {
+        printf("  %d is not the closest code of a crossing\n", s.code);
+        errors++;
+    }
+    if (bisect && !s.bisect)
+    {
+        printf("  the search did not bisect\n");
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    LMS7_set_log_level(LMS7_ERROR);
+
+    spi_emu_t emu;
+    spi_emu_init(&emu, NULL);
+    LMS7002M_t *lms = spi_emu_driver(&emu);
+    if (lms == NULL) return EXIT_FAILURE;
+
+    int errors = 0, probes = 0, searches = 0, total = 0;
+    cal_result_t old_result;
+    const int old_probes = binary_search(monotonic, TARGET, &old_result);
+
+    //monotonic: from seeds within 30% of the corner, less than half of the binary search probes
+    static const double offsets[] = {1.0, 0.7, 0.85, 1.15, 1.3};
+    int monotonic_probes = 0;
+    for (size_t i = 0; i < sizeof(offsets)/sizeof(offsets[0]); i++)
+    {
+        errors += check_search(lms, "monotonic", monotonic, TARGET, (int)(CORNER*offsets[i]), false, &probes);
+        monotonic_probes += probes;
+        total += probes;
+        searches++;
+    }
+    const double mean = monotonic_probes/(double)(sizeof(offsets)/sizeof(offsets[0]));
+    printf("monotonic: %.1f probes per search, binary search %d\n", mean, old_probes);
+    if (!(2*mean < old_probes))
+    {
+        printf("  not less than half of the binary search probes\n");
+        errors++;
+    }
+
+    //a seed far off or at the ends still finds the crossing
+    static const int far_seeds[] = {0, 100, 3000, REG_MAX};
+    for (size_t i = 0; i < sizeof(far_seeds)/sizeof(far_seeds[0]); i++)
+    {
+        errors += check_search(lms, "monotonic", monotonic, TARGET, far_seeds[i], false, &probes);
+        total += probes;
+        searches++;
+    }
+
+    //non-monotonic: the ripple makes the probes leave the bracket
+    static const int rippled_seeds[] = {CORNER, 560, 1040};
+    for (size_t i = 0; i < sizeof(rippled_seeds)/sizeof(rippled_seeds[0]); i++)
+    {
+        errors += check_search(lms, "rippled", rippled, TARGET, rippled_seeds[i], true, &probes);
+        total += probes;
+        searches++;
+    }
+
+    //out of range: every code above the target is CAL_LOW, every code below it CAL_HIGH
+    errors += check_search(lms, "above", monotonic, monotonic(REG_MAX)-1, CORNER, false, &probes);
+    total += probes;
+    searches++;
+    errors += check_search(lms, "below", monotonic, monotonic(0)+1, CORNER, false, &probes);
+    total += probes;
+    searches++;
+
+    //the counters of the driver add up the searches
+    LMS7002M_cal_search_stats_t stats;
+    LMS7002M_cal_search_stats(lms, &stats);
+    if (stats.searches != (unsigned long long)searches || stats.probes != (unsigned long long)total)
+    {
+        printf("  stats: %llu searches %llu probes, expected %d and %d\n", stats.searches, stats.probes, searches, total);
+        errors++;
+    }
+
+    LMS7002M_destroy(lms);
+
+    printf("%s\n", (errors == 0)?"PASS":"FAIL");
+    return (errors == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
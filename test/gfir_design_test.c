@@ -0,0 +1,219 @@
+//
+// Test the GFIR lowpass designs and their predicted response
+//
+// Designs over the ratios 1, 2, 8 and 32 and a few passband widths
+// must hold their taps in the bank order with unity gain at DC, and the
+// ripple and attenuation they report must match an evaluation of the
+// taps on a finer grid. The equiripple designs that fail with -2 must
+// be replaced by the window design in LMS7002M_set_gfir_lowpass() on an
+// emulated chip, and a passband too wide for the rate must fail there.
+//
+// Copyright (c) 2016-2017 Fairwaves, Inc.
+// Copyright (c) 2016-2016 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include <LMS7002M/LMS7002M.h>
+#include <LMS7002M/LMS7002M_logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "spi_emu.h"
+
+#define GRID 4096 //points per band of the evaluation
+
+//the taps of the filter in time order from the bank order
+static int unbank(const LMS7002M_gfir_design_t *design, double *h)
+{
+    int errors = 0;
+    for (size_t r = 0; r < design->ntaps; r++)
+    {
+        const int k = (int)r/8, i = (int)r%8;
+        if (i < design->bank_len) h[k*design->bank_len + i] = design->taps[r]/32767.0;
+        else if (design->taps[r] != 0) errors++;
+    }
+    return errors;
+}
+
+static double response(const double *h, const int len, const double freq)
+{
+    double re = 0.0, im = 0.0;
+    for (int n = 0; n < len; n++)
+    {
+        re += h[n]*cos(2*M_PI*freq*n);
+        im -= h[n]*sin(2*M_PI*freq*n);
+    }
+    return 10*log10(re*re + im*im + 1e-20);
+}
+
+static int check_design(const int method, const int which, const size_t ratio, const double passband, const double stopband)
+{
+    //the ripple of 120 taps is below the double precision of the equiripple design
+    const int exp_ret = (method == LMS7002M_GFIR_REMEZ && which == 3 && ratio >= 8)?-2:0;
+
+    LMS7002M_gfir_spec_t spec;
+    spec.method = method;
+    spec.which = which;
+    spec.ratio = ratio;
+    spec.rate = 1.0;
+    spec.passband = passband;
+    spec.stopband = stopband;
+
+    LMS7002M_gfir_design_t design;
+    const int ret = LMS7002M_gfir_design(&spec, &design);
+    printf("%c GFIR%d ratio %2zu pass %.2f stop %.3f: ", (char)method, which, ratio, passband, stopband);
+    if (ret != 0)
+    {
+        printf("returned %d\n", ret);
+        return (ret == exp_ret)?0:1;
+    }
+    if (exp_ret != 0)
+    {
+        printf("\n  no failure, expected %d\n", exp_ret);
+        return 1;
+    }
+
+    //the layout: bank_len of the 8 registers of each bank
+    const int banks = (which == 3)?15:5;
+    const int bank_len = (ratio < 8)?(int)ratio:8;
+    int errors = 0;
+    double h[LMS7002M_GFIR_MAX_TAPS];
+    memset(h, 0, sizeof(h));
+    if (design.ntaps != (size_t)banks*8 || design.bank_len != bank_len || design.length != banks*bank_len || unbank(&design, h) != 0)
+    {
+        printf("\n  %zu taps, %d per bank, length %d, or taps outside the banks\n", design.ntaps, design.bank_len, design.length);
+        return 1;
+    }
+
+    //unity at DC, within the rounding of the taps
+    double dc = 0.0;
+    for (int n = 0; n < design.length; n++) dc += h[n];
+    const bool unity = fabs(dc - 1.0) <= design.length*0.5/32767;
+
+    double pass_min = HUGE_VAL, pass_max = -HUGE_VAL, stop_max = -HUGE_VAL;
+    for (int i = 0; i <= GRID; i++)
+    {
+        const double p = response(h, design.length, passband*i/GRID);
+        if (p < pass_min) pass_min = p;
+        if (p > pass_max) pass_max = p;
+        const double s = response(h, design.length, stopband + (0.5 - stopband)*i/GRID);
+        if (s > stop_max) stop_max = s;
+    }
+    const double ripple = pass_max - pass_min, atten = -stop_max;
+    printf("ripple %.3f dB (%.3f), attenuation %.1f dB (%.1f)\n", design.passband_ripple, ripple, design.stopband_atten, atten);
+
+    //the reported values come from a coarser grid: no better than the fine one, and close
+    if (!unity)
+    {
+        printf("  DC gain %f\n", dc);
+        errors++;
+    }
+    if (design.passband_ripple > ripple + 1e-6 || design.passband_ripple < 0.9*ripple - 0.01)
+    {
+        printf("  reported ripple %f dB, evaluated %f dB\n", design.passband_ripple, ripple);
+        errors++;
+    }
+    if (design.stopband_atten < atten - 1e-6 || design.stopband_atten > atten + 0.5)
+    {
+        printf("  reported attenuation %f dB, evaluated %f dB\n", design.stopband_atten, atten);
+        errors++;
+    }
+
+    //the shortest filter over the narrowest transition still attenuates
+    if (design.stopband_atten < 15.0)
+    {
+        printf("  attenuation %f dB is no lowpass\n", design.stopband_atten);
+        errors++;
+    }
+    return errors;
+}
+
+static int expect(const bool ok, const char *what)
+{
+    if (!ok) printf("  %s\n", what);
+    return ok?0:1;
+}
+
+//the equiripple design of a filter fails and set_gfir_lowpass() uploads the window design instead
+static int check_fallback(LMS7002M_t *lms, const double rate, const size_t ratio, const double bw, const int which)
+{
+    //the stopband of LMS7002M_set_gfir_lowpass() for a filter this long
+    LMS7002M_gfir_spec_t spec;
+    spec.which = which;
+    spec.ratio = ratio;
+    spec.rate = rate/ratio;
+    spec.passband = bw/2;
+    const int length = ((which == 2)?5:15)*(int)((ratio < 8)?ratio:8);
+    spec.stopband = spec.passband + spec.rate*(40 - 8)/(2.285*2*M_PI*(length - 1));
+    if (spec.stopband < spec.passband*1.1) spec.stopband = spec.passband*1.1;
+    if (spec.stopband > spec.rate*0.495) spec.stopband = spec.rate*0.495;
+
+    int errors = 0;
+    LMS7002M_gfir_design_t remez, kaiser;
+    spec.method = LMS7002M_GFIR_REMEZ;
+    errors += expect(LMS7002M_gfir_design(&spec, &remez) == -2, "the equiripple design did not fail");
+    spec.method = LMS7002M_GFIR_KAISER;
+    errors += expect(LMS7002M_gfir_design(&spec, &kaiser) == 0, "the window design failed");
+
+    LMS7002M_rxtsp_set_decim(lms, LMS_CHA, ratio);
+    const int ret = LMS7002M_set_gfir_lowpass(lms, LMS_RX, LMS_CHA, bw);
+    short taps[120];
+    const bool fallback = ret == 0 && LMS7002M_get_gfir_taps(lms, LMS_RX, LMS_CHA, which, taps, kaiser.ntaps) == 0 &&
+        memcmp(taps, kaiser.taps, kaiser.ntaps*sizeof(short)) == 0;
+    printf("lowpass at %.2f of the rate, ratio %zu: returned %d, GFIR%d %s the window design, %.1f dB\n",
+        bw/spec.rate, ratio, ret, which, fallback?"is":"is not", kaiser.stopband_atten);
+    errors += expect(fallback, "no window design fallback");
+    return errors;
+}
+
+static int check_lowpass(void)
+{
+    spi_emu_t emu;
+    spi_emu_init(&emu, NULL);
+    LMS7002M_t *lms = spi_emu_driver(&emu);
+    if (lms == NULL) return 1;
+
+    double cgen = 0.0;
+    LMS7002M_set_data_clock(lms, 30.72e6, 61.44e6, &cgen);
+    LMS7002M_rxtsp_enable(lms, LMS_CHA, true);
+    const double rate = cgen/4; //the RxTSP rate before the decimation
+
+    //5 taps have no equiripple solution that wide
+    int errors = check_fallback(lms, rate, 1, 0.8*rate, 2);
+
+    //a passband without a 5% transition below 0.495 of the rate
+    const unsigned long writes = emu.writes;
+    errors += expect(LMS7002M_set_gfir_lowpass(lms, LMS_RX, LMS_CHA, 0.95*rate) == -2, "a passband too wide did not fail");
+    errors += expect(emu.writes == writes, "a passband too wide wrote the chip");
+
+    LMS7002M_destroy(lms);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    LMS7_set_log_level(LMS7_ERROR);
+
+    static const size_t ratios[] = {1, 2, 8, 32};
+    static const double passbands[] = {0.05, 0.15, 0.3};
+    int errors = 0;
+    for (size_t r = 0; r < sizeof(ratios)/sizeof(ratios[0]); r++)
+    {
+        for (size_t p = 0; p < sizeof(passbands)/sizeof(passbands[0]); p++)
+        {
+            const double stopband = (passbands[p] + 0.15 < 0.495)?(passbands[p] + 0.15):0.495;
+            for (int which = 1; which <= 3; which++)
+            {
+                errors += check_design(LMS7002M_GFIR_KAISER, which, ratios[r], passbands[p], stopband);
+                errors += check_design(LMS7002M_GFIR_REMEZ, which, ratios[r], passbands[p], stopband);
+            }
+        }
+    }
+    errors += check_lowpass();
+
+    printf("%s\n", (errors == 0)?"PASS":"FAIL");
+    return (errors == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
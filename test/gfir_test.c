@@ -0,0 +1,146 @@
+//
+// Test the differential GFIR tap upload on an emulated chip
+//
+// An upload only writes the taps that differ from what the driver last
+// wrote to the bank: none for the same taps again, one for one changed
+// tap, and all of them for a bank the driver has not written yet.
+// With the readback enabled, a tap the chip does not hold fails the
+// upload with -3 and the next upload writes every tap again.
+//
+// Copyright (c) 2016-2017 Fairwaves, Inc.
+// Copyright (c) 2016-2016 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include <LMS7002M/LMS7002M.h>
+#include <LMS7002M/LMS7002M_logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spi_emu.h"
+
+//register of tap i, the bank order of LMS7002M_set_gfir_taps()
+static int tap_addr(const LMS7002M_dir_t direction, const int which, const size_t i)
+{
+    if (which == 1) return ((direction == LMS_RX)?0x0480:0x0280) + (int)i;
+    if (which == 2) return ((direction == LMS_RX)?0x04c0:0x02c0) + (int)i;
+    return ((direction == LMS_RX)?0x0500:0x0300) + (int)(i/40)*64 + (int)(i%40);
+}
+
+static size_t num_taps(const int which)
+{
+    return (which == 3)?120:40;
+}
+
+static unsigned long tap_writes(spi_emu_t *emu, const LMS7002M_dir_t direction, const int which)
+{
+    unsigned long writes = 0;
+    for (size_t i = 0; i < num_taps(which); i++) writes += emu->writes_at[tap_addr(direction, which, i)];
+    return writes;
+}
+
+//the taps held by a bank of the emulated chip
+static bool chip_has(spi_emu_t *emu, const int bank, const LMS7002M_dir_t direction, const int which, const short *taps)
+{
+    for (size_t i = 0; i < num_taps(which); i++)
+    {
+        if (emu->gfir[bank][tap_addr(direction, which, i)] != (uint16_t)taps[i]) return false;
+    }
+    return true;
+}
+
+//upload and check the return code, the tap words written and the banks holding the taps
+static int upload(LMS7002M_t *lms, spi_emu_t *emu, const char *what,
+    const LMS7002M_dir_t direction, const LMS7002M_chan_t channel, const int which, const short *taps,
+    const int exp_ret, const unsigned long exp_writes)
+{
+    const unsigned long before = tap_writes(emu, direction, which);
+    const int ret = LMS7002M_set_gfir_taps(lms, direction, channel, which, taps, num_taps(which));
+    const unsigned long writes = tap_writes(emu, direction, which) - before;
+
+    int errors = 0;
+    printf("%s %s GFIR%d %s: returned %d, %lu tap words\n", (direction == LMS_RX)?"RX":"TX",
+        (channel == LMS_CHA)?"A":((channel == LMS_CHB)?"B":"AB"), which, what, ret, writes);
+    if (ret != exp_ret || writes != exp_writes)
+    {
+        printf("  expected %d and %lu tap words\n", exp_ret, exp_writes);
+        errors++;
+    }
+    for (int bank = 0; bank < 2 && exp_ret == 0; bank++)
+    {
+        if (channel == ((bank == 0)?LMS_CHB:LMS_CHA)) continue;
+        if (chip_has(emu, bank, direction, which, taps)) continue;
+        printf("  bank %c does not hold the taps\n", 'A'+bank);
+        errors++;
+    }
+    return errors;
+}
+
+static int check_filter(LMS7002M_t *lms, spi_emu_t *emu, const LMS7002M_dir_t direction, const int which)
+{
+    const unsigned long ntaps = num_taps(which);
+    short taps[120], other[120];
+    for (size_t i = 0; i < ntaps; i++) taps[i] = (short)((rand() & 0xffff) - 32768);
+    for (size_t i = 0; i < ntaps; i++) other[i] = taps[i];
+
+    int errors = 0;
+    errors += upload(lms, emu, "first", direction, LMS_CHA, which, taps, 0, ntaps);
+    errors += upload(lms, emu, "again", direction, LMS_CHA, which, taps, 0, 0);
+    taps[ntaps-1] ^= 0x0101;
+    errors += upload(lms, emu, "one tap", direction, LMS_CHA, which, taps, 0, 1);
+    if (chip_has(emu, 1, direction, which, taps))
+    {
+        printf("  bank B was written\n");
+        errors++;
+    }
+
+    //bank B is unknown: every tap goes to both banks, then none
+    errors += upload(lms, emu, "both", direction, LMS_CHAB, which, taps, 0, ntaps);
+    errors += upload(lms, emu, "both again", direction, LMS_CHAB, which, taps, 0, 0);
+    short readback[120];
+    if (LMS7002M_get_gfir_taps(lms, direction, LMS_CHB, which, readback, ntaps) != 0 ||
+        memcmp(readback, taps, ntaps*sizeof(short)) != 0)
+    {
+        printf("  the taps of bank B are not known\n");
+        errors++;
+    }
+
+    //a tap the chip lost fails the readback and makes the bank unknown
+    LMS7002M_set_gfir_verify(lms, true);
+    emu->gfir[0][tap_addr(direction, which, 3)] ^= 0x0010;
+    errors += upload(lms, emu, "lost tap", direction, LMS_CHA, which, taps, -3, 0);
+    if (LMS7002M_get_gfir_taps(lms, direction, LMS_CHA, which, readback, ntaps) != -1)
+    {
+        printf("  the taps of bank A are still known\n");
+        errors++;
+    }
+    errors += upload(lms, emu, "after the loss", direction, LMS_CHA, which, taps, 0, ntaps);
+    errors += upload(lms, emu, "other taps", direction, LMS_CHA, which, other, 0, 1);
+    LMS7002M_set_gfir_verify(lms, false);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    LMS7_set_log_level(LMS7_CRITICAL);
+    srand(1);
+
+    spi_emu_t emu;
+    spi_emu_init(&emu, NULL);
+    LMS7002M_t *lms = spi_emu_driver(&emu);
+    if (lms == NULL) return EXIT_FAILURE;
+
+    int errors = 0;
+    for (int which = 1; which <= 3; which++)
+    {
+        errors += check_filter(lms, &emu, LMS_RX, which);
+        errors += check_filter(lms, &emu, LMS_TX, which);
+    }
+
+    LMS7002M_destroy(lms);
+
+    printf("%s\n", (errors == 0)?"PASS":"FAIL");
+    return (errors == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
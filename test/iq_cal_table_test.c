@@ -0,0 +1,168 @@
+//
+// Test the IQ calibration table file against an emulated chip
+//
+// A table written by hand is loaded, looked up, saved and loaded again
+// by a second driver instance, which must save the same bytes.
+// A table of another chip revision or a truncated one is ignored.
+//
+// Copyright (c) 2016-2017 Fairwaves, Inc.
+// Copyright (c) 2016-2016 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include <LMS7002M/LMS7002M.h>
+#include <LMS7002M/LMS7002M_logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spi_emu.h"
+
+#define CHIP_REV 0x3841
+#define TABLE_PATH "iq_cal_table_test.bin"
+#define SAVED_PATH "iq_cal_table_test_saved.bin"
+
+typedef struct
+{
+    LMS7002M_dir_t direction;
+    LMS7002M_chan_t channel;
+    double freq;
+    int dc_i, dc_q, gain, phase;
+} table_entry_t;
+
+static const table_entry_t entries[] = {
+    {LMS_RX, LMS_CHA, 2.4e9, 5, -7, 100, -200},
+    {LMS_RX, LMS_CHA, 2.5e9, 15, -17, 300, -400},
+    {LMS_TX, LMS_CHB, 1.0e9, -128, 127, -2047, -2048},
+};
+#define NUM_ENTRIES (sizeof(entries)/sizeof(entries[0]))
+
+//the file layout of LMS7002M_iq_cal_save(), little endian
+static void put(FILE *p, const long long value, const int bytes)
+{
+    for (int i = 0; i < bytes; i++) fputc((int)(((unsigned long long)value >> (8*i)) & 0xff), p);
+}
+
+static void write_table(const char *path, const int rev, const size_t num)
+{
+    FILE *p = fopen(path, "wb");
+    fwrite("LMS7IQ", 6, 1, p);
+    put(p, 1, 1); //version
+    put(p, 0, 1);
+    put(p, rev, 2);
+    put(p, NUM_ENTRIES, 2);
+    for (size_t i = 0; i < num; i++)
+    {
+        put(p, entries[i].direction, 1);
+        put(p, entries[i].channel, 1);
+        put(p, (long long)entries[i].freq, 8);
+        put(p, entries[i].dc_i, 2);
+        put(p, entries[i].dc_q, 2);
+        put(p, entries[i].gain, 2);
+        put(p, entries[i].phase, 2);
+    }
+    fclose(p);
+}
+
+static long read_file(const char *path, unsigned char *buff, const size_t size)
+{
+    FILE *p = fopen(path, "rb");
+    if (p == NULL) return -1;
+    const long num = (long)fread(buff, 1, size, p);
+    fclose(p);
+    return num;
+}
+
+static LMS7002M_t *create(spi_emu_t *emu)
+{
+    spi_emu_init(emu, NULL);
+    LMS7002M_regs_set(&emu->regs[0], 0x002f, CHIP_REV);
+    LMS7002M_regs_set(&emu->regs[1], 0x002f, CHIP_REV);
+    LMS7002M_t *lms = spi_emu_driver(emu);
+    if (lms == NULL) return NULL;
+    LMS7002M_set_mac_ch(lms, LMS_CHB); //the revision is global, the MAC must not matter
+    return lms;
+}
+
+static int expect(const bool ok, const char *what)
+{
+    if (!ok) printf("  %s\n", what);
+    return ok?0:1;
+}
+
+//a lookup must give the expected corrections
+static int check_lookup(LMS7002M_t *lms, const char *what, const LMS7002M_dir_t direction, const LMS7002M_chan_t channel,
+    const double freq, const int dc_i, const int dc_q, const int gain, const int phase)
+{
+    LMS7002M_iq_cal_t cal;
+    memset(&cal, 0, sizeof(cal));
+    const int ret = LMS7002M_iq_cal_lookup(lms, direction, channel, freq, &cal);
+    const bool ok = ret == 0 && cal.dc_i == dc_i && cal.dc_q == dc_q && cal.gain == gain && cal.phase == phase;
+    if (!ok) printf("  %s: lookup %d gave %d,%d %d,%d, expected %d,%d %d,%d\n", what, ret,
+        cal.dc_i, cal.dc_q, cal.gain, cal.phase, dc_i, dc_q, gain, phase);
+    return ok?0:1;
+}
+
+static int check_table(LMS7002M_t *lms, const char *what)
+{
+    int errors = 0;
+    for (size_t i = 0; i < NUM_ENTRIES; i++)
+    {
+        errors += check_lookup(lms, what, entries[i].direction, entries[i].channel, entries[i].freq,
+            entries[i].dc_i, entries[i].dc_q, entries[i].gain, entries[i].phase);
+    }
+    errors += check_lookup(lms, what, LMS_RX, LMS_CHA, 2.45e9, 10, -12, 200, -300);
+    LMS7002M_iq_cal_t cal;
+    if (LMS7002M_iq_cal_lookup(lms, LMS_RX, LMS_CHB, 2.4e9, &cal) == 0)
+    {
+        printf("  %s: lookup of an empty channel succeeded\n", what);
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    LMS7_set_log_level(LMS7_ERROR);
+    int errors = 0;
+
+    spi_emu_t emu0, emu1;
+    LMS7002M_t *lms0 = create(&emu0);
+    LMS7002M_t *lms1 = create(&emu1);
+    if (lms0 == NULL || lms1 == NULL) return EXIT_FAILURE;
+
+    //load the table written by hand, save it, and load it again elsewhere
+    write_table(TABLE_PATH, CHIP_REV, NUM_ENTRIES);
+    errors += expect(LMS7002M_iq_cal_load(lms0, TABLE_PATH) == 0, "load failed");
+    errors += check_table(lms0, "loaded");
+    errors += expect(LMS7002M_iq_cal_save(lms0, SAVED_PATH) == 0, "save failed");
+    errors += expect(LMS7002M_iq_cal_load(lms1, SAVED_PATH) == 0, "reload failed");
+    errors += check_table(lms1, "reloaded");
+
+    //a second save of the same table gives the same bytes
+    unsigned char saved[256], resaved[256];
+    const long num_saved = read_file(SAVED_PATH, saved, sizeof(saved));
+    errors += expect(LMS7002M_iq_cal_save(lms1, SAVED_PATH) == 0, "resave failed");
+    const long num_resaved = read_file(SAVED_PATH, resaved, sizeof(resaved));
+    if (num_saved != 12 + 18*(long)NUM_ENTRIES || num_saved != num_resaved || memcmp(saved, resaved, num_saved) != 0)
+    {
+        printf("  saved %ld bytes, then %ld different bytes\n", num_saved, num_resaved);
+        errors++;
+    }
+
+    //another chip revision or a truncated file leave the table alone
+    write_table(TABLE_PATH, CHIP_REV+1, 1);
+    errors += expect(LMS7002M_iq_cal_load(lms1, TABLE_PATH) != 0, "loaded another revision");
+    write_table(TABLE_PATH, CHIP_REV, 1);
+    errors += expect(LMS7002M_iq_cal_load(lms1, TABLE_PATH) != 0, "loaded a truncated table");
+    errors += check_table(lms1, "after the rejected loads");
+
+    remove(TABLE_PATH);
+    remove(SAVED_PATH);
+    LMS7002M_destroy(lms0);
+    LMS7002M_destroy(lms1);
+
+    printf("%s\n", (errors == 0)?"PASS":"FAIL");
+    return (errors == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
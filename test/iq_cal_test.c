@@ -0,0 +1,169 @@
+//
+// Test the RX and TX IQ calibrations on an emulated chip
+//
+// Each channel has a known DC offset (RX: at the RFE, TX: the LO leakage)
+// and a known IQ error before the TSP corrections, the emulated RSSI
+// grows with the residue. Each calibration must find the corrections
+// within a code and leave only its correction registers changed.
+//
+// Copyright (c) 2016-2017 Fairwaves, Inc.
+// Copyright (c) 2016-2016 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include <LMS7002M/LMS7002M.h>
+#include <LMS7002M/LMS7002M_logger.h>
+#include <LMS7002M/LMS7002M_time.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "spi_emu.h"
+
+#define REF_FREQ 30.72e6
+
+//the errors of channel A and B, in correction codes
+static const int gain_err[2] = {-137, 60};
+static const int phase_err[2] = {91, -200};
+static const int rx_dc_err[2][2] = {{17, -9}, {-30, 5}};
+static const int tx_dc_err[2][2] = {{47, -9}, {-100, 35}};
+
+//RFE DCOFF fields are sign and magnitude
+static int sign_mag(const int v)
+{
+    return ((v & 0x40) != 0)?-(v & 0x3f):(v & 0x3f);
+}
+
+//TxTSP DCCORR fields are two's complement bytes
+static int sign_ext8(const int v)
+{
+    return ((v & 0x80) != 0)?(v - 256):v;
+}
+
+static double noise(void)
+{
+    return (rand() % 11) - 5;
+}
+
+static double dc_rssi(const int *err, const int i, const int q, const double scale)
+{
+    const double a = err[0] + i, b = err[1] + q;
+    return scale*sqrt(a*a + b*b) + 30;
+}
+
+//the image of the tone with the GCORRQ, GCORRI and IQCORR fields
+static double image_rssi(const int bank, const int gcorrq, const int gcorri, const int iqcorr)
+{
+    const int gain = (gcorrq < 2047)?(2047 - gcorrq):-(2047 - gcorri);
+    const int phase = ((iqcorr & 0x800) != 0)?(iqcorr - 4096):iqcorr;
+    const double g = gain + gain_err[bank], p = phase + phase_err[bank];
+    return 20000.0*sqrt(g*g + p*p)/4096 + 20;
+}
+
+static int clamp_rssi(const double rssi)
+{
+    return (rssi < 0)?0:(int)rssi;
+}
+
+static int rx_rssi(LMS7002M_regs_t *regs, const int bank)
+{
+    //CMIX bypassed: the DC, NCO at a negative frequency: the image
+    double rssi = 20000;
+    if (regs->reg_0x040c_cmix_byp != 0) rssi = dc_rssi(rx_dc_err[bank],
+        sign_mag(regs->reg_0x010e_dcoffi_rfe), sign_mag(regs->reg_0x010e_dcoffq_rfe), 40);
+    else if (regs->reg_0x0442_fcw0_hi >= 0x8000) rssi = image_rssi(bank,
+        regs->reg_0x0401_gcorrq, regs->reg_0x0402_gcorri, regs->reg_0x0403_iqcorr);
+    return clamp_rssi(rssi + noise());
+}
+
+static int tx_rssi(LMS7002M_regs_t *regs, const int bank)
+{
+    //the RxTSP NCO offset: twice the tone offset is the leakage, the tone offset the image
+    const uint32_t fcw = ((uint32_t)regs->reg_0x0442_fcw0_hi << 16) | regs->reg_0x0443_fcw0_lo;
+    const double offset = fabs((int32_t)fcw/4294967296.0);
+    const bool byp = regs->reg_0x0208_dc_byp != 0;
+    double rssi = 20000;
+    if (fabs(offset - 2/16.0) < 0.01) rssi = dc_rssi(tx_dc_err[bank],
+        byp?0:sign_ext8(regs->reg_0x0204_dccorri), byp?0:sign_ext8(regs->reg_0x0204_dccorrq), 20);
+    else if (fabs(offset - 1/16.0) < 0.01) rssi = image_rssi(bank,
+        regs->reg_0x0201_gcorrq, regs->reg_0x0202_gcorri, regs->reg_0x0203_iqcorr);
+    return clamp_rssi(rssi + noise());
+}
+
+typedef struct
+{
+    const char *name;
+    int (*calibrate)(LMS7002M_t *, const LMS7002M_chan_t, LMS7002M_iq_cal_t *);
+    spi_emu_rssi_t rssi;
+    const int (*dc_err)[2];
+    int allowed[5]; //the correction registers
+} iq_cal_case_t;
+
+static const iq_cal_case_t cases[] = {
+    {"RX", LMS7002M_rx_iq_calibrate, rx_rssi, rx_dc_err, {0x010e, 0x010e, 0x0401, 0x0403, 0}},
+    {"TX", LMS7002M_tx_iq_calibrate, tx_rssi, tx_dc_err, {0x0201, 0x0204, 0}},
+};
+
+static int check(const char *what, const int value, const int expected)
+{
+    const bool ok = abs(value - expected) <= 1;
+    if (!ok) printf("  %s = %d, expected %d\n", what, value, expected);
+    return ok?0:1;
+}
+
+static int run_case(const iq_cal_case_t *c)
+{
+    spi_emu_t emu;
+    spi_emu_init(&emu, c->rssi);
+    LMS7002M_t *lms = spi_emu_driver(&emu);
+    if (lms == NULL) return 1;
+
+    double actual = 0.0;
+    LMS7002M_set_data_clock(lms, REF_FREQ, 61.44e6, &actual);
+    LMS7002M_set_lo_freq(lms, LMS_RX, REF_FREQ, 2.4e9, &actual);
+    LMS7002M_set_lo_freq(lms, LMS_TX, REF_FREQ, 2.45e9, &actual);
+    LMS7002M_regs_to_rfic(lms); //the emulated chip starts equal to the shadow
+
+    LMS7002M_regs_t before[2];
+    memcpy(before, emu.regs, sizeof(before));
+
+    int errors = 0;
+    LMS7002M_iq_cal_t result[2];
+    const int status = c->calibrate(lms, LMS_CHAB, result);
+    if (status != 0)
+    {
+        printf("  %s calibration returned %d\n", c->name, status);
+        errors++;
+    }
+
+    for (int bank = 0; bank < 2 && status == 0; bank++)
+    {
+        printf("%s %c: dc %d,%d gain %d phase %d, %d probes, %.1f ms\n", c->name, 'A'+bank,
+            result[bank].dc_i, result[bank].dc_q, result[bank].gain, result[bank].phase,
+            result[bank].probes, result[bank].elapsed*1e3/LMS7_time_tps());
+        errors += check("dc_i", result[bank].dc_i, -c->dc_err[bank][0]);
+        errors += check("dc_q", result[bank].dc_q, -c->dc_err[bank][1]);
+        errors += check("gain", result[bank].gain, -gain_err[bank]);
+        errors += check("phase", result[bank].phase, -phase_err[bank]);
+    }
+
+    //only the corrections stay behind
+    errors += spi_emu_diff(&emu, before, c->allowed);
+
+    LMS7002M_destroy(lms);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    LMS7_set_log_level(LMS7_WARNING);
+    srand(1);
+
+    int errors = 0;
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) errors += run_case(&cases[i]);
+
+    printf("%s\n", (errors == 0)?"PASS":"FAIL");
+    return (errors == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+//
+// Test the RSSI monitor against an emulated SPI bus
+//
+// Counts the SPI words per sample, and checks that the monitor
+// recovers when another call rewrites the RSSI configuration.
+//
+// Copyright (c) 2016-2017 Fairwaves, Inc.
+// Copyright (c) 2016-2016 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include <LMS7002M/LMS7002M.h>
+#include <LMS7002M/LMS7002M_logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spi_emu.h"
+
+#define NUM_SAMPLES 100
+
+//a distinct RSSI per channel, only when the capture selects the RSSI
+static int emu_rssi(LMS7002M_regs_t *regs, const int bank)
+{
+    const bool valid = regs->reg_0x040c_agc_byp == 0 &&
+        regs->reg_0x040a_agc_mode == REG_0X040A_AGC_MODE_RSSI &&
+        regs->reg_0x0400_capsel == REG_0X0400_CAPSEL_RSSI;
+    return valid?(1000 + 1000*bank):0;
+}
+
+//read samples and count the ones with the wrong RSSI
+static int read_samples(LMS7002M_t *lms, spi_emu_t *emu, const char *what, const int monitored)
+{
+    const unsigned long writes = emu->writes, reads = emu->reads, batches = emu->batches;
+    const unsigned long config = emu->writes_at[0x040a] + emu->writes_at[0x040c];
+    int errors = 0;
+    for (int i = 0; i < NUM_SAMPLES; i++)
+    {
+        LMS7002M_rssi_sample_t sample;
+        if (LMS7002M_rssi_monitor_read(lms, &sample) != 0) errors++;
+        for (int bank = 0; bank < 2; bank++)
+        {
+            const int expected = ((monitored & (1 << bank)) != 0)?(1000 + 1000*bank):-1;
+            if (sample.rssi[bank] != expected) errors++;
+        }
+    }
+    printf("%-28s %5.2f writes %5.2f reads %5.2f batches per sample, %lu config writes, %d errors\n", what,
+        (double)(emu->writes - writes)/NUM_SAMPLES, (double)(emu->reads - reads)/NUM_SAMPLES,
+        (double)(emu->batches - batches)/NUM_SAMPLES,
+        emu->writes_at[0x040a] + emu->writes_at[0x040c] - config, errors);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    LMS7_set_log_level(LMS7_WARNING);
+
+    spi_emu_t emu;
+    spi_emu_init(&emu, emu_rssi);
+    LMS7002M_t *lms = spi_emu_driver(&emu);
+    if (lms == NULL) return EXIT_FAILURE;
+
+    int errors = 0;
+
+    //both channels with the combined capture write
+    LMS7002M_rssi_monitor_start(lms, LMS_CHAB);
+    errors += read_samples(lms, &emu, "CHAB", 0x3);
+
+    //a call that puts the AGC back into bypass on both channels
+    LMS7002M_rxtsp_enable(lms, LMS_CHAB, true);
+    errors += read_samples(lms, &emu, "CHAB after rxtsp_enable", 0x3);
+
+    //a single channel leaves the other one alone
+    LMS7002M_rssi_monitor_start(lms, LMS_CHB);
+    LMS7002M_rxtsp_enable(lms, LMS_CHA, true);
+    const int other = LMS7002M_regs_get(&emu.regs[0], 0x0400);
+    errors += read_samples(lms, &emu, "CHB", 0x2);
+    if (LMS7002M_regs_get(&emu.regs[0], 0x0400) != other)
+    {
+        printf("CHB monitor wrote 0x0400 of channel A\n");
+        errors++;
+    }
+
+    LMS7002M_rssi_monitor_stop(lms);
+    LMS7002M_destroy(lms);
+
+    printf("%s\n", (errors == 0)?"PASS":"FAIL");
+    return (errors == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
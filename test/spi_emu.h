@@ -0,0 +1,136 @@
+//
+// An emulated LMS7002M SPI bus for the tests that run without hardware
+//
+// The register memory has a bank per channel, selected by the MAC field
+// of 0x0020 like on the chip: registers below 0x0100 are global.
+// The GFIR coefficient memories, which the register map does not hold,
+// are kept as plain words per bank. The VCO comparators always read back
+// locked, and a rising edge of the RxTSP capture bit latches the RSSI
+// from the model of the test.
+// The helpers at the end put a driver on the bus and compare the
+// emulated registers against a snapshot.
+//
+// Copyright (c) 2016-2017 Fairwaves, Inc.
+// Copyright (c) 2016-2016 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#pragma once
+#include <LMS7002M/LMS7002M.h>
+#include <LMS7002M/LMS7002M_regs.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+//the RSSI of a bank when its capture bit rises, regs holds the bank registers
+typedef int (*spi_emu_rssi_t)(LMS7002M_regs_t *regs, const int bank);
+
+typedef struct
+{
+    LMS7002M_regs_t regs[2];
+    uint16_t gfir[2][0x0800]; //GFIR coefficients by address
+    int mac;
+    int latched[2];
+    spi_emu_rssi_t rssi;
+    unsigned long writes; //register writes, each batch word counts
+    unsigned long reads;
+    unsigned long batches; //calls to the batch writer
+    unsigned long writes_at[0x0800]; //writes per address
+} spi_emu_t;
+
+static inline void spi_emu_init(spi_emu_t *emu, spi_emu_rssi_t rssi)
+{
+    memset(emu, 0, sizeof(*emu));
+    emu->mac = REG_0X0020_MAC_CHA;
+    emu->rssi = rssi;
+}
+
+//the TxTSP and RxTSP GFIR coefficient memories
+static inline bool spi_emu_is_gfir(const int addr)
+{
+    return (addr >= 0x0280 && addr < 0x0400) || (addr >= 0x0480 && addr < 0x0600);
+}
+
+static inline void spi_emu_write(spi_emu_t *emu, const int addr, const int value)
+{
+    emu->writes++;
+    emu->writes_at[addr & 0x7ff]++;
+    if (addr == 0x0020) emu->mac = value & 0x3;
+
+    for (int bank = 0; bank < 2; bank++)
+    {
+        if (addr >= 0x0100 && (emu->mac & (1 << bank)) == 0) continue;
+        if (spi_emu_is_gfir(addr))
+        {
+            emu->gfir[bank][addr] = (uint16_t)value;
+            continue;
+        }
+        LMS7002M_regs_t *regs = &emu->regs[bank];
+        const int capture = regs->reg_0x0400_capture;
+        LMS7002M_regs_set(regs, addr, value);
+        if (addr == 0x0400 && capture == 0 && regs->reg_0x0400_capture != 0)
+        {
+            emu->latched[bank] = (emu->rssi == NULL)?0:emu->rssi(regs, bank);
+        }
+    }
+}
+
+static inline uint32_t spi_emu_transact(void *handle, const uint32_t data, const bool readback)
+{
+    spi_emu_t *emu = (spi_emu_t *)handle;
+    const int addr = (data >> 16) & 0x7fff;
+    if (!readback)
+    {
+        spi_emu_write(emu, addr, data & 0xffff);
+        return 0;
+    }
+
+    emu->reads++;
+    const int bank = (emu->mac == REG_0X0020_MAC_CHB)?1:0;
+    if (addr == 0x008c || addr == 0x0123) return 1 << 13; //VCO comparator high
+    if (addr == 0x040e) return emu->latched[bank] & 0x3;
+    if (addr == 0x040f) return (emu->latched[bank] >> 2) & 0xffff;
+    if (spi_emu_is_gfir(addr)) return emu->gfir[bank][addr];
+    return LMS7002M_regs_get(&emu->regs[bank], addr);
+}
+
+static inline void spi_emu_transact_batch(void *handle, const uint32_t *data, const size_t num)
+{
+    spi_emu_t *emu = (spi_emu_t *)handle;
+    emu->batches++;
+    for (size_t i = 0; i < num; i++) spi_emu_write(emu, (data[i] >> 16) & 0x7fff, data[i] & 0xffff);
+}
+
+//a reset driver on an initialized emulated bus, with the batch writer set
+static inline LMS7002M_t *spi_emu_driver(spi_emu_t *emu)
+{
+    LMS7002M_t *lms = LMS7002M_create(spi_emu_transact, emu);
+    if (lms == NULL) return NULL;
+    LMS7002M_set_spi_batch(lms, spi_emu_transact_batch);
+    LMS7002M_reset(lms);
+    return lms;
+}
+
+//print and count the registers that changed since a snapshot of emu->regs,
+//allowed holds first and last address pairs that may change, 0 terminated
+static inline int spi_emu_diff(spi_emu_t *emu, LMS7002M_regs_t *before, const int *allowed)
+{
+    int changed = 0;
+    for (int bank = 0; bank < 2; bank++)
+    {
+        for (const int *addr = LMS7002M_regs_addrs(); *addr != 0; addr++)
+        {
+            if (bank == 1 && *addr < 0x0100) continue;
+            bool skip = false;
+            for (const int *a = allowed; *a != 0; a += 2) skip = skip || (*addr >= a[0] && *addr <= a[1]);
+            const int old = LMS7002M_regs_get(&before[bank], *addr);
+            const int now = LMS7002M_regs_get(&emu->regs[bank], *addr);
+            if (skip || old == now) continue;
+            printf("  %c 0x%04x changed 0x%04x -> 0x%04x\n", 'A'+bank, *addr, old, now);
+            changed++;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,306 @@
+//
+// Test the TSP model against the register conventions of the driver
+//
+// The RX and TX chains are configured through the driver on an emulated
+// chip. With one stage enabled at a time, an impulse through a GFIR
+// gives its taps back in bank order, a DC input through the corrections
+// gives the gain and phase set by set_iq_correction(), and the NCO
+// moves a tone at set_freq(f) to DC (RX) or DC to the tone (TX), on
+// either chip mask. Then with every stage enabled and random full scale
+// GFIR taps, the SIMD kernels processing random samples in uneven blocks
+// must match the scalar kernels processing them in one block.
+//
+// Copyright (c) 2016-2017 Fairwaves, Inc.
+// Copyright (c) 2016-2016 Rice University
+// SPDX-License-Identifier: Apache-2.0
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+#include <LMS7002M/LMS7002M.h>
+#include <LMS7002M/LMS7002M_logger.h>
+#include <LMS7002M/LMS7002M_tsp_model.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "spi_emu.h"
+
+#define NUM_SAMPLES 20000
+#define RATIO 4
+#define NUM_CHECK 256 //samples of the behaviour checks
+#define NCO_FREQ 0.1
+#define NCO_AMPL 16000
+
+static int16_t in[2*NUM_SAMPLES];
+static int16_t out_simd[2*NUM_SAMPLES*RATIO];
+static int16_t out_scalar[2*NUM_SAMPLES*RATIO];
+
+static void random_samples(int16_t *samps, const size_t num)
+{
+    for (size_t i = 0; i < num; i++) samps[i] = (int16_t)((rand() & 0xffff) - 32768);
+}
+
+//a driver on an emulated chip of the given revision, both chains enabled with every stage bypassed
+static LMS7002M_t *create(spi_emu_t *emu, const int rev)
+{
+    spi_emu_init(emu, NULL);
+    LMS7002M_regs_set(&emu->regs[0], 0x002f, rev);
+    LMS7002M_regs_set(&emu->regs[1], 0x002f, rev);
+    LMS7002M_t *lms = spi_emu_driver(emu);
+    if (lms == NULL) return NULL;
+
+    double actual = 0.0;
+    LMS7002M_set_data_clock(lms, 30.72e6, 61.44e6, &actual);
+    LMS7002M_rxtsp_enable(lms, LMS_CHA, true);
+    LMS7002M_txtsp_enable(lms, LMS_CHA, true);
+    return lms;
+}
+
+//process the first NUM_CHECK samples of in into out_scalar, at a ratio of 1
+static int run_model(LMS7002M_t *lms, const LMS7002M_dir_t direction, const char *what)
+{
+    LMS7002M_tsp_model_t *model = LMS7002M_tsp_model_from_chip(lms, direction, LMS_CHA);
+    const size_t num = (model == NULL)?0:LMS7002M_tsp_model_process(model, in, out_scalar, NUM_CHECK);
+    if (model != NULL) LMS7002M_tsp_model_destroy(model);
+    if (num != NUM_CHECK) printf("  %s: %zu samples out of %d\n", what, num, NUM_CHECK);
+    return (num == NUM_CHECK)?0:1;
+}
+
+static int check_sample(const char *what, const size_t n, const double exp_i, const double exp_q, const double tolerance)
+{
+    const int i = out_scalar[2*n], q = out_scalar[2*n+1];
+    const bool ok = fabs(i - exp_i) <= tolerance && fabs(q - exp_q) <= tolerance;
+    if (!ok) printf("  %s: sample %zu is %d,%d, expected %.1f,%.1f\n", what, n, i, q, exp_i, exp_q);
+    return ok?0:1;
+}
+
+//an impulse through each GFIR alone gives tap k*L+i of the filter from register tap k*8+i
+static int check_gfir_impulse(LMS7002M_t *lms, const LMS7002M_dir_t direction, const char *what)
+{
+    //3 taps per bank: the other 5 register taps of each bank hold a value that must not show
+    const int l = 2;
+    LMS7002M_set_mac_ch(lms, LMS_CHA);
+    LMS7002M_regs_t *regs = LMS7002M_regs(lms);
+    if (direction == LMS_RX)
+    {
+        regs->reg_0x0405_gfir1_l = l;
+        regs->reg_0x0406_gfir2_l = l;
+        regs->reg_0x0407_gfir3_l = l;
+    }
+    else
+    {
+        regs->reg_0x0205_gfir1_l = l;
+        regs->reg_0x0206_gfir2_l = l;
+        regs->reg_0x0207_gfir3_l = l;
+    }
+    const int gfir_addr = (direction == LMS_RX)?0x0405:0x0205;
+    for (int j = 0; j < 3; j++) LMS7002M_regs_spi_write(lms, gfir_addr + j);
+
+    int errors = 0;
+    for (int which = 1; which <= 3; which++)
+    {
+        short taps[120];
+        const size_t ntaps = (which == 3)?120:40;
+        for (size_t j = 0; j < ntaps; j++) taps[j] = (short)(((int)(j % 8) <= l)?(1000 + 37*(int)j):12345);
+        for (int other = 1; other <= 3; other++)
+        {
+            if (other == which) LMS7002M_set_gfir_taps(lms, direction, LMS_CHA, other, taps, ntaps);
+            else LMS7002M_set_gfir_taps(lms, direction, LMS_CHA, other, NULL, 0);
+        }
+
+        memset(in, 0, 2*NUM_CHECK*sizeof(in[0]));
+        in[0] = 32767;
+        in[1] = -32767;
+        char name[32];
+        snprintf(name, sizeof(name), "%s GFIR%d impulse", what, which);
+        if (run_model(lms, direction, name) != 0) return 1;
+
+        const size_t len = (ntaps/8)*(l+1);
+        int wrong = 0;
+        for (size_t n = 0; n < NUM_CHECK; n++)
+        {
+            const double h = (n < len)?taps[(n/(l+1))*8 + n%(l+1)]:0;
+            wrong += check_sample(name, n, h, -h, 1);
+        }
+        printf("%s: %zu taps, %d wrong\n", name, len, wrong);
+        errors += wrong;
+    }
+    LMS7002M_set_gfir_taps(lms, direction, LMS_CHA, 3, NULL, 0);
+    return errors;
+}
+
+//a DC input through the gain and phase corrections, with the codes of set_iq_correction()
+static int check_iq_correction(LMS7002M_t *lms, const LMS7002M_dir_t direction, const double phase, const double gain, const char *what)
+{
+    if (direction == LMS_RX) LMS7002M_rxtsp_set_iq_correction(lms, LMS_CHA, phase, gain);
+    else LMS7002M_txtsp_set_iq_correction(lms, LMS_CHA, phase, gain);
+
+    const int dc_i = 12000, dc_q = -7000;
+    for (size_t n = 0; n < NUM_CHECK; n++)
+    {
+        in[2*n] = dc_i;
+        in[2*n+1] = dc_q;
+    }
+    if (run_model(lms, direction, what) != 0) return 1;
+
+    //the gain scales the rail it is below 1 on, the phase adds a part of the corrected I into Q
+    const int gcorri = (gain < 1.0)?(int)(gain*2047):2047;
+    const int gcorrq = (gain > 1.0)?(int)(2047/gain):2047;
+    const int iqcorr = (int)(2047*(phase/(M_PI/2)));
+    const double exp_i = dc_i*gcorri/2047.0;
+    const double exp_q = dc_q*gcorrq/2047.0 + exp_i*sin(iqcorr*(M_PI/2)/2047);
+
+    int errors = 0;
+    for (size_t n = 0; n < NUM_CHECK; n++) errors += check_sample(what, n, exp_i, exp_q, 2);
+    printf("%s: %d,%d to %d,%d\n", what, dc_i, dc_q, out_scalar[0], out_scalar[1]);
+
+    if (direction == LMS_RX) LMS7002M_rxtsp_set_iq_correction(lms, LMS_CHA, 0.0, 1.0);
+    else LMS7002M_txtsp_set_iq_correction(lms, LMS_CHA, 0.0, 1.0);
+    return errors;
+}
+
+//RX: a tone at +NCO_FREQ mixes to DC, TX: DC mixes to a tone at +NCO_FREQ
+static int check_nco(LMS7002M_t *lms, const LMS7002M_dir_t direction, const char *what)
+{
+    if (direction == LMS_RX) LMS7002M_rxtsp_set_freq(lms, LMS_CHA, NCO_FREQ);
+    else LMS7002M_txtsp_set_freq(lms, LMS_CHA, NCO_FREQ);
+
+    for (size_t n = 0; n < NUM_CHECK; n++)
+    {
+        const double phi = (direction == LMS_RX)?(2*M_PI*NCO_FREQ*n):0.0;
+        in[2*n] = (int16_t)lround(NCO_AMPL*cos(phi));
+        in[2*n+1] = (int16_t)lround(NCO_AMPL*sin(phi));
+    }
+    if (run_model(lms, direction, what) != 0) return 1;
+
+    //the 12 bit NCO phase is within a table step: 1% of the amplitude
+    int errors = 0;
+    for (size_t n = 0; n < NUM_CHECK && errors == 0; n++)
+    {
+        const double phi = (direction == LMS_TX)?(2*M_PI*NCO_FREQ*n):0.0;
+        errors += check_sample(what, n, NCO_AMPL*cos(phi), NCO_AMPL*sin(phi), NCO_AMPL/100);
+    }
+    printf("%s: %s\n", what, (errors == 0)?"at the expected frequency":"off frequency");
+
+    if (direction == LMS_RX) LMS7002M_rxtsp_set_freq(lms, LMS_CHA, 0.0);
+    else LMS7002M_txtsp_set_freq(lms, LMS_CHA, 0.0);
+    return errors;
+}
+
+static int check_behaviour(const int rev)
+{
+    spi_emu_t emu;
+    LMS7002M_t *lms = create(&emu, rev);
+    if (lms == NULL) return 1;
+
+    int errors = 0;
+    char what[64];
+    for (int i = 0; i < 2; i++)
+    {
+        const LMS7002M_dir_t direction = (i == 0)?LMS_RX:LMS_TX;
+        const char *dir = (direction == LMS_RX)?"RX":"TX";
+        snprintf(what, sizeof(what), "%s %.4x", dir, rev);
+        errors += check_gfir_impulse(lms, direction, what);
+        snprintf(what, sizeof(what), "%s %.4x gain 0.9 phase 0.1", dir, rev);
+        errors += check_iq_correction(lms, direction, 0.1, 0.9, what);
+        snprintf(what, sizeof(what), "%s %.4x gain 1.1 phase -0.1", dir, rev);
+        errors += check_iq_correction(lms, direction, -0.1, 1.1, what);
+        snprintf(what, sizeof(what), "%s %.4x NCO %g", dir, rev, NCO_FREQ);
+        errors += check_nco(lms, direction, what);
+    }
+
+    LMS7002M_destroy(lms);
+    return errors;
+}
+
+static int compare_kernels(LMS7002M_t *lms, const LMS7002M_dir_t direction, const char *what)
+{
+    LMS7002M_tsp_model_t *simd = LMS7002M_tsp_model_from_chip(lms, direction, LMS_CHA);
+    LMS7002M_tsp_model_t *scalar = LMS7002M_tsp_model_from_chip(lms, direction, LMS_CHA);
+    if (simd == NULL || scalar == NULL)
+    {
+        printf("  %s: no model\n", what);
+        return 1;
+    }
+    LMS7002M_tsp_model_set_simd(scalar, false);
+
+    //uneven blocks carry the filter state across the block edges
+    static const size_t blocks[] = {1, 7, 64, 333, 1000, 3};
+    size_t num_in = 0, num_simd = 0, b = 0;
+    while (num_in < NUM_SAMPLES)
+    {
+        size_t num = blocks[b++ % (sizeof(blocks)/sizeof(blocks[0]))];
+        if (num > NUM_SAMPLES - num_in) num = NUM_SAMPLES - num_in;
+        num_simd += LMS7002M_tsp_model_process(simd, in + 2*num_in, out_simd + 2*num_simd, num);
+        num_in += num;
+    }
+    const size_t num_scalar = LMS7002M_tsp_model_process(scalar, in, out_scalar, NUM_SAMPLES);
+
+    size_t diffs = 0;
+    for (size_t i = 0; i < 2*num_scalar && num_simd == num_scalar; i++)
+    {
+        if (out_simd[i] != out_scalar[i]) diffs++;
+    }
+    printf("%s: ratio %zu, %zu samples out, %zu differ\n", what, LMS7002M_tsp_model_ratio(simd), num_scalar, diffs);
+
+    LMS7002M_tsp_model_destroy(simd);
+    LMS7002M_tsp_model_destroy(scalar);
+    return (num_simd == num_scalar && num_scalar > 0 && diffs == 0)?0:1;
+}
+
+int main(int argc, char **argv)
+{
+    LMS7_set_log_level(LMS7_ERROR);
+    srand(1);
+
+    //the NCO sign of the RX differs between the chip masks
+    int errors = check_behaviour(0x3840);
+    errors += check_behaviour(0x3841);
+
+    spi_emu_t emu;
+    spi_emu_init(&emu, NULL);
+    LMS7002M_t *lms = spi_emu_driver(&emu);
+    if (lms == NULL) return EXIT_FAILURE;
+
+    double actual = 0.0;
+    LMS7002M_set_data_clock(lms, 30.72e6, 61.44e6, &actual);
+    random_samples(in, 2*NUM_SAMPLES);
+
+    for (int i = 0; i < 2; i++)
+    {
+        const LMS7002M_dir_t direction = (i == 0)?LMS_RX:LMS_TX;
+        if (direction == LMS_RX)
+        {
+            LMS7002M_rxtsp_enable(lms, LMS_CHA, true);
+            LMS7002M_rxtsp_set_decim(lms, LMS_CHA, RATIO);
+            LMS7002M_rxtsp_set_freq(lms, LMS_CHA, 0.1);
+            LMS7002M_rxtsp_set_iq_correction(lms, LMS_CHA, 0.1, 0.9);
+        }
+        else
+        {
+            LMS7002M_txtsp_enable(lms, LMS_CHA, true);
+            LMS7002M_txtsp_set_interp(lms, LMS_CHA, RATIO);
+            LMS7002M_txtsp_set_freq(lms, LMS_CHA, 0.05);
+            LMS7002M_txtsp_set_iq_correction(lms, LMS_CHA, -0.1, 1.1);
+            LMS7002M_txtsp_set_dc_correction(lms, LMS_CHA, 0.25, -0.5);
+        }
+
+        //the lowpass enables the filters, random taps replace its own
+        LMS7002M_set_gfir_lowpass(lms, direction, LMS_CHA, 5e6);
+        for (int which = 1; which <= 3; which++)
+        {
+            short taps[120];
+            const size_t ntaps = (which == 3)?120:40;
+            random_samples((int16_t *)taps, ntaps);
+            LMS7002M_set_gfir_taps(lms, direction, LMS_CHA, which, taps, ntaps);
+        }
+
+        errors += compare_kernels(lms, direction, (direction == LMS_RX)?"RX":"TX");
+    }
+
+    LMS7002M_destroy(lms);
+
+    printf("%s\n", (errors == 0)?"PASS":"FAIL");
+    return (errors == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}